@@ -0,0 +1,576 @@
+#include "bench.h"
+#include "cpufx.h"
+#include "cpufx_kernels.h"
+#include "encoder_utils.h"
+#include "log_utils.h"
+#include "scaleconv.h"
+#include "shader_utils.h"
+
+#include <gst/video/video.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+typedef struct _BenchResult {
+    double wall_ms;
+    double cpu_ms;
+} BenchResult;
+
+typedef struct _BenchParams {
+    PipelineConfig *config;
+    int frames;
+    int in_width, in_height;
+    int out_width, out_height;
+} BenchParams;
+
+typedef int (*BenchFn_t)(BenchParams *params);
+
+static int bench_scaleconv(BenchParams *params);
+static int bench_shaders(BenchParams *params);
+static int bench_encoder(BenchParams *params);
+static int bench_cpufx(BenchParams *params);
+
+static const struct {
+    const char* name;
+    BenchFn_t fn;
+    int default_frames;
+} benchmarks[] = {
+    {"scaleconv", bench_scaleconv, BENCH_DEFAULT_FRAMES},
+    {"shaders", bench_shaders, BENCH_SHADER_DEFAULT_FRAMES},
+    {"encoder", bench_encoder, BENCH_DEFAULT_FRAMES},
+    {"cpufx", bench_cpufx, BENCH_GOLDEN_FRAME + 1},
+};
+
+/* Shader suite resolutions & frame budgets */
+static const struct {
+    const char* name;
+    int width, height;
+    double budget_ms;
+} shader_resolutions[] = {
+    {"480p", 640, 480, 4.0},
+    {"1080p", 1920, 1080, 16.6},
+    {"4k", 3840, 2160, 33.3},
+};
+
+static double cpu_time_ms() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec * 1e3 + usage.ru_utime.tv_usec / 1e3 + 
+           usage.ru_stime.tv_sec * 1e3 + usage.ru_stime.tv_usec / 1e3;
+}
+
+static GstElement* create_bench_pipeline(const char* description) {
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(description, &error);
+    if (!pipeline) {
+        ERROR_FMT("Failed to create benchmark pipeline: %s", error ? error->message : "unknown");
+        g_clear_error(&error);
+        return NULL;
+    }
+    return pipeline;
+}
+
+/* Runs a pipeline until EOS, the pipeline is left in the NULL state (caller unrefs) */
+static int run_timed(GstElement *pipeline, BenchResult *result) {
+    double cpu_start = cpu_time_ms();
+    gint64 wall_start = g_get_monotonic_time();
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    result->wall_ms = (g_get_monotonic_time() - wall_start) / 1e3;
+    result->cpu_ms = cpu_time_ms() - cpu_start;
+
+    int ret = RET_OK;
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+        GError *err = NULL;
+        gst_message_parse_error(msg, &err, NULL);
+        ERROR_FMT("Benchmark pipeline failed: %s", err->message);
+        g_clear_error(&err);
+        ret = RET_ERR;
+    }
+
+    gst_message_unref(msg);
+    gst_object_unref(bus);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    return ret;
+}
+
+/* Runs a gst-launch style description until EOS */
+static int run_timed_pipeline(const char* description, BenchResult *result) {
+    GstElement *pipeline = create_bench_pipeline(description);
+    if (!pipeline) 
+        return RET_ERR;
+    int ret = run_timed(pipeline, result);
+    gst_object_unref(pipeline);
+    return ret;
+}
+
+static void print_result(const char* name, BenchParams *params, BenchResult *result, 
+                         BenchResult *baseline, double bytes_per_frame) {
+    double wall_ms = (result->wall_ms - baseline->wall_ms) / params->frames;
+    double cpu_ms = (result->cpu_ms - baseline->cpu_ms) / params->frames;
+    if (wall_ms <= 0.0) wall_ms = 1e-3;
+    printf("%-28s %8.3f ms/frame %8.1f fps %8.3f cpu ms/frame %8.2f MB/frame %8.2f GB/s\n", name, wall_ms, 
+           1e3 / wall_ms, cpu_ms, bytes_per_frame / 1e6, bytes_per_frame / (wall_ms * 1e6));
+}
+
+/* Fused scale + convert vs videoscale ! videoconvert, RGBA input to I420 output */
+static int bench_scaleconv(BenchParams *params) {
+    BenchResult baseline = {0}, result = {0};
+    char description[1024];
+    int num_cores = g_get_num_processors();
+
+    CHECK(register_scaleconv_element() == RET_OK, "Failed to register scale & convert element", RET_ERR);
+
+    /* Memory traffic estimate per frame: every pass reads its input & writes its output once */
+    double out_rgba = (double)params->out_width * params->out_height * 4;
+    double out_i420 = (double)params->out_width * params->out_height * 3 / 2;
+    /* Bilinear only touches two source rows per output row */
+    int rows_read = MIN(params->in_height, 2 * params->out_height);
+    double in_rgba = (double)params->in_width * rows_read * 4;
+    double separate_bytes = (in_rgba + out_rgba) + (out_rgba + out_i420);
+    double fused_bytes = in_rgba + out_i420;
+
+    #define BENCH_SOURCE "videotestsrc num-buffers=%d pattern=smpte ! video/x-raw,format=RGBA,width=%d,height=%d ! "
+    #define BENCH_SINK " ! video/x-raw,format=I420,width=%d,height=%d ! fakesink sync=false"
+
+    printf("scaleconv: %dx%d RGBA -> %dx%d I420, %d frames\n", params->in_width, params->in_height, 
+           params->out_width, params->out_height, params->frames);
+
+    /* 1) Source only */
+    snprintf(description, sizeof(description), BENCH_SOURCE "fakesink sync=false", 
+             params->frames, params->in_width, params->in_height);
+    CHECK(run_timed_pipeline(description, &baseline) == RET_OK, "Failed to run baseline", RET_ERR);
+
+    /* 2) Single threaded & one thread per core */
+    int thread_counts[] = {1, num_cores};
+    for (int idx = 0; idx < 2; idx++) {
+        char name[64];
+        int threads = thread_counts[idx];
+        
+        snprintf(description, sizeof(description), 
+                 BENCH_SOURCE "videoscale n-threads=%d ! video/x-raw,width=%d,height=%d ! videoconvert n-threads=%d" BENCH_SINK,
+                 params->frames, params->in_width, params->in_height, threads, params->out_width, 
+                 params->out_height, threads, params->out_width, params->out_height);
+        CHECK(run_timed_pipeline(description, &result) == RET_OK, "Failed to run videoscale ! videoconvert", RET_ERR);
+        snprintf(name, sizeof(name), "separate (%d threads)", threads);
+        print_result(name, params, &result, &baseline, separate_bytes);
+
+        snprintf(description, sizeof(description), BENCH_SOURCE "rtvppscaleconv threads=%d" BENCH_SINK,
+                 params->frames, params->in_width, params->in_height, threads, params->out_width, params->out_height);
+        CHECK(run_timed_pipeline(description, &result) == RET_OK, "Failed to run rtvppscaleconv", RET_ERR);
+        snprintf(name, sizeof(name), "fused (%d threads)", threads);
+        print_result(name, params, &result, &baseline, fused_bytes);
+    }
+    printf("MB/frame is an estimate assuming each pass streams its input and output through memory once\n");
+    return RET_OK;
+}
+
+/* Encoded bytes & frames held by the encoder, both probes run on the source streaming thread */
+typedef struct _BenchEncoderStats {
+    guint64 bytes;
+    int frames_in;
+    int frames_out;
+    int max_delay;
+} BenchEncoderStats;
+
+static GstPadProbeReturn bench_encoder_in_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    ((BenchEncoderStats*)user_data)->frames_in++;
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn bench_encoder_out_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    BenchEncoderStats *stats = (BenchEncoderStats*)user_data;
+    stats->bytes += gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info));
+    stats->frames_out++;
+    /* Frames in but not out when a frame leaves: threads, lookahead & B-frames delay */
+    stats->max_delay = MAX(stats->max_delay, stats->frames_in - stats->frames_out);
+    return GST_PAD_PROBE_OK;
+}
+
+/* Every encoder profile on the output size, I420 frames of an animated zone plate (detail & motion everywhere, 
+   hard on the rate control). Threads are sized as in the live pipeline for the cores of this process */
+static int bench_encoder(BenchParams *params) {
+    BenchResult baseline = {0}, result = {0};
+    char description[1024];
+    int num_cores = count_encoder_cores(NULL);
+    int bitrate = params->config->bitrate;
+    CHECK(bitrate > 0, "Encoder benchmark needs a positive --bitrate", RET_ERR);
+    CamParams frame = {
+        .width = params->out_width, 
+        .height = params->out_height, 
+        .fr_num = 1, 
+        .fr_denom = BENCH_ENCODER_FPS, 
+    };
+
+    #define BENCH_ENCODER_SOURCE "videotestsrc num-buffers=%d pattern=zone-plate kx2=20 ky2=20 kt=1 ! " \
+                                 "video/x-raw,format=I420,width=%d,height=%d,framerate=%d/1 ! "
+
+    printf("encoder: %dx%d I420 @ %d fps, %d kbps, %d frames, %d cores\n", params->out_width, params->out_height, 
+           BENCH_ENCODER_FPS, bitrate, params->frames, num_cores);
+
+    /* 1) Source only */
+    snprintf(description, sizeof(description), BENCH_ENCODER_SOURCE "fakesink sync=false", 
+             params->frames, params->out_width, params->out_height, BENCH_ENCODER_FPS);
+    CHECK(run_timed_pipeline(description, &baseline) == RET_OK, "Failed to run baseline", RET_ERR);
+
+    /* 2) One run per profile, configured exactly as the live encoder */
+    snprintf(description, sizeof(description), BENCH_ENCODER_SOURCE "x264enc name=enc ! fakesink sync=false", 
+             params->frames, params->out_width, params->out_height, BENCH_ENCODER_FPS);
+    const EncoderProfile *profile;
+    for (int idx = 0; (profile = get_encoder_profile(idx)) != NULL; idx++) {
+        BenchEncoderStats stats = {0};
+        GstElement *pipeline = create_bench_pipeline(description);
+        CHECK(pipeline != NULL, "Failed to create encoder pipeline", RET_ERR);
+        GstElement *encoder = gst_bin_get_by_name(GST_BIN(pipeline), "enc");
+        configure_encoder(encoder, profile, bitrate, &frame, num_cores, profile->name);
+
+        GstPad *enc_sink = gst_element_get_static_pad(encoder, "sink");
+        GstPad *enc_src = gst_element_get_static_pad(encoder, "src");
+        gst_pad_add_probe(enc_sink, GST_PAD_PROBE_TYPE_BUFFER, bench_encoder_in_probe, &stats, NULL);
+        gst_pad_add_probe(enc_src, GST_PAD_PROBE_TYPE_BUFFER, bench_encoder_out_probe, &stats, NULL);
+        gst_object_unref(enc_sink);
+        gst_object_unref(enc_src);
+        gst_object_unref(encoder);
+
+        int ret = run_timed(pipeline, &result);
+        gst_object_unref(pipeline);
+        CHECK(ret == RET_OK, "Failed to run encoder", RET_ERR);
+
+        /* Bitrate over the stream duration, not the (faster than real time) run */
+        double wall_ms = MAX(1e-3, (result.wall_ms - baseline.wall_ms) / params->frames);
+        double cpu_ms = (result.cpu_ms - baseline.cpu_ms) / params->frames;
+        double kbps = stats.bytes * 8.0 * BENCH_ENCODER_FPS / MAX(1, stats.frames_out) / 1e3;
+        printf("%-20s %8.3f ms/frame %8.1f fps %8.3f cpu ms/frame %8.0f kbps %6.1f%% of target %3d frames delay\n", 
+               profile->name, wall_ms, 1e3 / wall_ms, cpu_ms, kbps, 100.0 * kbps / bitrate, stats.max_delay);
+    }
+    printf("ms/frame is the throughput with all encoder threads busy, frames delay adds to the latency of each frame\n");
+    return RET_OK;
+}
+
+/* Shader suite pipelines: RGBA test frames uploaded, optionally rendered by a single glshader & downloaded */
+#define BENCH_SHADER_SOURCE "videotestsrc num-buffers=%d pattern=smpte ! video/x-raw,format=RGBA,width=%d,height=%d,framerate=30/1 ! glupload ! "
+#define BENCH_SHADER_DOWNLOAD "gldownload ! video/x-raw,format=RGBA ! "
+#define BENCH_LAST_FRAME_SINK "fakesink name=sink sync=false enable-last-sample=true"
+
+static GstElement* create_shader_pipeline(const char* shader_name, int frames, int width, int height, const char* sink) {
+    char description[1024];
+    snprintf(description, sizeof(description), BENCH_SHADER_SOURCE "%s" BENCH_SHADER_DOWNLOAD "%s", 
+             frames, width, height, shader_name ? "glshader name=shader ! " : "", sink);
+    GstElement *pipeline = create_bench_pipeline(description);
+    if (!pipeline || !shader_name) 
+        return pipeline;
+
+    /* Shader code can not go through the launch description */
+    GstElement *shader = gst_bin_get_by_name(GST_BIN(pipeline), "shader");
+    g_object_set(G_OBJECT(shader), "fragment", get_shader_code(shader_name), 
+                                   "vertex", shader_string_vertex_default, NULL);
+    gst_object_unref(shader);
+    return pipeline;
+}
+
+/* Runs the pipeline to EOS & returns the last frame reaching its "sink" fakesink */
+static GstSample* run_last_frame_pipeline(GstElement *pipeline) {
+    BenchResult result;
+    GstSample *sample = NULL;
+    if (!pipeline) 
+        return NULL;
+    if (run_timed(pipeline, &result) == RET_OK) {
+        GstElement *sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+        g_object_get(G_OBJECT(sink), "last-sample", &sample, NULL);
+        gst_object_unref(sink);
+    }
+    gst_object_unref(pipeline);
+    return sample;
+}
+
+/* Returns the largest per channel difference & the share of pixels above the tolerance, RET_ERR if sizes differ */
+static int compare_frames(GstSample *output, GstSample *golden, int *out_max_diff, double *out_bad_share) {
+    GstVideoInfo out_info, golden_info;
+    GstVideoFrame out_frame, golden_frame;
+    guint64 bad_pixels = 0;
+    int max_diff = 0;
+
+    CHECK(gst_video_info_from_caps(&out_info, gst_sample_get_caps(output)) && 
+          gst_video_info_from_caps(&golden_info, gst_sample_get_caps(golden)), "Failed to read frame format", RET_ERR);
+    CHECK(out_info.width == golden_info.width && out_info.height == golden_info.height, 
+          "Golden image size does not match", RET_ERR);
+    CHECK(gst_video_frame_map(&out_frame, &out_info, gst_sample_get_buffer(output), GST_MAP_READ), 
+          "Failed to map output frame", RET_ERR);
+    if (!gst_video_frame_map(&golden_frame, &golden_info, gst_sample_get_buffer(golden), GST_MAP_READ)) {
+        gst_video_frame_unmap(&out_frame);
+        ERROR("Failed to map golden frame");
+        return RET_ERR;
+    }
+
+    for (int row = 0; row < out_info.height; row++) {
+        const guint8 *out_row = (const guint8*)GST_VIDEO_FRAME_PLANE_DATA(&out_frame, 0) + row * GST_VIDEO_FRAME_PLANE_STRIDE(&out_frame, 0);
+        const guint8 *golden_row = (const guint8*)GST_VIDEO_FRAME_PLANE_DATA(&golden_frame, 0) + row * GST_VIDEO_FRAME_PLANE_STRIDE(&golden_frame, 0);
+        for (int col = 0; col < out_info.width; col++) {
+            int pixel_diff = 0;
+            for (int ch = 0; ch < 4; ch++) {
+                pixel_diff = MAX(pixel_diff, abs(out_row[4 * col + ch] - golden_row[4 * col + ch]));
+            }
+            max_diff = MAX(max_diff, pixel_diff);
+            bad_pixels += (pixel_diff > BENCH_GOLDEN_TOLERANCE);
+        }
+    }
+    gst_video_frame_unmap(&out_frame);
+    gst_video_frame_unmap(&golden_frame);
+
+    *out_max_diff = max_diff;
+    *out_bad_share = (double)bad_pixels / ((double)out_info.width * out_info.height);
+    return RET_OK;
+}
+
+static void add_shader_name(const char* shader_name, void* user_data) {
+    g_ptr_array_add((GPtrArray*)user_data, g_strdup(shader_name));
+}
+
+static gint compare_names(gconstpointer a, gconstpointer b) {
+    return g_strcmp0(*(const gchar**)a, *(const gchar**)b);
+}
+
+/* Reference timings, one "shader,resolution,ms" line each */
+static GHashTable* load_reference_timings(const char* path) {
+    GHashTable *timings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    gchar *contents = NULL;
+    if (!g_file_get_contents(path, &contents, NULL, NULL)) 
+        return timings;
+
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    for (int idx = 0; lines[idx]; idx++) {
+        gchar **fields = g_strsplit(lines[idx], ",", 3);
+        if (g_strv_length(fields) == 3) {
+            double *ms = g_new(double, 1);
+            *ms = g_ascii_strtod(fields[2], NULL);
+            g_hash_table_insert(timings, g_strdup_printf("%s,%s", fields[0], fields[1]), ms);
+        }
+        g_strfreev(fields);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+    return timings;
+}
+
+/* Renders every shader alone at each resolution: ms/frame against the frame budget & the reference timing, 
+   output against the golden image. Runs under software GL so results do not depend on the host GPU */
+static int bench_shaders(BenchParams *params) {
+    const char* shader_folder = params->config->shader_src_folder;
+    const char* golden_folder = params->config->bench_golden ? params->config->bench_golden : BENCH_DEFAULT_GOLDEN_FOLDER;
+    int update = params->config->bench_update;
+    int num_failed = 0, num_runs = 0;
+    GError *error = NULL;
+
+    /* 0) References are made on the reference machine, without them the suite checks nothing */
+    gchar *timings_path = g_build_filename(golden_folder, "timings.csv", NULL);
+    if (!update && !g_file_test(timings_path, G_FILE_TEST_EXISTS)) {
+        printf("shaders: SKIPPED, no reference set in %s. Generate it with --bench-update (make update-shaders) "
+               "on the reference machine & commit it\n", golden_folder);
+        g_free(timings_path);
+        return RET_OK;
+    }
+
+    /* 1) Software GL unless the caller decided otherwise, must be set before the first GL context */
+    if (!g_getenv("LIBGL_ALWAYS_SOFTWARE")) 
+        g_setenv("LIBGL_ALWAYS_SOFTWARE", "1", TRUE);
+
+    /* 2) Collect shaders: embedded ones & the --shader-src-path overrides */
+    if (init_shader_store() != RET_OK || (shader_folder && add_shaders_to_store(shader_folder) != RET_OK)) {
+        ERROR("Failed to load shaders");
+        cleanup_shader_store();
+        g_free(timings_path);
+        return RET_ERR;
+    }
+    GPtrArray *shaders = g_ptr_array_new_with_free_func(g_free);
+    visit_shaders(add_shader_name, shaders);
+    g_ptr_array_sort(shaders, compare_names);
+
+    GHashTable *reference = load_reference_timings(timings_path);
+    GString *timings = g_string_new(NULL);
+    if (update) 
+        g_mkdir_with_parents(golden_folder, 0755);
+
+    printf("shaders: %u shaders, %d frames per run, %s GL, golden images in %s%s\n", shaders->len, params->frames, 
+           g_strcmp0(g_getenv("LIBGL_ALWAYS_SOFTWARE"), "1") == 0 ? "software" : "default", golden_folder, 
+           update ? " (updating)" : "");
+
+    for (size_t res = 0; res < sizeof(shader_resolutions) / sizeof(shader_resolutions[0]); res++) {
+        int width = shader_resolutions[res].width, height = shader_resolutions[res].height;
+        BenchResult baseline = {0}, result = {0};
+        char sink[512];
+
+        /* 3) Upload & download only, subtracted from every shader run */
+        GstElement *pipeline = create_shader_pipeline(NULL, params->frames, width, height, "fakesink sync=false");
+        if (!pipeline || run_timed(pipeline, &baseline) != RET_OK) {
+            ERROR("Failed to run baseline");
+            if (pipeline) 
+                gst_object_unref(pipeline);
+            num_failed++;
+            goto cleanup;
+        }
+        gst_object_unref(pipeline);
+
+        for (guint idx = 0; idx < shaders->len; idx++) {
+            const char* name = g_ptr_array_index(shaders, idx);
+            gchar *key = g_strdup_printf("%s,%s", name, shader_resolutions[res].name);
+            gchar *golden_path = g_strdup_printf("%s/%s-%s.png", golden_folder, name, shader_resolutions[res].name);
+            GString *failures = g_string_new(NULL);
+            num_runs++;
+
+            /* 4) Timing against the frame budget & the reference */
+            double ms = -1.0;
+            pipeline = create_shader_pipeline(name, params->frames, width, height, "fakesink sync=false");
+            if (pipeline && run_timed(pipeline, &result) == RET_OK) 
+                ms = MAX((result.wall_ms - baseline.wall_ms) / params->frames, 0.0);
+            if (pipeline) 
+                gst_object_unref(pipeline);
+            double *ref_ms = g_hash_table_lookup(reference, key);
+            if (ms < 0.0) {
+                g_string_append(failures, " render");
+            } else {
+                if (ms > shader_resolutions[res].budget_ms) 
+                    g_string_append(failures, " budget");
+                /* A shader without reference is a suite that was not regenerated, not a pass */
+                if (!update && !ref_ms) 
+                    g_string_append(failures, " no-ref");
+                else if (!update && ms > *ref_ms * (1.0 + BENCH_SHADER_MAX_REGRESSION)) 
+                    g_string_append(failures, " regression");
+                g_string_append_printf(timings, "%s,%.3f\n", key, ms);
+            }
+
+            /* 5) Golden image: rewritten (PNG) or compared */
+            int max_diff = -1;
+            double bad_share = 0.0;
+            if (update) {
+                snprintf(sink, sizeof(sink), "pngenc ! multifilesink location=%s", golden_path);
+                pipeline = create_shader_pipeline(name, BENCH_GOLDEN_FRAME + 1, width, height, sink);
+                if (!pipeline || run_timed(pipeline, &result) != RET_OK) 
+                    g_string_append(failures, " golden-write");
+                if (pipeline) 
+                    gst_object_unref(pipeline);
+            } else if (g_file_test(golden_path, G_FILE_TEST_EXISTS)) {
+                GstSample *output = run_last_frame_pipeline(
+                    create_shader_pipeline(name, BENCH_GOLDEN_FRAME + 1, width, height, BENCH_LAST_FRAME_SINK));
+                snprintf(sink, sizeof(sink), "filesrc location=%s ! pngdec ! videoconvert ! video/x-raw,format=RGBA ! " 
+                         BENCH_LAST_FRAME_SINK, golden_path);
+                GstSample *golden = run_last_frame_pipeline(create_bench_pipeline(sink));
+                if (!output || !golden || compare_frames(output, golden, &max_diff, &bad_share) != RET_OK) 
+                    g_string_append(failures, " golden");
+                else if (bad_share > BENCH_GOLDEN_MAX_BAD_PIXELS) 
+                    g_string_append(failures, " mismatch");
+                if (output) gst_sample_unref(output);
+                if (golden) gst_sample_unref(golden);
+            } else {
+                g_string_append(failures, " no-golden");
+            }
+
+            printf("%-20s %-6s %8.3f ms/frame  budget %5.1f  ref %8.3f  golden %s%3d %7.3f%%  %s%s\n", 
+                   name, shader_resolutions[res].name, ms, shader_resolutions[res].budget_ms, ref_ms ? *ref_ms : 0.0, 
+                   max_diff < 0 ? "n/a " : "diff", MAX(max_diff, 0), bad_share * 100.0, 
+                   failures->len ? "FAIL" : "ok", failures->str);
+            num_failed += failures->len > 0;
+            g_string_free(failures, TRUE);
+            g_free(golden_path);
+            g_free(key);
+        }
+    }
+
+    /* 6) Reference timings come from the machine the goldens were made on */
+    if (update && !g_file_set_contents(timings_path, timings->str, -1, &error)) {
+        ERROR_FMT("Failed to write %s: %s", timings_path, error->message);
+        g_clear_error(&error);
+        num_failed++;
+    }
+    printf("%d/%d shader runs passed (budget, >%.0f%% regression, golden tolerance %d with %.1f%% outliers)\n", 
+           num_runs - num_failed, num_runs, BENCH_SHADER_MAX_REGRESSION * 100, BENCH_GOLDEN_TOLERANCE, 
+           BENCH_GOLDEN_MAX_BAD_PIXELS * 100);
+
+cleanup:
+    g_string_free(timings, TRUE);
+    g_hash_table_destroy(reference);
+    g_free(timings_path);
+    g_ptr_array_free(shaders, TRUE);
+    cleanup_shader_store();
+    return num_failed ? RET_ERR : RET_OK;
+}
+
+/* Renders every effect with a CPU implementation through glshader & rtvppcpufx (SIMD, then scalar kernels) on 
+   the same test frames & checks the largest per channel difference of the last frame */
+static int bench_cpufx(BenchParams *params) {
+    int num_failed = 0, num_runs = 0;
+    char sink[512];
+
+    CHECK(register_cpufx_element() == RET_OK, "Failed to register CPU effect element", RET_ERR);
+    CHECK(init_shader_store() == RET_OK, "Failed to create shader store", RET_ERR);
+    GPtrArray *shaders = g_ptr_array_new_with_free_func(g_free);
+    visit_shaders(add_shader_name, shaders);
+    g_ptr_array_sort(shaders, compare_names);
+
+    printf("cpufx: %dx%d RGBA, frame %d, simd=%s, tolerance %d per channel\n", params->in_width, params->in_height, 
+           params->frames - 1, cpufx_simd_level(), BENCH_CPUFX_TOLERANCE);
+    for (guint idx = 0; idx < shaders->len; idx++) {
+        const char* name = g_ptr_array_index(shaders, idx);
+        if (!cpufx_supports_effect(name)) 
+            continue;
+
+        /* 1) GLSL reference */
+        GstSample *reference = run_last_frame_pipeline(
+            create_shader_pipeline(name, params->frames, params->in_width, params->in_height, BENCH_LAST_FRAME_SINK));
+
+        /* 2) SIMD & scalar kernels on the same frames, the time uniform follows the same timestamps */
+        for (int scalar = 0; scalar <= 1; scalar++) {
+            int max_diff = -1;
+            double bad_share = 0.0;
+            cpufx_disable_simd(scalar);
+            snprintf(sink, sizeof(sink), "videotestsrc num-buffers=%d pattern=smpte ! "
+                     "video/x-raw,format=RGBA,width=%d,height=%d,framerate=30/1 ! rtvppcpufx effect=%s ! " 
+                     BENCH_LAST_FRAME_SINK, params->frames, params->in_width, params->in_height, name);
+            GstSample *output = run_last_frame_pipeline(create_bench_pipeline(sink));
+            if (reference && output) 
+                compare_frames(output, reference, &max_diff, &bad_share);
+            int failed = max_diff < 0 || max_diff > BENCH_CPUFX_TOLERANCE;
+
+            printf("%-20s %-6s max diff %3d  %7.3f%% above %d  %s\n", name, scalar ? "scalar" : "simd", 
+                   MAX(max_diff, 0), bad_share * 100.0, BENCH_GOLDEN_TOLERANCE, 
+                   failed ? (max_diff < 0 ? "FAIL render" : "FAIL") : "ok");
+            num_failed += failed;
+            num_runs++;
+            if (output) 
+                gst_sample_unref(output);
+        }
+        cpufx_disable_simd(0);
+        if (reference) 
+            gst_sample_unref(reference);
+    }
+    printf("%d/%d CPU effect runs match the GLSL output\n", num_runs - num_failed, num_runs);
+
+    g_ptr_array_free(shaders, TRUE);
+    cleanup_shader_store();
+    return num_failed ? RET_ERR : RET_OK;
+}
+
+int run_benchmark(PipelineConfig *pipeline_config) {
+    BenchParams params = {
+        .config = pipeline_config,
+        .frames = pipeline_config->bench_frames > 0 ? pipeline_config->bench_frames : BENCH_DEFAULT_FRAMES,
+        .out_width = pipeline_config->out_width > 0 ? pipeline_config->out_width : BENCH_DEFAULT_OUT_WIDTH,
+        .out_height = pipeline_config->out_height > 0 ? pipeline_config->out_height : BENCH_DEFAULT_OUT_HEIGHT,
+    };
+    const char* input = pipeline_config->bench_input ? pipeline_config->bench_input : BENCH_DEFAULT_INPUT;
+    if (sscanf(input, "%dx%d", &params.in_width, &params.in_height) != 2 || 
+        params.in_width <= 0 || params.in_height <= 0) {
+        ERROR_FMT("Invalid benchmark input size [%s], expected <width>x<height>", input);
+        return RET_ERR;
+    }
+
+    for (size_t idx = 0; idx < sizeof(benchmarks) / sizeof(benchmarks[0]); idx++) {
+        if (strcmp(benchmarks[idx].name, pipeline_config->bench) == 0) {
+            if (pipeline_config->bench_frames <= 0) 
+                params.frames = benchmarks[idx].default_frames;
+            return benchmarks[idx].fn(&params);
+        }
+    }
+    ERROR_FMT("Unknown benchmark [%s]", pipeline_config->bench);
+    return RET_ERR;
+}
@@ -0,0 +1,35 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "pipeline.h"
+
+/* Offline benchmarks, no capture device or display needed. Frames come from videotestsrc and
+   every run is compared against a source-only baseline so only the element under test is measured */
+
+/* Defaults used if not set on the command line */
+#define BENCH_DEFAULT_FRAMES 300
+#define BENCH_DEFAULT_INPUT "1920x1080"
+#define BENCH_DEFAULT_OUT_WIDTH 1280
+#define BENCH_DEFAULT_OUT_HEIGHT 720
+
+/* Encoder suite: framerate of the encoded test stream, the bitrate is --bitrate */
+#define BENCH_ENCODER_FPS 30
+
+/* Shader suite: every shader renders in isolation under software GL, is timed & compared to its golden image */
+#define BENCH_SHADER_DEFAULT_FRAMES 60
+#define BENCH_DEFAULT_GOLDEN_FOLDER "./shaders/golden"
+/* Golden images capture this frame (shader time = frame / 30 s) */
+#define BENCH_GOLDEN_FRAME 15
+/* Max per channel difference to the golden image & max share of pixels above it */
+#define BENCH_GOLDEN_TOLERANCE 2
+#define BENCH_GOLDEN_MAX_BAD_PIXELS 0.001
+/* A shader fails if it gets this much slower than its reference timing */
+#define BENCH_SHADER_MAX_REGRESSION 0.25
+
+/* CPU effect suite: max per channel difference between rtvppcpufx (SIMD & scalar kernels) & glshader output */
+#define BENCH_CPUFX_TOLERANCE 2
+
+/* Runs the benchmark selected by pipeline_config->bench */
+int run_benchmark(PipelineConfig *pipeline_config);
+
+#endif
@@ -2,6 +2,7 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <strings.h>
 #include <sys/ioctl.h>
 #include <linux/videodev2.h>
 
@@ -11,9 +12,12 @@
 static const char* map_pix_fmt_to_str[__PIX_FMT_MAX] = {
     [PIX_FMT_YUY2] = "YUY2",
     [PIX_FMT_MJPG] = "MJPG",
+    [PIX_FMT_NV12] = "NV12",
+    [PIX_FMT_H264] = "H264",
     [PIX_FMT_RGB24] = "RGB", 
     [PIX_FMT_BGR24] = "BGR",
     [PIX_FMT_I420] = "I420",  
+    [PIX_FMT_RGBA] = "RGBA",  
     [PIX_FMT_ERROR] = "ERROR"
 };
 const char* pixel_format_to_str(CamPixelFormat fmt) {
@@ -22,6 +26,14 @@ const char* pixel_format_to_str(CamPixelFormat fmt) {
     return map_pix_fmt_to_str[fmt];
 }
 
+CamPixelFormat pixel_format_from_str(const char* str) {
+    for (int fmt = 0; fmt < PIX_FMT_ERROR; fmt++) {
+        if (strcasecmp(str, map_pix_fmt_to_str[fmt]) == 0) 
+            return (CamPixelFormat)fmt;
+    }
+    return PIX_FMT_ERROR;
+}
+
 static void debug_print_fourcc(unsigned int pixel_format) {
     DEBUG_PRINT_FMT("V4L2 Pixel Format: %c%c%c%c\n", 
                     pixel_format & 0xFF,
@@ -38,6 +50,8 @@ static CamPixelFormat convert_v4l2_pixelformat(unsigned int pixel_format) {
         case V4L2_PIX_FMT_RGB24: return PIX_FMT_RGB24;
         case V4L2_PIX_FMT_BGR24: return PIX_FMT_BGR24;
         case V4L2_PIX_FMT_MJPEG: return PIX_FMT_MJPG;
+        case V4L2_PIX_FMT_NV12: return PIX_FMT_NV12;
+        case V4L2_PIX_FMT_H264: return PIX_FMT_H264;
         default: 
             ERROR("Unrecognized pixel format!");
             return PIX_FMT_ERROR;
@@ -90,4 +104,5 @@ int read_cam_params(const char* dev_path, CamParams *out_params) {
 
 void cleanup_cam_params(CamParams *params) {
     free(params->dev_path);
+    free(params->pattern);
 }
\ No newline at end of file
@@ -7,13 +7,33 @@ typedef enum {
     PIX_FMT_BGR24,
     PIX_FMT_I420, 
     PIX_FMT_MJPG, 
+    /* Uploaded to GL as is when possible */
+    PIX_FMT_NV12, 
+    /* Compressed on the camera, forwarded as is or decoded */
+    PIX_FMT_H264, 
+    /* Recordings only, decode stage output format */
+    PIX_FMT_RGBA, 
     PIX_FMT_ERROR,
     __PIX_FMT_MAX
 } CamPixelFormat;
 
+typedef enum {
+    CAM_SOURCE_V4L2,
+    /* Synthetic videotestsrc frames */
+    CAM_SOURCE_PATTERN,
+    /* Container file, decoded by decodebin */
+    CAM_SOURCE_CONTAINER,
+    /* Raw, H.264 or MJPEG stream read from a file or piped on stdin */
+    CAM_SOURCE_STREAM,
+    CAM_SOURCE_STDIN,
+} CamSourceType;
+
 typedef struct _CamParams {
-    /* Source device */
+    /* Source device (or file, or the full source description) */
     char* dev_path;
+    CamSourceType source_type;
+    /* Pattern sources only: videotestsrc pattern name */
+    char* pattern;
 
     /* Frame properties (pixel format & frame dimensions)*/
     CamPixelFormat pixelformat;
@@ -26,6 +46,7 @@ typedef struct _CamParams {
 } CamParams;
 
 const char* pixel_format_to_str(CamPixelFormat fmt);
+CamPixelFormat pixel_format_from_str(const char* str);
 int read_cam_params(const char* dev_path, CamParams *out_params);
 void cleanup_cam_params(CamParams* params);
 
@@ -0,0 +1,279 @@
+#include "complexity_utils.h"
+#include "log_utils.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <gst/video/video.h>
+
+static GstPadProbeReturn analysis_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn encoded_bytes_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static gboolean send_keyframe_cb(gpointer user_data);
+static gboolean update_bitrate(gpointer user_data);
+static gboolean report_bitrate(gpointer user_data);
+static void report_bitrate_window(PipelineHandle *handle, const char* label, gint64 start_us, guint64 start_bytes);
+
+/* Metrics are shared with the main loop as integers */
+#define COMPLEXITY_SCALE 10000.0
+
+int configure_adaptive_bitrate(PipelineHandle *handle) {
+    PipelineConfig *config = handle->config;
+    GstElement *chain[5];
+    int chain_len = 0;
+    if (!config->adaptive_bitrate) 
+        return RET_OK;
+
+    /* 0) Bounds */
+    if (sscanf(config->adaptive_bitrate, "%d-%d", &handle->cpx.min_kbps, &handle->cpx.max_kbps) != 2 || 
+        handle->cpx.min_kbps <= 0 || handle->cpx.max_kbps < handle->cpx.min_kbps) {
+        ERROR_FMT("Invalid adaptive bitrate [%s], expected MIN-MAX in kbps", config->adaptive_bitrate);
+        return RET_ERR;
+    }
+    CHECK(handle->proc.tee != NULL, "Adaptive bitrate needs the processing stage tee", RET_ERR);
+    int use_gl = handle->proc.uploader != NULL;
+
+    /* 1) Leaky queue, analysis never holds back the main output */
+    handle->cpx.queue = gst_element_factory_make("queue", "cpx-queue");
+    CHECK(handle->cpx.queue != NULL, "Failed to allocate queue element", RET_ERR);
+    g_object_set(G_OBJECT(handle->cpx.queue), 
+                "max-size-buffers", 1, 
+                "max-size-bytes", 0, 
+                "max-size-time", (guint64)0, 
+                "leaky", 2, // downstream
+                NULL);
+    chain[chain_len++] = handle->cpx.queue;
+
+    /* 2) Downscale to the analysis size, on the GPU only the tiny frame is downloaded */
+    handle->cpx.scaler = gst_element_factory_make(use_gl ? "glcolorscale" : "videoscale", "cpx-scale");
+    CHECK(handle->cpx.scaler != NULL, "Failed to allocate analysis scaler", RET_ERR);
+    chain[chain_len++] = handle->cpx.scaler;
+
+    handle->cpx.caps_filter = gst_element_factory_make("capsfilter", "cpx-capsfilter");
+    CHECK(handle->cpx.caps_filter != NULL, "Failed to allocate capsfilter", RET_ERR);
+    GstCaps *caps = gst_caps_new_simple("video/x-raw", 
+                                        "format", G_TYPE_STRING, "RGBA", 
+                                        "width", G_TYPE_INT, COMPLEXITY_WIDTH, 
+                                        "height", G_TYPE_INT, COMPLEXITY_HEIGHT, 
+                                        NULL);
+    if (use_gl) 
+        gst_caps_set_features(caps, 0, gst_caps_features_new(GST_CAPS_FEATURE_MEMORY_GL_MEMORY, NULL));
+    g_object_set(G_OBJECT(handle->cpx.caps_filter), "caps", caps, NULL);
+    gst_caps_unref(caps);
+    chain[chain_len++] = handle->cpx.caps_filter;
+
+    if (use_gl) {
+        handle->cpx.downloader = gst_element_factory_make("gldownload", "cpx-download");
+        CHECK(handle->cpx.downloader != NULL, "Failed to allocate gldownload element", RET_ERR);
+        chain[chain_len++] = handle->cpx.downloader;
+    }
+
+    /* 3) Frames end up in a fakesink, analysed from a probe on its input */
+    handle->cpx.sink = gst_element_factory_make("fakesink", "cpx-sink");
+    CHECK(handle->cpx.sink != NULL, "Failed to allocate fakesink element", RET_ERR);
+    g_object_set(G_OBJECT(handle->cpx.sink), "sync", FALSE, "async", FALSE, NULL);
+    chain[chain_len++] = handle->cpx.sink;
+
+    /* 4) Add & link all elements, branch off the processing stage tee */
+    for (int idx = 0; idx < chain_len; idx++) {
+        gst_bin_add(GST_BIN(handle->pipeline), chain[idx]);
+    }
+    for (int idx = 0; idx < chain_len; idx++) {
+        GstElement* prev = idx == 0 ? handle->proc.tee : chain[idx-1];
+        if (!gst_element_link(prev, chain[idx])) {
+            ERROR_FMT("Failed to link %s to %s", GST_ELEMENT_NAME(prev), GST_ELEMENT_NAME(chain[idx]));
+            return RET_ERR;
+        }
+    }
+    GstPad *sink_pad = gst_element_get_static_pad(handle->cpx.sink, "sink");
+    gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, analysis_probe, handle, NULL);
+    gst_object_unref(sink_pad);
+
+    /* 5) Start within bounds */
+    handle->cpx.target_kbps = CLAMP(config->bitrate, handle->cpx.min_kbps, handle->cpx.max_kbps);
+    g_object_set(G_OBJECT(handle->enc.encoder), "bitrate", handle->cpx.target_kbps, NULL);
+    return RET_OK;
+}
+
+int start_adaptive_bitrate(PipelineHandle *handle) {
+    if (!handle->cpx.sink) 
+        return RET_OK;
+
+    GstPad *enc_pad = gst_element_get_static_pad(handle->enc.out_caps_filter, "src");
+    CHECK(enc_pad != NULL, "Failed to get encoding stage output pad", RET_ERR);
+    gst_pad_add_probe(enc_pad, GST_PAD_PROBE_TYPE_BUFFER, encoded_bytes_probe, handle, NULL);
+    gst_object_unref(enc_pad);
+
+    handle->cpx.start_us = handle->cpx.window_start_us = g_get_monotonic_time();
+    handle->cpx.update_source_id = g_timeout_add(COMPLEXITY_UPDATE_INTERVAL_MS, update_bitrate, handle);
+    handle->cpx.report_source_id = g_timeout_add(COMPLEXITY_REPORT_INTERVAL_MS, report_bitrate, handle);
+    DEBUG_PRINT_FMT("Adaptive bitrate enabled: %d-%d kbps (reference %d kbps), analysis at %dx%d\n", 
+                    handle->cpx.min_kbps, handle->cpx.max_kbps, handle->config->bitrate, 
+                    COMPLEXITY_WIDTH, COMPLEXITY_HEIGHT);
+    return RET_OK;
+}
+
+void stop_adaptive_bitrate(PipelineHandle *handle) {
+    if (!handle->cpx.update_source_id) 
+        return;
+    g_source_remove(handle->cpx.update_source_id);
+    g_source_remove(handle->cpx.report_source_id);
+    handle->cpx.update_source_id = handle->cpx.report_source_id = 0;
+    report_bitrate_window(handle, "run", handle->cpx.start_us, 0);
+}
+
+void cleanup_adaptive_bitrate(PipelineHandle *handle) {
+    g_free(handle->cpx.prev_luma);
+    handle->cpx.prev_luma = NULL;
+}
+
+/* Runs on the analysis branch thread: motion (frame difference) & detail (gradient) of the downscaled luma */
+static GstPadProbeReturn analysis_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstVideoInfo video_info;
+    GstVideoFrame frame;
+
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (!caps) 
+        return GST_PAD_PROBE_OK;
+    gboolean valid = gst_video_info_from_caps(&video_info, caps);
+    gst_caps_unref(caps);
+    if (!valid || !gst_video_frame_map(&frame, &video_info, buffer, GST_MAP_READ)) 
+        return GST_PAD_PROBE_OK;
+
+    /* 1) Luma, sums of absolute differences with the previous frame & the left/upper neighbours */
+    int width = GST_VIDEO_FRAME_WIDTH(&frame), height = GST_VIDEO_FRAME_HEIGHT(&frame);
+    int stride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0);
+    const guint8 *pixels = GST_VIDEO_FRAME_PLANE_DATA(&frame, 0);
+    int has_prev = handle->cpx.prev_luma != NULL;
+    if (!has_prev) 
+        handle->cpx.prev_luma = g_malloc(width * height);
+    guint64 motion_sum = 0, detail_sum = 0;
+    for (int y = 0; y < height; y++) {
+        const guint8 *row = pixels + y * stride;
+        /* Rows are overwritten in place, the upper row already holds the current frame */
+        guint8 *luma = handle->cpx.prev_luma + y * width;
+        int left = 0;
+        for (int x = 0; x < width; x++) {
+            int value = (77 * row[4*x] + 150 * row[4*x + 1] + 29 * row[4*x + 2]) >> 8;
+            if (x > 0) detail_sum += abs(value - left);
+            if (y > 0) detail_sum += abs(value - luma[x - width]);
+            if (has_prev) motion_sum += abs(value - luma[x]);
+            luma[x] = left = value;
+        }
+    }
+    gst_video_frame_unmap(&frame);
+
+    double num_pixels = (double)width * height;
+    double motion = has_prev ? motion_sum / (255.0 * num_pixels) : 0.0;
+    double detail = detail_sum / (2 * 255.0 * num_pixels);
+
+    /* 2) Scene cut: sudden motion compared to the recent average */
+    gint64 now_us = g_get_monotonic_time();
+    if (has_prev && motion > COMPLEXITY_SCENE_CUT_MOTION && 
+        motion > COMPLEXITY_SCENE_CUT_RATIO * handle->cpx.motion && 
+        now_us - handle->cpx.last_keyframe_us > COMPLEXITY_MIN_KEYFRAME_INTERVAL_MS * 1000) {
+        handle->cpx.last_keyframe_us = now_us;
+        if (g_atomic_int_compare_and_exchange(&handle->cpx.keyframe_pending, 0, 1)) 
+            g_idle_add(send_keyframe_cb, handle);
+    }
+
+    /* 3) Smooth & publish */
+    handle->cpx.motion += COMPLEXITY_SMOOTHING * (motion - handle->cpx.motion);
+    handle->cpx.detail += COMPLEXITY_SMOOTHING * (detail - handle->cpx.detail);
+    double complexity = CLAMP(COMPLEXITY_MOTION_WEIGHT * handle->cpx.motion + 
+                              COMPLEXITY_DETAIL_WEIGHT * handle->cpx.detail, 0.0, 1.0);
+    g_atomic_int_set(&handle->cpx.complexity, (gint)(complexity * COMPLEXITY_SCALE));
+    g_atomic_int_set(&handle->cpx.motion_scaled, (gint)(handle->cpx.motion * COMPLEXITY_SCALE));
+    g_atomic_int_set(&handle->cpx.detail_scaled, (gint)(handle->cpx.detail * COMPLEXITY_SCALE));
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn encoded_bytes_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    __atomic_fetch_add(&handle->cpx.encoded_bytes, gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info)), 
+                       __ATOMIC_RELAXED);
+    return GST_PAD_PROBE_OK;
+}
+
+static gboolean send_keyframe_cb(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    g_atomic_int_set(&handle->cpx.keyframe_pending, 0);
+
+    /* Upstream request on the encoder output, served with the next encoded frame */
+    GstEvent *event = gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 
+                                                                  ++handle->cpx.window_keyframes);
+    GstPad *enc_src = gst_element_get_static_pad(handle->enc.encoder, "src");
+    gst_pad_send_event(enc_src, event);
+    gst_object_unref(enc_src);
+    return G_SOURCE_REMOVE;
+}
+
+/* Linear map of the complexity onto the bitrate bounds */
+static gboolean update_bitrate(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    double complexity = g_atomic_int_get(&handle->cpx.complexity) / COMPLEXITY_SCALE;
+    int min_kbps = handle->cpx.min_kbps, max_kbps = handle->cpx.max_kbps;
+
+    int target = min_kbps + (int)round(complexity * (max_kbps - min_kbps) / COMPLEXITY_BITRATE_STEP_KBPS) * 
+                 COMPLEXITY_BITRATE_STEP_KBPS;
+    target = CLAMP(target, min_kbps, max_kbps);
+    if (fabs(target - handle->cpx.target_kbps) >= COMPLEXITY_BITRATE_MIN_CHANGE * handle->cpx.target_kbps || 
+        (target != handle->cpx.target_kbps && (target == min_kbps || target == max_kbps))) {
+        handle->cpx.target_kbps = target;
+        g_object_set(G_OBJECT(handle->enc.encoder), "bitrate", target, NULL);
+    }
+
+    /* Window statistics */
+    handle->cpx.window_samples++;
+    handle->cpx.window_complexity_sum += complexity;
+    handle->cpx.window_target_sum += handle->cpx.target_kbps;
+    if (handle->cpx.target_kbps == max_kbps) handle->cpx.window_at_max++;
+    if (handle->cpx.target_kbps == min_kbps) handle->cpx.window_at_min++;
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean report_bitrate(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    guint64 bytes = __atomic_load_n(&handle->cpx.encoded_bytes, __ATOMIC_RELAXED);
+    report_bitrate_window(handle, "window", handle->cpx.window_start_us, handle->cpx.window_start_bytes);
+
+    handle->cpx.total_samples += handle->cpx.window_samples;
+    handle->cpx.total_at_max += handle->cpx.window_at_max;
+    handle->cpx.total_keyframes += handle->cpx.window_keyframes;
+    handle->cpx.window_start_us = g_get_monotonic_time();
+    handle->cpx.window_start_bytes = bytes;
+    handle->cpx.window_samples = handle->cpx.window_at_max = handle->cpx.window_at_min = 0;
+    handle->cpx.window_keyframes = 0;
+    handle->cpx.window_complexity_sum = handle->cpx.window_target_sum = 0.0;
+    return G_SOURCE_CONTINUE;
+}
+
+/* Encoded bitrate against the fixed --bitrate reference. Time spent at the max bound is the share of frames 
+   that wanted more bits than allowed (possible quality loss), the min bound is where most savings come from */
+static void report_bitrate_window(PipelineHandle *handle, const char* label, gint64 start_us, guint64 start_bytes) {
+    double seconds = (g_get_monotonic_time() - start_us) / 1e6;
+    guint64 bytes = __atomic_load_n(&handle->cpx.encoded_bytes, __ATOMIC_RELAXED) - start_bytes;
+    if (seconds <= 0.0) 
+        return;
+    double kbps = bytes * 8 / 1000.0 / seconds;
+    double saved = 100.0 * (1.0 - kbps / handle->config->bitrate);
+
+    if (strcmp(label, "window") == 0) {
+        int samples = MAX(handle->cpx.window_samples, 1);
+        DEBUG_PRINT_FMT("Adaptive bitrate (%s): complexity=%.2f (motion=%.3f, detail=%.3f), target=%.0f kbps, "
+                        "encoded=%.0f kbps, saved=%.1f%% vs %d kbps, at max=%.0f%%, at min=%.0f%%, scene cuts=%u\n", 
+                        label, handle->cpx.window_complexity_sum / samples, 
+                        g_atomic_int_get(&handle->cpx.motion_scaled) / COMPLEXITY_SCALE, 
+                        g_atomic_int_get(&handle->cpx.detail_scaled) / COMPLEXITY_SCALE, 
+                        handle->cpx.window_target_sum / samples, kbps, saved, handle->config->bitrate, 
+                        100.0 * handle->cpx.window_at_max / samples, 100.0 * handle->cpx.window_at_min / samples, 
+                        handle->cpx.window_keyframes);
+    } else {
+        int samples = MAX(handle->cpx.total_samples + handle->cpx.window_samples, 1);
+        DEBUG_PRINT_FMT("Adaptive bitrate (%s): encoded=%.0f kbps over %.0f s, saved=%.1f%% (%.1f MB) vs %d kbps, "
+                        "at max=%.0f%%, scene cuts=%u\n", label, kbps, seconds, saved, 
+                        (handle->config->bitrate * 1000.0 / 8 * seconds - bytes) / 1e6, handle->config->bitrate, 
+                        100.0 * (handle->cpx.total_at_max + handle->cpx.window_at_max) / samples, 
+                        handle->cpx.total_keyframes + handle->cpx.window_keyframes);
+    }
+}
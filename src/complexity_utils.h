@@ -0,0 +1,38 @@
+#ifndef __COMPLEXITY_UTILS_H__
+#define __COMPLEXITY_UTILS_H__
+
+#include <gst/gst.h>
+#include "pipeline.h"
+
+/* Processed frames are downscaled (on the GPU when shaders run there) to this size before analysis */
+#define COMPLEXITY_WIDTH 64
+#define COMPLEXITY_HEIGHT 36
+
+/* Complexity (0..1) = motion weight x mean luma difference with the previous frame 
+                     + detail weight x mean luma gradient, both normalized to 0..1 */
+#define COMPLEXITY_MOTION_WEIGHT 8.0
+#define COMPLEXITY_DETAIL_WEIGHT 2.0
+/* Exponential smoothing factor of the per frame metrics */
+#define COMPLEXITY_SMOOTHING 0.25
+
+/* Scene cut: frame motion above this & several times the smoothed motion forces a keyframe */
+#define COMPLEXITY_SCENE_CUT_MOTION 0.15
+#define COMPLEXITY_SCENE_CUT_RATIO 3.0
+#define COMPLEXITY_MIN_KEYFRAME_INTERVAL_MS 1000
+
+/* Encoder bitrate updates: interval, rounding step & minimal relative change */
+#define COMPLEXITY_UPDATE_INTERVAL_MS 500
+#define COMPLEXITY_BITRATE_STEP_KBPS 50
+#define COMPLEXITY_BITRATE_MIN_CHANGE 0.05
+
+/* Interval between bandwidth reports */
+#define COMPLEXITY_REPORT_INTERVAL_MS 5000
+
+/* Creates the analysis branch off proc.tee, adaptive bitrate syntax: "MIN-MAX" in kbps, eg. "500-4000" */
+int configure_adaptive_bitrate(PipelineHandle *handle);
+int start_adaptive_bitrate(PipelineHandle *handle);
+void stop_adaptive_bitrate(PipelineHandle *handle);
+/* Must be called after the pipeline is stopped, the analysis branch thread uses the previous frame until then */
+void cleanup_adaptive_bitrate(PipelineHandle *handle);
+
+#endif
@@ -0,0 +1,172 @@
+#include "cpufx.h"
+#include "cpufx_kernels.h"
+#include "stripe_runner.h"
+#include "log_utils.h"
+
+struct _RtvppCpuFx {
+    GstVideoFilter parent;
+
+    /* Properties */
+    gchar* effect;
+    gint num_threads;
+
+    CpuFxKernelFn_t kernel;
+    StripeRunner* runner;
+};
+
+enum {
+    PROP_0,
+    PROP_EFFECT,
+    PROP_THREADS,
+};
+
+typedef struct _CpuFxJob {
+    CpuFxFrame frame;
+    CpuFxKernelFn_t kernel;
+} CpuFxJob;
+
+#define CPUFX_CAPS GST_VIDEO_CAPS_MAKE("RGBA")
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, 
+                                                                    GST_STATIC_CAPS(CPUFX_CAPS));
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, 
+                                                                   GST_STATIC_CAPS(CPUFX_CAPS));
+
+G_DEFINE_TYPE(RtvppCpuFx, rtvpp_cpufx, GST_TYPE_VIDEO_FILTER)
+
+static void rtvpp_cpufx_set_property(GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec) {
+    RtvppCpuFx *self = RTVPP_CPUFX(object);
+    switch (prop_id) {
+        case PROP_EFFECT:
+            g_free(self->effect);
+            self->effect = g_value_dup_string(value);
+            self->kernel = self->effect ? get_cpufx_kernel(self->effect) : NULL;
+            break;
+        case PROP_THREADS:
+            self->num_threads = g_value_get_int(value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static void rtvpp_cpufx_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec) {
+    RtvppCpuFx *self = RTVPP_CPUFX(object);
+    switch (prop_id) {
+        case PROP_EFFECT:
+            g_value_set_string(value, self->effect);
+            break;
+        case PROP_THREADS:
+            g_value_set_int(value, self->num_threads);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static void rtvpp_cpufx_finalize(GObject* object) {
+    RtvppCpuFx *self = RTVPP_CPUFX(object);
+    g_free(self->effect);
+    G_OBJECT_CLASS(rtvpp_cpufx_parent_class)->finalize(object);
+}
+
+static gboolean rtvpp_cpufx_start(GstBaseTransform* trans) {
+    RtvppCpuFx *self = RTVPP_CPUFX(trans);
+    if (!self->kernel) {
+        ERROR_FMT("No CPU implementation for effect [%s]", self->effect ? self->effect : "none");
+        return FALSE;
+    }
+    self->runner = create_stripe_runner(self->num_threads);
+    CHECK(self->runner != NULL, "Failed to create stripe runner", FALSE);
+    DEBUG_PRINT_FMT("[%s] effect=%s, simd=%s, threads=%d\n", GST_ELEMENT_NAME(self), self->effect, 
+                    cpufx_simd_level(), stripe_runner_num_threads(self->runner));
+    return TRUE;
+}
+
+static gboolean rtvpp_cpufx_set_info(GstVideoFilter* filter, GstCaps* incaps, GstVideoInfo* in_info, 
+                                     GstCaps* outcaps, GstVideoInfo* out_info) {
+    RtvppCpuFx *self = RTVPP_CPUFX(filter);
+    if (GST_VIDEO_INFO_WIDTH(out_info) > CPUFX_MAX_WIDTH) {
+        ERROR_FMT("[%s] Unsupported width %d (max %d)", GST_ELEMENT_NAME(self), GST_VIDEO_INFO_WIDTH(out_info), 
+                  CPUFX_MAX_WIDTH);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean rtvpp_cpufx_stop(GstBaseTransform* trans) {
+    RtvppCpuFx *self = RTVPP_CPUFX(trans);
+    cleanup_stripe_runner(&self->runner);
+    return TRUE;
+}
+
+static void process_stripe(void* data, int first_row, int last_row) {
+    CpuFxJob *job = (CpuFxJob*)data;
+    job->kernel(&job->frame, first_row, last_row);
+}
+
+static GstFlowReturn rtvpp_cpufx_transform_frame(GstVideoFilter* filter, GstVideoFrame* in_frame, GstVideoFrame* out_frame) {
+    RtvppCpuFx *self = RTVPP_CPUFX(filter);
+    GstClockTime pts = GST_BUFFER_PTS(in_frame->buffer);
+
+    CpuFxJob job = {
+        .frame = {
+            .src = GST_VIDEO_FRAME_PLANE_DATA(in_frame, 0),
+            .src_stride = GST_VIDEO_FRAME_PLANE_STRIDE(in_frame, 0),
+            .dst = GST_VIDEO_FRAME_PLANE_DATA(out_frame, 0),
+            .dst_stride = GST_VIDEO_FRAME_PLANE_STRIDE(out_frame, 0),
+            .width = GST_VIDEO_FRAME_WIDTH(out_frame),
+            .height = GST_VIDEO_FRAME_HEIGHT(out_frame),
+            /* Mirrors glshader, time uniform follows buffer timestamps */
+            .time = GST_CLOCK_TIME_IS_VALID(pts) ? (float)((gdouble)pts / GST_SECOND) : 0.0f,
+        },
+        .kernel = self->kernel,
+    };
+    run_stripes(self->runner, job.frame.height, process_stripe, &job);
+    return GST_FLOW_OK;
+}
+
+static void rtvpp_cpufx_class_init(RtvppCpuFxClass* klass) {
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+    GstVideoFilterClass *filter_class = GST_VIDEO_FILTER_CLASS(klass);
+
+    gobject_class->set_property = rtvpp_cpufx_set_property;
+    gobject_class->get_property = rtvpp_cpufx_get_property;
+    gobject_class->finalize = rtvpp_cpufx_finalize;
+
+    g_object_class_install_property(gobject_class, PROP_EFFECT, 
+        g_param_spec_string("effect", "Effect", "Name of the built-in effect to apply", NULL, 
+                            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(gobject_class, PROP_THREADS, 
+        g_param_spec_int("threads", "Threads", "Number of threads processing row stripes (0 = one per core)", 
+                         0, 256, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    gst_element_class_set_static_metadata(element_class, "RT-VPP CPU effect", "Filter/Effect/Video", 
+                                          "Applies rt-vpp built-in effects using SIMD CPU kernels", "rt-vpp");
+    gst_element_class_add_static_pad_template(element_class, &sink_template);
+    gst_element_class_add_static_pad_template(element_class, &src_template);
+
+    transform_class->start = GST_DEBUG_FUNCPTR(rtvpp_cpufx_start);
+    transform_class->stop = GST_DEBUG_FUNCPTR(rtvpp_cpufx_stop);
+    filter_class->set_info = GST_DEBUG_FUNCPTR(rtvpp_cpufx_set_info);
+    filter_class->transform_frame = GST_DEBUG_FUNCPTR(rtvpp_cpufx_transform_frame);
+}
+
+static void rtvpp_cpufx_init(RtvppCpuFx* self) {
+    self->effect = NULL;
+    self->num_threads = 0;
+}
+
+int register_cpufx_element() {
+    gboolean ret = gst_element_register(NULL, "rtvppcpufx", GST_RANK_NONE, RTVPP_TYPE_CPUFX);
+    CHECK(ret == TRUE, "Failed to register rtvppcpufx element", RET_ERR);
+    return RET_OK;
+}
+
+int cpufx_supports_effect(const char* effect_name) {
+    return get_cpufx_kernel(effect_name) != NULL;
+}
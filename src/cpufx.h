@@ -0,0 +1,18 @@
+#ifndef __CPUFX_H__
+#define __CPUFX_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+/* rtvppcpufx: applies one of the built-in effects on the CPU using SIMD kernels,
+   frames are split in row stripes processed in parallel.
+   Drop-in replacement for `glupload ! glshader ! gldownload` on hosts without usable GPU acceleration */
+
+#define RTVPP_TYPE_CPUFX (rtvpp_cpufx_get_type())
+G_DECLARE_FINAL_TYPE(RtvppCpuFx, rtvpp_cpufx, RTVPP, CPUFX, GstVideoFilter)
+
+int register_cpufx_element();
+int cpufx_supports_effect(const char* effect_name);
+
+#endif
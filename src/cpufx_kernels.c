@@ -0,0 +1,541 @@
+#include "cpufx_kernels.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPUFX_X86 1
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+static int simd_disabled = 0;
+
+void cpufx_disable_simd(int disable) {
+    simd_disabled = disable;
+}
+
+#ifdef CPUFX_X86
+static int has_avx2() {
+    return !simd_disabled && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+static int has_sse2() {
+    return !simd_disabled && __builtin_cpu_supports("sse2");
+}
+#endif
+
+const char* cpufx_simd_level() {
+#ifdef CPUFX_X86
+    if (has_avx2()) return "avx2";
+    if (has_sse2()) return "sse2";
+#endif
+    return "none";
+}
+
+/* Helpers shared by the portable kernels */
+
+static inline uint8_t to_unorm8(float c) {
+    c = c < 0.0f ? 0.0f : (c > 1.0f ? 1.0f : c);
+    return (uint8_t)(c * 255.0f + 0.5f);
+}
+
+static inline const uint8_t* texel(const CpuFxFrame* f, int x, int y) {
+    x = x < 0 ? 0 : (x >= f->width ? f->width - 1 : x);
+    y = y < 0 ? 0 : (y >= f->height ? f->height - 1 : y);
+    return f->src + (size_t)y * f->src_stride + (size_t)x * 4;
+}
+
+/* GL_LINEAR sampling with GL_CLAMP_TO_EDGE, (u, v) in normalized texture coordinates */
+static inline void sample_bilinear(const CpuFxFrame* f, float u, float v, float out[4]) {
+    float x = u * f->width - 0.5f;
+    float y = v * f->height - 0.5f;
+    float x0f = floorf(x), y0f = floorf(y);
+    float fx = x - x0f, fy = y - y0f;
+    int x0 = (int)x0f, y0 = (int)y0f;
+
+    const uint8_t* p00 = texel(f, x0, y0);
+    const uint8_t* p10 = texel(f, x0 + 1, y0);
+    const uint8_t* p01 = texel(f, x0, y0 + 1);
+    const uint8_t* p11 = texel(f, x0 + 1, y0 + 1);
+    for (int c = 0; c < 4; c++) {
+        float top = p00[c] + (p10[c] - p00[c]) * fx;
+        float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+        out[c] = (top + (bottom - top) * fy) * (1.0f / 255.0f);
+    }
+}
+
+static inline float pixel_center(int idx, int size) {
+    return (idx + 0.5f) / size;
+}
+
+/* passthrough */
+
+static void passthrough_kernel(const CpuFxFrame* f, int first_row, int last_row) {
+    for (int y = first_row; y < last_row; y++) 
+        memcpy(f->dst + (size_t)y * f->dst_stride, f->src + (size_t)y * f->src_stride, (size_t)f->width * 4);
+}
+
+/* vertical_flip */
+
+static void vertical_flip_kernel(const CpuFxFrame* f, int first_row, int last_row) {
+    for (int y = first_row; y < last_row; y++) 
+        memcpy(f->dst + (size_t)y * f->dst_stride, 
+               f->src + (size_t)(f->height - 1 - y) * f->src_stride, (size_t)f->width * 4);
+}
+
+/* invert_color */
+
+static void invert_color_row(const uint32_t* src, uint32_t* dst, int x, int width) {
+    for (; x < width; x++) 
+        dst[x] = src[x] ^ 0x00FFFFFFu; /* 255 - c on RGB, keep alpha (little endian RGBA) */
+}
+
+#ifdef CPUFX_X86
+static void invert_color_row_sse2(const uint32_t* src, uint32_t* dst, int width) {
+    const __m128i mask = _mm_set1_epi32(0x00FFFFFF);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(src + x));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_xor_si128(px, mask));
+    }
+    invert_color_row(src, dst, x, width);
+}
+
+TARGET_AVX2 static void invert_color_row_avx2(const uint32_t* src, uint32_t* dst, int width) {
+    const __m256i mask = _mm256_set1_epi32(0x00FFFFFF);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(src + x));
+        _mm256_storeu_si256((__m256i*)(dst + x), _mm256_xor_si256(px, mask));
+    }
+    invert_color_row(src, dst, x, width);
+}
+#endif
+
+static void invert_color_kernel(const CpuFxFrame* f, int first_row, int last_row) {
+    for (int y = first_row; y < last_row; y++) {
+        const uint32_t* src = (const uint32_t*)(f->src + (size_t)y * f->src_stride);
+        uint32_t* dst = (uint32_t*)(f->dst + (size_t)y * f->dst_stride);
+#ifdef CPUFX_X86
+        if (has_avx2()) { invert_color_row_avx2(src, dst, f->width); continue; }
+        if (has_sse2()) { invert_color_row_sse2(src, dst, f->width); continue; }
+#endif
+        invert_color_row(src, dst, 0, f->width);
+    }
+}
+
+/* horizontal_flip */
+
+static void horizontal_flip_row(const uint32_t* src, uint32_t* dst, int x, int width) {
+    for (; x < width; x++) 
+        dst[x] = src[width - 1 - x];
+}
+
+#ifdef CPUFX_X86
+static void horizontal_flip_row_sse2(const uint32_t* src, uint32_t* dst, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(src + width - x - 4));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_shuffle_epi32(px, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+    horizontal_flip_row(src, dst, x, width);
+}
+
+TARGET_AVX2 static void horizontal_flip_row_avx2(const uint32_t* src, uint32_t* dst, int width) {
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(src + width - x - 8));
+        _mm256_storeu_si256((__m256i*)(dst + x), _mm256_permutevar8x32_epi32(px, reverse));
+    }
+    horizontal_flip_row(src, dst, x, width);
+}
+#endif
+
+static void horizontal_flip_kernel(const CpuFxFrame* f, int first_row, int last_row) {
+    for (int y = first_row; y < last_row; y++) {
+        const uint32_t* src = (const uint32_t*)(f->src + (size_t)y * f->src_stride);
+        uint32_t* dst = (uint32_t*)(f->dst + (size_t)y * f->dst_stride);
+#ifdef CPUFX_X86
+        if (has_avx2()) { horizontal_flip_row_avx2(src, dst, f->width); continue; }
+        if (has_sse2()) { horizontal_flip_row_sse2(src, dst, f->width); continue; }
+#endif
+        horizontal_flip_row(src, dst, 0, f->width);
+    }
+}
+
+/* vignette: vig = pow(15 * u(1-v) * v(1-u), 0.25) which is separable into
+   15^0.25 * pow(u(1-u), 0.25) * pow(v(1-v), 0.25), rows only scale a precomputed column table */
+
+#define VIGNETTE_FRAC_BITS 8
+
+static void vignette_row(const uint8_t* src, uint8_t* dst, const uint16_t* factors, int x, int width) {
+    for (; x < width; x++) {
+        for (int c = 0; c < 3; c++) {
+            unsigned int val = (src[4 * x + c] * factors[x] + (1 << (VIGNETTE_FRAC_BITS - 1))) >> VIGNETTE_FRAC_BITS;
+            dst[4 * x + c] = val > 255 ? 255 : val;
+        }
+        dst[4 * x + 3] = 255;
+    }
+}
+
+#ifdef CPUFX_X86
+static void vignette_row_sse2(const uint8_t* src, uint8_t* dst, const uint16_t* factors, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(1 << (VIGNETTE_FRAC_BITS - 1));
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(src + 4 * x));
+        /* Broadcast each pixel factor to its 4 channels */
+        __m128i fac = _mm_loadl_epi64((const __m128i*)(factors + x));
+        fac = _mm_unpacklo_epi16(fac, fac);
+        __m128i fac_lo = _mm_unpacklo_epi32(fac, fac);
+        __m128i fac_hi = _mm_unpackhi_epi32(fac, fac);
+
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+        lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, fac_lo), round), VIGNETTE_FRAC_BITS);
+        hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, fac_hi), round), VIGNETTE_FRAC_BITS);
+        _mm_storeu_si128((__m128i*)(dst + 4 * x), _mm_or_si128(_mm_packus_epi16(lo, hi), alpha));
+    }
+    vignette_row(src, dst, factors, x, width);
+}
+
+TARGET_AVX2 static void vignette_row_avx2(const uint8_t* src, uint8_t* dst, const uint16_t* factors, int width) {
+    const __m256i round = _mm256_set1_epi16(1 << (VIGNETTE_FRAC_BITS - 1));
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+    /* Maps factor pairs to the lanes used by the in-lane unpack below */
+    const __m256i fac_shuffle = _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 2, 3,
+                                                 0, 1, 0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 2, 3);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(src + 4 * x));
+        __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(px));      /* pixels 0..3 */
+        __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(px, 1)); /* pixels 4..7 */
+
+        /* Factor lanes: [f0 f0 f0 f0 f1 f1 f1 f1 | f2 .. f3 ..] and [f4 .. f5 .. | f6 .. f7 ..] */
+        __m128i fac = _mm_loadu_si128((const __m128i*)(factors + x));
+        __m256i fac_lo = _mm256_shuffle_epi8(_mm256_setr_m128i(fac, _mm_srli_si128(fac, 4)), fac_shuffle);
+        __m256i fac_hi = _mm256_shuffle_epi8(_mm256_setr_m128i(_mm_srli_si128(fac, 8), _mm_srli_si128(fac, 12)), fac_shuffle);
+
+        lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(lo, fac_lo), round), VIGNETTE_FRAC_BITS);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(hi, fac_hi), round), VIGNETTE_FRAC_BITS);
+        /* packus works within 128 bit lanes, restore pixel order */
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(dst + 4 * x), _mm256_or_si256(packed, alpha));
+    }
+    vignette_row(src, dst, factors, x, width);
+}
+#endif
+
+static void vignette_kernel(const CpuFxFrame* f, int first_row, int last_row) {
+    float columns[CPUFX_MAX_WIDTH];
+    uint16_t factors[CPUFX_MAX_WIDTH];
+    int width = f->width;
+
+    for (int x = 0; x < width; x++) {
+        float u = pixel_center(x, f->width);
+        columns[x] = powf(u * (1.0f - u), 0.25f);
+    }
+
+    for (int y = first_row; y < last_row; y++) {
+        float v = pixel_center(y, f->height);
+        float row = powf(15.0f, 0.25f) * powf(v * (1.0f - v), 0.25f);
+        for (int x = 0; x < width; x++) 
+            factors[x] = (uint16_t)(columns[x] * row * (1 << VIGNETTE_FRAC_BITS) + 0.5f);
+
+        const uint8_t* src = f->src + (size_t)y * f->src_stride;
+        uint8_t* dst = f->dst + (size_t)y * f->dst_stride;
+#ifdef CPUFX_X86
+        if (has_avx2()) { vignette_row_avx2(src, dst, factors, width); continue; }
+        if (has_sse2()) { vignette_row_sse2(src, dst, factors, width); continue; }
+#endif
+        vignette_row(src, dst, factors, 0, width);
+    }
+}
+
+/* Helpers shared by the AVX2 warp kernels */
+
+#ifdef CPUFX_X86
+/* Gathers 8 RGBA texels, indices are clamped to the frame */
+TARGET_AVX2 static inline __m256i gather_texels(const CpuFxFrame* f, __m256i x, __m256i y) {
+    const __m256i zero = _mm256_setzero_si256();
+    x = _mm256_min_epi32(_mm256_max_epi32(x, zero), _mm256_set1_epi32(f->width - 1));
+    y = _mm256_min_epi32(_mm256_max_epi32(y, zero), _mm256_set1_epi32(f->height - 1));
+    __m256i idx = _mm256_add_epi32(_mm256_mullo_epi32(y, _mm256_set1_epi32(f->src_stride / 4)), x);
+    return _mm256_i32gather_epi32((const int*)f->src, idx, 4);
+}
+
+TARGET_AVX2 static inline __m256 channel(__m256i texels, int c) {
+    return _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texels, 8 * c), _mm256_set1_epi32(0xFF)));
+}
+
+/* GL_LINEAR sampling of 8 coordinates, returns channels in [0, 255] */
+TARGET_AVX2 static inline void sample_bilinear_avx2(const CpuFxFrame* f, __m256 u, __m256 v, __m256 out[4]) {
+    __m256 x = _mm256_fmsub_ps(u, _mm256_set1_ps((float)f->width), _mm256_set1_ps(0.5f));
+    __m256 y = _mm256_fmsub_ps(v, _mm256_set1_ps((float)f->height), _mm256_set1_ps(0.5f));
+    __m256 x0f = _mm256_floor_ps(x), y0f = _mm256_floor_ps(y);
+    __m256 fx = _mm256_sub_ps(x, x0f), fy = _mm256_sub_ps(y, y0f);
+    __m256i x0 = _mm256_cvtps_epi32(x0f), y0 = _mm256_cvtps_epi32(y0f);
+    __m256i x1 = _mm256_add_epi32(x0, _mm256_set1_epi32(1)), y1 = _mm256_add_epi32(y0, _mm256_set1_epi32(1));
+
+    __m256i p00 = gather_texels(f, x0, y0), p10 = gather_texels(f, x1, y0);
+    __m256i p01 = gather_texels(f, x0, y1), p11 = gather_texels(f, x1, y1);
+    for (int c = 0; c < 4; c++) {
+        __m256 c00 = channel(p00, c), c10 = channel(p10, c), c01 = channel(p01, c), c11 = channel(p11, c);
+        __m256 top = _mm256_fmadd_ps(_mm256_sub_ps(c10, c00), fx, c00);
+        __m256 bottom = _mm256_fmadd_ps(_mm256_sub_ps(c11, c01), fx, c01);
+        out[c] = _mm256_fmadd_ps(_mm256_sub_ps(bottom, top), fy, top);
+    }
+}
+
+/* Packs channels in [0, 255] to 8 RGBA pixels */
+TARGET_AVX2 static inline void store_pixels(uint8_t* dst, const __m256 rgba[4]) {
+    const __m256 zero = _mm256_setzero_ps(), max = _mm256_set1_ps(255.0f);
+    __m256i px = _mm256_setzero_si256();
+    for (int c = 0; c < 4; c++) {
+        __m256i val = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(rgba[c], zero), max));
+        px = _mm256_or_si256(px, _mm256_slli_epi32(val, 8 * c));
+    }
+    _mm256_storeu_si256((__m256i*)dst, px);
+}
+
+TARGET_AVX2 static inline __m256 pixel_centers_avx2(int x, int width) {
+    __m256 idx = _mm256_add_ps(_mm256_set1_ps((float)x), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+    return _mm256_div_ps(idx, _mm256_set1_ps((float)width));
+}
+#endif
+
+/* chromatical */
+
+static float chromatical_blur(float time) {
+    float blur = (1.0f + sinf(time * 6.0f)) * 0.5f;
+    blur *= 1.0f + sinf(time * 16.0f) * 0.5f;
+    return powf(blur, 3.0f) * 0.05f;
+}
+
+static void chromatical_row(const CpuFxFrame* f, int y, int x, float blur) {
+    float v = pixel_center(y, f->height);
+    float scanline = sinf(v * 800.0f) * 0.04f;
+    uint8_t* dst = f->dst + (size_t)y * f->dst_stride;
+    float r[4], b[4];
+
+    for (; x < f->width; x++) {
+        float u = pixel_center(x, f->width);
+        float d = sqrtf((u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f));
+        sample_bilinear(f, u + blur * d, v, r);
+        sample_bilinear(f, u - blur * d, v, b);
+        float g = texel(f, x, y)[1] * (1.0f / 255.0f);
+        float vig = 1.0f - d * 0.5f;
+
+        dst[4 * x + 0] = to_unorm8((r[0] - scanline) * vig);
+        dst[4 * x + 1] = to_unorm8((g - scanline) * vig);
+        dst[4 * x + 2] = to_unorm8((b[2] - scanline) * vig);
+        dst[4 * x + 3] = 255;
+    }
+}
+
+#ifdef CPUFX_X86
+TARGET_AVX2 static void chromatical_row_avx2(const CpuFxFrame* f, int y, float blur) {
+    float v_scalar = pixel_center(y, f->height);
+    __m256 v = _mm256_set1_ps(v_scalar);
+    __m256 dv = _mm256_set1_ps((v_scalar - 0.5f) * (v_scalar - 0.5f));
+    __m256 scanline = _mm256_set1_ps(sinf(v_scalar * 800.0f) * 0.04f * 255.0f);
+    uint8_t* dst = f->dst + (size_t)y * f->dst_stride;
+    __m256 r[4], g[4], b[4], out[4];
+    int x = 0;
+
+    for (; x + 8 <= f->width; x += 8) {
+        __m256 u = pixel_centers_avx2(x, f->width);
+        __m256 du = _mm256_sub_ps(u, _mm256_set1_ps(0.5f));
+        __m256 d = _mm256_sqrt_ps(_mm256_fmadd_ps(du, du, dv));
+        __m256 offset = _mm256_mul_ps(_mm256_set1_ps(blur), d);
+        sample_bilinear_avx2(f, _mm256_add_ps(u, offset), v, r);
+        sample_bilinear_avx2(f, u, v, g);
+        sample_bilinear_avx2(f, _mm256_sub_ps(u, offset), v, b);
+        __m256 vig = _mm256_fnmadd_ps(d, _mm256_set1_ps(0.5f), _mm256_set1_ps(1.0f));
+
+        out[0] = _mm256_mul_ps(_mm256_sub_ps(r[0], scanline), vig);
+        out[1] = _mm256_mul_ps(_mm256_sub_ps(g[1], scanline), vig);
+        out[2] = _mm256_mul_ps(_mm256_sub_ps(b[2], scanline), vig);
+        out[3] = _mm256_set1_ps(255.0f);
+        store_pixels(dst + 4 * x, out);
+    }
+    chromatical_row(f, y, x, blur);
+}
+#endif
+
+static void chromatical_kernel(const CpuFxFrame* f, int first_row, int last_row) {
+    float blur = chromatical_blur(f->time);
+    for (int y = first_row; y < last_row; y++) {
+#ifdef CPUFX_X86
+        if (has_avx2()) { chromatical_row_avx2(f, y, blur); continue; }
+#endif
+        chromatical_row(f, y, 0, blur);
+    }
+}
+
+/* crt_effect */
+
+#define CRT_WARP 0.75f
+#define CRT_SCAN 0.75f
+
+static void crt_effect_row(const CpuFxFrame* f, int y, int x) {
+    float v = pixel_center(y, f->height);
+    float dcx_v = (0.5f - v) * (0.5f - v);
+    /* `height` uniform is the output height */
+    float apply = fabsf(sinf(v * f->height) * 0.5f * CRT_SCAN);
+    uint8_t* dst = f->dst + (size_t)y * f->dst_stride;
+    float px[4];
+
+    for (; x < f->width; x++) {
+        float u = pixel_center(x, f->width);
+        float dcx_u = (0.5f - u) * (0.5f - u);
+        float wu = (u - 0.5f) * (1.0f + dcx_v * (0.3f * CRT_WARP)) + 0.5f;
+        float wv = (v - 0.5f) * (1.0f + dcx_u * (0.4f * CRT_WARP)) + 0.5f;
+
+        if (wv > 1.0f || wu < 0.0f || wu > 1.0f || wv < 0.0f) {
+            dst[4 * x + 0] = dst[4 * x + 1] = dst[4 * x + 2] = 0;
+        } else {
+            sample_bilinear(f, wu, wv, px);
+            for (int c = 0; c < 3; c++) 
+                dst[4 * x + c] = to_unorm8(px[c] * (1.0f - apply));
+        }
+        dst[4 * x + 3] = 255;
+    }
+}
+
+#ifdef CPUFX_X86
+TARGET_AVX2 static void crt_effect_row_avx2(const CpuFxFrame* f, int y) {
+    float v_scalar = pixel_center(y, f->height);
+    float dcx_v = (0.5f - v_scalar) * (0.5f - v_scalar);
+    __m256 keep = _mm256_set1_ps(1.0f - fabsf(sinf(v_scalar * f->height) * 0.5f * CRT_SCAN));
+    __m256 v_centered = _mm256_set1_ps(v_scalar - 0.5f);
+    __m256 scale_u = _mm256_set1_ps(1.0f + dcx_v * (0.3f * CRT_WARP));
+    const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+    uint8_t* dst = f->dst + (size_t)y * f->dst_stride;
+    __m256 px[4];
+    int x = 0;
+
+    for (; x + 8 <= f->width; x += 8) {
+        __m256 u = pixel_centers_avx2(x, f->width);
+        __m256 u_centered = _mm256_sub_ps(u, half);
+        __m256 dcx_u = _mm256_mul_ps(u_centered, u_centered);
+        __m256 wu = _mm256_fmadd_ps(u_centered, scale_u, half);
+        __m256 wv = _mm256_fmadd_ps(v_centered, _mm256_fmadd_ps(dcx_u, _mm256_set1_ps(0.4f * CRT_WARP), one), half);
+
+        /* Mask of samples inside the frame, outside is black */
+        __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(wu, zero, _CMP_GE_OQ), _mm256_cmp_ps(wu, one, _CMP_LE_OQ)),
+                                      _mm256_and_ps(_mm256_cmp_ps(wv, zero, _CMP_GE_OQ), _mm256_cmp_ps(wv, one, _CMP_LE_OQ)));
+        sample_bilinear_avx2(f, wu, wv, px);
+        for (int c = 0; c < 3; c++) 
+            px[c] = _mm256_and_ps(_mm256_mul_ps(px[c], keep), inside);
+        px[3] = _mm256_set1_ps(255.0f);
+        store_pixels(dst + 4 * x, px);
+    }
+    crt_effect_row(f, y, x);
+}
+#endif
+
+static void crt_effect_kernel(const CpuFxFrame* f, int first_row, int last_row) {
+    for (int y = first_row; y < last_row; y++) {
+#ifdef CPUFX_X86
+        if (has_avx2()) { crt_effect_row_avx2(f, y); continue; }
+#endif
+        crt_effect_row(f, y, 0);
+    }
+}
+
+/* ripple_effect */
+
+#define RIPPLE_SPEED 4.0f
+#define RIPPLE_STRENGTH 40.0f
+#define RIPPLE_DISTORTION 0.03f
+
+static void ripple_effect_row(const CpuFxFrame* f, int y, int x, const float* column_waves) {
+    float v = pixel_center(y, f->height);
+    float row_wave = sinf(f->time * RIPPLE_SPEED + v * RIPPLE_STRENGTH) * RIPPLE_DISTORTION;
+    float cy = 2.0f * v - 1.0f;
+    float aspect = (float)f->width / f->height;
+    uint8_t* dst = f->dst + (size_t)y * f->dst_stride;
+    float px[4];
+
+    for (; x < f->width; x++) {
+        float u = pixel_center(x, f->width);
+        float cx = 2.0f * u - 1.0f;
+        float legsx = 1.0f - sqrtf(cx * cx + (cy / aspect) * (cy / aspect));
+        float legsy = 1.0f - sqrtf((cx * aspect) * (cx * aspect) + cy * cy);
+
+        sample_bilinear(f, u + row_wave * legsx, v + column_waves[x] * legsy, px);
+        for (int c = 0; c < 4; c++) 
+            dst[4 * x + c] = to_unorm8(px[c]);
+    }
+}
+
+#ifdef CPUFX_X86
+TARGET_AVX2 static void ripple_effect_row_avx2(const CpuFxFrame* f, int y, const float* column_waves) {
+    float v_scalar = pixel_center(y, f->height);
+    float cy = 2.0f * v_scalar - 1.0f;
+    float aspect = (float)f->width / f->height;
+    __m256 v = _mm256_set1_ps(v_scalar);
+    __m256 row_wave = _mm256_set1_ps(sinf(f->time * RIPPLE_SPEED + v_scalar * RIPPLE_STRENGTH) * RIPPLE_DISTORTION);
+    __m256 cy_x2 = _mm256_set1_ps((cy / aspect) * (cy / aspect));
+    __m256 cy_y2 = _mm256_set1_ps(cy * cy);
+    const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+    uint8_t* dst = f->dst + (size_t)y * f->dst_stride;
+    __m256 px[4];
+    int x = 0;
+
+    for (; x + 8 <= f->width; x += 8) {
+        __m256 u = pixel_centers_avx2(x, f->width);
+        __m256 cx = _mm256_fmsub_ps(two, u, one);
+        __m256 cx_aspect = _mm256_mul_ps(cx, _mm256_set1_ps(aspect));
+        __m256 legsx = _mm256_sub_ps(one, _mm256_sqrt_ps(_mm256_fmadd_ps(cx, cx, cy_x2)));
+        __m256 legsy = _mm256_sub_ps(one, _mm256_sqrt_ps(_mm256_fmadd_ps(cx_aspect, cx_aspect, cy_y2)));
+
+        __m256 su = _mm256_fmadd_ps(row_wave, legsx, u);
+        __m256 sv = _mm256_fmadd_ps(_mm256_loadu_ps(column_waves + x), legsy, v);
+        sample_bilinear_avx2(f, su, sv, px);
+        store_pixels(dst + 4 * x, px);
+    }
+    ripple_effect_row(f, y, x, column_waves);
+}
+#endif
+
+static void ripple_effect_kernel(const CpuFxFrame* f, int first_row, int last_row) {
+    float column_waves[CPUFX_MAX_WIDTH];
+
+    /* The vertical offset only depends on the column */
+    for (int x = 0; x < f->width; x++) 
+        column_waves[x] = sinf(f->time * RIPPLE_SPEED + pixel_center(x, f->width) * RIPPLE_STRENGTH) * RIPPLE_DISTORTION;
+
+    for (int y = first_row; y < last_row; y++) {
+#ifdef CPUFX_X86
+        if (has_avx2()) { ripple_effect_row_avx2(f, y, column_waves); continue; }
+#endif
+        ripple_effect_row(f, y, 0, column_waves);
+    }
+}
+
+static const struct {
+    const char* name;
+    CpuFxKernelFn_t kernel;
+} map_effect_to_kernel[] = {
+    {"passthrough", passthrough_kernel},
+    {"invert_color", invert_color_kernel},
+    {"horizontal_flip", horizontal_flip_kernel},
+    {"vertical_flip", vertical_flip_kernel},
+    {"vignette", vignette_kernel},
+    {"chromatical", chromatical_kernel},
+    {"crt_effect", crt_effect_kernel},
+    {"ripple_effect", ripple_effect_kernel},
+};
+
+CpuFxKernelFn_t get_cpufx_kernel(const char* effect_name) {
+    for (size_t idx = 0; idx < sizeof(map_effect_to_kernel) / sizeof(map_effect_to_kernel[0]); idx++) {
+        if (strcmp(map_effect_to_kernel[idx].name, effect_name) == 0) 
+            return map_effect_to_kernel[idx].kernel;
+    }
+    return NULL;
+}
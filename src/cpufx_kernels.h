@@ -0,0 +1,32 @@
+#ifndef __CPUFX_KERNELS_H__
+#define __CPUFX_KERNELS_H__
+
+#include <stdint.h>
+
+/* CPU implementations of the built-in shaders found in shaders/. All kernels operate on RGBA frames,
+   follow the GLSL math (texture coordinates at pixel centers, GL_LINEAR sampling with clamp to edge)
+   and only touch rows [first_row, last_row) of the destination so frames can be split in stripes. */
+
+/* Widest frame the kernels accept, vignette & ripple keep per-column tables on the stack */
+#define CPUFX_MAX_WIDTH 8192
+
+typedef struct _CpuFxFrame {
+    const uint8_t* src;
+    int src_stride;
+    uint8_t* dst;
+    int dst_stride;
+    int width;
+    int height;
+    /* Same as the glshader `time` uniform: buffer timestamp in seconds */
+    float time;
+} CpuFxFrame;
+
+typedef void (*CpuFxKernelFn_t)(const CpuFxFrame* frame, int first_row, int last_row);
+
+/* Returns NULL if there is no CPU implementation for the given shader name */
+CpuFxKernelFn_t get_cpufx_kernel(const char* effect_name);
+/* Forces the portable (non SIMD) kernels, used to check SIMD kernels against the reference */
+void cpufx_disable_simd(int disable);
+const char* cpufx_simd_level();
+
+#endif
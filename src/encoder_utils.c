@@ -0,0 +1,87 @@
+#include "encoder_utils.h"
+#include "log_utils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const EncoderProfile encoder_profiles[] = {
+    /* name                 tune           preset       sliced  lookahead  bframes  vbv  key-int */
+    {"ultra-low-latency",   "zerolatency", "superfast", 1,      0,         0,       2,   2},
+    {"balanced",            "",            "veryfast",  0,      10,        0,       15,  4},
+    {"archival",            "",            "medium",    0,      40,        3,       0,   10},
+};
+
+const EncoderProfile* find_encoder_profile(const char* name) {
+    if (!name)
+        name = ENCODER_DEFAULT_PROFILE;
+    for (size_t idx = 0; idx < G_N_ELEMENTS(encoder_profiles); idx++) {
+        if (strcmp(encoder_profiles[idx].name, name) == 0)
+            return &encoder_profiles[idx];
+    }
+    ERROR_FMT("Unknown encoder profile %s (ultra-low-latency, balanced, archival)", name);
+    return NULL;
+}
+
+const EncoderProfile* get_encoder_profile(int idx) {
+    if (idx < 0 || idx >= (int)G_N_ELEMENTS(encoder_profiles))
+        return NULL;
+    return &encoder_profiles[idx];
+}
+
+int count_encoder_cores(const StageThreadConfig* enc_cfg) {
+    cpu_set_t cpus;
+    int num_cores = g_get_num_processors();
+
+    /* 1) x264 threads are spawned by the encoding stage thread & inherit its affinity */
+    if (enc_cfg && enc_cfg->has_cpus)
+        num_cores = CPU_COUNT(&enc_cfg->cpus);
+    else if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+        num_cores = CPU_COUNT(&cpus);
+
+    /* 2) A CPU quota caps the cores actually available, whatever the affinity says */
+    gchar *contents = NULL;
+    if (g_file_get_contents(ENCODER_CGROUP_CPU_MAX, &contents, NULL, NULL)) {
+        long long quota = 0, period = 0;
+        if (sscanf(contents, "%lld %lld", &quota, &period) == 2 && quota > 0 && period > 0)
+            num_cores = MIN(num_cores, (int)((quota + period - 1) / period));
+        g_free(contents);
+    }
+    return MAX(1, num_cores);
+}
+
+void configure_encoder(GstElement *encoder, const EncoderProfile* profile, int bitrate,
+                       const CamParams* params, int num_cores, const char* label) {
+    /* 1) Size threads from the frame. Slices need a few macroblock rows each, frame threads only add delay past a point */
+    int num_threads = (int)(((gint64)params->width * params->height + ENCODER_PIXELS_PER_THREAD - 1) / ENCODER_PIXELS_PER_THREAD);
+    num_threads = CLAMP(num_threads, 1, MAX(1, num_cores));
+    if (profile->sliced_threads)
+        num_threads = MIN(num_threads, MAX(1, (params->height + 15) / 16 / ENCODER_MIN_SLICE_MB_ROWS));
+    else
+        num_threads = MIN(num_threads, ENCODER_MAX_FRAME_THREADS);
+
+    /* 2) Apply the profile, frame based settings follow the framerate (stored as time per frame) */
+    guint key_int = MAX(1, profile->key_int_sec * params->fr_denom / MAX(1, params->fr_num));
+    guint vbv_ms = profile->vbv_frames * 1000 * params->fr_num / MAX(1, params->fr_denom);
+    if (profile->tune[0])
+        gst_util_set_object_arg(G_OBJECT(encoder), "tune", profile->tune);
+    else
+        g_object_set(G_OBJECT(encoder), "tune", 0, NULL);
+    gst_util_set_object_arg(G_OBJECT(encoder), "speed-preset", profile->speed_preset);
+    g_object_set(G_OBJECT(encoder),
+                "bitrate", bitrate,
+                "threads", num_threads,
+                "sliced-threads", profile->sliced_threads,
+                "rc-lookahead", profile->lookahead,
+                "sync-lookahead", profile->lookahead,
+                "bframes", profile->bframes,
+                "key-int-max", key_int,
+                NULL);
+    if (vbv_ms > 0)
+        g_object_set(G_OBJECT(encoder), "vbv-buf-capacity", vbv_ms, NULL);
+
+    DEBUG_PRINT_FMT("%s: encoder profile %s (%s%s%s) %dx%d @ %d kbps, %d %s threads (%d cores), lookahead %d, "
+                    "B-frames %d, VBV %u ms, key-int %u\n", label, profile->name, profile->speed_preset,
+                    profile->tune[0] ? ", " : "", profile->tune, params->width, params->height, bitrate, num_threads,
+                    profile->sliced_threads ? "sliced" : "frame", num_cores, profile->lookahead, profile->bframes,
+                    vbv_ms > 0 ? vbv_ms : ENCODER_DEFAULT_VBV_MS, key_int);
+}
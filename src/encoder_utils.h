@@ -0,0 +1,52 @@
+#ifndef __ENCODER_UTILS_H__
+#define __ENCODER_UTILS_H__
+
+#include <gst/gst.h>
+#include "cam_utils.h"
+#include "thread_utils.h"
+
+/* Named x264enc settings, applied together to the main & rendition encoders:
+ *   ultra-low-latency  zerolatency, superfast, sliced threads, no lookahead, two frame VBV (no frame of delay)
+ *   balanced           veryfast, frame threads, short lookahead, 0.5 s VBV (a few frames of delay)
+ *   archival           medium, frame threads, long lookahead, B-frames, default VBV (quality over delay) */
+#define ENCODER_DEFAULT_PROFILE "ultra-low-latency"
+
+/* Threads are sized from the frame: one thread per this many pixels (a 720p frame keeps 4 threads busy) */
+#define ENCODER_PIXELS_PER_THREAD (640 * 360)
+/* Slices thinner than this (in 16 pixel macroblock rows) cost more in quality & prediction than they save */
+#define ENCODER_MIN_SLICE_MB_ROWS 4
+/* x264 gains nothing from more frame threads, each one adds a frame of delay */
+#define ENCODER_MAX_FRAME_THREADS 16
+/* x264enc vbv-buf-capacity default */
+#define ENCODER_DEFAULT_VBV_MS 600
+/* cgroup v2 CPU quota ("<quota> <period>" or "max <period>"), containers may get fewer cores than they see */
+#define ENCODER_CGROUP_CPU_MAX "/sys/fs/cgroup/cpu.max"
+
+typedef struct _EncoderProfile {
+    const char* name;
+    /* x264enc tune flags & speed preset nicks ("" keeps the x264 defaults) */
+    const char* tune;
+    const char* speed_preset;
+    /* Sliced threads split every frame across the threads, frame threads encode several frames at once */
+    int sliced_threads;
+    /* Frames of rate control & sync lookahead, B-frames */
+    int lookahead;
+    int bframes;
+    /* VBV buffer in frames (0 keeps the x264enc default) */
+    int vbv_frames;
+    /* Max keyframe interval in seconds */
+    int key_int_sec;
+} EncoderProfile;
+
+/* Looks a profile up by name (NULL is the default one), NULL if unknown */
+const EncoderProfile* find_encoder_profile(const char* name);
+/* Profiles in order of increasing latency, NULL past the last one */
+const EncoderProfile* get_encoder_profile(int idx);
+/* Cores usable by the encoder threads: stage affinity (or the process one) bounded by the cgroup CPU quota */
+int count_encoder_cores(const StageThreadConfig* enc_cfg);
+/* Applies the profile & bitrate (kbps) to an x264enc encoding frames of params, threads are auto-sized
+   to the frame & num_cores. Logs the resulting settings under label */
+void configure_encoder(GstElement *encoder, const EncoderProfile* profile, int bitrate,
+                       const CamParams* params, int num_cores, const char* label);
+
+#endif
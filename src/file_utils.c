@@ -0,0 +1,393 @@
+#include "file_utils.h"
+#include "log_utils.h"
+
+#include <stdlib.h>
+#include <glib/gstdio.h>
+#include <gst/pbutils/pbutils.h>
+
+typedef struct _FileSegment {
+    /* Stream time range, stop is GST_CLOCK_TIME_NONE for the last segment */
+    GstClockTime start;
+    GstClockTime stop;
+    char* out_path;
+    PipelineHandle handle;
+    /* Set once the flushing seek reached the decoding stage output */
+    gint seeked;
+} FileSegment;
+
+typedef struct _KeyframeScan {
+    GstElement* pipeline;
+    GArray* keyframes;
+    gboolean has_video;
+} KeyframeScan;
+
+static int find_keyframes(const char* file_path, GArray *keyframes);
+static int plan_segments(GArray *keyframes, GstClockTime duration, int num_jobs, FileSegment *segments);
+static int start_segment(CamParams *cam_params, PipelineConfig *pipeline_config, FileSegment *segment, 
+                         const char* muxer_name, int num_segments);
+static int wait_for_eos(GstElement *pipeline, const char* name);
+static int concat_segments(const char* pattern, const char* out_path, const char* muxer_name);
+static const char* muxer_for_path(const char* path);
+
+int read_file_params(const char* file_path, CamParams *out_params, GstClockTime *out_duration) {
+    GError *error = NULL;
+    int ret = RET_ERR;
+
+    /* 1) Probe the container */
+    gchar *uri = gst_filename_to_uri(file_path, &error);
+    if (!uri) {
+        ERROR_FMT("Invalid file path %s: %s", file_path, error->message);
+        g_clear_error(&error);
+        return RET_ERR;
+    }
+    GstDiscoverer *discoverer = gst_discoverer_new(FILE_DISCOVER_TIMEOUT_SEC * GST_SECOND, &error);
+    if (!discoverer) {
+        ERROR_FMT("Failed to create discoverer: %s", error->message);
+        g_clear_error(&error);
+        g_free(uri);
+        return RET_ERR;
+    }
+    GstDiscovererInfo *info = gst_discoverer_discover_uri(discoverer, uri, &error);
+    if (!info || gst_discoverer_info_get_result(info) != GST_DISCOVERER_OK) {
+        ERROR_FMT("Failed to read %s: %s", file_path, error ? error->message : "unsupported file");
+        goto out;
+    }
+
+    /* 2) Extract the parameters of the first video stream */
+    GList *streams = gst_discoverer_info_get_video_streams(info);
+    if (!streams) {
+        ERROR_FMT("No video stream found in %s", file_path);
+        goto out;
+    }
+    GstDiscovererVideoInfo *video = (GstDiscovererVideoInfo*)streams->data;
+    out_params->dev_path = strdup(file_path);
+    /* Decoded format is negotiated by decodebin */
+    out_params->pixelformat = PIX_FMT_ERROR;
+    out_params->width = gst_discoverer_video_info_get_width(video);
+    out_params->height = gst_discoverer_video_info_get_height(video);
+    /* Stored as time per frame, same as V4L2 */
+    out_params->fr_num = gst_discoverer_video_info_get_framerate_denom(video);
+    out_params->fr_denom = gst_discoverer_video_info_get_framerate_num(video);
+    *out_duration = gst_discoverer_info_get_duration(info);
+    gst_discoverer_stream_info_list_free(streams);
+
+    DEBUG_PRINT_FMT("File %s: %dx%d @ %d/%d fps, duration %.2f s\n", file_path, out_params->width, 
+                    out_params->height, out_params->fr_denom, out_params->fr_num, 
+                    GST_CLOCK_TIME_IS_VALID(*out_duration) ? (double)*out_duration / GST_SECOND : 0.0);
+    ret = RET_OK;
+
+out:
+    g_clear_error(&error);
+    if (info) g_object_unref(info);
+    g_object_unref(discoverer);
+    g_free(uri);
+    return ret;
+}
+
+int process_file(CamParams *cam_params, PipelineConfig *pipeline_config, GstClockTime duration) {
+    FileSegment segments[MAX_NUM_FILE_SEGMENTS] = {0};
+    int num_segments = 1;
+    int ret = RET_ERR;
+    gchar *tmp_dir = NULL;
+
+    CHECK(pipeline_config->file_out != NULL, "File mode requires an output file (--file-out)", RET_ERR);
+    const char* muxer_name = muxer_for_path(pipeline_config->file_out);
+    if (!muxer_name) {
+        ERROR_FMT("Unsupported output container %s, expected .mp4 or .mkv", pipeline_config->file_out);
+        return RET_ERR;
+    }
+
+    /* Nothing to wait for in file mode: no latency budget, no source recovery */
+    PipelineConfig file_config = *pipeline_config;
+    file_config.latency_budget_ms = 0;
+    file_config.source_retries = 0;
+
+    /* 1) Split in keyframe aligned segments, each one starts with a decodable frame */
+    int num_jobs = pipeline_config->file_jobs > 0 ? pipeline_config->file_jobs : MAX(1, g_get_num_processors() / 2);
+    num_jobs = MIN(num_jobs, MAX_NUM_FILE_SEGMENTS);
+    if (num_jobs > 1 && GST_CLOCK_TIME_IS_VALID(duration)) {
+        GArray *keyframes = g_array_new(FALSE, FALSE, sizeof(GstClockTime));
+        if (find_keyframes(cam_params->dev_path, keyframes) == RET_OK) {
+            num_segments = plan_segments(keyframes, duration, num_jobs, segments);
+        }
+        g_array_free(keyframes, TRUE);
+    }
+    if (num_segments == 1) {
+        segments[0].start = 0;
+        segments[0].stop = GST_CLOCK_TIME_NONE;
+    }
+
+    /* 2) Single segment goes straight to the output file, the others to intermediate matroska files */
+    if (num_segments == 1) {
+        segments[0].out_path = g_strdup(pipeline_config->file_out);
+    } else {
+        tmp_dir = g_dir_make_tmp("rt-vpp-XXXXXX", NULL);
+        CHECK(tmp_dir != NULL, "Failed to create directory for segments", RET_ERR);
+        for (int idx = 0; idx < num_segments; idx++) {
+            segments[idx].out_path = g_strdup_printf("%s/segment_%03d.mkv", tmp_dir, idx);
+        }
+    }
+
+    /* 3) Process all segments in parallel */
+    gint64 start_time = g_get_monotonic_time();
+    int started = 0;
+    for (; started < num_segments; started++) {
+        if (start_segment(cam_params, &file_config, &segments[started], 
+                          num_segments == 1 ? muxer_name : "matroskamux", num_segments) != RET_OK) {
+            /* The failed segment's pipeline may already exist (and be paused), the others are released below */
+            GstElement *pipeline = segments[started].handle.pipeline;
+            if (pipeline) {
+                gst_element_set_state(pipeline, GST_STATE_NULL);
+                gst_object_unref(pipeline);
+                segments[started].handle.pipeline = NULL;
+            }
+            break;
+        }
+    }
+
+    ret = (started == num_segments) ? RET_OK : RET_ERR;
+    for (int idx = 0; idx < started; idx++) {
+        GstElement *pipeline = segments[idx].handle.pipeline;
+        if (ret == RET_OK && wait_for_eos(pipeline, segments[idx].out_path) != RET_OK) 
+            ret = RET_ERR;
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_object_unref(pipeline);
+        DEBUG_PRINT_FMT("Segment %d [%.2f s, %.2f s) done after %.2f s\n", idx, (double)segments[idx].start / GST_SECOND,
+                        GST_CLOCK_TIME_IS_VALID(segments[idx].stop) ? (double)segments[idx].stop / GST_SECOND : 
+                        (double)duration / GST_SECOND, (g_get_monotonic_time() - start_time) / 1e6);
+    }
+
+    /* 4) Concatenate segments, timestamps continue across segment boundaries */
+    if (ret == RET_OK && num_segments > 1) {
+        gchar *pattern = g_strdup_printf("%s/segment_*.mkv", tmp_dir);
+        ret = concat_segments(pattern, pipeline_config->file_out, muxer_name);
+        g_free(pattern);
+    }
+
+    if (ret == RET_OK) {
+        double elapsed_sec = (g_get_monotonic_time() - start_time) / 1e6;
+        DEBUG_PRINT_FMT("Processed %s in %.2f s using %d segment(s) (%.1fx real time)\n", pipeline_config->file_in, 
+                        elapsed_sec, num_segments, GST_CLOCK_TIME_IS_VALID(duration) ? 
+                        ((double)duration / GST_SECOND) / elapsed_sec : 0.0);
+    }
+
+    /* 5) Remove intermediate files */
+    for (int idx = 0; idx < num_segments; idx++) {
+        if (tmp_dir && segments[idx].out_path) g_remove(segments[idx].out_path);
+        g_free(segments[idx].out_path);
+    }
+    if (tmp_dir) {
+        g_rmdir(tmp_dir);
+        g_free(tmp_dir);
+    }
+    return ret;
+}
+
+static GstPadProbeReturn keyframe_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    KeyframeScan *scan = (KeyframeScan*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+        GstClockTime ts = GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : GST_BUFFER_DTS(buffer);
+        if (GST_CLOCK_TIME_IS_VALID(ts)) 
+            g_array_append_val(scan->keyframes, ts);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+static void scan_pad_added(GstElement *parser, GstPad *pad, gpointer user_data) {
+    KeyframeScan *scan = (KeyframeScan*)user_data;
+
+    /* Every stream needs a sink, unlinked streams stop the demuxer */
+    GstElement *sink = gst_element_factory_make("fakesink", NULL);
+    g_object_set(G_OBJECT(sink), "sync", FALSE, "async", FALSE, NULL);
+    gst_bin_add(GST_BIN(scan->pipeline), sink);
+    gst_element_sync_state_with_parent(sink);
+    GstPad *sink_pad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_link(pad, sink_pad);
+    gst_object_unref(sink_pad);
+
+    GstCaps *caps = gst_pad_query_caps(pad, NULL);
+    if (!scan->has_video && g_str_has_prefix(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "video/")) {
+        scan->has_video = TRUE;
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, keyframe_probe, scan, NULL);
+    }
+    gst_caps_unref(caps);
+}
+
+/* Demux only pass (no decoding), collects the timestamps of all video keyframes */
+static int find_keyframes(const char* file_path, GArray *keyframes) {
+    KeyframeScan scan = {.keyframes = keyframes};
+    scan.pipeline = gst_pipeline_new("keyframe-scan");
+    GstElement *source = gst_element_factory_make("filesrc", NULL);
+    GstElement *parser = gst_element_factory_make("parsebin", NULL);
+    if (!scan.pipeline || !source || !parser) {
+        ERROR("Failed to allocate keyframe scan elements");
+        return RET_ERR;
+    }
+
+    g_object_set(G_OBJECT(source), "location", file_path, NULL);
+    gst_bin_add_many(GST_BIN(scan.pipeline), source, parser, NULL);
+    CHECK(gst_element_link(source, parser) == TRUE, "Failed to link keyframe scan elements", RET_ERR);
+    g_signal_connect(parser, "pad-added", G_CALLBACK(scan_pad_added), &scan);
+
+    gint64 start_time = g_get_monotonic_time();
+    gst_element_set_state(scan.pipeline, GST_STATE_PLAYING);
+    int ret = wait_for_eos(scan.pipeline, "keyframe-scan");
+    gst_element_set_state(scan.pipeline, GST_STATE_NULL);
+    gst_object_unref(scan.pipeline);
+
+    DEBUG_PRINT_FMT("Found %u keyframes in %.2f s\n", keyframes->len, (g_get_monotonic_time() - start_time) / 1e6);
+    return ret;
+}
+
+static gint compare_clock_time(gconstpointer a, gconstpointer b) {
+    GstClockTime ta = *(const GstClockTime*)a, tb = *(const GstClockTime*)b;
+    return (ta > tb) - (ta < tb);
+}
+
+/* Splits [0, duration) in up to num_jobs segments of roughly equal length, boundaries snap to the next keyframe */
+static int plan_segments(GArray *keyframes, GstClockTime duration, int num_jobs, FileSegment *segments) {
+    const GstClockTime min_length = FILE_MIN_SEGMENT_SEC * GST_SECOND;
+    int num_segments = 1;
+    guint next_keyframe = 0;
+
+    g_array_sort(keyframes, compare_clock_time);
+    segments[0].start = 0;
+    for (int idx = 1; idx < num_jobs; idx++) {
+        GstClockTime target = gst_util_uint64_scale(duration, idx, num_jobs);
+        while (next_keyframe < keyframes->len && g_array_index(keyframes, GstClockTime, next_keyframe) < target) 
+            next_keyframe++;
+        if (next_keyframe >= keyframes->len) 
+            break;
+
+        GstClockTime boundary = g_array_index(keyframes, GstClockTime, next_keyframe);
+        if (boundary + min_length > duration) 
+            break;
+        if (boundary < segments[num_segments - 1].start + min_length) 
+            continue;
+        segments[num_segments - 1].stop = boundary;
+        segments[num_segments++].start = boundary;
+    }
+    segments[num_segments - 1].stop = GST_CLOCK_TIME_NONE;
+    return num_segments;
+}
+
+static GstPadProbeReturn segment_seek_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    FileSegment *segment = (FileSegment*)user_data;
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        /* Frames decoded before the seek took effect */
+        return GST_PAD_PROBE_DROP;
+    }
+
+    /* The flushing seek is the only source of flush events, data after it belongs to the segment */
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_FLUSH_STOP) {
+        g_atomic_int_set(&segment->seeked, 1);
+        return GST_PAD_PROBE_REMOVE;
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+static int start_segment(CamParams *cam_params, PipelineConfig *pipeline_config, FileSegment *segment, 
+                         const char* muxer_name, int num_segments) {
+    PipelineHandle *handle = &segment->handle;
+    GstPad *dec_src = NULL;
+
+    /* 1) Create pipeline writing to the segment file */
+    CHECK(create_file_pipeline(cam_params, pipeline_config, segment->out_path, muxer_name, handle) == RET_OK, 
+          "Failed to create file pipeline", RET_ERR);
+    if (num_segments > 1) {
+        /* Segments share the cores, one encoder may not use them all */
+        g_object_set(G_OBJECT(handle->enc.encoder), "threads", MAX(1, g_get_num_processors() / num_segments), NULL);
+    }
+
+    /* 2) Single segment, plain run from start to EOS */
+    if (num_segments == 1) {
+        CHECK(gst_element_set_state(handle->pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE, 
+              "Failed to start file pipeline", RET_ERR);
+        return RET_OK;
+    }
+
+    /* 3) Nothing may reach the encoder before the segment seek is done (muxers can not be flushed) */
+    dec_src = gst_element_get_static_pad(handle->dec.bin, "src");
+    gst_pad_add_probe(dec_src, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_FLUSH, 
+                      segment_seek_probe, segment, NULL);
+    gst_object_unref(dec_src);
+    CHECK(gst_element_set_state(handle->pipeline, GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE, 
+          "Failed to pause file pipeline", RET_ERR);
+
+    /* 4) Seek to the segment, fails until decodebin exposed its pads. 
+          Timestamps stay in stream time so shader time matches a run over the whole file */
+    gint64 deadline = g_get_monotonic_time() + FILE_SEEK_TIMEOUT_MS * 1000;
+    GstSeekType stop_type = GST_CLOCK_TIME_IS_VALID(segment->stop) ? GST_SEEK_TYPE_SET : GST_SEEK_TYPE_NONE;
+    while (!gst_element_seek(handle->pipeline, 1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, 
+                             GST_SEEK_TYPE_SET, segment->start, stop_type, segment->stop)) {
+        if (g_get_monotonic_time() > deadline) {
+            ERROR_FMT("Seek to %.2f s not handled", (double)segment->start / GST_SECOND);
+            return RET_ERR;
+        }
+        g_usleep(10 * 1000);
+    }
+    while (!g_atomic_int_get(&segment->seeked)) {
+        if (g_get_monotonic_time() > deadline) {
+            ERROR_FMT("Seek to %.2f s did not flush the pipeline", (double)segment->start / GST_SECOND);
+            return RET_ERR;
+        }
+        g_usleep(1000);
+    }
+
+    CHECK(gst_element_set_state(handle->pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE, 
+          "Failed to start file pipeline", RET_ERR);
+    return RET_OK;
+}
+
+static int wait_for_eos(GstElement *pipeline, const char* name) {
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    int ret = RET_OK;
+
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+        GError *err = NULL;
+        gchar *debug_info = NULL;
+        gst_message_parse_error(msg, &err, &debug_info);
+        ERROR_FMT("[%s] Error received from element %s: %s", name, GST_OBJECT_NAME(msg->src), err->message);
+        ERROR_FMT("Debugging information: %s\n", debug_info ? debug_info : "none");
+        g_clear_error(&err);
+        g_free(debug_info);
+        ret = RET_ERR;
+    }
+    gst_message_unref(msg);
+    gst_object_unref(bus);
+    return ret;
+}
+
+static int concat_segments(const char* pattern, const char* out_path, const char* muxer_name) {
+    GError *error = NULL;
+
+    /* splitmuxsrc plays the (name ordered) segment files back to back with continuous timestamps */
+    gchar *description = g_strdup_printf("splitmuxsrc location=\"%s\" ! h264parse ! %s ! filesink location=\"%s\" sync=false",
+                                         pattern, muxer_name, out_path);
+    GstElement *pipeline = gst_parse_launch(description, &error);
+    g_free(description);
+    if (!pipeline) {
+        ERROR_FMT("Failed to create concat pipeline: %s", error ? error->message : "unknown");
+        g_clear_error(&error);
+        return RET_ERR;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    int ret = wait_for_eos(pipeline, "concat");
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    return ret;
+}
+
+static const char* muxer_for_path(const char* path) {
+    gchar *lower = g_ascii_strdown(path, -1);
+    const char* muxer = NULL;
+    if (g_str_has_suffix(lower, ".mp4") || g_str_has_suffix(lower, ".mov")) 
+        muxer = "mp4mux";
+    else if (g_str_has_suffix(lower, ".mkv")) 
+        muxer = "matroskamux";
+    g_free(lower);
+    return muxer;
+}
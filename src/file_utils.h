@@ -0,0 +1,22 @@
+#ifndef __FILE_UTILS_H__
+#define __FILE_UTILS_H__
+
+#include <gst/gst.h>
+#include "cam_utils.h"
+#include "pipeline.h"
+
+/* Offline file mode: container file in, MP4/MKV out, processed as fast as possible (no clock sync).
+   Long inputs are split at keyframes, segments are processed by parallel pipelines and concatenated */
+
+/* Max time spent probing the input file */
+#define FILE_DISCOVER_TIMEOUT_SEC 10
+/* Segments shorter than this are merged with their neighbour */
+#define FILE_MIN_SEGMENT_SEC 2
+/* Max time to wait for the demuxer to accept the segment seek */
+#define FILE_SEEK_TIMEOUT_MS 5000
+#define MAX_NUM_FILE_SEGMENTS 64
+
+int read_file_params(const char* file_path, CamParams *out_params, GstClockTime *out_duration);
+int process_file(CamParams *cam_params, PipelineConfig *pipeline_config, GstClockTime duration);
+
+#endif
@@ -0,0 +1,61 @@
+#include "gl_utils.h"
+#include "log_utils.h"
+
+#include <gst/gst.h>
+#include <gst/gl/gl.h>
+
+/* Substrings identifying software rasterizers in GL_RENDERER */
+static const char* software_renderers[] = {
+    "llvmpipe", "softpipe", "Software Rasterizer", "SWR", "swrast",
+};
+
+static void query_renderer(GstGLContext* context, gpointer data) {
+    const GstGLFuncs *gl = context->gl_vtable;
+    const char* renderer = (const char*)gl->GetString(GL_RENDERER);
+    *(char**)data = renderer ? g_strdup(renderer) : NULL;
+}
+
+char* get_gl_renderer() {
+    GError *error = NULL;
+    char* renderer = NULL;
+
+    /* Create a throwaway context on the default display, same platform the pipeline GL elements end up using */
+    GstGLDisplay *display = gst_gl_display_new();
+    CHECK(display != NULL, "Failed to create GL display", NULL);
+    GstGLContext *context = gst_gl_context_new(display);
+    if (!context || !gst_gl_context_create(context, NULL, &error)) {
+        ERROR_FMT("Failed to create GL context: %s", error ? error->message : "unknown");
+        g_clear_error(&error);
+        if (context) gst_object_unref(context);
+        gst_object_unref(display);
+        return NULL;
+    }
+
+    gst_gl_context_thread_add(context, query_renderer, &renderer);
+    gst_object_unref(context);
+    gst_object_unref(display);
+    return renderer;
+}
+
+int is_software_gl() {
+    /* Probing creates & destroys a GL context, the renderer does not change while running */
+    static gsize probed = 0;
+    static int is_software = 1;
+    if (!g_once_init_enter(&probed)) 
+        return is_software;
+
+    char* renderer = get_gl_renderer();
+    if (renderer) {
+        is_software = 0;
+        for (size_t idx = 0; idx < sizeof(software_renderers) / sizeof(software_renderers[0]); idx++) {
+            if (strstr(renderer, software_renderers[idx])) {
+                is_software = 1;
+                break;
+            }
+        }
+        DEBUG_PRINT_FMT("GL renderer: %s (%s)\n", renderer, is_software ? "software" : "hardware");
+        g_free(renderer);
+    }
+    g_once_init_leave(&probed, 1);
+    return is_software;
+}
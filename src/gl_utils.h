@@ -0,0 +1,9 @@
+#ifndef __GL_UTILS_H__
+#define __GL_UTILS_H__
+
+/* Returns a copy of the GL_RENDERER string of the default GL platform (must be freed), NULL if no GL context can be created */
+char* get_gl_renderer();
+/* Returns 1 if the GL implementation is a software rasterizer (or missing), 0 otherwise */
+int is_software_gl();
+
+#endif
@@ -0,0 +1,195 @@
+#include "gpu_timing_utils.h"
+#include "log_utils.h"
+
+#include <gst/gl/gl.h>
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+
+static GstPadProbeReturn shader_input_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn shader_output_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static void begin_query(GstGLContext *context, gpointer data);
+static void end_query(GstGLContext *context, gpointer data);
+static void delete_queries(GstGLContext *context, gpointer data);
+static gboolean report_gpu_timing(gpointer user_data);
+
+void configure_gpu_timing(PipelineHandle *handle) {
+    if (!handle->config->gpu_timing) 
+        return;
+
+    /* glshader renders from its transform (GL thread, called synchronously from the streaming thread), 
+       so a query begun when a buffer enters & ended when it leaves only encloses that shader's draw */
+    handle->gpu.num_stages = handle->proc.graph.num_shader_stages;
+    handle->gpu.stages = g_new0(GpuTimingStage, handle->gpu.num_stages);
+    handle->gpu.busy = 0;
+    for (int idx = 0; idx < handle->gpu.num_stages; idx++) {
+        GpuTimingStage *stage = &handle->gpu.stages[idx];
+        GstPad *sink_pad = gst_element_get_static_pad(handle->proc.graph.shader_stages[idx], "sink");
+        GstPad *src_pad = gst_element_get_static_pad(handle->proc.graph.shader_stages[idx], "src");
+        stage->shader = handle->proc.graph.shader_stages[idx];
+        stage->busy = &handle->gpu.busy;
+
+        gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, shader_input_probe, stage, NULL);
+        gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_BUFFER, shader_output_probe, stage, NULL);
+        gst_object_unref(sink_pad);
+        gst_object_unref(src_pad);
+    }
+}
+
+int start_gpu_timing(PipelineHandle *handle) {
+    if (!handle->config->gpu_timing) 
+        return RET_OK;
+    if (handle->gpu.num_stages == 0) {
+        DEBUG_PRINT("GPU timing requested but no GL shader stage is used, ignoring\n");
+        return RET_OK;
+    }
+
+    /* V4L2 time per frame: fr_num / fr_denom seconds */
+    CamParams *cam_params = handle->cam_params;
+    handle->gpu.budget_ms = cam_params->fr_denom > 0 ? 1000.0 * cam_params->fr_num / cam_params->fr_denom : 0.0;
+    handle->gpu.report_source_id = g_timeout_add(GPU_TIMING_REPORT_INTERVAL_MS, report_gpu_timing, handle);
+    DEBUG_PRINT_FMT("GPU timing enabled: shader stages=%d, frame budget=%.1f ms\n", 
+                    handle->gpu.num_stages, handle->gpu.budget_ms);
+    return RET_OK;
+}
+
+void stop_gpu_timing(PipelineHandle *handle) {
+    if (handle->gpu.report_source_id) {
+        g_source_remove(handle->gpu.report_source_id);
+        handle->gpu.report_source_id = 0;
+        report_gpu_timing(handle);
+    }
+
+    /* The context reference keeps its GL thread alive after the shaders released it */
+    for (int idx = 0; idx < handle->gpu.num_stages; idx++) {
+        GstGLContext *context = handle->gpu.stages[idx].context;
+        if (!context) continue;
+        gst_gl_context_thread_add(context, delete_queries, &handle->gpu.stages[idx]);
+        gst_object_unref(context);
+        handle->gpu.stages[idx].context = NULL;
+    }
+    g_clear_pointer(&handle->gpu.stages, g_free);
+    handle->gpu.num_stages = 0;
+}
+
+static GstPadProbeReturn shader_input_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    GpuTimingStage *stage = (GpuTimingStage*)user_data;
+
+    /* Context is only known once the element negotiated */
+    if (!stage->context) 
+        g_object_get(G_OBJECT(stage->shader), "context", &stage->context, NULL);
+    if (!stage->context || stage->unsupported) 
+        return GST_PAD_PROBE_OK;
+
+    /* Another branch is being timed, skip this frame rather than wait for it */
+    if (!g_atomic_int_compare_and_exchange(stage->busy, 0, 1)) {
+        g_atomic_int_inc(&stage->skipped);
+        return GST_PAD_PROBE_OK;
+    }
+    gst_gl_context_thread_add(stage->context, begin_query, stage);
+    if (!stage->active) 
+        g_atomic_int_set(stage->busy, 0);
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn shader_output_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    GpuTimingStage *stage = (GpuTimingStage*)user_data;
+
+    if (stage->context && stage->active) {
+        gst_gl_context_thread_add(stage->context, end_query, stage);
+        g_atomic_int_set(stage->busy, 0);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+static void begin_query(GstGLContext *context, gpointer data) {
+    GpuTimingStage *stage = (GpuTimingStage*)data;
+    const GstGLFuncs *gl = context->gl_vtable;
+    GLuint available = 0;
+    GLuint64 elapsed_ns = 0;
+
+    /* 1) Lazily create the query ring, requires GL_ARB_timer_query / GL_EXT_disjoint_timer_query */
+    if (!stage->queries[0]) {
+        if (!gl->GenQueries || !gl->BeginQuery || !gl->GetQueryObjectui64v) {
+            ERROR_FMT("GL timer queries not supported, not timing %s", GST_ELEMENT_NAME(stage->shader));
+            stage->unsupported = TRUE;
+            return;
+        }
+        gl->GenQueries(GPU_TIMING_QUERY_RING_SIZE, stage->queries);
+    }
+
+    /* 2) Collect the query issued GPU_TIMING_QUERY_RING_SIZE frames ago, never wait on the GPU. 
+       If it is still in flight keep it & skip timing this frame */
+    GLuint query = stage->queries[stage->next];
+    if (stage->pending[stage->next]) {
+        gl->GetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            g_atomic_int_inc(&stage->skipped);
+            return;
+        }
+        gl->GetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_ns);
+        __atomic_fetch_add(&stage->elapsed_ns, (guint64)elapsed_ns, __ATOMIC_RELAXED);
+        g_atomic_int_inc(&stage->samples);
+        stage->pending[stage->next] = FALSE;
+    }
+
+    /* 3) Start timing this frame */
+    gl->BeginQuery(GL_TIME_ELAPSED, query);
+    stage->active = TRUE;
+}
+
+static void end_query(GstGLContext *context, gpointer data) {
+    GpuTimingStage *stage = (GpuTimingStage*)data;
+    const GstGLFuncs *gl = context->gl_vtable;
+
+    gl->EndQuery(GL_TIME_ELAPSED);
+    stage->pending[stage->next] = TRUE;
+    stage->next = (stage->next + 1) % GPU_TIMING_QUERY_RING_SIZE;
+    stage->active = FALSE;
+}
+
+static void delete_queries(GstGLContext *context, gpointer data) {
+    GpuTimingStage *stage = (GpuTimingStage*)data;
+    const GstGLFuncs *gl = context->gl_vtable;
+
+    if (stage->queries[0] && gl->DeleteQueries)
+        gl->DeleteQueries(GPU_TIMING_QUERY_RING_SIZE, stage->queries);
+    memset(stage->queries, 0, sizeof(stage->queries));
+}
+
+static gboolean report_gpu_timing(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    double total_ms = 0.0;
+
+    for (int idx = 0; idx < handle->gpu.num_stages; idx++) {
+        GpuTimingStage *stage = &handle->gpu.stages[idx];
+        const char* shader_name = g_object_get_data(G_OBJECT(stage->shader), SHADER_NAME_KEY);
+
+        /* Fetch & reset window statistics */
+        guint64 elapsed_ns = __atomic_exchange_n(&stage->elapsed_ns, 0, __ATOMIC_RELAXED);
+        guint samples = g_atomic_int_and(&stage->samples, 0);
+        guint skipped = g_atomic_int_and(&stage->skipped, 0);
+        if (samples == 0) 
+            continue;
+
+        stage->frame_ms = elapsed_ns / 1e6 / samples;
+        total_ms += stage->frame_ms;
+        DEBUG_PRINT_FMT("GPU time stage %d [%s]: %.3f ms/frame (%.1f%% of frame budget), %u samples, %u skipped\n", 
+                        idx, shader_name ? shader_name : GST_ELEMENT_NAME(stage->shader), stage->frame_ms, 
+                        handle->gpu.budget_ms > 0.0 ? 100.0 * stage->frame_ms / handle->gpu.budget_ms : 0.0, 
+                        samples, skipped);
+    }
+    if (total_ms > 0.0) {
+        DEBUG_PRINT_FMT("GPU time all shader stages: %.3f ms/frame (%.1f%% of %.1f ms frame budget)\n", total_ms, 
+                        handle->gpu.budget_ms > 0.0 ? 100.0 * total_ms / handle->gpu.budget_ms : 0.0, 
+                        handle->gpu.budget_ms);
+    }
+    return G_SOURCE_CONTINUE;
+}
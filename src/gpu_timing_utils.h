@@ -0,0 +1,16 @@
+#ifndef __GPU_TIMING_UTILS_H__
+#define __GPU_TIMING_UTILS_H__
+
+#include <gst/gst.h>
+#include "pipeline.h"
+
+/* Interval between GPU timing reports */
+#define GPU_TIMING_REPORT_INTERVAL_MS 5000
+
+/* Called once the GL shader stages are created */
+void configure_gpu_timing(PipelineHandle *handle);
+int start_gpu_timing(PipelineHandle *handle);
+/* Must be called after the pipeline is stopped, releases the timer queries & stage state */
+void stop_gpu_timing(PipelineHandle *handle);
+
+#endif
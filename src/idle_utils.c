@@ -0,0 +1,180 @@
+#include "idle_utils.h"
+#include "join_utils.h"
+#include "log_utils.h"
+
+#include <time.h>
+
+static GstPadProbeReturn idle_capture_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn resume_keyframe_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static gboolean poll_consumers(gpointer user_data);
+static int has_consumers(PipelineHandle *handle);
+static gint64 get_process_cpu_us();
+
+int configure_idle_mode(PipelineHandle *handle) {
+    const char* mode = handle->config->idle_mode ? handle->config->idle_mode : "off";
+    if (strcmp(mode, "off") == 0) 
+        return RET_OK;
+    if (strcmp(mode, "decimate") != 0 && strcmp(mode, "pause") != 0) {
+        ERROR_FMT("Unknown idle mode [%s], expected off, decimate or pause", mode);
+        return RET_ERR;
+    }
+    handle->idl.enabled = 1;
+    handle->idl.pause = strcmp(mode, "pause") == 0;
+    return RET_OK;
+}
+
+void attach_decoding_stage_idle(PipelineHandle *handle, DecodingStage *dec) {
+    if (!handle->idl.enabled || !dec->cam_source) 
+        return;
+
+    /* Frames are dropped right after capture, nothing downstream (decode, shaders, encoder) runs for them */
+    GstPad *cam_pad = gst_element_get_static_pad(dec->cam_source, "src");
+    gst_pad_add_probe(cam_pad, GST_PAD_PROBE_TYPE_BUFFER, idle_capture_probe, dec, NULL);
+    gst_object_unref(cam_pad);
+}
+
+int start_idle_monitor(PipelineHandle *handle) {
+    if (!handle->idl.enabled) 
+        return RET_OK;
+
+    /* A display (or a file) is always watched */
+    if (handle->out.disp_sink) 
+        DEBUG_PRINT("Idle mode: the display is always a consumer, run with --no-display to go idle\n");
+
+    /* Resume latency ends with the first keyframe leaving the encoder */
+    GstPad *enc_pad = gst_element_get_static_pad(handle->enc.out_caps_filter, "src");
+    CHECK(enc_pad != NULL, "Failed to get encoding stage output pad", RET_ERR);
+    gst_pad_add_probe(enc_pad, GST_PAD_PROBE_TYPE_BUFFER, resume_keyframe_probe, handle, NULL);
+    gst_object_unref(enc_pad);
+
+    handle->idl.last_consumer_us = handle->idl.state_start_us = g_get_monotonic_time();
+    handle->idl.state_start_cpu_us = get_process_cpu_us();
+    handle->idl.poll_source_id = g_timeout_add(IDLE_POLL_INTERVAL_MS, poll_consumers, handle);
+    DEBUG_PRINT_FMT("Idle mode enabled: %s after %d ms without consumer\n", 
+                    handle->idl.pause ? "pause" : "decimate", IDLE_ENTER_DELAY_MS);
+    return RET_OK;
+}
+
+void stop_idle_monitor(PipelineHandle *handle) {
+    if (!handle->idl.poll_source_id) 
+        return;
+    g_source_remove(handle->idl.poll_source_id);
+    handle->idl.poll_source_id = 0;
+    DEBUG_PRINT_FMT("Idle mode: %.1f s idle in total, %d resumes\n", 
+                    (handle->idl.idle_total_us + (g_atomic_int_get(&handle->idl.idle) ? 
+                        g_get_monotonic_time() - handle->idl.state_start_us : 0)) / 1e6, 
+                    handle->idl.num_resumes);
+}
+
+/* Runs on the capture thread. Raw & MJPEG frames stand alone, H.264 delta frames can not be decoded once 
+   a frame before them was dropped: they are dropped too until the next keyframe */
+static GstPadProbeReturn idle_capture_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    DecodingStage *dec = (DecodingStage*)user_data;
+    PipelineHandle *handle = dec->owner;
+    int is_delta = GST_BUFFER_FLAG_IS_SET(GST_PAD_PROBE_INFO_BUFFER(info), GST_BUFFER_FLAG_DELTA_UNIT);
+    if (!g_atomic_int_get(&handle->idl.idle)) {
+        if (dec->idle_gap && is_delta) 
+            return GST_PAD_PROBE_DROP;
+        dec->idle_gap = 0;
+        return GST_PAD_PROBE_OK;
+    }
+    if (handle->idl.pause || is_delta) 
+        goto drop;
+
+    /* Decimate: one frame per interval, shared by all cameras of a mosaic */
+    gint64 now_us = g_get_monotonic_time();
+    gint64 last_us = __atomic_load_n(&handle->idl.last_frame_us, __ATOMIC_RELAXED);
+    if (now_us - last_us < IDLE_DECIMATE_INTERVAL_MS * 1000 || 
+        !__atomic_compare_exchange_n(&handle->idl.last_frame_us, &last_us, now_us, FALSE, 
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) 
+        goto drop;
+    return GST_PAD_PROBE_OK;
+
+drop:
+    dec->idle_gap = 1;
+    return GST_PAD_PROBE_DROP;
+}
+
+/* Runs on the encoding stage thread */
+static GstPadProbeReturn resume_keyframe_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    gint64 resume_us = __atomic_load_n(&handle->idl.resume_us, __ATOMIC_ACQUIRE);
+    if (!resume_us || GST_BUFFER_FLAG_IS_SET(GST_PAD_PROBE_INFO_BUFFER(info), GST_BUFFER_FLAG_DELTA_UNIT)) 
+        return GST_PAD_PROBE_OK;
+
+    /* First keyframe since the resume, reported from the main loop */
+    if (__atomic_compare_exchange_n(&handle->idl.resume_us, &resume_us, 0, FALSE, 
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) 
+        __atomic_store_n(&handle->idl.resume_latency_us, g_get_monotonic_time() - resume_us, __ATOMIC_RELEASE);
+    return GST_PAD_PROBE_OK;
+}
+
+static gboolean poll_consumers(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    gint64 now_us = g_get_monotonic_time();
+    int idle = g_atomic_int_get(&handle->idl.idle);
+
+    /* 1) Resume latency of the last transition */
+    gint64 latency_us = __atomic_exchange_n(&handle->idl.resume_latency_us, 0, __ATOMIC_ACQUIRE);
+    if (latency_us) 
+        DEBUG_PRINT_FMT("Idle mode: first keyframe %.1f ms after the consumer was detected (checked every %d ms)\n", 
+                        latency_us / 1000.0, IDLE_POLL_INTERVAL_MS);
+
+    /* 2) Transitions, CPU usage is measured over each state */
+    int consumers = has_consumers(handle);
+    if (consumers) 
+        handle->idl.last_consumer_us = now_us;
+    int go_idle = !idle && !consumers && now_us - handle->idl.last_consumer_us >= IDLE_ENTER_DELAY_MS * 1000;
+    int resume = idle && consumers;
+    if (!go_idle && !resume) 
+        return G_SOURCE_CONTINUE;
+
+    gint64 cpu_us = get_process_cpu_us();
+    gint64 state_us = now_us - handle->idl.state_start_us;
+    double state_s = state_us / 1e6;
+    double cpu_percent = state_us > 0 ? 100.0 * (cpu_us - handle->idl.state_start_cpu_us) / state_us : 0.0;
+    handle->idl.state_start_us = now_us;
+    handle->idl.state_start_cpu_us = cpu_us;
+
+    if (go_idle) {
+        DEBUG_PRINT_FMT("Idle mode: no consumer, %s (CPU while active: %.1f%% over %.1f s)\n", 
+                        handle->idl.pause ? "pausing" : "decimating capture", cpu_percent, state_s);
+        g_atomic_int_set(&handle->idl.idle, 1);
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* Resume: frames flow again right away, the encoders restart on a keyframe */
+    DEBUG_PRINT_FMT("Idle mode: consumer attached, resuming (CPU while idle: %.1f%% over %.1f s)\n", cpu_percent, state_s);
+    handle->idl.idle_total_us += state_us;
+    handle->idl.num_resumes++;
+    __atomic_store_n(&handle->idl.resume_us, now_us, __ATOMIC_RELEASE);
+    g_atomic_int_set(&handle->idl.idle, 0);
+    /* Passthrough: asked to the camera, frames wait for its next keyframe anyway */
+    request_keyframe(handle->enc.encoder ? handle->enc.encoder : handle->enc.out_caps_filter);
+    for (int idx = 0; idx < handle->ren.num; idx++) {
+        request_keyframe(handle->ren.items[idx].encoder);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* Outputs are the display, the V4L2 loopback sink & the rendition sinks. Only loopback devices can be unwatched: 
+   they are, when no other process holds the device open */
+static int has_consumers(PipelineHandle *handle) {
+    if (handle->out.disp_sink) 
+        return 1;
+    /* Readers can not be counted (no /proc, or processes of other users): stay active */
+    if (handle->config->dev_sink && count_device_readers(handle->config->dev_sink) != 0) 
+        return 1;
+    for (int idx = 0; idx < handle->ren.num; idx++) {
+        const char* sink_path = handle->ren.items[idx].sink_path;
+        if (!g_str_has_prefix(sink_path, RENDITION_DEVICE_PREFIX) || count_device_readers(sink_path) != 0) 
+            return 1;
+    }
+    return 0;
+}
+
+static gint64 get_process_cpu_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (gint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
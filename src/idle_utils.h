@@ -0,0 +1,21 @@
+#ifndef __IDLE_UTILS_H__
+#define __IDLE_UTILS_H__
+
+#include <gst/gst.h>
+#include "pipeline.h"
+
+/* Interval between consumer checks (scan of the open files of all processes) */
+#define IDLE_POLL_INTERVAL_MS 500
+/* Outputs must have no consumer for this long before going idle (player restarts, probing tools) */
+#define IDLE_ENTER_DELAY_MS 2000
+/* Decimate mode: one captured frame per interval keeps flowing while idle */
+#define IDLE_DECIMATE_INTERVAL_MS 1000
+
+/* Idle mode: "off", "decimate" (one frame per IDLE_DECIMATE_INTERVAL_MS) or "pause" (no frame past capture) */
+int configure_idle_mode(PipelineHandle *handle);
+/* Called each time a decoding stage is (re-)created */
+void attach_decoding_stage_idle(PipelineHandle *handle, DecodingStage *dec);
+int start_idle_monitor(PipelineHandle *handle);
+void stop_idle_monitor(PipelineHandle *handle);
+
+#endif
@@ -0,0 +1,182 @@
+#include "join_utils.h"
+#include "log_utils.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <gst/video/video.h>
+
+static gboolean poll_readers(gpointer user_data);
+static gboolean could_open_device(pid_t pid, const struct stat *dev_stat);
+static void add_join_output(PipelineHandle *handle, const char* dev_path, GstElement *encoder);
+
+int start_join_monitor(PipelineHandle *handle) {
+    if (handle->config->join_keyframe_ms <= 0)
+        return RET_OK;
+
+    /* 1) Collect device outputs, the main one is fed by the camera itself in passthrough mode */
+    handle->jn.outputs = g_new0(JoinOutput, 1 + handle->ren.num);
+    if (handle->config->dev_sink)
+        add_join_output(handle, handle->config->dev_sink,
+                        handle->enc.encoder ? handle->enc.encoder : handle->enc.out_caps_filter);
+    for (int idx = 0; idx < handle->ren.num; idx++) {
+        RenditionHandle *ren = &handle->ren.items[idx];
+        if (g_str_has_prefix(ren->sink_path, RENDITION_DEVICE_PREFIX))
+            add_join_output(handle, ren->sink_path, ren->encoder);
+    }
+    if (handle->jn.num == 0)
+        return RET_OK;
+
+    /* 2) Readers present before the start get the first IDR anyway */
+    for (int idx = 0; idx < handle->jn.num; idx++) {
+        handle->jn.outputs[idx].num_readers = MAX(0, count_device_readers(handle->jn.outputs[idx].dev_path));
+    }
+    handle->jn.poll_source_id = g_timeout_add(JOIN_POLL_INTERVAL_MS, poll_readers, handle);
+    DEBUG_PRINT_FMT("Join keyframes enabled: %d device outputs, at most one keyframe per %d ms\n",
+                    handle->jn.num, handle->config->join_keyframe_ms);
+    return RET_OK;
+}
+
+void stop_join_monitor(PipelineHandle *handle) {
+    if (handle->jn.poll_source_id) {
+        g_source_remove(handle->jn.poll_source_id);
+        handle->jn.poll_source_id = 0;
+        DEBUG_PRINT_FMT("Join keyframes: %d forced for %d new readers\n", handle->jn.num_keyframes, handle->jn.num_joins);
+    }
+    g_clear_pointer(&handle->jn.outputs, g_free);
+    handle->jn.num = 0;
+}
+
+static void add_join_output(PipelineHandle *handle, const char* dev_path, GstElement *encoder) {
+    JoinOutput *output = &handle->jn.outputs[handle->jn.num++];
+    output->dev_path = dev_path;
+    output->encoder = encoder;
+}
+
+static gboolean poll_readers(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    gint64 now_us = g_get_monotonic_time();
+
+    for (int idx = 0; idx < handle->jn.num; idx++) {
+        JoinOutput *output = &handle->jn.outputs[idx];
+        /* Unknown counts as no visible reader, readers of other users can not be seen joining anyway */
+        int num_readers = MAX(0, count_device_readers(output->dev_path));
+
+        /* 1) A reader joined since the last check, readers leaving need nothing */
+        if (num_readers > output->num_readers) {
+            DEBUG_PRINT_FMT("New reader on %s (%d readers)\n", output->dev_path, num_readers);
+            handle->jn.num_joins += num_readers - output->num_readers;
+            output->pending = 1;
+        }
+        output->num_readers = num_readers;
+
+        /* 2) Held back requests fire once the rate limit allows, the joiner waits at most the interval */
+        if (!output->pending || now_us - output->keyframe_us < (gint64)handle->config->join_keyframe_ms * 1000)
+            continue;
+        request_keyframe(output->encoder);
+        output->keyframe_us = now_us;
+        output->pending = 0;
+        handle->jn.num_keyframes++;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+int count_device_readers(const char* dev_path) {
+    char resolved[PATH_MAX], fd_dir[64], fd_path[PATH_MAX], target[PATH_MAX];
+    struct stat dev_stat;
+    if (!realpath(dev_path, resolved) || stat(resolved, &dev_stat) != 0)
+        return 0;
+
+    DIR *proc = opendir("/proc");
+    if (!proc)
+        return -1;
+    pid_t self = getpid();
+    int num_readers = 0, num_hidden = 0;
+    struct dirent *proc_entry;
+    while ((proc_entry = readdir(proc)) != NULL) {
+        pid_t pid = (pid_t)strtol(proc_entry->d_name, NULL, 10);
+        if (pid <= 0 || pid == self)
+            continue;
+        snprintf(fd_dir, sizeof(fd_dir), "/proc/%d/fd", pid);
+        DIR *fds = opendir(fd_dir);
+        if (!fds) {
+            /* Exited, or another user's process: only one allowed to open the device might be a reader */
+            if (errno == EACCES && could_open_device(pid, &dev_stat))
+                num_hidden++;
+            continue;
+        }
+        struct dirent *fd_entry;
+        while ((fd_entry = readdir(fds)) != NULL) {
+            if (fd_entry->d_name[0] == '.')
+                continue;
+            snprintf(fd_path, sizeof(fd_path), "%s/%s", fd_dir, fd_entry->d_name);
+            ssize_t len = readlink(fd_path, target, sizeof(target) - 1);
+            if (len <= 0)
+                continue;
+            target[len] = '\0';
+            /* A process counts once, however many times it opened the device */
+            if (strcmp(target, resolved) == 0) {
+                num_readers++;
+                break;
+            }
+        }
+        closedir(fds);
+    }
+    closedir(proc);
+    return (num_readers == 0 && num_hidden > 0) ? -1 : num_readers;
+}
+
+static gboolean could_open_device(pid_t pid, const struct stat *dev_stat) {
+    char status_path[64], line[1024];
+    uid_t uid = (uid_t)-1;
+    gid_t gid = (gid_t)-1;
+    char *groups = NULL;
+
+    /* 1) Filesystem uid/gid & supplementary groups, /proc/<pid>/status is readable by everyone */
+    snprintf(status_path, sizeof(status_path), "/proc/%d/status", pid);
+    FILE *status = fopen(status_path, "r");
+    if (!status)
+        return FALSE;
+    while (fgets(line, sizeof(line), status)) {
+        unsigned long real, effective, saved, fs;
+        if (sscanf(line, "Uid: %lu %lu %lu %lu", &real, &effective, &saved, &fs) == 4)
+            uid = (uid_t)fs;
+        else if (sscanf(line, "Gid: %lu %lu %lu %lu", &real, &effective, &saved, &fs) == 4)
+            gid = (gid_t)fs;
+        else if (g_str_has_prefix(line, "Groups:"))
+            groups = g_strdup(line + strlen("Groups:"));
+    }
+    fclose(status);
+    if (uid == (uid_t)-1) {
+        g_free(groups);
+        return FALSE;
+    }
+
+    /* 2) Read permission as the kernel checks it: owner bits, else group bits, else other bits */
+    gboolean allowed;
+    if (uid == 0) {
+        allowed = TRUE;
+    } else if (uid == dev_stat->st_uid) {
+        allowed = (dev_stat->st_mode & S_IRUSR) != 0;
+    } else {
+        gboolean in_group = (gid == dev_stat->st_gid);
+        for (char *group = groups, *end; !in_group && group && *group; group = end) {
+            unsigned long value = strtoul(group, &end, 10);
+            if (end == group)
+                break;
+            in_group = ((gid_t)value == dev_stat->st_gid);
+        }
+        allowed = (dev_stat->st_mode & (in_group ? S_IRGRP : S_IROTH)) != 0;
+    }
+    g_free(groups);
+    return allowed;
+}
+
+void request_keyframe(GstElement *encoder) {
+    GstPad *enc_src = gst_element_get_static_pad(encoder, "src");
+    gst_pad_send_event(enc_src, gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 0));
+    gst_object_unref(enc_src);
+}
@@ -0,0 +1,24 @@
+#ifndef __JOIN_UTILS_H__
+#define __JOIN_UTILS_H__
+
+#include <gst/gst.h>
+#include "pipeline.h"
+
+/* A reader opening the loopback device (or a device rendition) mid-stream can only start decoding at the next IDR, 
+   up to the encoder key interval away. New readers are detected by polling & get an on-demand keyframe, 
+   at most one per --join-keyframe-interval. SPS/PPS are repeated in-band with every IDR by the parsers */
+
+/* Interval between reader checks (scan of the open files of all processes) */
+#define JOIN_POLL_INTERVAL_MS 250
+
+int start_join_monitor(PipelineHandle *handle);
+void stop_join_monitor(PipelineHandle *handle);
+
+/* Number of other processes holding the device open, -1 if it can not be told: no /proc, or no reader 
+   among the visible processes while some that could open the device (by their uid/groups & its mode) 
+   can not be inspected (other users, unless running as root) */
+int count_device_readers(const char* dev_path);
+/* Asks the encoder (or whatever is upstream of the element) for a keyframe, main loop only */
+void request_keyframe(GstElement *encoder);
+
+#endif
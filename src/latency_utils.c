@@ -0,0 +1,155 @@
+#include "latency_utils.h"
+#include "log_utils.h"
+
+static void queue_overrun_cb(GstElement *queue, gpointer user_data);
+static GstPadProbeReturn source_allocation_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn output_latency_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static gboolean report_latency(gpointer user_data);
+static int attach_output_latency_probe(PipelineHandle *handle, GstElement *sink, int *num_sinks);
+
+void configure_latency_queue(PipelineHandle *handle, GstElement *queue, const char* stage) {
+    int budget_ms = handle->config->latency_budget_ms;
+    if (budget_ms <= 0)
+        return;
+
+    /* Minimal depth, when full drop the oldest frame (latest frame wins) */
+    g_object_set(G_OBJECT(queue), 
+                "max-size-buffers", 1, 
+                "max-size-bytes", 0, 
+                "max-size-time", (guint64)budget_ms * GST_MSECOND, 
+                "leaky", 2, // leaky downstream
+                NULL);
+
+    /* Overrun is emitted each time the leaky queue drops a buffer, past the limit drops are just not counted */ 
+    if (handle->lat.num_queues >= MAX_NUM_MONITORED_QUEUES) {
+        ERROR_FMT("Too many queues, not monitoring stage %s", stage);
+        return;
+    }
+    int idx = handle->lat.num_queues++;
+    handle->lat.queues[idx].queue = queue;
+    handle->lat.queues[idx].stage = stage;
+    handle->lat.queues[idx].dropped = 0;
+    g_signal_connect(queue, "overrun", G_CALLBACK(queue_overrun_cb), &handle->lat.queues[idx].dropped);
+}
+
+void configure_latency_source(PipelineHandle *handle, GstElement *source) {
+    if (handle->config->latency_budget_ms <= 0)
+        return;
+
+    /* v4l2src does not expose the capture buffer count, bound it through the allocation query instead */
+    GstPad *src_pad = gst_element_get_static_pad(source, "src");
+    gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM | GST_PAD_PROBE_TYPE_PULL, 
+                      source_allocation_probe, NULL, NULL);
+    gst_object_unref(src_pad);
+}
+
+int start_latency_monitor(PipelineHandle *handle) {
+    if (handle->config->latency_budget_ms <= 0)
+        return RET_OK;
+
+    /* Measure latency where frames leave the pipeline, timestamps are capture running times */
+    int num_sinks = 0;
+    CHECK(attach_output_latency_probe(handle, handle->out.dev_sink, &num_sinks) == RET_OK && 
+          attach_output_latency_probe(handle, handle->out.disp_sink, &num_sinks) == RET_OK && 
+          attach_output_latency_probe(handle, handle->out.null_sink, &num_sinks) == RET_OK, 
+          "Failed to monitor output latency", RET_ERR);
+    for (int idx = 0; idx < handle->ren.num; idx++) {
+        CHECK(attach_output_latency_probe(handle, handle->ren.items[idx].sink, &num_sinks) == RET_OK, 
+              "Failed to monitor rendition latency", RET_ERR);
+    }
+
+    handle->lat.report_source_id = g_timeout_add(LATENCY_REPORT_INTERVAL_MS, report_latency, handle);
+    DEBUG_PRINT_FMT("Latency budget mode enabled: budget=%d ms, monitored queues=%d, monitored outputs=%d\n", 
+                    handle->config->latency_budget_ms, handle->lat.num_queues, num_sinks);
+    return RET_OK;
+}
+
+void stop_latency_monitor(PipelineHandle *handle) {
+    if (!handle->lat.report_source_id)
+        return;
+    g_source_remove(handle->lat.report_source_id);
+    handle->lat.report_source_id = 0;
+    report_latency(handle);
+}
+
+static void queue_overrun_cb(GstElement *queue, gpointer user_data) {
+    g_atomic_int_inc((gint*)user_data);
+}
+
+static GstPadProbeReturn source_allocation_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    GstQuery *query = GST_PAD_PROBE_INFO_QUERY(info);
+    GstBufferPool *pool = NULL;
+    guint size = 0, min = 0, max = 0;
+
+    if (GST_QUERY_TYPE(query) != GST_QUERY_ALLOCATION)
+        return GST_PAD_PROBE_OK;
+
+    /* Downstream answered, cap the number of buffers the source may queue up */
+    if (gst_query_get_n_allocation_pools(query) > 0) {
+        gst_query_parse_nth_allocation_pool(query, 0, &pool, &size, &min, &max);
+        gst_query_set_nth_allocation_pool(query, 0, pool, size, min, MAX(min, LATENCY_CAPTURE_BUFFERS));
+        if (pool) 
+            gst_object_unref(pool);
+    } else {
+        gst_query_add_allocation_pool(query, NULL, 0, 0, LATENCY_CAPTURE_BUFFERS);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+/* Counts the sink & stamps every frame it receives */
+static int attach_output_latency_probe(PipelineHandle *handle, GstElement *sink, int *num_sinks) {
+    if (!sink) 
+        return RET_OK;
+    GstPad *sink_pad = gst_element_get_static_pad(sink, "sink");
+    CHECK(sink_pad != NULL, "Failed to get output sink pad", RET_ERR);
+    gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, output_latency_probe, handle, NULL);
+    gst_object_unref(sink_pad);
+    (*num_sinks)++;
+    return RET_OK;
+}
+
+static GstPadProbeReturn output_latency_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstClock *clock = GST_ELEMENT_CLOCK(handle->pipeline);
+    guint latency_us, cur_max;
+
+    if (!clock || !GST_BUFFER_PTS_IS_VALID(buffer))
+        return GST_PAD_PROBE_OK;
+
+    /* Current running time minus capture running time */
+    GstClockTime now = gst_clock_get_time(clock) - gst_element_get_base_time(handle->pipeline);
+    if (now < GST_BUFFER_PTS(buffer))
+        return GST_PAD_PROBE_OK;
+    latency_us = (guint)((now - GST_BUFFER_PTS(buffer)) / GST_USECOND);
+
+    __atomic_fetch_add(&handle->lat.latency_sum_us, (guint64)latency_us, __ATOMIC_RELAXED);
+    g_atomic_int_inc(&handle->lat.latency_count);
+    do {
+        cur_max = g_atomic_int_get(&handle->lat.latency_max_us);
+    } while (latency_us > cur_max && 
+             !g_atomic_int_compare_and_exchange(&handle->lat.latency_max_us, cur_max, latency_us));
+
+    return GST_PAD_PROBE_OK;
+}
+
+static gboolean report_latency(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+
+    /* Fetch & reset window statistics */
+    guint64 sum_us = __atomic_exchange_n(&handle->lat.latency_sum_us, 0, __ATOMIC_RELAXED);
+    guint count = g_atomic_int_and(&handle->lat.latency_count, 0);
+    guint max_us = g_atomic_int_and(&handle->lat.latency_max_us, 0);
+
+    if (count > 0) {
+        double avg_ms = sum_us / 1000.0 / count;
+        DEBUG_PRINT_FMT("Capture to output latency: avg=%.1f ms, max=%.1f ms, budget=%d ms%s\n", 
+                        avg_ms, max_us / 1000.0, handle->config->latency_budget_ms, 
+                        (max_us / 1000 > handle->config->latency_budget_ms) ? " (OVER BUDGET)" : "");
+    }
+    for (int idx = 0; idx < handle->lat.num_queues; idx++) {
+        DEBUG_PRINT_FMT("Frames dropped in stage %s: %u\n", handle->lat.queues[idx].stage, 
+                        g_atomic_int_get(&handle->lat.queues[idx].dropped));
+    }
+    return G_SOURCE_CONTINUE;
+}
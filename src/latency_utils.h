@@ -0,0 +1,18 @@
+#ifndef __LATENCY_UTILS_H__
+#define __LATENCY_UTILS_H__
+
+#include <gst/gst.h>
+#include "pipeline.h"
+
+/* Number of buffers v4l2src is allowed to allocate in latency budget mode */
+#define LATENCY_CAPTURE_BUFFERS 3
+
+/* Interval between latency & frame drop reports */
+#define LATENCY_REPORT_INTERVAL_MS 5000
+
+void configure_latency_queue(PipelineHandle *handle, GstElement *queue, const char* stage);
+void configure_latency_source(PipelineHandle *handle, GstElement *source);
+int start_latency_monitor(PipelineHandle *handle);
+void stop_latency_monitor(PipelineHandle *handle);
+
+#endif
@@ -2,6 +2,11 @@
 #include "glib.h"
 #include "gst/gstdebugutils.h"
 #include "pipeline.h"
+#include "bench.h"
+#include "file_utils.h"
+#include "replay_utils.h"
+#include "source_utils.h"
+#include "trace_utils.h"
 
 #include "log_utils.h"
 #include "shader_utils.h"
@@ -13,33 +18,61 @@ int main(int argc, char *argv[]) {
     PipelineHandle handle = {0};
     PipelineConfig pipeline_config = {0};
     CamParams cam_params  = {0};
+    int ret = RET_ERR;
 
     /* Parse command line args */
     if (read_cmd_line_params(argc, argv, &pipeline_config) != RET_OK) return RET_ERR;
     DEBUG_PRINT_FMT("MAIN: %s\n", pipeline_config.shader_pipeline);
-    /* Initialize shader stuff */
+    
+    /* Dump conversion & benchmarks run standalone, no camera or shader store needed */
+    if (pipeline_config.trace_json) return convert_trace_to_json(pipeline_config.trace_json);
+    if (pipeline_config.bench) return run_benchmark(&pipeline_config);
+
+    /* Initialize shader stuff, shaders are embedded & the folder only overrides them */
     init_shader_store();
-    DEBUG_PRINT_FMT("Loading shaders from %s\n", pipeline_config.shader_src_folder);
-    if (add_shaders_to_store(pipeline_config.shader_src_folder) != RET_OK) goto err; 
+    if (pipeline_config.shader_src_folder) {
+        DEBUG_PRINT_FMT("Loading shader overrides from %s\n", pipeline_config.shader_src_folder);
+        if (add_shaders_to_store(pipeline_config.shader_src_folder) != RET_OK) goto cleanup; 
+    }
   
-    /* Read camera parameters */
-    DEBUG_PRINT_FMT("Reading camera parameters for device %s\n", pipeline_config.dev_src);
-    if (read_cam_params(pipeline_config.dev_src, &cam_params) != RET_OK) goto err;
+    /* File mode: read stream parameters from the container & process it offline */
+    if (pipeline_config.file_in) {
+        GstClockTime duration = GST_CLOCK_TIME_NONE;
+        DEBUG_PRINT_FMT("Reading stream parameters for file %s\n", pipeline_config.file_in);
+        if (read_file_params(pipeline_config.file_in, &cam_params, &duration) != RET_OK) goto cleanup;
+        if (process_file(&cam_params, &pipeline_config, duration) != RET_OK) goto cleanup;
+        ret = RET_OK;
+        goto cleanup;
+    }
+
+    /* Read camera parameters (or the recording's), a replay ends with the recording so there is nothing to recover */
+    if (pipeline_config.replay) {
+        if (read_recording_params(pipeline_config.replay, &cam_params) != RET_OK) goto cleanup;
+        pipeline_config.source_retries = 0;
+    } else {
+        DEBUG_PRINT_FMT("Reading camera parameters for device %s\n", pipeline_config.dev_src);
+        if (read_source_params(pipeline_config.dev_src, &cam_params) != RET_OK) goto cleanup;
+    }
+    /* Files & pipes end with their input, nothing to re-open */
+    for (int idx = 0; pipeline_config.dev_srcs && pipeline_config.dev_srcs[idx]; idx++) {
+        if (is_finite_source(pipeline_config.dev_srcs[idx])) 
+            pipeline_config.source_retries = 0;
+    }
     
     /* Create the elements */
-    if (create_pipeline(&cam_params, &pipeline_config, &handle) != RET_OK) goto err; 
+    if (create_pipeline(&cam_params, &pipeline_config, &handle) != RET_OK) goto cleanup; 
 
     /* Play pipeline */
-    if (play_pipeline(&handle) != RET_OK) goto err;
+    if (play_pipeline(&handle) != RET_OK) goto cleanup;
 
     /* Exit success*/ 
-    return RET_OK;
+    ret = RET_OK;
 
-err: 
+cleanup: 
     /* Clean allocated junk*/
     cleanup_shader_store();
     cleanup_cam_params(&cam_params);
-    return RET_ERR;
+    return ret;
 }  
 
 int read_cmd_line_params(int argc, char *argv[], PipelineConfig* out_config) {
@@ -53,16 +86,70 @@ int read_cmd_line_params(int argc, char *argv[], PipelineConfig* out_config) {
     #define INDENT_LEVEL "\t\t\t\t\t\t" // hack but couldn't find a better way
     GOptionEntry entries[] = {
         {"shader-pipeline", 'p', 0, G_OPTION_ARG_STRING, &out_config->shader_pipeline, 
-            "String which specifies the chain of shaders which should be applied to input stream\n" 
+            "String which specifies the chain (or graph) of shaders which should be applied to input stream\n" 
             INDENT_LEVEL "(default: vertical_flip ! invert_color)\n" 
-            INDENT_LEVEL "Example: 'horizontal_flip ! invert_color ! crt_effect'\n", "SHADER_PIPELINE"}, 
+            INDENT_LEVEL "Example: 'horizontal_flip ! invert_color ! crt_effect'\n" 
+            INDENT_LEVEL "Graph: chains separated by ';', '! @label' names a chain output, leading labels are its inputs\n" 
+            INDENT_LEVEL "(@in is the input frame), several inputs are merged by a compositor (blend, pip, split)\n" 
+            INDENT_LEVEL "Example: 'vertical_flip ! @raw; @raw ! crt_effect ! @fx; @raw @fx pip'\n" 
+            INDENT_LEVEL "ROI: 'stage[x,y,w,h+x,y,w,h]' or 'stage[/path/to/rects]' only shades inside the rects\n", "SHADER_PIPELINE"}, 
+
+        {"cpu-effects", 0, 0, G_OPTION_ARG_STRING, &out_config->cpu_effects, 
+            "String which specifies when the SIMD CPU effect engine replaces the GL shader chain\n"
+            INDENT_LEVEL "auto: only on software GL if all stages have a CPU implementation, always, never (default: auto)\n"
+            INDENT_LEVEL "Example: --cpu-effects=always\n", "CPU_EFFECTS"}, 
+
+        {"scale-convert", 0, 0, G_OPTION_ARG_STRING, &out_config->scale_convert, 
+            "String which specifies how frames are rescaled & converted to I420 before encoding\n"
+            INDENT_LEVEL "fused: single SIMD pass, separate: videoscale ! videoconvert (default: fused)\n"
+            INDENT_LEVEL "Example: --scale-convert=separate\n", "SCALE_CONVERT"}, 
 
-        {"dev-src", 'i', 0, G_OPTION_ARG_STRING, &out_config->dev_src, 
-            "String which specifies the path to the V4L2 capture device\n" 
-            INDENT_LEVEL "Example -i /dev/video<x> --dev-src=/dev/video<x>", "SRC_DEVICE"},
+        {"dev-src", 'i', 0, G_OPTION_ARG_STRING_ARRAY, &out_config->dev_srcs, 
+            "String which specifies the path to the V4L2 capture device, repeat it to composite several cameras\n" 
+            INDENT_LEVEL "or a synthetic source test:PATTERN[,WxH@FPS[,FORMAT]], a file file:PATH[,WxH@FPS,FORMAT]\n" 
+            INDENT_LEVEL "(raw frames or H264/MJPG streams need their size, rate & format), or stdin:WxH@FPS,FORMAT\n" 
+            INDENT_LEVEL "Example -i /dev/video<x> --dev-src=/dev/video<x> -i test:ball,3840x2160@120,NV12", "SRC_DEVICE"},
+        {"source-speed", 0, 0, G_OPTION_ARG_STRING, &out_config->source_speed, 
+            "String which specifies the pacing of test, file & stdin sources: realtime (at their framerate)\n" 
+            INDENT_LEVEL "or fast (no clock, as fast as the pipeline goes) (default: realtime)\n" 
+            INDENT_LEVEL "Example: --source-speed=fast", "SOURCE_SPEED"},
+        {"mosaic-layout", 0, 0, G_OPTION_ARG_STRING, &out_config->mosaic_layout, 
+            "String which specifies how several cameras are placed on the output frame (size: --out-width/--out-height)\n" 
+            INDENT_LEVEL "grid or one x,y,w,h tile per camera separated by ';' (default: grid)\n" 
+            INDENT_LEVEL "Example: --mosaic-layout=\"0,0,1280,720;1280,0,640,360;1280,360,640,360\"", "MOSAIC_LAYOUT"},
+        {"mosaic-shaders", 0, 0, G_OPTION_ARG_STRING, &out_config->mosaic_shaders, 
+            "String which specifies a shader pipeline per camera separated by '|' (applied before compositing)\n" 
+            INDENT_LEVEL "Example: --mosaic-shaders=\"invert_color | | vertical_flip ! vignette\"", "MOSAIC_SHADERS"},
         {"dev-sink", 'o', 0, G_OPTION_ARG_STRING, &out_config->dev_sink, 
             "String which specifies the path to the V4L2 loopback device\n"
-            INDENT_LEVEL "Example: -o /dev/video<y> --out-device=/dev/video<y>\n", "SINK_DEVICE"}, 
+            INDENT_LEVEL "Example: -o /dev/video<y> --out-device=/dev/video<y>", "SINK_DEVICE"}, 
+        {"join-keyframe-interval", 0, 0, G_OPTION_ARG_INT, &out_config->join_keyframe_ms, 
+            "Integer which specifies the min interval in ms between keyframes forced when a reader opens a device output\n"
+            INDENT_LEVEL "(default: 1000, 0 disabled)\n"
+            INDENT_LEVEL "Example: --join-keyframe-interval=2000", "JOIN_MS"},
+        {"no-display", 0, 0, G_OPTION_ARG_NONE, &out_config->no_display, 
+            "Do not decode & show the output stream in a window", NULL},
+        {"idle-mode", 0, 0, G_OPTION_ARG_STRING, &out_config->idle_mode, 
+            "String which specifies what happens while no process reads the outputs (loopback device, device renditions)\n"
+            INDENT_LEVEL "off, decimate: one captured frame per second, pause: no frame (default: off)\n"
+            INDENT_LEVEL "Example: --idle-mode=pause\n", "IDLE_MODE"}, 
+
+        {"renditions", 0, 0, G_OPTION_ARG_STRING, &out_config->renditions, 
+            "String which specifies extra renditions (size, bitrate in kbps & sink) encoded from the same processed frames\n"
+            INDENT_LEVEL "Sink is a V4L2 device (/dev/..) or an H.264 byte-stream file\n"
+            INDENT_LEVEL "Example: --renditions=\"1280x720@2500:/dev/video3,640x360@800:/tmp/360p.h264\"\n", "RENDITIONS"}, 
+
+        {"file-in", 0, 0, G_OPTION_ARG_STRING, &out_config->file_in, 
+            "String which specifies a container file to process offline instead of a capture device\n"
+            INDENT_LEVEL "Frames are processed as fast as possible, shader time follows the file timestamps\n"
+            INDENT_LEVEL "Example: --file-in=recording.mp4", "FILE_IN"},
+        {"file-out", 0, 0, G_OPTION_ARG_STRING, &out_config->file_out, 
+            "String which specifies the output file in file mode, container is picked from the extension (.mp4, .mkv)\n"
+            INDENT_LEVEL "Example: --file-out=processed.mkv", "FILE_OUT"},
+        {"file-jobs", 0, 0, G_OPTION_ARG_INT, &out_config->file_jobs, 
+            "Integer which specifies the number of keyframe aligned segments processed in parallel in file mode\n"
+            INDENT_LEVEL "(default: <number of cores> / 2)\n"
+            INDENT_LEVEL "Example: --file-jobs=4\n", "FILE_JOBS"},
 
         {"out-width", 'w', 0, G_OPTION_ARG_INT, &out_config->out_width, 
             "Integer which specifies the width of the scaled output video (default: <input_width>)\n"
@@ -74,9 +161,85 @@ int read_cmd_line_params(int argc, char *argv[], PipelineConfig* out_config) {
        {"bitrate", 0, 0, G_OPTION_ARG_INT, &out_config->bitrate, 
             "Integer which specifies the bitrate of the h264 encoded stream (default: 2000)\n"
             INDENT_LEVEL "Example: --bitrate=1000", "BITRATE"},
+        {"encoder-profile", 0, 0, G_OPTION_ARG_STRING, &out_config->encoder_profile, 
+            "String which specifies the x264 settings, threads are sized from the output size & available cores\n"
+            INDENT_LEVEL "ultra-low-latency, balanced or archival (default: ultra-low-latency)\n"
+            INDENT_LEVEL "Example: --encoder-profile=balanced", "ENCODER_PROFILE"},
+        {"adaptive-bitrate", 0, 0, G_OPTION_ARG_STRING, &out_config->adaptive_bitrate, 
+            "String which specifies the bitrate bounds (kbps) followed according to the scene complexity, --bitrate is the reference\n"
+            INDENT_LEVEL "Scene cuts force a keyframe (default: none, fixed bitrate)\n"
+            INDENT_LEVEL "Example: --adaptive-bitrate=500-4000", "MIN-MAX"},
         {"shader-src-path", 0, 0, G_OPTION_ARG_STRING, &out_config->shader_src_folder, 
-            "String which specifies the path to shaders source directory (default: ./shaders)\n" 
+            "String which specifies a shader source directory overriding the embedded shaders of the same name (default: none)\n" 
             INDENT_LEVEL "Example: --shader-src-path=../shaders", "SHADER_SRC_PATH"},
+        {"stage-threads", 0, 0, G_OPTION_ARG_NONE, &out_config->stage_threads, 
+            "Insert bounded queues between the dec/proc/enc/out stages so each stage runs on its own thread", NULL},
+        {"stage-affinity", 0, 0, G_OPTION_ARG_STRING, &out_config->stage_affinity, 
+            "String which specifies the CPUs each stage thread may run on (stages: dec, proc, enc, out)\n"
+            INDENT_LEVEL "Example: --stage-affinity=\"dec=0;proc=1;enc=2-5;out=6\"", "STAGE_AFFINITY"},
+        {"stage-sched", 0, 0, G_OPTION_ARG_STRING, &out_config->stage_sched, 
+            "String which specifies the scheduling policy (other, batch, fifo, rr) and priority of each stage thread\n"
+            INDENT_LEVEL "Example: --stage-sched=\"enc=fifo:10;out=rr:5\"\n", "STAGE_SCHED"},
+        {"gpu-timing", 0, 0, G_OPTION_ARG_NONE, &out_config->gpu_timing, 
+            "Time each GL shader stage on the GPU with timer queries, reported as ms/frame & share of the frame budget\n", NULL},
+        {"latency-budget", 0, 0, G_OPTION_ARG_INT, &out_config->latency_budget_ms, 
+            "Integer which specifies the capture to output sink latency budget in ms, enables leaky minimal depth\n"
+            INDENT_LEVEL "queues which drop stale frames (default: 0 disabled)\n"
+            INDENT_LEVEL "Example: --latency-budget=100", "LATENCY_MS"},
+        {"source-retries", 0, 0, G_OPTION_ARG_INT, &out_config->source_retries, 
+            "Integer which specifies how many times a failed capture device is re-opened before exiting\n"
+            INDENT_LEVEL "(default: -1 retry forever, 0 disables recovery)\n"
+            INDENT_LEVEL "Example: --source-retries=10\n", "SOURCE_RETRIES"},
+        {"metrics-port", 0, 0, G_OPTION_ARG_INT, &out_config->metrics_port, 
+            "Integer which specifies the port of the Prometheus text metrics endpoint, served on 127.0.0.1 (default: 0 disabled)\n"
+            INDENT_LEVEL "Example: --metrics-port=9100", "PORT"},
+        {"metrics-file", 0, 0, G_OPTION_ARG_STRING, &out_config->metrics_file, 
+            "String which specifies a file rewritten every second with the metrics (Prometheus text format)\n"
+            INDENT_LEVEL "Example: --metrics-file=/tmp/rtvpp.prom\n", "METRICS_FILE"},
+        {"record", 0, 0, G_OPTION_ARG_STRING, &out_config->record, 
+            "String which specifies a file the raw decode stage frames & timestamps are recorded to\n"
+            INDENT_LEVEL "Example: --record=/tmp/capture.rtvpp", "RECORDING"},
+        {"replay", 0, 0, G_OPTION_ARG_STRING, &out_config->replay, 
+            "String which specifies a recording fed to the pipeline instead of the capture device\n"
+            INDENT_LEVEL "Example: --replay=/tmp/capture.rtvpp", "RECORDING"},
+        {"replay-speed", 0, 0, G_OPTION_ARG_STRING, &out_config->replay_speed, 
+            "String which specifies the replay pacing: realtime (as captured) or fast (no clock) (default: realtime)\n"
+            INDENT_LEVEL "Example: --replay-speed=fast", "REPLAY_SPEED"},
+        {"frame-report", 0, 0, G_OPTION_ARG_STRING, &out_config->frame_report, 
+            "String which specifies a CSV file receiving the checksum & processing times of each output frame\n"
+            INDENT_LEVEL "Example: --frame-report=/tmp/run.csv\n", "REPORT_FILE"},
+        {"trace-file", 0, 0, G_OPTION_ARG_STRING, &out_config->trace_file, 
+            "String which specifies the prefix of flight recorder dumps, written on SIGUSR1, errors & latency spikes\n"
+            INDENT_LEVEL "Example: --trace-file=/tmp/rtvpp", "PREFIX"},
+        {"trace-threshold", 0, 0, G_OPTION_ARG_INT, &out_config->trace_threshold_ms, 
+            "Integer which specifies the capture to encoder latency (ms) triggering a flight recorder dump (default: 0 disabled)\n"
+            INDENT_LEVEL "Example: --trace-threshold=100", "MS"},
+        {"trace-json", 0, 0, G_OPTION_ARG_STRING, &out_config->trace_json, 
+            "String which specifies a flight recorder dump converted to Chrome trace JSON (<DUMP>.json), nothing else is run\n"
+            INDENT_LEVEL "Example: --trace-json=/tmp/rtvpp-0.rtvtrace\n", "DUMP"},
+        {"pool-buffers", 0, 0, G_OPTION_ARG_INT, &out_config->pool_buffers, 
+            "Integer which specifies the buffers preallocated by each raw video pool, pools grow up to twice as many\n"
+            INDENT_LEVEL "(default: 4, 0 keeps the default GStreamer allocation)\n"
+            INDENT_LEVEL "Example: --pool-buffers=6", "POOL_BUFFERS"},
+        {"hugepages", 0, 0, G_OPTION_ARG_NONE, &out_config->hugepages, 
+            "Back the raw video pools with huge pages (reserved hugetlbfs pages if available, transparent huge pages otherwise)", NULL},
+        {"alloc-stats", 0, 0, G_OPTION_ARG_NONE, &out_config->alloc_stats, 
+            "Count the buffer allocations per frame of each raw video link, steady state should report 0.00\n", NULL},
+        {"bench", 0, 0, G_OPTION_ARG_STRING, &out_config->bench, 
+            "String which specifies a benchmark to run instead of the live pipeline (scaleconv, shaders, encoder, cpufx)\n"
+            INDENT_LEVEL "Output size is taken from --out-width/--out-height (default: 1280x720)\n"
+            INDENT_LEVEL "Example: --bench=scaleconv", "BENCHMARK"},
+        {"bench-frames", 0, 0, G_OPTION_ARG_INT, &out_config->bench_frames, 
+            "Integer which specifies the number of frames processed per benchmark run (default: 300, shaders: 60)\n"
+            INDENT_LEVEL "Example: --bench-frames=1000", "FRAMES"},
+        {"bench-input", 0, 0, G_OPTION_ARG_STRING, &out_config->bench_input, 
+            "String which specifies the benchmark input frame size (default: 1920x1080)\n"
+            INDENT_LEVEL "Example: --bench-input=3840x2160", "WxH"},
+        {"bench-golden", 0, 0, G_OPTION_ARG_STRING, &out_config->bench_golden, 
+            "String which specifies the folder holding the shader golden images & reference timings (default: ./shaders/golden)\n"
+            INDENT_LEVEL "Example: --bench-golden=../golden", "GOLDEN_FOLDER"},
+        {"bench-update", 0, 0, G_OPTION_ARG_NONE, &out_config->bench_update, 
+            "Rewrite the shader golden images & reference timings instead of checking against them", NULL},
        {NULL}
     };
 
@@ -93,6 +256,10 @@ int read_cmd_line_params(int argc, char *argv[], PipelineConfig* out_config) {
     }
 
     g_option_context_free(context);
+
+    /* The first source is the main camera, the others are only used by the mosaic */
+    if (out_config->dev_srcs && out_config->dev_srcs[0]) 
+        out_config->dev_src = out_config->dev_srcs[0];
     return RET_OK;
 }
     
@@ -0,0 +1,465 @@
+#include "metrics_utils.h"
+#include "log_utils.h"
+
+#include <dirent.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Streaming thread side: relaxed atomics only, ordering between counters does not matter */
+#define COUNTER_ADD(counter, value) __atomic_fetch_add(&(counter), (value), __ATOMIC_RELAXED)
+#define COUNTER_GET(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+typedef struct _StageProbeData {
+    PipelineHandle* handle;
+    PipelineStage stage;
+} StageProbeData;
+
+static StageProbeData stage_probe_data[__PIPELINE_STAGE_MAX];
+
+/* One scrape in flight, owns the connection until the response is written */
+typedef struct _MetricsRequest {
+    PipelineHandle* handle;
+    GSocketConnection* connection;
+    char request[1024];
+    GString* response;
+} MetricsRequest;
+
+static void attach_stage_probes(PipelineHandle *handle, PipelineStage stage, GstPad *entry_pad, GstPad *exit_pad);
+static GstPad* stage_entry_pad(GstElement *queue, GstElement *first);
+static GstPadProbeReturn stage_entry_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn stage_exit_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn capture_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn encoded_frame_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static gboolean update_metrics(gpointer user_data);
+static GString* render_metrics(PipelineHandle *handle);
+static gboolean metrics_incoming_cb(GSocketService *service, GSocketConnection *connection, 
+                                    GObject *source_object, gpointer user_data);
+static void metrics_read_cb(GObject *source_object, GAsyncResult *res, gpointer user_data);
+static void metrics_write_cb(GObject *source_object, GAsyncResult *res, gpointer user_data);
+static void finish_metrics_request(MetricsRequest *request);
+
+int metrics_enabled(PipelineHandle *handle) {
+    return handle->config && (handle->config->metrics_port > 0 || handle->config->metrics_file);
+}
+
+void attach_decoding_stage_metrics(PipelineHandle *handle) {
+    if (!metrics_enabled(handle)) 
+        return;
+
+    /* Capture sequence numbers restart with the device */
+    handle->met.camera_last_offset = GST_BUFFER_OFFSET_NONE;
+
+    GstPad *cam_pad = gst_element_get_static_pad(handle->dec.cam_source, "src");
+    GstPad *out_pad = gst_element_get_static_pad(handle->dec.out_caps_filter, "src");
+    gst_pad_add_probe(cam_pad, GST_PAD_PROBE_TYPE_BUFFER, capture_probe, handle, NULL);
+    attach_stage_probes(handle, PIPELINE_STAGE_DEC, cam_pad, out_pad);
+    gst_object_unref(cam_pad);
+    gst_object_unref(out_pad);
+}
+
+int start_metrics(PipelineHandle *handle) {
+    if (!metrics_enabled(handle)) 
+        return RET_OK;
+
+    /* 1) Stage timing, a stage starts when its thread picks a frame up & ends when the frame is pushed out. 
+       Passthrough H.264 has no processing stage & an encoding stage without encoder */
+    GstElement *proc_first = handle->proc.uploader ? handle->proc.uploader : handle->proc.graph.input;
+    GstElement *enc_first = handle->enc.converter ? handle->enc.converter : 
+                            (handle->enc.encoder ? handle->enc.encoder : handle->enc.out_caps_filter);
+    GstPad *enc_out = gst_element_get_static_pad(handle->enc.out_caps_filter, "src");
+    GstPad *pads[][2] = {
+        [PIPELINE_STAGE_PROC] = {handle->proc.out_caps_filter ? stage_entry_pad(handle->proc.queue, proc_first) : NULL, 
+                                 handle->proc.out_caps_filter ? gst_element_get_static_pad(handle->proc.out_caps_filter, "src") : NULL},
+        [PIPELINE_STAGE_ENC] = {stage_entry_pad(handle->enc.queue, enc_first), gst_object_ref(enc_out)},
+        /* Output stage is measured on the display path (H.264 decode & convert), not at all without display */
+        [PIPELINE_STAGE_OUT] = {handle->out.disp_queue ? stage_entry_pad(handle->out.disp_queue, NULL) : NULL, 
+                                handle->out.disp_converter ? gst_element_get_static_pad(handle->out.disp_converter, "src") : NULL},
+    };
+    for (int stage = PIPELINE_STAGE_PROC; stage <= PIPELINE_STAGE_OUT; stage++) {
+        if (!pads[stage][0] || !pads[stage][1]) {
+            g_clear_object(&pads[stage][0]);
+            g_clear_object(&pads[stage][1]);
+            continue;
+        }
+        attach_stage_probes(handle, stage, pads[stage][0], pads[stage][1]);
+        gst_object_unref(pads[stage][0]);
+        gst_object_unref(pads[stage][1]);
+    }
+
+    /* 2) Encoder output */
+    gst_pad_add_probe(enc_out, GST_PAD_PROBE_TYPE_BUFFER, encoded_frame_probe, handle, NULL);
+    gst_object_unref(enc_out);
+
+    /* 3) Exporters */
+    if (handle->config->metrics_port > 0) {
+        GError *error = NULL;
+        GInetAddress *loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+        GSocketAddress *address = g_inet_socket_address_new(loopback, handle->config->metrics_port);
+        handle->met.service = g_socket_service_new();
+        gboolean ret = g_socket_listener_add_address(G_SOCKET_LISTENER(handle->met.service), address, 
+                                                     G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL, NULL, &error);
+        g_object_unref(address);
+        g_object_unref(loopback);
+        if (!ret) {
+            ERROR_FMT("Failed to listen on metrics port %d: %s", handle->config->metrics_port, error->message);
+            g_clear_error(&error);
+            g_clear_object(&handle->met.service);
+            return RET_ERR;
+        }
+        g_signal_connect(handle->met.service, "incoming", G_CALLBACK(metrics_incoming_cb), handle);
+        g_socket_service_start(handle->met.service);
+        DEBUG_PRINT_FMT("Serving metrics on http://127.0.0.1:%d/metrics\n", handle->config->metrics_port);
+    }
+
+    handle->met.prev.time_us = g_get_monotonic_time();
+    handle->met.update_source_id = g_timeout_add(METRICS_UPDATE_INTERVAL_MS, update_metrics, handle);
+    return RET_OK;
+}
+
+void stop_metrics(PipelineHandle *handle) {
+    if (handle->met.update_source_id) {
+        g_source_remove(handle->met.update_source_id);
+        handle->met.update_source_id = 0;
+    }
+    if (handle->met.service) {
+        g_socket_service_stop(handle->met.service);
+        g_socket_listener_close(G_SOCKET_LISTENER(handle->met.service));
+        g_clear_object(&handle->met.service);
+    }
+}
+
+static void attach_stage_probes(PipelineHandle *handle, PipelineStage stage, GstPad *entry_pad, GstPad *exit_pad) {
+    stage_probe_data[stage] = (StageProbeData){.handle = handle, .stage = stage};
+    gst_pad_add_probe(entry_pad, GST_PAD_PROBE_TYPE_BUFFER, stage_entry_probe, &stage_probe_data[stage], NULL);
+    gst_pad_add_probe(exit_pad, GST_PAD_PROBE_TYPE_BUFFER, stage_exit_probe, &stage_probe_data[stage], NULL);
+}
+
+/* Frames wait in the queue, processing starts when the queue thread pushes them */
+static GstPad* stage_entry_pad(GstElement *queue, GstElement *first) {
+    if (queue) return gst_element_get_static_pad(queue, "src");
+    return gst_element_get_static_pad(first, "sink");
+}
+
+static GstPadProbeReturn stage_entry_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    StageProbeData *data = (StageProbeData*)user_data;
+    data->handle->met.stages[data->stage].enter_us = g_get_monotonic_time();
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn stage_exit_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    StageProbeData *data = (StageProbeData*)user_data;
+    gint64 enter_us = data->handle->met.stages[data->stage].enter_us;
+    if (enter_us == 0) 
+        return GST_PAD_PROBE_OK;
+    COUNTER_ADD(data->handle->met.stages[data->stage].busy_us, (guint64)(g_get_monotonic_time() - enter_us));
+    COUNTER_ADD(data->handle->met.stages[data->stage].frames, 1);
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn capture_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    COUNTER_ADD(handle->met.frames_in, 1);
+
+    /* v4l2src sets the offset to the driver sequence number, gaps are frames the driver dropped */
+    guint64 offset = GST_BUFFER_OFFSET(buffer);
+    if (offset != GST_BUFFER_OFFSET_NONE) {
+        if (handle->met.camera_last_offset != GST_BUFFER_OFFSET_NONE && offset > handle->met.camera_last_offset + 1) 
+            COUNTER_ADD(handle->met.camera_dropped, offset - handle->met.camera_last_offset - 1);
+        handle->met.camera_last_offset = offset;
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn encoded_frame_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    guint64 size = gst_buffer_get_size(buffer);
+
+    COUNTER_ADD(handle->met.frames_out, 1);
+    COUNTER_ADD(handle->met.encoded_bytes, size);
+    if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) 
+        COUNTER_ADD(handle->met.encoded_keyframes, 1);
+
+    guint64 cur_max = COUNTER_GET(handle->met.max_frame_bytes);
+    while (size > cur_max && !__atomic_compare_exchange_n(&handle->met.max_frame_bytes, &cur_max, size, TRUE, 
+                                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return GST_PAD_PROBE_OK;
+}
+
+static gboolean update_metrics(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    gint64 now_us = g_get_monotonic_time();
+    double elapsed_sec = (now_us - handle->met.prev.time_us) / 1e6;
+    if (elapsed_sec <= 0.0) 
+        return G_SOURCE_CONTINUE;
+
+    /* 1) Rates over the last interval */
+    guint64 frames_in = COUNTER_GET(handle->met.frames_in);
+    guint64 frames_out = COUNTER_GET(handle->met.frames_out);
+    guint64 encoded_bytes = COUNTER_GET(handle->met.encoded_bytes);
+    handle->met.fps_in = (frames_in - handle->met.prev.frames_in) / elapsed_sec;
+    handle->met.fps_out = (frames_out - handle->met.prev.frames_out) / elapsed_sec;
+    handle->met.bitrate_kbps = (encoded_bytes - handle->met.prev.encoded_bytes) * 8 / 1000.0 / elapsed_sec;
+    handle->met.window_max_frame_bytes = __atomic_exchange_n(&handle->met.max_frame_bytes, 0, __ATOMIC_RELAXED);
+
+    for (int stage = 0; stage < __PIPELINE_STAGE_MAX; stage++) {
+        guint64 busy_us = COUNTER_GET(handle->met.stages[stage].busy_us);
+        guint64 frames = COUNTER_GET(handle->met.stages[stage].frames);
+        guint64 delta_frames = frames - handle->met.prev.stage_frames[stage];
+        handle->met.stage_frame_ms[stage] = delta_frames ? 
+            (busy_us - handle->met.prev.stage_busy_us[stage]) / 1000.0 / delta_frames : 0.0;
+        handle->met.prev.stage_busy_us[stage] = busy_us;
+        handle->met.prev.stage_frames[stage] = frames;
+    }
+    handle->met.prev.time_us = now_us;
+    handle->met.prev.frames_in = frames_in;
+    handle->met.prev.frames_out = frames_out;
+    handle->met.prev.encoded_bytes = encoded_bytes;
+
+    /* 2) Rewrite metrics file, replaced atomically so readers never see a partial file */
+    if (handle->config->metrics_file) {
+        GError *error = NULL;
+        GString *text = render_metrics(handle);
+        if (!g_file_set_contents(handle->config->metrics_file, text->str, text->len, &error)) {
+            ERROR_FMT("Failed to write metrics file: %s", error->message);
+            g_clear_error(&error);
+        }
+        g_string_free(text, TRUE);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void render_queue_levels(PipelineHandle *handle, GString *text) {
+    GstElement *queues[] = {handle->proc.queue, handle->enc.queue, handle->out.queue, 
+                            handle->out.dev_queue, handle->out.disp_queue};
+    g_string_append(text, "# HELP rtvpp_queue_level_buffers Buffers currently held by each queue\n"
+                          "# TYPE rtvpp_queue_level_buffers gauge\n");
+    for (size_t idx = 0; idx < G_N_ELEMENTS(queues); idx++) {
+        guint level = 0;
+        if (!queues[idx]) continue;
+        g_object_get(G_OBJECT(queues[idx]), "current-level-buffers", &level, NULL);
+        g_string_append_printf(text, "rtvpp_queue_level_buffers{queue=\"%s\"} %u\n", GST_ELEMENT_NAME(queues[idx]), level);
+    }
+    g_string_append(text, "# HELP rtvpp_queue_capacity_buffers Max buffers each queue may hold (0 unlimited)\n"
+                          "# TYPE rtvpp_queue_capacity_buffers gauge\n");
+    for (size_t idx = 0; idx < G_N_ELEMENTS(queues); idx++) {
+        guint capacity = 0;
+        if (!queues[idx]) continue;
+        g_object_get(G_OBJECT(queues[idx]), "max-size-buffers", &capacity, NULL);
+        g_string_append_printf(text, "rtvpp_queue_capacity_buffers{queue=\"%s\"} %u\n", GST_ELEMENT_NAME(queues[idx]), capacity);
+    }
+}
+
+/* utime & stime of every thread of the process, threads are named after the GStreamer task owning them */
+static void render_thread_cpu(GString *text) {
+    static long ticks_per_sec = 0;
+    if (!ticks_per_sec) ticks_per_sec = sysconf(_SC_CLK_TCK);
+
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) return;
+
+    g_string_append(text, "# HELP rtvpp_thread_cpu_seconds_total CPU time (user + system) used by each thread\n"
+                          "# TYPE rtvpp_thread_cpu_seconds_total counter\n");
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char path[300], stat[1024], name[64] = "";
+        unsigned long utime = 0, stime = 0;
+        if (entry->d_name[0] == '.') continue;
+
+        snprintf(path, sizeof(path), "/proc/self/task/%s/stat", entry->d_name);
+        FILE *file = fopen(path, "r");
+        if (!file) continue;
+        size_t len = fread(stat, 1, sizeof(stat) - 1, file);
+        fclose(file);
+        stat[len] = '\0';
+
+        /* "tid (comm) state ..." comm may contain spaces, fields resume after the last ')' */
+        char *comm_start = strchr(stat, '(');
+        char *comm_end = strrchr(stat, ')');
+        if (!comm_start || !comm_end || comm_end < comm_start) continue;
+        snprintf(name, sizeof(name), "%.*s", (int)(comm_end - comm_start - 1), comm_start + 1);
+        /* Skip state (3) to cutime, utime & stime are fields 14 & 15 */
+        if (sscanf(comm_end + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) 
+            continue;
+        g_string_append_printf(text, "rtvpp_thread_cpu_seconds_total{tid=\"%s\",name=\"%s\"} %.2f\n", 
+                               entry->d_name, name, (double)(utime + stime) / ticks_per_sec);
+    }
+    closedir(dir);
+}
+
+static long read_rss_bytes() {
+    long pages = 0;
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+    if (fscanf(file, "%*ld %ld", &pages) != 1) pages = 0;
+    fclose(file);
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+static GString* render_metrics(PipelineHandle *handle) {
+    GString *text = g_string_new(NULL);
+
+    /* 1) Throughput */
+    g_string_append_printf(text, 
+        "# HELP rtvpp_frames_total Frames captured (input) & encoded (output)\n"
+        "# TYPE rtvpp_frames_total counter\n"
+        "rtvpp_frames_total{point=\"input\"} %" G_GUINT64_FORMAT "\n"
+        "rtvpp_frames_total{point=\"output\"} %" G_GUINT64_FORMAT "\n"
+        "# HELP rtvpp_fps Frames per second over the last update interval\n"
+        "# TYPE rtvpp_fps gauge\n"
+        "rtvpp_fps{point=\"input\"} %.2f\n"
+        "rtvpp_fps{point=\"output\"} %.2f\n",
+        COUNTER_GET(handle->met.frames_in), COUNTER_GET(handle->met.frames_out), 
+        handle->met.fps_in, handle->met.fps_out);
+
+    /* 2) Drops: driver sequence gaps & leaky queues */
+    g_string_append_printf(text, 
+        "# HELP rtvpp_frames_dropped_total Frames dropped per element\n"
+        "# TYPE rtvpp_frames_dropped_total counter\n"
+        "rtvpp_frames_dropped_total{element=\"camera-source\"} %" G_GUINT64_FORMAT "\n", 
+        COUNTER_GET(handle->met.camera_dropped));
+    for (int idx = 0; idx < handle->lat.num_queues; idx++) {
+        g_string_append_printf(text, "rtvpp_frames_dropped_total{element=\"%s\"} %u\n", 
+                               GST_ELEMENT_NAME(handle->lat.queues[idx].queue), 
+                               g_atomic_int_get(&handle->lat.queues[idx].dropped));
+    }
+
+    /* 3) Queues */
+    render_queue_levels(handle, text);
+
+    /* 4) Encoder */
+    g_string_append_printf(text, 
+        "# HELP rtvpp_encoded_bytes_total Bytes produced by the encoder\n"
+        "# TYPE rtvpp_encoded_bytes_total counter\n"
+        "rtvpp_encoded_bytes_total %" G_GUINT64_FORMAT "\n"
+        "# HELP rtvpp_encoded_keyframes_total Keyframes produced by the encoder\n"
+        "# TYPE rtvpp_encoded_keyframes_total counter\n"
+        "rtvpp_encoded_keyframes_total %" G_GUINT64_FORMAT "\n"
+        "# HELP rtvpp_encoded_bitrate_kbps Encoded bitrate over the last update interval\n"
+        "# TYPE rtvpp_encoded_bitrate_kbps gauge\n"
+        "rtvpp_encoded_bitrate_kbps %.1f\n"
+        "# HELP rtvpp_encoded_frame_bytes Encoded frame size over the last update interval\n"
+        "# TYPE rtvpp_encoded_frame_bytes gauge\n"
+        "rtvpp_encoded_frame_bytes{stat=\"avg\"} %.0f\n"
+        "rtvpp_encoded_frame_bytes{stat=\"max\"} %" G_GUINT64_FORMAT "\n",
+        COUNTER_GET(handle->met.encoded_bytes), COUNTER_GET(handle->met.encoded_keyframes), 
+        handle->met.bitrate_kbps, handle->met.fps_out > 0.0 ? handle->met.bitrate_kbps * 1000.0 / 8 / handle->met.fps_out : 0.0,
+        handle->met.window_max_frame_bytes);
+
+    /* 5) Stages */
+    g_string_append(text, "# HELP rtvpp_stage_busy_seconds_total Time spent processing frames per stage\n"
+                          "# TYPE rtvpp_stage_busy_seconds_total counter\n");
+    for (int stage = 0; stage < __PIPELINE_STAGE_MAX; stage++) {
+        g_string_append_printf(text, "rtvpp_stage_busy_seconds_total{stage=\"%s\"} %.3f\n", 
+                               pipeline_stage_to_str(stage), COUNTER_GET(handle->met.stages[stage].busy_us) / 1e6);
+    }
+    g_string_append(text, "# HELP rtvpp_stage_frame_ms Average processing time per frame over the last update interval\n"
+                          "# TYPE rtvpp_stage_frame_ms gauge\n");
+    for (int stage = 0; stage < __PIPELINE_STAGE_MAX; stage++) {
+        g_string_append_printf(text, "rtvpp_stage_frame_ms{stage=\"%s\"} %.3f\n", 
+                               pipeline_stage_to_str(stage), handle->met.stage_frame_ms[stage]);
+    }
+
+    /* 6) GPU time per shader stage (averaged over the GPU timing report window) */
+    if (handle->gpu.report_source_id) {
+        g_string_append(text, "# HELP rtvpp_shader_gpu_frame_ms GPU time per frame of each shader stage\n"
+                              "# TYPE rtvpp_shader_gpu_frame_ms gauge\n");
+        for (int idx = 0; idx < handle->gpu.num_stages; idx++) {
+            const char* shader_name = g_object_get_data(G_OBJECT(handle->gpu.stages[idx].shader), SHADER_NAME_KEY);
+            g_string_append_printf(text, "rtvpp_shader_gpu_frame_ms{stage=\"%d\",shader=\"%s\"} %.3f\n", 
+                                   idx, shader_name ? shader_name : "", handle->gpu.stages[idx].frame_ms);
+        }
+        g_string_append_printf(text, 
+            "# HELP rtvpp_frame_budget_ms Frame interval of the capture framerate\n"
+            "# TYPE rtvpp_frame_budget_ms gauge\n"
+            "rtvpp_frame_budget_ms %.3f\n", handle->gpu.budget_ms);
+    }
+
+    /* 7) Region of interest stages */
+    if (handle->roi.num > 0) {
+        g_string_append(text, "# HELP rtvpp_roi_shaded_pixels_total Pixels shaded by each region of interest stage\n"
+                              "# TYPE rtvpp_roi_shaded_pixels_total counter\n");
+        for (int idx = 0; idx < handle->roi.num; idx++) {
+            RoiStage *stage = &handle->roi.stages[idx];
+            const char* shader_name = g_object_get_data(G_OBJECT(stage->shader), SHADER_NAME_KEY);
+            g_string_append_printf(text, "rtvpp_roi_shaded_pixels_total{stage=\"%s\",shader=\"%s\"} %" G_GUINT64_FORMAT "\n", 
+                                   GST_ELEMENT_NAME(stage->shader), shader_name ? shader_name : "", stage->shaded_pixels);
+        }
+        g_string_append(text, "# HELP rtvpp_roi_frame_pixels_total Pixels of the frames going through each region of interest stage\n"
+                              "# TYPE rtvpp_roi_frame_pixels_total counter\n");
+        for (int idx = 0; idx < handle->roi.num; idx++) {
+            RoiStage *stage = &handle->roi.stages[idx];
+            const char* shader_name = g_object_get_data(G_OBJECT(stage->shader), SHADER_NAME_KEY);
+            g_string_append_printf(text, "rtvpp_roi_frame_pixels_total{stage=\"%s\",shader=\"%s\"} %" G_GUINT64_FORMAT "\n", 
+                                   GST_ELEMENT_NAME(stage->shader), shader_name ? shader_name : "", stage->frame_pixels);
+        }
+    }
+
+    /* 8) Scene complexity & adaptive bitrate */
+    if (handle->cpx.update_source_id) {
+        g_string_append_printf(text, 
+            "# HELP rtvpp_scene_complexity Smoothed scene complexity (0..1) driving the encoder bitrate\n"
+            "# TYPE rtvpp_scene_complexity gauge\n"
+            "rtvpp_scene_complexity %.4f\n"
+            "# HELP rtvpp_target_bitrate_kbps Encoder bitrate set by the adaptive bitrate controller\n"
+            "# TYPE rtvpp_target_bitrate_kbps gauge\n"
+            "rtvpp_target_bitrate_kbps %d\n", 
+            g_atomic_int_get(&handle->cpx.complexity) / 10000.0, handle->cpx.target_kbps);
+    }
+
+    /* 9) Process */
+    render_thread_cpu(text);
+    g_string_append_printf(text, 
+        "# HELP rtvpp_resident_memory_bytes Resident set size\n"
+        "# TYPE rtvpp_resident_memory_bytes gauge\n"
+        "rtvpp_resident_memory_bytes %ld\n", read_rss_bytes());
+    return text;
+}
+
+static gboolean metrics_incoming_cb(GSocketService *service, GSocketConnection *connection, 
+                                    GObject *source_object, gpointer user_data) {
+    MetricsRequest *request = g_new0(MetricsRequest, 1);
+    request->handle = (PipelineHandle*)user_data;
+    request->connection = g_object_ref(connection);
+
+    /* Single endpoint, request is not parsed. Read & write are asynchronous so a slow or idle client 
+       never holds the main loop, the socket timeout drops it */
+    g_socket_set_timeout(g_socket_connection_get_socket(connection), METRICS_SOCKET_TIMEOUT_SEC);
+    g_input_stream_read_async(g_io_stream_get_input_stream(G_IO_STREAM(connection)), request->request, 
+                              sizeof(request->request), G_PRIORITY_DEFAULT, NULL, metrics_read_cb, request);
+    return TRUE;
+}
+
+static void metrics_read_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+    MetricsRequest *request = (MetricsRequest*)user_data;
+    if (g_input_stream_read_finish(G_INPUT_STREAM(source_object), res, NULL) < 0) {
+        finish_metrics_request(request);
+        return;
+    }
+
+    GString *body = render_metrics(request->handle);
+    request->response = g_string_new(NULL);
+    g_string_printf(request->response, "HTTP/1.0 200 OK\r\n"
+                                       "Content-Type: text/plain; version=0.0.4\r\n"
+                                       "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+                                       "Connection: close\r\n\r\n", body->len);
+    g_string_append_len(request->response, body->str, body->len);
+    g_string_free(body, TRUE);
+    g_output_stream_write_all_async(g_io_stream_get_output_stream(G_IO_STREAM(request->connection)), 
+                                    request->response->str, request->response->len, G_PRIORITY_DEFAULT, NULL, 
+                                    metrics_write_cb, request);
+}
+
+static void metrics_write_cb(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+    g_output_stream_write_all_finish(G_OUTPUT_STREAM(source_object), res, NULL, NULL);
+    finish_metrics_request((MetricsRequest*)user_data);
+}
+
+static void finish_metrics_request(MetricsRequest *request) {
+    g_io_stream_close(G_IO_STREAM(request->connection), NULL, NULL);
+    g_object_unref(request->connection);
+    if (request->response) 
+        g_string_free(request->response, TRUE);
+    g_free(request);
+}
@@ -0,0 +1,18 @@
+#ifndef __METRICS_UTILS_H__
+#define __METRICS_UTILS_H__
+
+#include <gst/gst.h>
+#include "pipeline.h"
+
+/* Interval between rate updates & metrics file rewrites */
+#define METRICS_UPDATE_INTERVAL_MS 1000
+/* Scrapes are served asynchronously from the main loop, clients idle for longer are dropped */
+#define METRICS_SOCKET_TIMEOUT_SEC 1
+
+int metrics_enabled(PipelineHandle *handle);
+/* Called each time the decoding stage is (re-)created */
+void attach_decoding_stage_metrics(PipelineHandle *handle);
+int start_metrics(PipelineHandle *handle);
+void stop_metrics(PipelineHandle *handle);
+
+#endif
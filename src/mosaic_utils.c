@@ -0,0 +1,113 @@
+#include "mosaic_utils.h"
+#include "log_utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static void layout_mosaic_grid(MosaicInput* inputs, int num, int width, int height);
+
+int parse_mosaic_inputs(PipelineConfig* config, CamParams* cam_params, DecodingStage* dec, 
+                        MosaicInput** out_inputs, int* out_num) {
+    *out_inputs = NULL;
+    *out_num = 0;
+    int num = config->dev_srcs ? g_strv_length(config->dev_srcs) : 0;
+    if (num < 2) 
+        return RET_OK;
+    if (num > MAX_NUM_MOSAIC_INPUTS) {
+        ERROR_FMT("Too many sources (%d), a mosaic holds at most %d", num, MAX_NUM_MOSAIC_INPUTS);
+        return RET_ERR;
+    }
+
+    /* 1) Sources, extra cameras get their own parameters & decoding stage */
+    MosaicInput* inputs = g_new0(MosaicInput, num);
+    for (int idx = 0; idx < num; idx++) {
+        if (idx == 0) {
+            inputs[idx].cam_params = cam_params;
+            inputs[idx].dec = dec;
+        } else {
+            inputs[idx].cam_params = g_new0(CamParams, 1);
+            inputs[idx].dec = g_new0(DecodingStage, 1);
+        }
+    }
+
+    /* 2) Per source shader graphs */
+    if (config->mosaic_shaders) {
+        gchar** entries = g_strsplit(config->mosaic_shaders, MOSAIC_SHADERS_DELIMITERS, -1);
+        int num_entries = g_strv_length(entries);
+        if (num_entries > num) {
+            ERROR_FMT("Mosaic has %d sources but %d shader graphs", num, num_entries);
+            g_strfreev(entries);
+            cleanup_mosaic(inputs, num);
+            return RET_ERR;
+        }
+        for (int idx = 0; idx < num_entries; idx++) {
+            g_strstrip(entries[idx]);
+            if (entries[idx][0] != '\0') 
+                inputs[idx].shader_pipeline = g_strdup(entries[idx]);
+        }
+        g_strfreev(entries);
+    }
+
+    *out_inputs = inputs;
+    *out_num = num;
+    return RET_OK;
+}
+
+int layout_mosaic(const char* layout, MosaicInput* inputs, int num, int width, int height) {
+    if (!layout || strcmp(layout, MOSAIC_LAYOUT_GRID) == 0) {
+        layout_mosaic_grid(inputs, num, width, height);
+        return RET_OK;
+    }
+
+    /* Custom tiles, one per source */
+    gchar** tiles = g_strsplit(layout, MOSAIC_TILE_DELIMITERS, -1);
+    int num_tiles = g_strv_length(tiles);
+    if (num_tiles != num) {
+        ERROR_FMT("Mosaic has %d sources but %d tiles", num, num_tiles);
+        g_strfreev(tiles);
+        return RET_ERR;
+    }
+    for (int idx = 0; idx < num; idx++) {
+        MosaicInput* input = &inputs[idx];
+        if (sscanf(tiles[idx], "%d,%d,%d,%d", &input->x, &input->y, &input->width, &input->height) != 4 || 
+            input->x < 0 || input->y < 0 || input->width <= 0 || input->height <= 0 || 
+            input->x + input->width > width || input->y + input->height > height) {
+            ERROR_FMT("Invalid mosaic tile [%s], expected x,y,w,h within %dx%d", tiles[idx], width, height);
+            g_strfreev(tiles);
+            return RET_ERR;
+        }
+    }
+    g_strfreev(tiles);
+    return RET_OK;
+}
+
+void cleanup_mosaic(MosaicInput* inputs, int num) {
+    for (int idx = 0; idx < num; idx++) {
+        if (idx > 0) {
+            cleanup_cam_params(inputs[idx].cam_params);
+            g_free(inputs[idx].cam_params);
+            g_free(inputs[idx].dec);
+        }
+        g_free(inputs[idx].shader_pipeline);
+    }
+    g_free(inputs);
+}
+
+/* Equal cells filled row by row, each camera scaled to fit its cell & centered (letterboxed) */
+static void layout_mosaic_grid(MosaicInput* inputs, int num, int width, int height) {
+    int cols = (int)ceil(sqrt((double)num));
+    int rows = (num + cols - 1) / cols;
+    int cell_width = width / cols;
+    int cell_height = height / rows;
+
+    for (int idx = 0; idx < num; idx++) {
+        MosaicInput* input = &inputs[idx];
+        double scale = MIN((double)cell_width / input->cam_params->width, 
+                           (double)cell_height / input->cam_params->height);
+        input->width = MAX((int)(input->cam_params->width * scale), 1);
+        input->height = MAX((int)(input->cam_params->height * scale), 1);
+        input->x = (idx % cols) * cell_width + (cell_width - input->width) / 2;
+        input->y = (idx / cols) * cell_height + (cell_height - input->height) / 2;
+    }
+}
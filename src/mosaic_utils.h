@@ -0,0 +1,29 @@
+#ifndef __MOSAIC_UTILS_H__
+#define __MOSAIC_UTILS_H__
+
+#include <gst/gst.h>
+#include "pipeline.h"
+
+/* Mosaic layout syntax: "grid" (default, cells of ceil(sqrt(N)) columns, each camera keeps its aspect ratio) 
+ * or one tile per source "x,y,w,h[;x,y,w,h..]" in output frame pixels, in --dev-src order
+ * Eg. "0,0,1280,720;1280,0,640,360;1280,360,640,360" */
+#define MOSAIC_LAYOUT_GRID "grid"
+#define MOSAIC_TILE_DELIMITERS ";"
+/* Per source shader graphs are separated by '|' (graphs use ';'), an empty entry leaves the camera as is 
+ * Eg. "invert_color | | vertical_flip ! vignette" */
+#define MOSAIC_SHADERS_DELIMITERS "|"
+#define MAX_NUM_MOSAIC_INPUTS 16
+
+/* Depth of the leaky queue in front of each camera upload, a slow compositor drops old frames instead of 
+   blocking the camera */
+#define MOSAIC_INPUT_QUEUE_DEPTH 1
+
+/* Creates one input per source (none with a single source), the first input borrows cam_params & handle->dec. 
+   out_inputs must be freed with cleanup_mosaic */
+int parse_mosaic_inputs(PipelineConfig* config, CamParams* cam_params, DecodingStage* dec, 
+                        MosaicInput** out_inputs, int* out_num);
+/* Places every input (camera parameters must be known) on a width x height output frame */
+int layout_mosaic(const char* layout, MosaicInput* inputs, int num, int width, int height);
+void cleanup_mosaic(MosaicInput* inputs, int num);
+
+#endif
@@ -5,19 +5,70 @@
 #include "log_utils.h"
 #include "cam_utils.h"
 #include "shader_utils.h"
+#include "latency_utils.h"
+#include "metrics_utils.h"
+#include "gpu_timing_utils.h"
+#include "pool_utils.h"
+#include "replay_utils.h"
+#include "trace_utils.h"
+#include "mosaic_utils.h"
+#include "complexity_utils.h"
+#include "idle_utils.h"
+#include "join_utils.h"
+#include "roi_utils.h"
+#include "source_utils.h"
+#include "encoder_utils.h"
+#include "gl_utils.h"
+#include "cpufx.h"
+#include "scaleconv.h"
 #include <time.h>
 
 
-static int create_decoding_stage(PipelineHandle *handle, CamParams *cam_params);
+static int create_decoding_stage(PipelineHandle *handle, DecodingStage *dec, CamParams *cam_params, const char* name);
 static int create_processing_stage(PipelineHandle *handle, CamParams* cam_params, PipelineConfig* pipeline_config);
 static int create_encoding_stage(PipelineHandle *handle, PipelineConfig* pipeline_config);
 static int create_output_stage(PipelineHandle *handle, PipelineConfig* pipeline_config);
+static int create_rendition_stage(PipelineHandle *handle, CamParams* cam_params, PipelineConfig* pipeline_config);
+static int create_recovery_stage(PipelineHandle *handle, CamParams* cam_params);
+static int create_mosaic_stage(PipelineHandle *handle, PipelineConfig* pipeline_config);
+static int create_file_decoding_stage(PipelineHandle *handle, CamParams *cam_params);
+static int create_file_output_stage(PipelineHandle *handle, PipelineConfig* pipeline_config, 
+                                    const char* out_path, const char* muxer_name);
+static void file_decoder_pad_added(GstElement *decoder, GstPad *pad, gpointer user_data);
+
+static GstElement* create_stage_queue(PipelineHandle *handle, PipelineConfig *pipeline_config, 
+                                        const char* name, const char* stage);
+
+static gboolean bus_message_handler(GstBus* bus, GstMessage* msg, gpointer user_data);
+static GstBusSyncReply bus_sync_handler(GstBus* bus, GstMessage* msg, gpointer user_data);
+static void start_source_recovery(PipelineHandle *handle);
+static void teardown_decoding_stage(PipelineHandle *handle, DecodingStage *dec);
+static void start_mosaic_input_recovery(PipelineHandle *handle, MosaicInput *input);
+static gboolean retry_mosaic_input(gpointer user_data);
+static gboolean finish_mosaic_input_recovery(gpointer user_data);
+static GstPadProbeReturn mosaic_first_buffer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static MosaicInput* find_mosaic_input(PipelineHandle *handle, GstObject *src);
+static gboolean retry_decoding_stage(gpointer user_data);
+static gboolean finish_source_recovery(gpointer user_data);
+static GstPadProbeReturn drop_eos_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn first_buffer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
 
 
 static GstElement* create_caps_filter(const char* type, const char* name, const char* format, 
                                         int width, int height, int fr_num, int fr_denom);
-static int create_shader_pipeline_from_string(PipelineHandle *handle, const char* shader_pipeline);
 static GstElement* create_shader(const char* shader_name); 
+static GstElement* create_camera_h264_decoder(PipelineHandle *handle);
+static GstElement* create_cpu_effect(const char* effect_name);
+static GstElement* processing_stage_input(PipelineHandle *handle);
+static GstElement* encoding_stage_input(PipelineHandle *handle);
+static int select_cpu_effects(PipelineConfig *pipeline_config);
+static int select_fused_scale_convert(PipelineConfig *pipeline_config);
+static const char* select_decoding_format(PipelineHandle *handle, CamParams *cam_params);
+static int select_passthrough(PipelineHandle *handle, CamParams *cam_params);
+
+/* Backoff bounds used when re-opening a failed decoding stage */
+#define SOURCE_RETRY_MIN_BACKOFF_MS 250
+#define SOURCE_RETRY_MAX_BACKOFF_MS 5000
 
 //#define DEBUT_SHOW_CAPS
 #ifdef DEBUG_SHOW_CAPS
@@ -28,11 +79,16 @@ void get_default_pipeline_config(PipelineConfig *out_pipeline_config) {
     *out_pipeline_config = (PipelineConfig){
         .dev_src = "/dev/video0",
         .shader_pipeline = "vertical_flip ! invert_color",
-        .shader_src_folder = "./shaders",
         .bitrate = 2000, 
+        .source_retries = -1,
+        .cpu_effects = "auto",
+        .scale_convert = "fused",
+        .idle_mode = "off",
+        .join_keyframe_ms = 1000,
         .out_height = -1, 
         .out_width = -1, 
         .dev_sink = NULL, 
+        .pool_buffers = POOL_DEFAULT_MIN_BUFFERS, 
     };
 }
 
@@ -40,39 +96,184 @@ int create_pipeline(CamParams *cam_params, PipelineConfig *pipeline_config, Pipe
     int create_res = 0;
     gboolean link_res = FALSE;
 
+    handle->cam_params = cam_params;
+    handle->config = pipeline_config;
+
+    /* 0) Parse per stage thread settings */
+    CHECK(parse_stage_affinity(pipeline_config->stage_affinity, handle->thread_cfg) == RET_OK, 
+        "Failed to parse stage affinity", RET_ERR);
+    CHECK(parse_stage_sched(pipeline_config->stage_sched, handle->thread_cfg) == RET_OK, 
+        "Failed to parse stage scheduling policy", RET_ERR);
+    CHECK(parse_renditions(pipeline_config->renditions, &handle->ren.items, &handle->ren.num) == RET_OK, 
+        "Failed to parse renditions", RET_ERR);
+    CHECK(parse_mosaic_inputs(pipeline_config, cam_params, &handle->dec, &handle->mos.inputs, &handle->mos.num) == RET_OK, 
+        "Failed to parse mosaic", RET_ERR);
+    CHECK(handle->mos.num == 0 || !pipeline_config->replay, "A replay can not be combined with a mosaic", RET_ERR);
+
     /* 1) Create the empty pipeline */
     handle->pipeline = gst_pipeline_new("processing-pipeline");
     CHECK(handle->pipeline != NULL, "Failed to create pipeline", RET_ERR);
 
-    /* 2) Create stages */    
-    create_res = create_decoding_stage(handle, cam_params);
+    /* Fast replay: no clock, every element runs as soon as data is available. Leaky queues would drop 
+       frames depending on the host speed, which breaks frame for frame comparisons */
+    if (pipeline_config->replay) {
+        int replay_fast = select_replay_fast(pipeline_config);
+        CHECK(replay_fast != RET_ERR, "Failed to select replay speed", RET_ERR);
+        CHECK(!replay_fast || pipeline_config->latency_budget_ms <= 0, 
+            "Fast replay can not be combined with a latency budget", RET_ERR);
+        if (replay_fast) 
+            gst_pipeline_use_clock(GST_PIPELINE(handle->pipeline), NULL);
+    }
+    /* Fast pattern, file & stdin sources run the same way, frames are produced as fast as the pipeline takes them */
+    if (!pipeline_config->replay && cam_params->source_type != CAM_SOURCE_V4L2) {
+        int source_fast = select_source_fast(pipeline_config);
+        CHECK(source_fast != RET_ERR, "Failed to select source speed", RET_ERR);
+        CHECK(!source_fast || pipeline_config->latency_budget_ms <= 0, 
+            "Fast sources can not be combined with a latency budget", RET_ERR);
+        if (source_fast) 
+            gst_pipeline_use_clock(GST_PIPELINE(handle->pipeline), NULL);
+    }
+
+    /* Streaming threads announce themselves through stream-status messages, configure them in place */
+    if (pipeline_config->stage_affinity || pipeline_config->stage_sched) {
+        GstBus *bus = gst_element_get_bus(handle->pipeline);
+        gst_bus_set_sync_handler(bus, bus_sync_handler, handle, NULL);
+        gst_object_unref(bus);
+    }
+
+    CHECK(configure_idle_mode(handle) == RET_OK, "Failed to configure idle mode", RET_ERR);
+
+    /* Decoding stage output, an H.264 camera skips the processing & encoding when there is nothing to do */
+    handle->dec_format = select_decoding_format(handle, cam_params);
+    CHECK(handle->dec_format != NULL, "Failed to select decoding stage format", RET_ERR);
+    handle->passthrough = select_passthrough(handle, cam_params);
+    CHECK(handle->passthrough != RET_ERR, "Failed to select passthrough mode", RET_ERR);
+
+    /* 2) Create stages, a mosaic feeds the processing stage with composited frames as if they came from one camera */    
+    create_res = create_decoding_stage(handle, &handle->dec, cam_params, "decoding-stage");
     CHECK(create_res == 0, "Failed to create decoding stage of pipeline", RET_ERR); 
 
-    create_res = create_processing_stage(handle, cam_params, pipeline_config);
-    CHECK(create_res == 0, "Failed to create processing stage of pipeline", RET_ERR);
+    /* Mosaic tiles keep their last frame while a camera is re-opened, no placeholder needed. 
+       A black placeholder can not be spliced into a passthrough H.264 stream */
+    if (pipeline_config->source_retries != 0 && handle->mos.num == 0 && !handle->passthrough) {
+        create_res = create_recovery_stage(handle, cam_params);
+        CHECK(create_res == 0, "Failed to create recovery stage of pipeline", RET_ERR);
+    }
+
+    CamParams *proc_params = cam_params;
+    if (handle->mos.num > 0) {
+        handle->mos.canvas = (CamParams){
+            .pixelformat = PIX_FMT_RGBA, 
+            .width = pipeline_config->out_width > 0 ? pipeline_config->out_width : cam_params->width, 
+            .height = pipeline_config->out_height > 0 ? pipeline_config->out_height : cam_params->height, 
+            .fr_num = cam_params->fr_num, 
+            .fr_denom = cam_params->fr_denom, 
+        };
+        proc_params = &handle->mos.canvas;
+    }
+
+    if (!handle->passthrough) {
+        create_res = create_processing_stage(handle, proc_params, pipeline_config);
+        CHECK(create_res == 0, "Failed to create processing stage of pipeline", RET_ERR);
+    }
+
+    if (handle->mos.num > 0) {
+        create_res = create_mosaic_stage(handle, pipeline_config);
+        CHECK(create_res == 0, "Failed to create mosaic stage of pipeline", RET_ERR);
+    }
 
     create_res = create_encoding_stage(handle, pipeline_config);
     CHECK(create_res == 0, "Failed to create encoding stage of pipeline", RET_ERR);
 
+    create_res = configure_adaptive_bitrate(handle);
+    CHECK(create_res == 0, "Failed to configure adaptive bitrate", RET_ERR);
+
     create_res = create_output_stage(handle, pipeline_config);
     CHECK(create_res == 0, "Failed to create output stage of pipeline", RET_ERR);
 
+    if (handle->ren.num > 0) {
+        create_res = create_rendition_stage(handle, proc_params, pipeline_config);
+        CHECK(create_res == 0, "Failed to create rendition stage of pipeline", RET_ERR);
+    }
+
     /* 3) Link stages */
-    link_res = gst_element_link(handle->dec.out_caps_filter, handle->proc.uploader);  
+    GstElement *proc_input = handle->passthrough ? encoding_stage_input(handle) : processing_stage_input(handle);
+    if (handle->mos.num > 0) {
+        link_res = gst_element_link(handle->mos.downloader ? handle->mos.downloader : handle->mos.caps_filter, 
+                                    proc_input);
+    } else if (handle->rec.selector) {
+        link_res = gst_element_link(handle->dec.bin, handle->rec.selector) &&
+                   gst_element_link(handle->rec.selector, proc_input);
+    } else {
+        link_res = gst_element_link(handle->dec.bin, proc_input);  
+    }
     CHECK(link_res == TRUE, "Failed to link decode and processing stages of the pipeline", RET_ERR);
 
-    link_res = gst_element_link(handle->proc.out_caps_filter, handle->enc.converter);
-    CHECK(link_res == TRUE, "Failed to link processing and encoding stages of the pipeline", RET_ERR);
+    if (!handle->passthrough) {
+        link_res = gst_element_link(handle->proc.out_caps_filter, encoding_stage_input(handle));
+        CHECK(link_res == TRUE, "Failed to link processing and encoding stages of the pipeline", RET_ERR);
+    }
 
-    link_res = gst_element_link(handle->enc.out_caps_filter, handle->out.tee);
+    link_res = gst_element_link(handle->enc.out_caps_filter, 
+                                handle->out.queue ? handle->out.queue : handle->out.tee);
     CHECK(link_res == TRUE, "Failed to link encoding and output stages of the pipeline", RET_ERR);
 
+    /* 4) Keep track of the selector pads used for switching between live and placeholder frames */
+    if (handle->rec.selector) {
+        GstPad *dec_src = gst_element_get_static_pad(handle->dec.bin, "src");
+        handle->rec.live_pad = gst_pad_get_peer(dec_src);
+        gst_object_unref(dec_src);
+        g_object_set(G_OBJECT(handle->rec.selector), "active-pad", handle->rec.live_pad, NULL);
+    }
+
+    return RET_OK;
+}
+
+int create_file_pipeline(CamParams *cam_params, PipelineConfig *pipeline_config, const char* out_path, 
+                         const char* muxer_name, PipelineHandle *handle) {
+    int create_res = 0;
+    gboolean link_res = FALSE;
+
+    handle->cam_params = cam_params;
+    handle->config = pipeline_config;
+
+    /* 1) Create the empty pipeline */
+    handle->pipeline = gst_pipeline_new(NULL);
+    CHECK(handle->pipeline != NULL, "Failed to create pipeline", RET_ERR);
+
+    /* 2) Create stages, processing & encoding are the same as for a live run */
+    create_res = create_file_decoding_stage(handle, cam_params);
+    CHECK(create_res == 0, "Failed to create file decoding stage of pipeline", RET_ERR);
+
+    create_res = create_processing_stage(handle, cam_params, pipeline_config);
+    CHECK(create_res == 0, "Failed to create processing stage of pipeline", RET_ERR);
+
+    create_res = create_encoding_stage(handle, pipeline_config);
+    CHECK(create_res == 0, "Failed to create encoding stage of pipeline", RET_ERR);
+
+    /* Containers store AVC (length prefixed) streams, h264parse converts */
+    GstCaps *caps = gst_caps_from_string("video/x-h264,stream-format=avc,alignment=au");
+    g_object_set(G_OBJECT(handle->enc.out_caps_filter), "caps", caps, NULL);
+    gst_caps_unref(caps);
+
+    create_res = create_file_output_stage(handle, pipeline_config, out_path, muxer_name);
+    CHECK(create_res == 0, "Failed to create file output stage of pipeline", RET_ERR);
+
+    /* 3) Link stages */
+    link_res = gst_element_link(handle->dec.bin, processing_stage_input(handle));
+    CHECK(link_res == TRUE, "Failed to link decode and processing stages of the pipeline", RET_ERR);
+
+    link_res = gst_element_link(handle->proc.out_caps_filter, encoding_stage_input(handle));
+    CHECK(link_res == TRUE, "Failed to link processing and encoding stages of the pipeline", RET_ERR);
+
+    link_res = gst_element_link(handle->enc.out_caps_filter, 
+                                handle->out.queue ? handle->out.queue : handle->out.muxer);
+    CHECK(link_res == TRUE, "Failed to link encoding and output stages of the pipeline", RET_ERR);
     return RET_OK;
 }
 
 int play_pipeline(PipelineHandle *handle) {
     GstBus *bus = NULL;
-    GstMessage *msg = NULL;
     GstStateChangeReturn ret;
 
     /* Start playing */
@@ -86,48 +287,202 @@ int play_pipeline(PipelineHandle *handle) {
     /* DEBUG: output dot file describing pipeline */
     gst_debug_bin_to_dot_file(GST_BIN(handle->pipeline), GST_DEBUG_GRAPH_SHOW_CAPS_DETAILS, "debug_pipeline_nodes.dot");
 
-    /* Wait until error or EOS */
+    /* Run main loop until unrecoverable error or EOS, bus messages are handled by bus_message_handler */
+    handle->exit_code = RET_OK;
+    if (start_latency_monitor(handle) != RET_OK) 
+        ERROR("Failed to start latency monitor");
+    if (start_metrics(handle) != RET_OK) 
+        ERROR("Failed to start metrics exporter");
+    if (start_gpu_timing(handle) != RET_OK) 
+        ERROR("Failed to start GPU timing");
+    if (start_pool_stats(handle) != RET_OK) 
+        ERROR("Failed to start allocation stats");
+    if (start_frame_report(handle) != RET_OK) 
+        ERROR("Failed to start frame report");
+    if (start_flight_recorder(handle) != RET_OK) 
+        ERROR("Failed to start flight recorder");
+    if (start_adaptive_bitrate(handle) != RET_OK) 
+        ERROR("Failed to start adaptive bitrate");
+    if (start_idle_monitor(handle) != RET_OK) 
+        ERROR("Failed to start idle monitor");
+    if (start_join_monitor(handle) != RET_OK) 
+        ERROR("Failed to start join monitor");
+    if (start_roi_monitor(handle) != RET_OK) 
+        ERROR("Failed to start ROI monitor");
+    handle->loop = g_main_loop_new(NULL, FALSE);
     bus = gst_element_get_bus(handle->pipeline);
-    msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ERROR| GST_MESSAGE_EOS);
-
-    /* Parse message */ 
-    if (msg != NULL) {
-        GError *err;
-        gchar *debug_info;
-
-        switch (GST_MESSAGE_TYPE(msg)) {
-            case GST_MESSAGE_ERROR: 
-                gst_message_parse_error(msg, &err, &debug_info);
-                ERROR_FMT("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
-                ERROR_FMT("Debugging information: %s\n", debug_info ? debug_info: "none");
-                g_clear_error(&err);
-                g_free(debug_info);
-                return RET_ERR; 
-            case GST_MESSAGE_EOS: 
-                DEBUG_PRINT("End-Of-Stream reached.\n");
-                break;
-            default: 
-                /* We should no reach this point because we only asked for ERRORs and EOS */
-                DEBUG_PRINT("Unexpected message received. \n");
-                break;
-        }
-        gst_message_unref(msg);
-    }
+    gst_bus_add_watch(bus, bus_message_handler, handle);
+    g_main_loop_run(handle->loop);
 
     /* Free resources */
+    stop_latency_monitor(handle);
+    stop_metrics(handle);
+    stop_pool_stats(handle);
+    stop_flight_recorder(handle);
+    stop_adaptive_bitrate(handle);
+    stop_idle_monitor(handle);
+    stop_join_monitor(handle);
+    stop_roi_monitor(handle);
+    stop_replay(handle);
+    if (handle->rec.retry_source_id) 
+        g_source_remove(handle->rec.retry_source_id);
+    for (int idx = 0; idx < handle->mos.num; idx++) {
+        if (handle->mos.inputs[idx].retry_source_id) 
+            g_source_remove(handle->mos.inputs[idx].retry_source_id);
+    }
+    gst_bus_remove_watch(bus);
     gst_object_unref(bus);
+    g_main_loop_unref(handle->loop);
     gst_element_set_state(handle->pipeline, GST_STATE_NULL);
+    stop_gpu_timing(handle);
+    cleanup_adaptive_bitrate(handle);
+    cleanup_replay(handle);
+    if (handle->rec.selector) {
+        gst_object_unref(handle->rec.live_pad);
+        gst_object_unref(handle->rec.placeholder_pad);
+    }
+    for (int idx = 0; idx < handle->mos.num; idx++) {
+        gst_object_unref(handle->mos.inputs[idx].mixer_pad);
+    }
     gst_object_unref(handle->pipeline);
+    cleanup_renditions(handle->ren.items, handle->ren.num);
+    cleanup_mosaic(handle->mos.inputs, handle->mos.num);
+    cleanup_buffer_pools(handle);
 
-    return RET_OK;
+    return handle->exit_code;
+}
+
+static GstBusSyncReply bus_sync_handler(GstBus* bus, GstMessage* msg, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstStreamStatusType type;
+    GstElement *owner = NULL;
+
+    if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_STREAM_STATUS) 
+        return GST_BUS_PASS;
+    
+    /* ENTER is posted from the streaming thread itself */
+    gst_message_parse_stream_status(msg, &type, &owner);
+    if (type != GST_STREAM_STATUS_TYPE_ENTER || owner == NULL) 
+        return GST_BUS_PASS;
+
+    /* The element owning the task determines which stage runs on the thread */ 
+    static const struct { const char* owner; PipelineStage stage; } owner_to_stage[] = {
+        {"camera-source", PIPELINE_STAGE_DEC},
+        {"rec-placeholder", PIPELINE_STAGE_DEC},
+        {"proc-queue", PIPELINE_STAGE_PROC},
+        {"enc-queue", PIPELINE_STAGE_ENC},
+        {"out-queue", PIPELINE_STAGE_OUT},
+        {"disp-devqueue", PIPELINE_STAGE_OUT},
+        {"disp-dispqueue", PIPELINE_STAGE_OUT},
+    };
+    for (size_t idx = 0; idx < sizeof(owner_to_stage) / sizeof(owner_to_stage[0]); idx++) {
+        if (strcmp(GST_ELEMENT_NAME(owner), owner_to_stage[idx].owner) == 0) {
+            PipelineStage stage = owner_to_stage[idx].stage;
+            DEBUG_PRINT_FMT("Configuring streaming thread of %s for stage %s\n", 
+                            GST_ELEMENT_NAME(owner), pipeline_stage_to_str(stage));
+            apply_thread_config(stage, &handle->thread_cfg[stage]);
+            break;
+        }
+    }
+    /* Elements of the pattern, file & stdin sources (readers, parsers, decoders) feed the decoding stage */
+    if (g_str_has_prefix(GST_ELEMENT_NAME(owner), "src-")) {
+        DEBUG_PRINT_FMT("Configuring streaming thread of %s for stage %s\n", 
+                        GST_ELEMENT_NAME(owner), pipeline_stage_to_str(PIPELINE_STAGE_DEC));
+        apply_thread_config(PIPELINE_STAGE_DEC, &handle->thread_cfg[PIPELINE_STAGE_DEC]);
+    }
+    /* Mosaic input branches upload & shade their camera, the mixer composites, the complexity analysis downscales */
+    if (g_str_has_prefix(GST_ELEMENT_NAME(owner), "mos-") || g_str_has_prefix(GST_ELEMENT_NAME(owner), "cpx-")) {
+        DEBUG_PRINT_FMT("Configuring streaming thread of %s for stage %s\n", 
+                        GST_ELEMENT_NAME(owner), pipeline_stage_to_str(PIPELINE_STAGE_PROC));
+        apply_thread_config(PIPELINE_STAGE_PROC, &handle->thread_cfg[PIPELINE_STAGE_PROC]);
+    }
+    /* Rendition branches mostly run their encoder */
+    if (g_str_has_prefix(GST_ELEMENT_NAME(owner), "ren-")) {
+        DEBUG_PRINT_FMT("Configuring streaming thread of %s for stage %s\n", 
+                        GST_ELEMENT_NAME(owner), pipeline_stage_to_str(PIPELINE_STAGE_ENC));
+        apply_thread_config(PIPELINE_STAGE_ENC, &handle->thread_cfg[PIPELINE_STAGE_ENC]);
+    }
+    return GST_BUS_PASS;
+}
+
+static gboolean bus_message_handler(GstBus* bus, GstMessage* msg, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GError *err;
+    gchar *debug_info;
+
+    switch (GST_MESSAGE_TYPE(msg)) {
+        case GST_MESSAGE_ERROR: 
+            gst_message_parse_error(msg, &err, &debug_info);
+            ERROR_FMT("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+            ERROR_FMT("Debugging information: %s\n", debug_info ? debug_info: "none");
+            g_clear_error(&err);
+            g_free(debug_info);
+
+            /* A torn down decoding stage (main or mosaic camera) can still have errors queued (eg. the flow 
+               error following the source error), its elements are no longer in the pipeline */
+            if ((handle->rec.selector || handle->mos.num > 0) && 
+                !gst_object_has_as_ancestor(msg->src, GST_OBJECT(handle->pipeline))) {
+                DEBUG_PRINT_FMT("Ignoring error of torn down element %s\n", GST_OBJECT_NAME(msg->src));
+                break;
+            }
+            TRACE_EVENT(TRACE_EVENT_ERROR, 0, 0, 0);
+            dump_flight_recorder(handle, TRACE_DUMP_ERROR);
+
+            /* Errors raised by the decoding stage are recoverable, everything else is fatal */
+            MosaicInput *input = find_mosaic_input(handle, msg->src);
+            if (input && handle->config->source_retries != 0) {
+                start_mosaic_input_recovery(handle, input);
+                break;
+            }
+            if (handle->rec.selector && handle->dec.bin && 
+                gst_object_has_as_ancestor(msg->src, GST_OBJECT(handle->dec.bin))) {
+                start_source_recovery(handle);
+                break;
+            }
+            handle->exit_code = RET_ERR;
+            g_main_loop_quit(handle->loop);
+            break;
+        case GST_MESSAGE_EOS: 
+            DEBUG_PRINT("End-Of-Stream reached.\n");
+            g_main_loop_quit(handle->loop);
+            break;
+        case GST_MESSAGE_QOS: {
+            guint64 processed, dropped;
+            gint64 jitter;
+            gst_message_parse_qos_stats(msg, NULL, &processed, &dropped);
+            gst_message_parse_qos_values(msg, &jitter, NULL, NULL);
+            TRACE_EVENT(TRACE_EVENT_QOS, 0, (guint32)dropped, (guint64)jitter);
+            break;
+        }
+        case GST_MESSAGE_STATE_CHANGED: 
+            if (GST_MESSAGE_SRC(msg) == GST_OBJECT(handle->pipeline)) {
+                GstState old_state, new_state;
+                gst_message_parse_state_changed(msg, &old_state, &new_state, NULL);
+                TRACE_EVENT(TRACE_EVENT_STATE, 0, (old_state << 8) | new_state, 0);
+            }
+            break;
+        default: 
+            break;
+    }
+    return TRUE;
 }
 
-static int create_decoding_stage(PipelineHandle* handle, CamParams* cam_params) {
-    /* 1) Create v4l2 source element */
-    handle->dec.cam_source = gst_element_factory_make("v4l2src", "camera-source"); 
-    CHECK(handle->dec.cam_source != NULL, "Failed to allocate v4l2src element", RET_ERR);
-    g_object_set(G_OBJECT(handle->dec.cam_source), 
-                "device", cam_params->dev_path, NULL);
+static int create_decoding_stage(PipelineHandle* handle, DecodingStage* dec, CamParams* cam_params, const char* name) {
+    /* 0) Create bin holding the stage elements */
+    dec->bin = gst_bin_new(name);
+    CHECK(dec->bin != NULL, "Failed to allocate decoding stage bin", RET_ERR);
+    dec->owner = handle;
+
+    /* 1) Create camera source element (or the recording replay source), 
+       only the main decoding stage is replayed, recorded & instrumented */
+    int is_main = (dec == &handle->dec);
+    if (is_main && handle->config && handle->config->replay) {
+        dec->cam_source = create_replay_source(handle);
+        CHECK(dec->cam_source != NULL, "Failed to create replay source", RET_ERR);
+    } else {
+        dec->cam_source = create_input_source(handle, cam_params);
+        CHECK(dec->cam_source != NULL, "Failed to create camera source", RET_ERR);
+    }
 
     /* 2) Create capsfilter for source element & decoder */
     DEBUG_PRINT_FMT("GStreamer compatible source format %s\n", pixel_format_to_str(cam_params->pixelformat));
@@ -136,129 +491,754 @@ static int create_decoding_stage(PipelineHandle* handle, CamParams* cam_params)
         case PIX_FMT_BGR24:
         case PIX_FMT_I420:
         case PIX_FMT_YUY2:
-            handle->dec.cam_caps_filter = create_caps_filter("video/x-raw", "camera-capsfilter", 
+        case PIX_FMT_NV12:
+        case PIX_FMT_RGBA:
+            dec->cam_caps_filter = create_caps_filter("video/x-raw", "camera-capsfilter", 
                             pixel_format_to_str(cam_params->pixelformat), 
                             cam_params->width, cam_params->height, 
                             cam_params->fr_num, cam_params->fr_denom);
-            handle->dec.decoder = NULL;
+            dec->decoder = NULL;
             break;
         case PIX_FMT_MJPG:
-            handle->dec.cam_caps_filter = create_caps_filter("image/jpeg", "camera-capsfilter", 
+            dec->cam_caps_filter = create_caps_filter("image/jpeg", "camera-capsfilter", 
                             pixel_format_to_str(cam_params->pixelformat), 
                             cam_params->width, cam_params->height, 
                             cam_params->fr_num, cam_params->fr_denom);
-            handle->dec.decoder = gst_element_factory_make("avdec_mjpeg", "camera-decoder");
-            CHECK(handle->dec.decoder != NULL, "Failed to allocate camera decoder", RET_ERR);
+            dec->decoder = gst_element_factory_make("avdec_mjpeg", "camera-decoder");
+            CHECK(dec->decoder != NULL, "Failed to allocate camera decoder", RET_ERR);
+            break;
+        case PIX_FMT_H264:
+            dec->cam_caps_filter = create_caps_filter("video/x-h264", "camera-capsfilter", 
+                            pixel_format_to_str(cam_params->pixelformat), 
+                            cam_params->width, cam_params->height, 
+                            cam_params->fr_num, cam_params->fr_denom);
+            dec->parser = gst_element_factory_make("h264parse", "camera-parser");
+            CHECK(dec->parser != NULL, "Failed to allocate camera parser", RET_ERR);
+            if (is_main && handle->passthrough) {
+                /* SPS/PPS repeated with every IDR, readers may join the output at any keyframe */
+                g_object_set(G_OBJECT(dec->parser), "config-interval", -1, NULL);
+                break;
+            }
+            dec->decoder = create_camera_h264_decoder(handle);
+            CHECK(dec->decoder != NULL, "Failed to allocate camera decoder", RET_ERR);
             break;
         default:
             ERROR("Failed to create caps filter! Unsupported pixel format");
             return RET_ERR;
     }
-    CHECK(handle->dec.cam_caps_filter != NULL, "Failed to allocate camera capsfilter", RET_ERR);
+    CHECK(dec->cam_caps_filter != NULL, "Failed to allocate camera capsfilter", RET_ERR);
+
+    /* 3-4) Create video converter & output capsfilter. NV12 is converted by the processing stage on the GPU, 
+       passthrough H.264 leaves the stage parsed into byte-stream access units */
+    const char* out_format = is_main ? handle->dec_format : "RGBA";
+    if (is_main && handle->passthrough) {
+        dec->out_caps_filter = gst_element_factory_make("capsfilter", "output-capsfilter");
+        CHECK(dec->out_caps_filter != NULL, "Failed to allocate output camera capsfilter", RET_ERR);
+        GstCaps* caps = gst_caps_from_string("video/x-h264,stream-format=byte-stream,alignment=au");
+        g_object_set(G_OBJECT(dec->out_caps_filter), "caps", caps, NULL);
+        gst_caps_unref(caps);
+    } else {
+        if (cam_params->pixelformat != PIX_FMT_NV12 || strcmp(out_format, "NV12") != 0) {
+            dec->converter = gst_element_factory_make("videoconvert", "camera-convert");
+            CHECK(dec->converter != NULL, "Failed to allocate camera converter", RET_ERR);
+        }
+        dec->out_caps_filter = create_caps_filter("video/x-raw", "output-capsfilter",
+                                    out_format, 
+                                    cam_params->width, cam_params->height,
+                                    cam_params->fr_num, cam_params->fr_denom);
+        CHECK(dec->out_caps_filter != NULL, "Failed to allocate output camera capsfilter", RET_ERR);
+    }
+    
+    /* 5-6) Add front end elements to stage bin & link them in order, optional elements might be NULL */ 
+    GstElement* chain[] = {dec->cam_source, dec->cam_caps_filter, dec->parser, dec->decoder, 
+                           dec->converter, dec->out_caps_filter};
+    GstElement* prev = NULL;
+    gboolean res = TRUE;
+    for (size_t idx = 0; idx < G_N_ELEMENTS(chain) && res; idx++) {
+        if (!chain[idx]) 
+            continue;
+        gst_bin_add(GST_BIN(dec->bin), chain[idx]);
+        if (prev) 
+            res = gst_element_link(prev, chain[idx]);
+        prev = chain[idx];
+    }
+    CHECK(res == TRUE, "Failed to link elements", RET_ERR);
+
+    /* 7) Expose stage output & add bin to pipeline */
+    GstPad *out_pad = gst_element_get_static_pad(dec->out_caps_filter, "src");
+    res = gst_element_add_pad(dec->bin, gst_ghost_pad_new("src", out_pad));
+    gst_object_unref(out_pad);
+    CHECK(res == TRUE, "Failed to add decoding stage ghost pad", RET_ERR);
+    gst_bin_add(GST_BIN(handle->pipeline), dec->bin);
+
+    /* A failing source pushes EOS after posting its error, keep it away from the 
+       rest of the pipeline when the stage can be re-opened */
+    if (handle->config && handle->config->source_retries != 0) {
+        GstPad *ghost_pad = gst_element_get_static_pad(dec->bin, "src");
+        gst_pad_add_probe(ghost_pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, drop_eos_probe, NULL, NULL);
+        gst_object_unref(ghost_pad);
+    }
+    if (dec->decoder) 
+        configure_buffer_pool(handle, dec->decoder);
+    if (dec->converter) 
+        configure_buffer_pool(handle, dec->converter);
+    attach_decoding_stage_idle(handle, dec);
+    if (!is_main) 
+        return RET_OK;
+    attach_decoding_stage_metrics(handle);
+    attach_decoding_stage_trace(handle);
+    CHECK(configure_recorder(handle) == RET_OK, "Failed to configure recorder", RET_ERR);
+        
+    return RET_OK;
+}
+
+/* Camera H.264 decoder, slice threading only when the latency is budgeted */
+static GstElement* create_camera_h264_decoder(PipelineHandle *handle) {
+    GstElement *decoder = gst_element_factory_make("avdec_h264", "camera-decoder");
+    CHECK(decoder != NULL, "Failed to allocate avdec_h264 element", NULL);
+    int num_threads = MIN((int)g_get_num_processors(), CAMERA_DECODE_MAX_THREADS);
+    g_object_set(G_OBJECT(decoder), "max-threads", num_threads, NULL);
+    if (handle->config && handle->config->latency_budget_ms > 0) 
+        gst_util_set_object_arg(G_OBJECT(decoder), "thread-type", "slice");
+    return decoder;
+}
+
+static int create_file_decoding_stage(PipelineHandle* handle, CamParams* cam_params) {
+    /* 0) Create bin holding the stage elements */
+    handle->dec.bin = gst_bin_new("decoding-stage");
+    CHECK(handle->dec.bin != NULL, "Failed to allocate decoding stage bin", RET_ERR);
+
+    /* 1) Create file source element */
+    handle->dec.file_source = gst_element_factory_make("filesrc", "file-source");
+    CHECK(handle->dec.file_source != NULL, "Failed to allocate filesrc element", RET_ERR);
+    g_object_set(G_OBJECT(handle->dec.file_source), "location", cam_params->dev_path, NULL);
+
+    /* 2) Create demuxer & decoder, output pads are only known once the stream is parsed */
+    handle->dec.file_decoder = gst_element_factory_make("decodebin", "file-decoder");
+    CHECK(handle->dec.file_decoder != NULL, "Failed to allocate decodebin element", RET_ERR);
+    g_signal_connect(handle->dec.file_decoder, "pad-added", G_CALLBACK(file_decoder_pad_added), handle);
 
     /* 3) Create video converter */
-    handle->dec.converter = gst_element_factory_make("videoconvert", "camera-convert");
-    CHECK(handle->dec.converter != NULL, "Failed to allocate camera converter", RET_ERR);
+    handle->dec.converter = gst_element_factory_make("videoconvert", "file-convert");
+    CHECK(handle->dec.converter != NULL, "Failed to allocate file converter", RET_ERR);
 
     /* 4) Create output capsfilter */ 
     handle->dec.out_caps_filter = create_caps_filter("video/x-raw", "output-capsfilter",
                                 "RGBA", 
                                 cam_params->width, cam_params->height,
                                 cam_params->fr_num, cam_params->fr_denom);
-    CHECK(handle->dec.out_caps_filter != NULL, "Failed to allocate output camera capsfilter", RET_ERR);
-    
-    /* 5) Add front end elements to pipeline */ 
-    gst_bin_add_many(GST_BIN(handle->pipeline), 
-                     handle->dec.cam_source,
-                     handle->dec.cam_caps_filter,
-                     handle->dec.converter, 
-                     handle->dec.out_caps_filter,
-                     handle->dec.decoder, /* Adding it last cause it might be NULL*/
-                     NULL);
-    
-    /* 6) Link all elements */
-    gboolean res = TRUE;
-    if (handle->dec.decoder) {
-        res = gst_element_link_many(handle->dec.cam_source,
-                              handle->dec.cam_caps_filter, 
-                              handle->dec.decoder, 
-                              handle->dec.converter, 
-                              handle->dec.out_caps_filter, NULL);
-    } else {
-        res = gst_element_link_many(handle->dec.cam_source,
-                              handle->dec.cam_caps_filter, 
-                              handle->dec.converter, 
-                              handle->dec.out_caps_filter, NULL);
-    }
+    CHECK(handle->dec.out_caps_filter != NULL, "Failed to allocate output file capsfilter", RET_ERR);
+
+    /* 5) Add & link static elements */
+    gst_bin_add_many(GST_BIN(handle->dec.bin), handle->dec.file_source, handle->dec.file_decoder, 
+                     handle->dec.converter, handle->dec.out_caps_filter, NULL);
+    gboolean res = gst_element_link(handle->dec.file_source, handle->dec.file_decoder) &&
+                   gst_element_link(handle->dec.converter, handle->dec.out_caps_filter);
     CHECK(res == TRUE, "Failed to link elements", RET_ERR);
-        
+
+    /* 6) Expose stage output & add bin to pipeline */
+    GstPad *out_pad = gst_element_get_static_pad(handle->dec.out_caps_filter, "src");
+    res = gst_element_add_pad(handle->dec.bin, gst_ghost_pad_new("src", out_pad));
+    gst_object_unref(out_pad);
+    CHECK(res == TRUE, "Failed to add decoding stage ghost pad", RET_ERR);
+    gst_bin_add(GST_BIN(handle->pipeline), handle->dec.bin);
+    configure_buffer_pool(handle, handle->dec.converter);
     return RET_OK;
 }
 
+static void file_decoder_pad_added(GstElement *decoder, GstPad *pad, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstPad *sink_pad = gst_element_get_static_pad(handle->dec.converter, "sink");
+
+    /* Only the first video stream is processed, audio & other streams are left unlinked */
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (!caps) caps = gst_pad_query_caps(pad, NULL);
+    const char* media_type = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+    if (g_str_has_prefix(media_type, "video/x-raw") && !gst_pad_is_linked(sink_pad)) {
+        if (gst_pad_link(pad, sink_pad) != GST_PAD_LINK_OK) 
+            ERROR_FMT("Failed to link decoded stream %s", media_type);
+    }
+    gst_caps_unref(caps);
+    gst_object_unref(sink_pad);
+}
+
+static int create_recovery_stage(PipelineHandle *handle, CamParams *cam_params) {
+    /* 1) Create placeholder source */
+    handle->rec.placeholder_source = gst_element_factory_make("videotestsrc", "rec-placeholder");
+    CHECK(handle->rec.placeholder_source != NULL, "Failed to allocate videotestsrc element", RET_ERR);
+    g_object_set(G_OBJECT(handle->rec.placeholder_source), 
+                "is-live", TRUE, 
+                "pattern", 2, // black frames
+                NULL);
+
+    /* 2) Create placeholder caps filter, must match the decoding stage output */
+    handle->rec.placeholder_caps_filter = create_caps_filter("video/x-raw", "rec-placeholder-capsfilter",
+                                handle->dec_format, 
+                                cam_params->width, cam_params->height,
+                                cam_params->fr_num, cam_params->fr_denom);
+    CHECK(handle->rec.placeholder_caps_filter != NULL, "Failed to allocate placeholder capsfilter", RET_ERR);
+
+    /* 3) Create selector */
+    handle->rec.selector = gst_element_factory_make("input-selector", "rec-selector");
+    CHECK(handle->rec.selector != NULL, "Failed to allocate input-selector element", RET_ERR);
+
+    /* 4) Add elements */
+    gst_bin_add_many(GST_BIN(handle->pipeline), handle->rec.placeholder_source, 
+                    handle->rec.placeholder_caps_filter, handle->rec.selector, NULL);
+
+    /* 5) Link elements, live pad is requested when linking the decoding stage */
+    gboolean ret = gst_element_link_many(handle->rec.placeholder_source, handle->rec.placeholder_caps_filter, 
+                                        handle->rec.selector, NULL);
+    CHECK(ret != FALSE, "Failed to link elements in recovery stage", RET_ERR);
+    GstPad *placeholder_src = gst_element_get_static_pad(handle->rec.placeholder_caps_filter, "src");
+    handle->rec.placeholder_pad = gst_pad_get_peer(placeholder_src);
+    gst_object_unref(placeholder_src);
+
+    handle->rec.backoff_ms = SOURCE_RETRY_MIN_BACKOFF_MS;
+    return RET_OK;
+}
+
+static void start_source_recovery(PipelineHandle *handle) {
+    /* Retry already scheduled, stage is down */
+    if (handle->rec.retry_source_id) 
+        return;
+
+    /* Switch to placeholder frames on first failure */
+    if (!handle->rec.recovering) {
+        DEBUG_PRINT("Decoding stage failed, switching to placeholder frames\n");
+        g_object_set(G_OBJECT(handle->rec.selector), "active-pad", handle->rec.placeholder_pad, NULL);
+        handle->rec.recovering = TRUE;
+        handle->rec.error_time_us = g_get_monotonic_time();
+    }
+
+    teardown_decoding_stage(handle, &handle->dec);
+
+    /* Give up after the configured number of retries */ 
+    if (handle->config->source_retries > 0 && handle->rec.num_retries >= handle->config->source_retries) {
+        ERROR_FMT("Failed to re-open decoding stage after %d retries", handle->rec.num_retries);
+        handle->exit_code = RET_ERR;
+        g_main_loop_quit(handle->loop);
+        return;
+    }
+
+    DEBUG_PRINT_FMT("Re-opening decoding stage in %u ms\n", handle->rec.backoff_ms);
+    handle->rec.retry_source_id = g_timeout_add(handle->rec.backoff_ms, retry_decoding_stage, handle);
+    handle->rec.backoff_ms = MIN(handle->rec.backoff_ms * 2, SOURCE_RETRY_MAX_BACKOFF_MS);
+}
+
+static void teardown_decoding_stage(PipelineHandle *handle, DecodingStage *dec) {
+    if (!dec->bin) 
+        return;
+    gst_element_set_state(dec->bin, GST_STATE_NULL);
+    /* Removing the bin also unlinks it from the selector (or mosaic input) and drops the last reference */ 
+    gst_bin_remove(GST_BIN(handle->pipeline), dec->bin);
+    memset(dec, 0, sizeof(*dec));
+}
+
+static gboolean retry_decoding_stage(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    handle->rec.retry_source_id = 0;
+    handle->rec.num_retries++;
+    DEBUG_PRINT_FMT("Re-opening decoding stage, attempt %d\n", handle->rec.num_retries);
+
+    /* Re-create stage and link it to the selector pad it was using */
+    if (create_decoding_stage(handle, &handle->dec, handle->cam_params, "decoding-stage") != RET_OK) {
+        start_source_recovery(handle);
+        return G_SOURCE_REMOVE;
+    }
+    GstPad *dec_src = gst_element_get_static_pad(handle->dec.bin, "src");
+    if (gst_pad_link(dec_src, handle->rec.live_pad) != GST_PAD_LINK_OK) {
+        ERROR("Failed to link decoding stage to selector");
+        gst_object_unref(dec_src);
+        start_source_recovery(handle);
+        return G_SOURCE_REMOVE;
+    }
+
+    /* Recovery is complete once the first live frame leaves the stage */
+    gst_pad_add_probe(dec_src, GST_PAD_PROBE_TYPE_BUFFER, first_buffer_probe, handle, NULL);
+    gst_object_unref(dec_src);
+
+    if (!gst_element_sync_state_with_parent(handle->dec.bin)) {
+        ERROR("Failed to start decoding stage");
+        start_source_recovery(handle);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean finish_source_recovery(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    if (!handle->rec.recovering) 
+        return G_SOURCE_REMOVE;
+
+    g_object_set(G_OBJECT(handle->rec.selector), "active-pad", handle->rec.live_pad, NULL);
+    DEBUG_PRINT_FMT("Decoding stage recovered after %d retries in %.1f ms\n", handle->rec.num_retries,
+                    (g_get_monotonic_time() - handle->rec.error_time_us) / 1000.0);
+
+    handle->rec.recovering = FALSE;
+    handle->rec.num_retries = 0;
+    handle->rec.backoff_ms = SOURCE_RETRY_MIN_BACKOFF_MS;
+    return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn drop_eos_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS)
+        return GST_PAD_PROBE_DROP;
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn first_buffer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    /* Called from the streaming thread, switch back from the main loop */
+    g_idle_add(finish_source_recovery, user_data);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+static int create_mosaic_stage(PipelineHandle *handle, PipelineConfig *pipeline_config) {
+    CamParams *canvas = &handle->mos.canvas;
+    char name[64];
+
+    /* 1) Read the extra cameras parameters & place every camera on the output frame */
+    for (int idx = 1; idx < handle->mos.num; idx++) {
+        MosaicInput *input = &handle->mos.inputs[idx];
+        DEBUG_PRINT_FMT("Reading camera parameters for device %s\n", pipeline_config->dev_srcs[idx]);
+        CHECK(read_source_params(pipeline_config->dev_srcs[idx], input->cam_params) == RET_OK, 
+              "Failed to read mosaic camera parameters", RET_ERR);
+    }
+    CHECK(layout_mosaic(pipeline_config->mosaic_layout, handle->mos.inputs, handle->mos.num, 
+                        canvas->width, canvas->height) == RET_OK, "Failed to lay out mosaic", RET_ERR);
+
+    /* 2) Create GPU compositor. Output frames are due at the first camera framerate, a camera with nothing new 
+       by then keeps its last frame (slower or stalled cameras never hold the output back) */
+    handle->mos.mixer = gst_element_factory_make("glvideomixer", "mos-mixer");
+    CHECK(handle->mos.mixer != NULL, "Failed to allocate glvideomixer element", RET_ERR);
+    g_object_set(G_OBJECT(handle->mos.mixer), 
+                "background", 1, // black
+                "latency", gst_util_uint64_scale(GST_SECOND, canvas->fr_num, canvas->fr_denom), 
+                "start-time-selection", 1, // first buffer
+                NULL);
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(handle->mos.mixer), "ignore-inactive-pads")) 
+        g_object_set(G_OBJECT(handle->mos.mixer), "ignore-inactive-pads", TRUE, NULL);
+
+    /* 3) Create output caps filter, fixes the output size & framerate (frames stay in GL memory) */
+    handle->mos.caps_filter = gst_element_factory_make("capsfilter", "mos-capsfilter");
+    CHECK(handle->mos.caps_filter != NULL, "Failed to allocate capsfilter", RET_ERR);
+    GstCaps *caps = gst_caps_new_simple("video/x-raw", 
+                                        "format", G_TYPE_STRING, "RGBA", 
+                                        "width", G_TYPE_INT, canvas->width, 
+                                        "height", G_TYPE_INT, canvas->height, 
+                                        "framerate", GST_TYPE_FRACTION, canvas->fr_denom, canvas->fr_num,
+                                        "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
+                                        NULL);
+    gst_caps_set_features(caps, 0, gst_caps_features_new(GST_CAPS_FEATURE_MEMORY_GL_MEMORY, NULL));
+    g_object_set(G_OBJECT(handle->mos.caps_filter), "caps", caps, NULL);
+    gst_caps_unref(caps);
+
+    /* 4) The CPU effect engine expects frames in system memory */
+    gst_bin_add_many(GST_BIN(handle->pipeline), handle->mos.mixer, handle->mos.caps_filter, NULL);
+    CHECK(gst_element_link(handle->mos.mixer, handle->mos.caps_filter) == TRUE, "Failed to link mosaic mixer", RET_ERR);
+    if (!handle->proc.uploader) {
+        handle->mos.downloader = gst_element_factory_make("gldownload", "mos-download");
+        CHECK(handle->mos.downloader != NULL, "Failed to allocate gldownload element", RET_ERR);
+        gst_bin_add(GST_BIN(handle->pipeline), handle->mos.downloader);
+        CHECK(gst_element_link(handle->mos.caps_filter, handle->mos.downloader) == TRUE, 
+              "Failed to link mosaic download", RET_ERR);
+    }
+
+    /* 5) Create one branch per camera: decoding stage ! [leaky queue ! glupload ! shader graph] ! mixer tile */
+    for (int idx = 0; idx < handle->mos.num; idx++) {
+        MosaicInput *input = &handle->mos.inputs[idx];
+        input->owner = handle;
+        input->backoff_ms = SOURCE_RETRY_MIN_BACKOFF_MS;
+
+        if (idx > 0) {
+            snprintf(name, sizeof(name), "decoding-stage-%d", idx);
+            CHECK(create_decoding_stage(handle, input->dec, input->cam_params, name) == RET_OK, 
+                  "Failed to create mosaic decoding stage", RET_ERR);
+        }
+
+        /* Element names only need to be unique within the input bin */
+        snprintf(name, sizeof(name), "mos-input-%d", idx);
+        input->bin = gst_bin_new(name);
+        CHECK(input->bin != NULL, "Failed to allocate mosaic input bin", RET_ERR);
+        snprintf(name, sizeof(name), "mos-queue-%d", idx);
+        input->queue = gst_element_factory_make("queue", name);
+        CHECK(input->queue != NULL, "Failed to allocate queue element", RET_ERR);
+        g_object_set(G_OBJECT(input->queue), 
+                    "max-size-buffers", MOSAIC_INPUT_QUEUE_DEPTH, 
+                    "max-size-bytes", 0, 
+                    "max-size-time", (guint64)0, 
+                    "leaky", 2, // downstream, drop the oldest frame
+                    NULL);
+        input->uploader = gst_element_factory_make("glupload", "mos-upload");
+        CHECK(input->uploader != NULL, "Failed to allocate glupload element", RET_ERR);
+        gst_bin_add_many(GST_BIN(input->bin), input->queue, input->uploader, NULL);
+        CHECK(gst_element_link(input->queue, input->uploader) == TRUE, "Failed to link mosaic upload", RET_ERR);
+
+        GstElement *branch_out = input->uploader;
+        if (input->shader_pipeline) {
+            CHECK(create_shader_graph(GST_BIN(input->bin), input->shader_pipeline, create_shader, 1, 
+                                      input->cam_params->width, input->cam_params->height, &input->graph) == RET_OK, 
+                  "Failed to create mosaic shader graph", RET_ERR);
+            configure_roi_stages(handle, &input->graph);
+            CHECK(gst_element_link(input->uploader, input->graph.input) == TRUE, 
+                  "Failed to link mosaic shader graph", RET_ERR);
+            branch_out = input->graph.output;
+        }
+
+        /* Expose branch ends & link decoding stage */
+        GstPad *pad = gst_element_get_static_pad(input->queue, "sink");
+        gst_element_add_pad(input->bin, gst_ghost_pad_new("sink", pad));
+        gst_object_unref(pad);
+        pad = gst_element_get_static_pad(branch_out, "src");
+        gst_element_add_pad(input->bin, gst_ghost_pad_new("src", pad));
+        gst_object_unref(pad);
+        gst_bin_add(GST_BIN(handle->pipeline), input->bin);
+        CHECK(gst_element_link(input->dec->bin, input->bin) == TRUE, "Failed to link mosaic decoding stage", RET_ERR);
+
+        /* Place tile */
+        input->mixer_pad = gst_element_request_pad_simple(handle->mos.mixer, "sink_%u");
+        CHECK(input->mixer_pad != NULL, "Failed to request mixer pad", RET_ERR);
+        g_object_set(G_OBJECT(input->mixer_pad), 
+                    "xpos", input->x, 
+                    "ypos", input->y, 
+                    "width", input->width, 
+                    "height", input->height, 
+                    NULL);
+        pad = gst_element_get_static_pad(input->bin, "src");
+        GstPadLinkReturn link_ret = gst_pad_link(pad, input->mixer_pad);
+        gst_object_unref(pad);
+        CHECK(link_ret == GST_PAD_LINK_OK, "Failed to link mosaic input to mixer", RET_ERR);
+
+        DEBUG_PRINT_FMT("Mosaic tile %d: %s %dx%d -> %dx%d at %d,%d%s%s\n", idx, input->cam_params->dev_path, 
+                        input->cam_params->width, input->cam_params->height, input->width, input->height, 
+                        input->x, input->y, input->shader_pipeline ? ", shaders: " : "", 
+                        input->shader_pipeline ? input->shader_pipeline : "");
+    }
+    return RET_OK;
+}
+
+static MosaicInput* find_mosaic_input(PipelineHandle *handle, GstObject *src) {
+    for (int idx = 0; idx < handle->mos.num; idx++) {
+        GstElement *bin = handle->mos.inputs[idx].dec->bin;
+        if (bin && gst_object_has_as_ancestor(src, GST_OBJECT(bin))) 
+            return &handle->mos.inputs[idx];
+    }
+    return NULL;
+}
+
+static void start_mosaic_input_recovery(PipelineHandle *handle, MosaicInput *input) {
+    /* Retry already scheduled, stage is down */
+    if (input->retry_source_id) 
+        return;
+
+    /* The mixer keeps compositing the last frame of the camera meanwhile */
+    teardown_decoding_stage(handle, input->dec);
+
+    /* Give up after the configured number of retries */ 
+    if (handle->config->source_retries > 0 && input->num_retries >= handle->config->source_retries) {
+        ERROR_FMT("Failed to re-open mosaic camera %s after %d retries", input->cam_params->dev_path, input->num_retries);
+        handle->exit_code = RET_ERR;
+        g_main_loop_quit(handle->loop);
+        return;
+    }
+
+    DEBUG_PRINT_FMT("Re-opening mosaic camera %s in %u ms\n", input->cam_params->dev_path, input->backoff_ms);
+    input->retry_source_id = g_timeout_add(input->backoff_ms, retry_mosaic_input, input);
+    input->backoff_ms = MIN(input->backoff_ms * 2, SOURCE_RETRY_MAX_BACKOFF_MS);
+}
+
+static gboolean retry_mosaic_input(gpointer user_data) {
+    MosaicInput *input = (MosaicInput*)user_data;
+    PipelineHandle *handle = input->owner;
+    int idx = input - handle->mos.inputs;
+    char name[64];
+    input->retry_source_id = 0;
+    input->num_retries++;
+
+    /* Re-create stage and link it to its mosaic input */
+    if (idx == 0) 
+        snprintf(name, sizeof(name), "decoding-stage");
+    else 
+        snprintf(name, sizeof(name), "decoding-stage-%d", idx);
+    if (create_decoding_stage(handle, input->dec, input->cam_params, name) != RET_OK || 
+        !gst_element_link(input->dec->bin, input->bin)) {
+        ERROR_FMT("Failed to re-create decoding stage of mosaic camera %s", input->cam_params->dev_path);
+        start_mosaic_input_recovery(handle, input);
+        return G_SOURCE_REMOVE;
+    }
+
+    GstPad *dec_src = gst_element_get_static_pad(input->dec->bin, "src");
+    gst_pad_add_probe(dec_src, GST_PAD_PROBE_TYPE_BUFFER, mosaic_first_buffer_probe, input, NULL);
+    gst_object_unref(dec_src);
+
+    if (!gst_element_sync_state_with_parent(input->dec->bin)) {
+        ERROR_FMT("Failed to start decoding stage of mosaic camera %s", input->cam_params->dev_path);
+        start_mosaic_input_recovery(handle, input);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean finish_mosaic_input_recovery(gpointer user_data) {
+    MosaicInput *input = (MosaicInput*)user_data;
+    DEBUG_PRINT_FMT("Mosaic camera %s recovered after %d retries\n", input->cam_params->dev_path, input->num_retries);
+    input->num_retries = 0;
+    input->backoff_ms = SOURCE_RETRY_MIN_BACKOFF_MS;
+    return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn mosaic_first_buffer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    /* Called from the streaming thread, switch back from the main loop */
+    g_idle_add(finish_mosaic_input_recovery, user_data);
+    return GST_PAD_PROBE_REMOVE;
+}
+
 static int create_processing_stage(PipelineHandle *handle, CamParams* cam_params, PipelineConfig* pipeline_config) {
-    int num_shaders = 0;
-    /* 1) Create gluploader */
-    handle->proc.uploader = gst_element_factory_make("glupload", "proc-upload");
-    CHECK(handle->proc.uploader != NULL, "Failed to allocate glupload element", RET_ERR);
+    int use_cpu_effects = 0;
+    int use_fused_scale_convert = 0;
+    /* 0) Create stage boundary queue, also drops stale frames before they reach the GPU */
+    if (pipeline_config->stage_threads || pipeline_config->latency_budget_ms > 0) {
+        handle->proc.queue = create_stage_queue(handle, pipeline_config, "proc-queue", "proc");
+        CHECK(handle->proc.queue != NULL, "Failed to allocate queue element", RET_ERR);
+    }
 
-    /* 2) Create glshader instances */
-    num_shaders = create_shader_pipeline_from_string(handle, pipeline_config->shader_pipeline);
-    CHECK(num_shaders != RET_ERR, "Failed to create entire shader pipeline", RET_ERR);
+    use_fused_scale_convert = select_fused_scale_convert(pipeline_config);
+    CHECK(use_fused_scale_convert != RET_ERR, "Failed to select scale & convert mode", RET_ERR);
 
-    /* 3) Create gldownloader*/
-    handle->proc.downloader = gst_element_factory_make("gldownload", "proc-download");
-    CHECK(handle->proc.downloader != NULL, "Failed to allocate gldownlaod element", RET_ERR);
+    /* Pick between the GL shader chain and the CPU effect engine */
+    use_cpu_effects = select_cpu_effects(pipeline_config);
+    CHECK(use_cpu_effects != RET_ERR, "Failed to select processing engine", RET_ERR);
 
-    /* 4) Create videoscaler*/
-    handle->proc.scaler = gst_element_factory_make("videoscale", "proc-videoscale");
-    CHECK(handle->proc.scaler != NULL, "Failed to allocate videoscale element", RET_ERR);
-    g_object_set(G_OBJECT(handle->proc.scaler), "add-borders", 0, NULL);
+    if (use_cpu_effects) {
+        /* 1-3) Create CPU effect instances, frames stay in system memory */
+        CHECK(register_cpufx_element() == RET_OK, "Failed to register CPU effect element", RET_ERR);
+        CHECK(create_shader_graph(GST_BIN(handle->pipeline), pipeline_config->shader_pipeline, create_cpu_effect, 0, 
+                                  cam_params->width, cam_params->height, &handle->proc.graph) == RET_OK, 
+              "Failed to create entire CPU effect graph", RET_ERR);
+        for (int idx = 0; idx < handle->proc.graph.num_shader_stages; idx++) {
+            configure_buffer_pool(handle, handle->proc.graph.shader_stages[idx]);
+        }
+    } else {
+        /* 1) Create gluploader */
+        handle->proc.uploader = gst_element_factory_make("glupload", "proc-upload");
+        CHECK(handle->proc.uploader != NULL, "Failed to allocate glupload element", RET_ERR);
+        if (handle->dec_format && strcmp(handle->dec_format, "NV12") == 0) {
+            handle->proc.colorconvert = gst_element_factory_make("glcolorconvert", "proc-colorconvert");
+            CHECK(handle->proc.colorconvert != NULL, "Failed to allocate glcolorconvert element", RET_ERR);
+        }
+
+        /* 2) Create glshader graph, intermediate frames stay in GL memory */
+        CHECK(create_shader_graph(GST_BIN(handle->pipeline), pipeline_config->shader_pipeline, create_shader, 1, 
+                                  cam_params->width, cam_params->height, &handle->proc.graph) == RET_OK, 
+              "Failed to create entire shader graph", RET_ERR);
+        configure_gpu_timing(handle);
+        configure_roi_stages(handle, &handle->proc.graph);
+
+        /* 3) Create gldownloader*/
+        handle->proc.downloader = gst_element_factory_make("gldownload", "proc-download");
+        CHECK(handle->proc.downloader != NULL, "Failed to allocate gldownlaod element", RET_ERR);
+    }
+    CHECK(handle->proc.graph.num_shader_stages > 0, "Shader graph has no stage", RET_ERR);
+
+    /* Shaders run once, the renditions & the complexity analysis branch off the processed frame 
+       (still in GL memory on the GPU path) */
+    if (handle->ren.num > 0 || pipeline_config->adaptive_bitrate) {
+        handle->proc.tee = gst_element_factory_make("tee", "proc-tee");
+        CHECK(handle->proc.tee != NULL, "Failed to allocate tee element", RET_ERR);
+    }
+
+    if (use_fused_scale_convert) {
+        /* 4) Create fused scaler & I420 converter, replaces the converter of the encoding stage */
+        CHECK(register_scaleconv_element() == RET_OK, "Failed to register scale & convert element", RET_ERR);
+        handle->proc.scaler = gst_element_factory_make("rtvppscaleconv", "proc-scaleconv");
+        CHECK(handle->proc.scaler != NULL, "Failed to allocate rtvppscaleconv element", RET_ERR);
+    } else {
+        /* 4) Create videoscaler*/
+        handle->proc.scaler = gst_element_factory_make("videoscale", "proc-videoscale");
+        CHECK(handle->proc.scaler != NULL, "Failed to allocate videoscale element", RET_ERR);
+        g_object_set(G_OBJECT(handle->proc.scaler), "add-borders", 0, NULL);
+    }
 
     /* 5) Create out caps_filter */
-    handle->proc.out_caps_filter = create_caps_filter("video/x-raw", "proc-out-capsfilter", "RGBA", 
+    handle->proc.out_caps_filter = create_caps_filter("video/x-raw", "proc-out-capsfilter", 
+                use_fused_scale_convert ? "I420" : "RGBA", 
                 pipeline_config->out_width > 0 ? pipeline_config->out_width : cam_params->width, 
                 pipeline_config->out_height > 0 ? pipeline_config->out_height : cam_params->height, 
                 cam_params->fr_num, cam_params->fr_denom);
 
-    /* 6) Add all elements */
-    gst_bin_add(GST_BIN(handle->pipeline), handle->proc.uploader);
-    for (int idx = 0; idx < num_shaders; idx++) {
-        gst_bin_add(GST_BIN(handle->pipeline), handle->proc.shader_stages[idx]);
+    configure_buffer_pool(handle, handle->proc.scaler);
+
+    /* 6) Collect elements in link order, optional elements might be NULL. 
+       The graph (already added & linked) is entered through its input & left through its output */
+    GstElement* chain[8];
+    int chain_len = 0, graph_idx = 0;
+    if (handle->proc.queue) chain[chain_len++] = handle->proc.queue;
+    if (handle->proc.uploader) chain[chain_len++] = handle->proc.uploader;
+    if (handle->proc.colorconvert) chain[chain_len++] = handle->proc.colorconvert;
+    graph_idx = chain_len;
+    chain[chain_len++] = handle->proc.graph.output;
+    if (handle->proc.tee) chain[chain_len++] = handle->proc.tee;
+    if (handle->proc.downloader) chain[chain_len++] = handle->proc.downloader;
+    chain[chain_len++] = handle->proc.scaler;
+    chain[chain_len++] = handle->proc.out_caps_filter;
+
+    /* 7) Add & link all elements */
+    for (int idx = 0; idx < chain_len; idx++) {
+        if (idx != graph_idx) 
+            gst_bin_add(GST_BIN(handle->pipeline), chain[idx]);
+    }
+    for (int idx = 1; idx < chain_len; idx++) {
+        GstElement* sink = (idx == graph_idx) ? handle->proc.graph.input : chain[idx];
+        if (!gst_element_link(chain[idx-1], sink)) {
+            ERROR_FMT("Failed to link %s to %s", GST_ELEMENT_NAME(chain[idx-1]), GST_ELEMENT_NAME(sink));
+            return RET_ERR;
+        }
     }
-    gst_bin_add_many(GST_BIN(handle->pipeline), handle->proc.downloader, 
-                    handle->proc.scaler, handle->proc.out_caps_filter, NULL);
-    
-    /* 7) Link all elements*/
-    gst_element_link(handle->proc.uploader, handle->proc.shader_stages[0]);
-    for (int idx = 1; idx < num_shaders; idx++) {
-        DEBUG_PRINT_FMT("Linking shaders %d %d\n", idx-1, idx);
-        gst_element_link(handle->proc.shader_stages[idx-1], handle->proc.shader_stages[idx]);
-    }
-    gst_element_link_many(handle->proc.shader_stages[num_shaders-1], handle->proc.downloader, 
-                        handle->proc.scaler, handle->proc.out_caps_filter, NULL);
 #ifdef DEBUT_SHOW_CAPS
     debug_print_caps(handle->proc.scaler, "sink");
 #endif
     return RET_OK;
 }
 
+static GstElement* processing_stage_input(PipelineHandle *handle) {
+    if (handle->proc.queue) return handle->proc.queue;
+    if (handle->proc.uploader) return handle->proc.uploader;
+    return handle->proc.graph.input;
+}
+
+/* Returns 1 if scaling & I420 conversion happen in a single rtvppscaleconv pass */
+static int select_fused_scale_convert(PipelineConfig *pipeline_config) {
+    const char* mode = pipeline_config->scale_convert ? pipeline_config->scale_convert : "fused";
+    if (strcmp(mode, "fused") == 0) 
+        return 1;
+    if (strcmp(mode, "separate") == 0) 
+        return 0;
+    ERROR_FMT("Unknown scale & convert mode [%s], expected fused or separate", mode);
+    return RET_ERR;
+}
+
+/* Returns 1 if the CPU effect engine should be used, 0 for the GL shader chain */
+static int select_cpu_effects(PipelineConfig *pipeline_config) {
+    const char* mode = pipeline_config->cpu_effects ? pipeline_config->cpu_effects : "auto";
+
+    if (strcmp(mode, "never") == 0) 
+        return 0;
+    if (strcmp(mode, "always") == 0) 
+        return 1;
+    if (strcmp(mode, "auto") != 0) {
+        ERROR_FMT("Unknown CPU effects mode [%s], expected auto, always or never", mode);
+        return RET_ERR;
+    }
+
+    /* Auto: only worth it when GL runs on a software rasterizer and every stage has a CPU kernel */
+    if (!is_software_gl()) 
+        return 0;
+    
+    int supported = 1;
+    gchar** names = list_shader_graph_stages(pipeline_config->shader_pipeline);
+    CHECK(names != NULL, "Failed to parse shader graph", RET_ERR);
+    for (int idx = 0; names[idx]; idx++) {
+        if (!cpufx_supports_effect(names[idx])) {
+            DEBUG_PRINT_FMT("Software GL detected but [%s] has no CPU implementation, using GL shaders\n", names[idx]);
+            supported = 0;
+            break;
+        }
+    }
+    g_strfreev(names);
+
+    if (supported) 
+        DEBUG_PRINT("Software GL detected, using CPU effect engine\n");
+    return supported;
+}
+
+/* Returns the raw format leaving the decoding stage: NV12 cameras are uploaded as is on the GL path, 
+   everything else is converted to RGBA on the CPU. NULL on error */
+static const char* select_decoding_format(PipelineHandle *handle, CamParams *cam_params) {
+    /* Mosaic tiles & recordings expect RGBA */
+    if (cam_params->pixelformat != PIX_FMT_NV12 || handle->mos.num > 0 || handle->config->record) 
+        return "RGBA";
+    int use_cpu_effects = select_cpu_effects(handle->config);
+    CHECK(use_cpu_effects != RET_ERR, "Failed to select processing engine", NULL);
+    return use_cpu_effects ? "RGBA" : "NV12";
+}
+
+/* Returns 1 if the H.264 camera stream can be forwarded as is: only passthrough shaders, no rescale 
+   & no feature which needs decoded frames */
+static int select_passthrough(PipelineHandle *handle, CamParams *cam_params) {
+    PipelineConfig *pipeline_config = handle->config;
+    if (cam_params->pixelformat != PIX_FMT_H264 || handle->mos.num > 0) 
+        return 0;
+    if ((pipeline_config->out_width > 0 && pipeline_config->out_width != cam_params->width) || 
+        (pipeline_config->out_height > 0 && pipeline_config->out_height != cam_params->height)) 
+        return 0;
+    if (handle->ren.num > 0 || pipeline_config->adaptive_bitrate || pipeline_config->record || 
+        pipeline_config->replay || pipeline_config->frame_report) 
+        return 0;
+
+    gchar** names = list_shader_graph_stages(pipeline_config->shader_pipeline);
+    CHECK(names != NULL, "Failed to parse shader graph", RET_ERR);
+    int passthrough = 1;
+    for (int idx = 0; names[idx]; idx++) {
+        if (strcmp(names[idx], "passthrough") != 0) {
+            passthrough = 0;
+            break;
+        }
+    }
+    g_strfreev(names);
+
+    if (passthrough) 
+        DEBUG_PRINT("Nothing to process, forwarding the camera H.264 stream (--bitrate ignored)\n");
+    return passthrough;
+}
+
 static int create_encoding_stage(PipelineHandle *handle, PipelineConfig* pipeline_config) {
-    /* 1) Create converter stage */
-    handle->enc.converter = gst_element_factory_make("videoconvert", "enc-convert");
-    CHECK(handle->enc.converter != NULL, "Failed to allocate videoconvert element", RET_ERR);
+    /* 0) Create stage boundary queue */
+    if (pipeline_config->stage_threads) {
+        handle->enc.queue = create_stage_queue(handle, pipeline_config, "enc-queue", "enc");
+        CHECK(handle->enc.queue != NULL, "Failed to allocate queue element", RET_ERR);
+    }
+
+    /* Passthrough: the camera stream is already parsed, only the stage output (watched by the 
+       latency, metrics & idle probes) remains */
+    if (handle->passthrough) {
+        handle->enc.out_caps_filter = gst_element_factory_make("capsfilter", "enc-capsfilter");
+        CHECK(handle->enc.out_caps_filter != NULL, "Failed to allocate capsfilter", RET_ERR);
+        GstCaps* caps = gst_caps_from_string("video/x-h264,stream-format=byte-stream");
+        g_object_set(G_OBJECT(handle->enc.out_caps_filter), "caps", caps, NULL);
+        gst_caps_unref(caps);
+        gst_bin_add(GST_BIN(handle->pipeline), handle->enc.out_caps_filter);
+        if (handle->enc.queue) {
+            gst_bin_add(GST_BIN(handle->pipeline), handle->enc.queue);
+            CHECK(gst_element_link(handle->enc.queue, handle->enc.out_caps_filter) != FALSE, 
+                "Failed to link encoding stage queue", RET_ERR);
+        }
+        return RET_OK;
+    }
+
+    /* 1) Create converter stage, not needed if processing already outputs I420 */
+    if (select_fused_scale_convert(pipeline_config) == 0) {
+        handle->enc.converter = gst_element_factory_make("videoconvert", "enc-convert");
+        CHECK(handle->enc.converter != NULL, "Failed to allocate videoconvert element", RET_ERR);
+        configure_buffer_pool(handle, handle->enc.converter);
+    }
 
-    /* 2) Create encoder stage */ 
+    /* 2) Create encoder stage, the cores are shared with the rendition encoders */ 
+    const EncoderProfile *profile = find_encoder_profile(pipeline_config->encoder_profile);
+    CHECK(profile != NULL, "Failed to select encoder profile", RET_ERR);
     handle->enc.encoder = gst_element_factory_make("x264enc", "enc-h264");
     CHECK(handle->enc.encoder != NULL, "Failed to allocate x264enc element", RET_ERR);
-    g_object_set(G_OBJECT(handle->enc.encoder), 
-                "bitrate", pipeline_config->bitrate, 
-                "tune", 4, // zerolatency mode 
-                "speed-preset", 2, // superfast mode  
-                NULL);
+    CamParams *in_params = handle->mos.num > 0 ? &handle->mos.canvas : handle->cam_params;
+    CamParams enc_params = {
+        .width = pipeline_config->out_width > 0 ? pipeline_config->out_width : in_params->width, 
+        .height = pipeline_config->out_height > 0 ? pipeline_config->out_height : in_params->height, 
+        .fr_num = in_params->fr_num, 
+        .fr_denom = in_params->fr_denom, 
+    };
+    int num_cores = count_encoder_cores(&handle->thread_cfg[PIPELINE_STAGE_ENC]) / (handle->ren.num + 1);
+    configure_encoder(handle->enc.encoder, profile, pipeline_config->bitrate, &enc_params, num_cores, "enc-h264");
     
-    /* 3) Create parser */
+    /* 3) Create parser, SPS/PPS repeated with every IDR so readers may join at any keyframe */
     handle->enc.parser = gst_element_factory_make("h264parse", "enc-parser");
-    CHECK(handle->enc.encoder != NULL, "Failed to allocate h264parse", RET_ERR);
+    CHECK(handle->enc.parser != NULL, "Failed to allocate h264parse", RET_ERR);
+    g_object_set(G_OBJECT(handle->enc.parser), "config-interval", -1, NULL);
 
     /* 4) Create caps filter */ 
     handle->enc.out_caps_filter = gst_element_factory_make("capsfilter", "enc-capsfilter");
@@ -267,18 +1247,45 @@ static int create_encoding_stage(PipelineHandle *handle, PipelineConfig* pipelin
     g_object_set(G_OBJECT(handle->enc.out_caps_filter), "caps", caps, NULL);
 
     /* 5) Add elements */
-    gst_bin_add_many(GST_BIN(handle->pipeline), handle->enc.converter, handle->enc.encoder, 
+    gst_bin_add_many(GST_BIN(handle->pipeline), handle->enc.encoder, 
                     handle->enc.parser, handle->enc.out_caps_filter, NULL);
+    if (handle->enc.converter) {
+        gst_bin_add(GST_BIN(handle->pipeline), handle->enc.converter);
+    }
+    if (handle->enc.queue) {
+        gst_bin_add(GST_BIN(handle->pipeline), handle->enc.queue);
+    }
     
     /* 6) Link elements */
-    gboolean ret = gst_element_link_many(handle->enc.converter, handle->enc.encoder, 
+    gboolean ret = gst_element_link_many(handle->enc.encoder, 
                             handle->enc.parser, handle->enc.out_caps_filter, NULL);
     CHECK(ret != FALSE, "Failed to link elements in encoding stage", RET_ERR);
+    if (handle->enc.converter) {
+        ret = gst_element_link(handle->enc.converter, handle->enc.encoder);
+        CHECK(ret != FALSE, "Failed to link encoding stage converter", RET_ERR);
+    }
+    if (handle->enc.queue) {
+        ret = gst_element_link(handle->enc.queue, handle->enc.converter ? handle->enc.converter : handle->enc.encoder);
+        CHECK(ret != FALSE, "Failed to link encoding stage queue", RET_ERR);
+    }
     return RET_OK;
 }
 
+static GstElement* encoding_stage_input(PipelineHandle *handle) {
+    if (handle->enc.queue) return handle->enc.queue;
+    if (handle->enc.converter) return handle->enc.converter;
+    if (handle->enc.encoder) return handle->enc.encoder;
+    return handle->enc.out_caps_filter;
+}
+
 static int create_output_stage(PipelineHandle *handle, PipelineConfig *pipeline_config) {
     gboolean ret = FALSE;
+    /* 0) Create stage boundary queue */
+    if (pipeline_config->stage_threads) {
+        handle->out.queue = create_stage_queue(handle, pipeline_config, "out-queue", "out");
+        CHECK(handle->out.queue != NULL, "Failed to allocate queue element", RET_ERR);
+    }
+
     /* 1) Create tee splitter */
     handle->out.tee = gst_element_factory_make("tee", "disp-tee");
     CHECK(handle->out.tee != NULL, "Failed to allocate tee element", RET_ERR);
@@ -288,44 +1295,75 @@ static int create_output_stage(PipelineHandle *handle, PipelineConfig *pipeline_
         /* 2.a1) Create dev queue */
         handle->out.dev_queue = gst_element_factory_make("queue", "disp-devqueue");
         CHECK(handle->out.dev_queue != NULL, "Failed to allocate queue element", RET_ERR);
+        configure_latency_queue(handle, handle->out.dev_queue, "out-device");
 
         /* 2.a2) Create V4L2 sink */
         handle->out.dev_sink = gst_element_factory_make("v4l2sink", "disp-devsink");
         CHECK(handle->out.dev_sink != NULL, "Failed to allocate v4l2sink element", RET_ERR);
         g_object_set(G_OBJECT(handle->out.dev_sink), "device", pipeline_config->dev_sink, NULL);
+        if (pipeline_config->latency_budget_ms > 0) {
+            /* Render as soon as possible, do not wait for the pipeline latency */
+            g_object_set(G_OBJECT(handle->out.dev_sink), "sync", FALSE, NULL);
+        }
     }
    
-    /* Display path */
-    /* 2.b1) Create display decoder */
-    handle->out.disp_queue = gst_element_factory_make("queue", "disp-dispqueue");
-    CHECK(handle->out.disp_queue != NULL, "Failed to allocate queue element", RET_ERR);
-
-    /* 2.b2) Create display decoder */
-    handle->out.disp_decoder = gst_element_factory_make("avdec_h264", "disp-decoder");
-    CHECK(handle->out.disp_decoder != NULL, "Failed to allocate avdec_h264 element", RET_ERR);
-
-    /* 2.b3) Create display converter */
-    handle->out.disp_converter = gst_element_factory_make("videoconvert", "disp-converter");
-    CHECK(handle->out.disp_converter != NULL, "Failed to allocate videoconvert element", RET_ERR);
-
-    /* 2.b4) Create display sink */
-    handle->out.disp_sink = gst_element_factory_make("autovideosink", "disp-autovideosink");
-    CHECK(handle->out.disp_sink != NULL, "Failed to allocate autovideosink element", RET_ERR);
-    g_object_set(G_OBJECT(handle->out.disp_sink), "sync", FALSE, NULL);
+    /* Display path, unless disabled */
+    if (!pipeline_config->no_display) {
+        /* 2.b1) Create display decoder */
+        handle->out.disp_queue = gst_element_factory_make("queue", "disp-dispqueue");
+        CHECK(handle->out.disp_queue != NULL, "Failed to allocate queue element", RET_ERR);
+        configure_latency_queue(handle, handle->out.disp_queue, "out-display");
+
+        /* 2.b2) Create display decoder */
+        handle->out.disp_decoder = gst_element_factory_make("avdec_h264", "disp-decoder");
+        CHECK(handle->out.disp_decoder != NULL, "Failed to allocate avdec_h264 element", RET_ERR);
+
+        /* 2.b3) Create display converter */
+        handle->out.disp_converter = gst_element_factory_make("videoconvert", "disp-converter");
+        CHECK(handle->out.disp_converter != NULL, "Failed to allocate videoconvert element", RET_ERR);
+
+        /* 2.b4) Create display sink */
+        handle->out.disp_sink = gst_element_factory_make("autovideosink", "disp-autovideosink");
+        CHECK(handle->out.disp_sink != NULL, "Failed to allocate autovideosink element", RET_ERR);
+        g_object_set(G_OBJECT(handle->out.disp_sink), "sync", FALSE, NULL);
+    } else if (!pipeline_config->dev_sink) {
+        /* 2.c) Nothing to output to, frames still need a sink to flow (renditions, metrics, ..) */
+        handle->out.null_sink = gst_element_factory_make("fakesink", "disp-nullsink");
+        CHECK(handle->out.null_sink != NULL, "Failed to allocate fakesink element", RET_ERR);
+        g_object_set(G_OBJECT(handle->out.null_sink), "sync", FALSE, "async", FALSE, NULL);
+    }
     
     /* 3) Add elements */
     gst_bin_add(GST_BIN(handle->pipeline), handle->out.tee);
-    gst_bin_add_many(GST_BIN(handle->pipeline), handle->out.disp_queue, handle->out.disp_decoder, 
-                    handle->out.disp_converter, handle->out.disp_sink, NULL);
+    if (handle->out.queue) {
+        gst_bin_add(GST_BIN(handle->pipeline), handle->out.queue);
+    }
+    if (handle->out.disp_sink) {
+        gst_bin_add_many(GST_BIN(handle->pipeline), handle->out.disp_queue, handle->out.disp_decoder, 
+                        handle->out.disp_converter, handle->out.disp_sink, NULL);
+    }
+    if (handle->out.null_sink) {
+        gst_bin_add(GST_BIN(handle->pipeline), handle->out.null_sink);
+    }
 
     if (pipeline_config->dev_sink) {
         gst_bin_add_many(GST_BIN(handle->pipeline),handle->out.dev_queue, handle->out.dev_sink, NULL);
     }
     
     /* 4) Link elements */
-    ret = gst_element_link_many(handle->out.tee, handle->out.disp_queue, handle->out.disp_decoder, 
-                                handle->out.disp_converter, handle->out.disp_sink, NULL);
-    CHECK(ret != FALSE, "Failed to link elements in output stage: screen sink", RET_ERR);
+    if (handle->out.queue) {
+        ret = gst_element_link(handle->out.queue, handle->out.tee);
+        CHECK(ret != FALSE, "Failed to link output stage queue", RET_ERR);
+    }
+    if (handle->out.disp_sink) {
+        ret = gst_element_link_many(handle->out.tee, handle->out.disp_queue, handle->out.disp_decoder, 
+                                    handle->out.disp_converter, handle->out.disp_sink, NULL);
+        CHECK(ret != FALSE, "Failed to link elements in output stage: screen sink", RET_ERR);
+    }
+    if (handle->out.null_sink) {
+        ret = gst_element_link(handle->out.tee, handle->out.null_sink);
+        CHECK(ret != FALSE, "Failed to link elements in output stage: null sink", RET_ERR);
+    }
 
 #ifdef DEBUT_SHOW_CAPS
     debug_print_caps(handle->out.disp_converter, "src");
@@ -340,6 +1378,182 @@ static int create_output_stage(PipelineHandle *handle, PipelineConfig *pipeline_
     return RET_OK;
 }
 
+static int create_rendition_stage(PipelineHandle *handle, CamParams* cam_params, PipelineConfig* pipeline_config) {
+    char name[128];
+    int use_gl = handle->proc.uploader != NULL;
+    /* Share the cores between the main encoder & the rendition encoders */
+    int num_cores = count_encoder_cores(&handle->thread_cfg[PIPELINE_STAGE_ENC]) / (handle->ren.num + 1);
+    const EncoderProfile *profile = find_encoder_profile(pipeline_config->encoder_profile);
+    CHECK(profile != NULL, "Failed to select encoder profile", RET_ERR);
+
+    if (!use_gl) 
+        CHECK(register_scaleconv_element() == RET_OK, "Failed to register scale & convert element", RET_ERR);
+
+    for (int idx = 0; idx < handle->ren.num; idx++) {
+        RenditionHandle *ren = &handle->ren.items[idx];
+        GstElement* chain[10];
+        int chain_len = 0;
+
+        /* 0) Create rendition thread boundary, each rendition scales & encodes in parallel */
+        snprintf(name, sizeof(name), "%s-queue", ren->name);
+        ren->queue = create_stage_queue(handle, pipeline_config, name, ren->name);
+        CHECK(ren->queue != NULL, "Failed to allocate queue element", RET_ERR);
+        chain[chain_len++] = ren->queue;
+
+        if (use_gl) {
+            /* 1.a) Scale & convert to I420 on the GPU, only the small I420 frame is downloaded */
+            snprintf(name, sizeof(name), "%s-scale", ren->name);
+            ren->scaler = gst_element_factory_make("glcolorscale", name);
+            CHECK(ren->scaler != NULL, "Failed to allocate glcolorscale element", RET_ERR);
+            snprintf(name, sizeof(name), "%s-convert", ren->name);
+            ren->converter = gst_element_factory_make("glcolorconvert", name);
+            CHECK(ren->converter != NULL, "Failed to allocate glcolorconvert element", RET_ERR);
+
+            snprintf(name, sizeof(name), "%s-capsfilter", ren->name);
+            ren->caps_filter = gst_element_factory_make("capsfilter", name);
+            CHECK(ren->caps_filter != NULL, "Failed to allocate capsfilter", RET_ERR);
+            GstCaps *caps = gst_caps_new_simple("video/x-raw", 
+                                                "format", G_TYPE_STRING, "I420", 
+                                                "width", G_TYPE_INT, ren->width, 
+                                                "height", G_TYPE_INT, ren->height, 
+                                                NULL);
+            gst_caps_set_features(caps, 0, gst_caps_features_new(GST_CAPS_FEATURE_MEMORY_GL_MEMORY, NULL));
+            g_object_set(G_OBJECT(ren->caps_filter), "caps", caps, NULL);
+            gst_caps_unref(caps);
+
+            snprintf(name, sizeof(name), "%s-download", ren->name);
+            ren->downloader = gst_element_factory_make("gldownload", name);
+            CHECK(ren->downloader != NULL, "Failed to allocate gldownload element", RET_ERR);
+
+            chain[chain_len++] = ren->scaler;
+            chain[chain_len++] = ren->converter;
+            chain[chain_len++] = ren->caps_filter;
+            chain[chain_len++] = ren->downloader;
+        } else {
+            /* 1.b) Fused scale & I420 convert on the CPU */
+            snprintf(name, sizeof(name), "%s-scaleconv", ren->name);
+            ren->scaler = gst_element_factory_make("rtvppscaleconv", name);
+            CHECK(ren->scaler != NULL, "Failed to allocate rtvppscaleconv element", RET_ERR);
+            configure_buffer_pool(handle, ren->scaler);
+            snprintf(name, sizeof(name), "%s-capsfilter", ren->name);
+            ren->caps_filter = create_caps_filter("video/x-raw", name, "I420", ren->width, ren->height, 
+                                                  cam_params->fr_num, cam_params->fr_denom);
+            CHECK(ren->caps_filter != NULL, "Failed to allocate capsfilter", RET_ERR);
+
+            chain[chain_len++] = ren->scaler;
+            chain[chain_len++] = ren->caps_filter;
+        }
+
+        /* 2) Create encoder, same profile as the main output */
+        snprintf(name, sizeof(name), "%s-h264", ren->name);
+        ren->encoder = gst_element_factory_make("x264enc", name);
+        CHECK(ren->encoder != NULL, "Failed to allocate x264enc element", RET_ERR);
+        CamParams ren_params = {
+            .width = ren->width, 
+            .height = ren->height, 
+            .fr_num = cam_params->fr_num, 
+            .fr_denom = cam_params->fr_denom, 
+        };
+        configure_encoder(ren->encoder, profile, ren->bitrate, &ren_params, num_cores, name);
+
+        snprintf(name, sizeof(name), "%s-parser", ren->name);
+        ren->parser = gst_element_factory_make("h264parse", name);
+        CHECK(ren->parser != NULL, "Failed to allocate h264parse", RET_ERR);
+        g_object_set(G_OBJECT(ren->parser), "config-interval", -1, NULL);
+
+        snprintf(name, sizeof(name), "%s-enc-capsfilter", ren->name);
+        ren->out_caps_filter = gst_element_factory_make("capsfilter", name);
+        CHECK(ren->out_caps_filter != NULL, "Failed to allocate capsfilter", RET_ERR);
+        GstCaps* caps = gst_caps_from_string("video/x-h264,stream-format=byte-stream");
+        g_object_set(G_OBJECT(ren->out_caps_filter), "caps", caps, NULL);
+        gst_caps_unref(caps);
+
+        chain[chain_len++] = ren->encoder;
+        chain[chain_len++] = ren->parser;
+        chain[chain_len++] = ren->out_caps_filter;
+
+        /* 3) Create sink, V4L2 device or H.264 byte-stream file */
+        snprintf(name, sizeof(name), "%s-sink", ren->name);
+        if (g_str_has_prefix(ren->sink_path, RENDITION_DEVICE_PREFIX)) {
+            ren->sink = gst_element_factory_make("v4l2sink", name);
+            CHECK(ren->sink != NULL, "Failed to allocate v4l2sink element", RET_ERR);
+            g_object_set(G_OBJECT(ren->sink), "device", ren->sink_path, NULL);
+        } else {
+            ren->sink = gst_element_factory_make("filesink", name);
+            CHECK(ren->sink != NULL, "Failed to allocate filesink element", RET_ERR);
+            g_object_set(G_OBJECT(ren->sink), "location", ren->sink_path, NULL);
+        }
+        if (pipeline_config->latency_budget_ms > 0) {
+            /* Render as soon as possible, do not wait for the pipeline latency */
+            g_object_set(G_OBJECT(ren->sink), "sync", FALSE, NULL);
+        }
+        chain[chain_len++] = ren->sink;
+
+        /* 4) Add & link all elements, branch off the processing stage tee */
+        for (int elem = 0; elem < chain_len; elem++) {
+            gst_bin_add(GST_BIN(handle->pipeline), chain[elem]);
+        }
+        for (int elem = 0; elem < chain_len; elem++) {
+            GstElement* prev = elem == 0 ? handle->proc.tee : chain[elem-1];
+            if (!gst_element_link(prev, chain[elem])) {
+                ERROR_FMT("Failed to link %s to %s", GST_ELEMENT_NAME(prev), GST_ELEMENT_NAME(chain[elem]));
+                return RET_ERR;
+            }
+        }
+        DEBUG_PRINT_FMT("Rendition %dx%d @ %d kbps -> %s\n", ren->width, ren->height, ren->bitrate, ren->sink_path);
+    }
+    return RET_OK;
+}
+
+static int create_file_output_stage(PipelineHandle *handle, PipelineConfig* pipeline_config, 
+                                    const char* out_path, const char* muxer_name) {
+    /* 0) Create stage boundary queue */
+    if (pipeline_config->stage_threads) {
+        handle->out.queue = create_stage_queue(handle, pipeline_config, "out-queue", "out");
+        CHECK(handle->out.queue != NULL, "Failed to allocate queue element", RET_ERR);
+    }
+
+    /* 1) Create container muxer */
+    handle->out.muxer = gst_element_factory_make(muxer_name, "file-muxer");
+    CHECK(handle->out.muxer != NULL, "Failed to allocate muxer element", RET_ERR);
+
+    /* 2) Create file sink, no clock sync: frames are written as fast as they are produced */
+    handle->out.file_sink = gst_element_factory_make("filesink", "file-sink");
+    CHECK(handle->out.file_sink != NULL, "Failed to allocate filesink element", RET_ERR);
+    g_object_set(G_OBJECT(handle->out.file_sink), 
+                "location", out_path, 
+                "sync", FALSE, 
+                "async", FALSE, 
+                NULL);
+
+    /* 3) Add & link elements */
+    gst_bin_add_many(GST_BIN(handle->pipeline), handle->out.muxer, handle->out.file_sink, NULL);
+    if (handle->out.queue) {
+        gst_bin_add(GST_BIN(handle->pipeline), handle->out.queue);
+        CHECK(gst_element_link(handle->out.queue, handle->out.muxer) == TRUE, 
+              "Failed to link output stage queue", RET_ERR);
+    }
+    CHECK(gst_element_link(handle->out.muxer, handle->out.file_sink) == TRUE, 
+          "Failed to link elements in output stage: file sink", RET_ERR);
+    return RET_OK;
+}
+
+static GstElement* create_stage_queue(PipelineHandle *handle, PipelineConfig *pipeline_config, 
+                                        const char* name, const char* stage) {
+    GstElement *queue = gst_element_factory_make("queue", name);
+    CHECK(queue != NULL, "Failed to create queue element", NULL);
+
+    /* Bounded in buffers only, the upstream stage blocks when the downstream stage falls behind */
+    g_object_set(G_OBJECT(queue), 
+                "max-size-buffers", STAGE_QUEUE_DEPTH, 
+                "max-size-bytes", 0, 
+                "max-size-time", (guint64)0, 
+                NULL);
+    /* Latency budget mode overrides the limits with leaky minimal depth settings */
+    configure_latency_queue(handle, queue, stage);
+    return queue;
+}
+
 static GstElement* create_caps_filter(const char* type, const char* name, const char* format, 
                                         int width, int height, int fr_num, int fr_denom) {
     GstElement *caps_filter;
@@ -365,39 +1579,6 @@ static GstElement* create_caps_filter(const char* type, const char* name, const
     return caps_filter;
 }
 
-static void _remove_char(char* s, char c) {
-    int j, n = strlen(s);
-    for(int i = j = 0; i < n; i++) {
-        if (s[i] != c) 
-            s[j++] = s[i];
-    }
-    s[j] = '\0';
-}
-
-static int create_shader_pipeline_from_string(PipelineHandle *handle, const char* shader_pipeline) {
-    const char* DELIMITERS = "! "; // TODO: Fix will allow accept "shader1 shader2"
-    int num_stages = 0;
-    DEBUG_PRINT_FMT("!!!!%s\n", shader_pipeline);
-    char* copy_shader_pipeline = strdup(shader_pipeline);
-    char* shader_name_ptr = strtok(copy_shader_pipeline, DELIMITERS);   
-    while (shader_name_ptr != NULL) {
-        /*Remove ' " ' characters "*/
-        _remove_char(shader_name_ptr, '"');
-        /* Create shader stage*/
-        handle->proc.shader_stages[num_stages++] = create_shader(shader_name_ptr);    
-        if (handle->proc.shader_stages[num_stages-1] == NULL) {
-            ERROR_FMT("Failed to create shader %s", shader_name_ptr);
-            free(copy_shader_pipeline);
-            return RET_ERR;
-        }
-
-        /* Advance to next shader stage*/ 
-        shader_name_ptr = strtok(NULL, DELIMITERS);
-    }
-    free(copy_shader_pipeline);
-    return num_stages;
-}
-
 const char *shader_string_vertex_default =
     DEFAULT_SHADER_VERSION
     "attribute vec4 a_position;\n"
@@ -409,28 +1590,71 @@ const char *shader_string_vertex_default =
     "   v_texcoord = a_texcoord;\n"
     "}\n";
 
-static GstElement* create_shader(const char* shader_name) {
+static GstElement* create_shader(const char* stage_name) {
     GstElement *shader;
+    char *roi = NULL;
+    char *shader_name = split_roi_stage(stage_name, &roi);
     
-    /* Load shader code. */
+    /* Load shader code, restricted to the region of interest if the stage has one */
     const char* shader_code = get_shader_code(shader_name);
-    if (!shader_code) {
+    char* roi_code = NULL;
+    if (!shader_code || (roi && !(roi_code = wrap_roi_shader(shader_code)))) {
         ERROR_FMT("Failed to load shader code for shader [%s]", shader_name);
+        g_free(shader_name);
+        g_free(roi);
         return NULL;
     }
     // DEBUG_PRINT_FMT("Shader code; %s \n", shader_code);
 
     /* Crate shader object and set properties */
     shader = gst_element_factory_make("glshader", NULL); 
-    CHECK(shader != NULL, "Failed to create shader element", NULL);
-    g_object_set(G_OBJECT(shader), "fragment", shader_code,
+    if (!shader) {
+        ERROR("Failed to create shader element");
+        g_free(roi_code);
+        g_free(shader_name);
+        g_free(roi);
+        return NULL;
+    }
+    g_object_set(G_OBJECT(shader), "fragment", roi_code ? roi_code : shader_code,
                                     "vertex", shader_string_vertex_default, NULL);
+    g_free(roi_code);
+    if (roi) {
+        if (apply_roi(shader, roi) != RET_OK) {
+            gst_object_unref(shader);
+            g_free(shader_name);
+            g_free(roi);
+            return NULL;
+        }
+        g_object_set_data_full(G_OBJECT(shader), ROI_DESC_KEY, roi, g_free);
+    }
+    /* Keep the transformation name around for per stage reports */
+    g_object_set_data_full(G_OBJECT(shader), SHADER_NAME_KEY, shader_name, g_free);
 
-    DEBUG_PRINT_FMT("[%s]-[%s] created! \n", shader_name, GST_ELEMENT_NAME(shader));
+    DEBUG_PRINT_FMT("[%s]-[%s] created! \n", stage_name, GST_ELEMENT_NAME(shader));
     return shader;
 }
 
 
+static GstElement* create_cpu_effect(const char* effect_name) {
+    GstElement *effect;
+
+    if (strchr(effect_name, ROI_OPEN)) {
+        ERROR_FMT("Region of interest stage [%s] needs the GL shader path, use --cpu-effects=never", effect_name);
+        return NULL;
+    }
+    if (!cpufx_supports_effect(effect_name)) {
+        ERROR_FMT("No CPU implementation for effect [%s]", effect_name);
+        return NULL;
+    }
+
+    effect = gst_element_factory_make("rtvppcpufx", NULL);
+    CHECK(effect != NULL, "Failed to create CPU effect element", NULL);
+    g_object_set(G_OBJECT(effect), "effect", effect_name, NULL);
+
+    DEBUG_PRINT_FMT("[%s]-[%s] created! \n", effect_name, GST_ELEMENT_NAME(effect));
+    return effect;
+}
+
 // Only doing this to avoid annoying build warning :0
 #ifdef DEBUT_SHOW_CAPS
 static void debug_print_caps(GstElement* elem, const char* pad) {
@@ -3,34 +3,212 @@
 
 #include "gst/gstelement.h"
 #include <gst/gst.h>
+#include <gio/gio.h>
+#include <stdio.h>
 #include <linux/videodev2.h>
 #include "cam_utils.h"
+#include "thread_utils.h"
+#include "shader_graph_utils.h"
+#include "rendition_utils.h"
 
-#define MAX_NUM_SHADER_STAGES 8
+#define MAX_NUM_MONITORED_QUEUES 8
+/* Number of in-flight GPU timer queries per shader stage, results are read back this many frames later */
+#define GPU_TIMING_QUERY_RING_SIZE 4
+/* Object data key holding the transformation name of a shader stage element */
+#define SHADER_NAME_KEY "rtvpp-shader-name"
+/* Max number of buffers held between two stages when stage threading is enabled */
+#define STAGE_QUEUE_DEPTH 3
+/* Max number of raw video links with a preallocated buffer pool (each mosaic input brings its own) */
+#define MAX_NUM_POOL_LINKS 64
+/* Number of frames tracked between the decoding stage output & the encoder output by the frame report */
+#define FRAME_REPORT_RING_SIZE 64
+/* Max threads of the camera H.264 decoder, frame threading delays the output by one frame per extra thread */
+#define CAMERA_DECODE_MAX_THREADS 4
+
+/* Max number of region of interest rectangles per shader stage */
+#define ROI_MAX_RECTS 4
+
+/* GPU timing state of a single shader stage */
+typedef struct _GpuTimingStage {
+    GstElement* shader;
+    /* Context the shader renders with, fetched on its first frame */
+    struct _GstGLContext* context;
+    /* Timer query ring, only accessed from the GL thread */
+    guint queries[GPU_TIMING_QUERY_RING_SIZE];
+    gboolean pending[GPU_TIMING_QUERY_RING_SIZE];
+    guint next;
+    /* Query of the current frame is open (and the busy flag held) */
+    gboolean active;
+    /* Shared by all stages, queries can not nest and graph branches render from several threads */
+    gint* busy;
+    gboolean unsupported;
+    /* Results of the current report window, updated from the GL thread */
+    guint64 elapsed_ns;
+    guint samples;
+    guint skipped;
+    /* Average of the last report window, only accessed from the main loop */
+    double frame_ms;
+} GpuTimingStage;
+
+/* Region of interest rectangle in stage frame pixels (origin top left) */
+typedef struct _RoiRect {
+    int x;
+    int y;
+    int width;
+    int height;
+} RoiRect;
+
+/* Region of interest state of a single shader stage, see roi_utils.h */
+typedef struct _RoiStage {
+    GstElement* shader;
+    /* Rectangle file (NULL for static rectangles) & its last seen modification time */
+    char* file;
+    gint64 file_mtime;
+    /* Only accessed from the main loop */
+    RoiRect rects[ROI_MAX_RECTS];
+    int num_rects;
+    int width;
+    int height;
+    /* Frames leaving the stage, counted from the streaming thread */
+    gint64 num_frames;
+    /* Frames accounted for so far & pixels shaded / in full frames over them, only accessed from the main loop */
+    gint64 prev_frames;
+    guint64 shaded_pixels;
+    guint64 frame_pixels;
+} RoiStage;
+
+/* Preallocated buffer pool & allocation counters of a single raw video link (element output) */
+typedef struct _BufferPoolLink {
+    /* Owned element path (mosaic inputs re-use element names in their own bins), 
+    the element itself is freed when its stage is torn down */
+    gchar* key;
+    /* Created on the first allocation query, re-used when caps are renegotiated */
+    GstBufferPool* pool;
+    GstAllocator* allocator;
+    int min_buffers;
+    int max_buffers;
+    int use_hugepages;
+    /* Updated from the streaming thread */
+    guint frames;
+    guint unpooled;
+    /* Previous report window, only accessed from the main loop */
+    guint prev_frames;
+    guint prev_unpooled;
+    guint64 prev_pooled;
+} BufferPoolLink;
+
+/* Timing & checksum of a single frame in flight, keyed by its timestamp */
+typedef struct _FrameReportEntry {
+    /* Written last (release) by the decoding stage thread, GST_CLOCK_TIME_NONE when free */
+    GstClockTime pts;
+    gint64 enter_us;
+    /* Written by the processing stage thread */
+    gint64 proc_us;
+    guint64 checksum;
+} FrameReportEntry;
+
+/* Decoding stage elements */
+typedef struct _DecodingStage {
+    /* Bin grouping all decoding stage elements, exposes a single "src" ghost pad.
+    Allows the stage to be torn down and re-created without touching the rest of the pipeline */
+    GstElement* bin;
+    /* Source node: v4l2src, or the pattern, file or stdin source yielding the same frames (see source_utils.h) */
+    GstElement* cam_source; 
+    /* File mode only: file source & demuxer/decoder (replace the camera elements) */
+    GstElement* file_source;
+    GstElement* file_decoder;
+    /* Enforces correct camera capture settings */ 
+    GstElement* cam_caps_filter; 
+    /* Optional: only relevant for H.264 streams, feeds the decoder (or the output stage in passthrough mode) */
+    GstElement* parser;
+    /* Optional: only relevant for MJPEG & H.264 streams which require dedicated decoder*/ 
+    GstElement* decoder;     
+    /* Converter section ensures that output of front end pipeline source
+    is compatible with `glupload` sink (NULL if the camera format is uploaded as is)*/
+    GstElement* converter;
+    GstElement* out_caps_filter; 
+    /* Idle mode: set once a frame was dropped, H.264 delta frames are dropped until the next keyframe 
+       (capture thread only) */
+    int idle_gap;
+    struct _PipelineHandle* owner;
+} DecodingStage;
+
+/* Single camera of a mosaic, composited into its tile of the output frame */
+typedef struct _MosaicInput {
+    /* Capture parameters & decoding stage, the first input uses the pipeline's own (cam_params & dec) */
+    CamParams* cam_params;
+    DecodingStage* dec;
+    /* Optional shader graph applied to this camera only (NULL if none) */
+    char* shader_pipeline;
+    /* Bin holding the input queue, uploader & shader graph, linked between the decoding stage & the mixer */
+    GstElement* bin;
+    GstElement* queue;
+    GstElement* uploader;
+    ShaderGraph graph;
+    /* Tile in output frame pixels & compositor sink pad */
+    int x;
+    int y;
+    int width;
+    int height;
+    GstPad* mixer_pad;
+    /* Re-open state, only accessed from the main loop */
+    struct _PipelineHandle* owner;
+    int num_retries;
+    guint backoff_ms;
+    guint retry_source_id;
+} MosaicInput;
+
+/* Device output watched for readers joining mid-stream */
+typedef struct _JoinOutput {
+    const char* dev_path;
+    /* Feeds the device, receives the keyframe requests */
+    GstElement* encoder;
+    int num_readers;
+    /* Last forced keyframe & request held back by the rate limit */
+    gint64 keyframe_us;
+    int pending;
+} JoinOutput;
 
 typedef struct _PipelineHandle {
     GstElement* pipeline;
-    /* Decoding stage elements */
-    struct {
-        /* V4L2 source node */
-        GstElement* cam_source; 
-        /* Enforces correct camera capture settings */ 
-        GstElement* cam_caps_filter; 
-        /* Optional: only relevant for MJPEG streams which require dedicated decoder*/ 
-        GstElement* decoder;     
-        /* Converter section ensures that output of front end pipeline source
-        is compatible with `glupload` sink*/
-        GstElement* converter;
-        GstElement* out_caps_filter; 
-    } dec;
+    /* Decoding stage elements (first camera in mosaic mode) */
+    DecodingStage dec;
+    /* Raw format handed to the processing stage: "RGBA" or "NV12" (uploaded as is & converted on the GPU) */
+    const char* dec_format;
+    /* H.264 camera stream forwarded as is to the output stage: no decode, processing or encode */
+    int passthrough;
+
+    /* Source recovery elements (only present if recovery is enabled) */
+    struct {
+        /* Placeholder source, keeps frames flowing while the decoding stage is re-opened */
+        GstElement* placeholder_source;
+        GstElement* placeholder_caps_filter;
+        /* Switches between decoding stage output and placeholder output */
+        GstElement* selector;
+        GstPad* live_pad;
+        GstPad* placeholder_pad;
+
+        /* Recovery state, only accessed from the main loop */
+        gboolean recovering;
+        int num_retries;
+        guint backoff_ms;
+        guint retry_source_id;
+        gint64 error_time_us;
+    } rec;
 
     /* Processing stage elements */
     struct {
-        /* Copy buffer host to GPU*/
+        /* Optional: stage thread boundary, also drops stale captured frames in latency budget mode */
+        GstElement* queue;
+        /* Copy buffer host to GPU (NULL when the CPU effect engine is used) */
         GstElement* uploader;
-        /* Processing stages, buffer is NULL terminated */
-        GstElement* shader_stages[MAX_NUM_SHADER_STAGES + 1];
-        /* Copy buffer GPU to host */
+        /* Optional: converts NV12 camera frames to RGBA on the GPU */
+        GstElement* colorconvert;
+        /* Processing graph: stages (glshader or rtvppcpufx), fan-out tees & compositors */
+        ShaderGraph graph;
+        /* Optional: splits processed frames between the main output & the simulcast renditions */
+        GstElement* tee;
+        /* Copy buffer GPU to host (NULL when the CPU effect engine is used) */
         GstElement* downloader;
         /* Video scaler */
         GstElement* scaler;
@@ -39,6 +217,8 @@ typedef struct _PipelineHandle {
 
     /* Encoding stage elements */
     struct {
+        /* Optional: stage thread boundary */
+        GstElement* queue;
         /* Convert from glbuffer to H264 compatible format*/
         GstElement* converter; 
         /* H264 encoding*/ 
@@ -49,8 +229,100 @@ typedef struct _PipelineHandle {
         GstElement* out_caps_filter;
     } enc;
 
+    /* Scene complexity driven encoder bitrate (only present if adaptive bitrate is configured) */
+    struct {
+        /* Analysis branch off proc.tee: leaky queue, downscale (GPU on the shader path), download & sink */
+        GstElement* queue;
+        GstElement* scaler;
+        GstElement* caps_filter;
+        GstElement* downloader;
+        GstElement* sink;
+        /* Bitrate bounds (kbps) */
+        int min_kbps;
+        int max_kbps;
+        /* Previous analysis frame luma, smoothed metrics & last forced keyframe, only accessed from the analysis thread */
+        guint8* prev_luma;
+        double motion;
+        double detail;
+        gint64 last_keyframe_us;
+        /* Published metrics (x 10000) & pending keyframe request, written from the analysis thread */
+        gint complexity;
+        gint motion_scaled;
+        gint detail_scaled;
+        gint keyframe_pending;
+        /* Updated from the encoding stage thread */
+        guint64 encoded_bytes;
+        /* Controller & report state, only accessed from the main loop */
+        int target_kbps;
+        gint64 start_us;
+        gint64 window_start_us;
+        guint64 window_start_bytes;
+        int window_samples;
+        int window_at_min;
+        int window_at_max;
+        guint window_keyframes;
+        double window_complexity_sum;
+        double window_target_sum;
+        int total_samples;
+        int total_at_max;
+        guint total_keyframes;
+        guint update_source_id;
+        guint report_source_id;
+    } cpx;
+
+    /* On-demand keyframes for late joining readers, only accessed from the main loop (present if enabled & 
+       a device output exists) */
+    struct {
+        JoinOutput* outputs;
+        int num;
+        int num_joins;
+        int num_keyframes;
+        guint poll_source_id;
+    } jn;
+
+    /* Idle mode state (only used if an idle mode is configured) */
+    struct {
+        int enabled;
+        int pause;
+        /* Set while no consumer is attached, read by the capture probes */
+        gint idle;
+        /* Last frame let through in decimate mode, updated from the capture threads */
+        gint64 last_frame_us;
+        /* Set on resume, cleared by the encoding stage thread with the first keyframe which reports the latency */
+        gint64 resume_us;
+        gint64 resume_latency_us;
+        /* Consumer checks & time/CPU accounting, only accessed from the main loop */
+        gint64 last_consumer_us;
+        gint64 state_start_us;
+        gint64 state_start_cpu_us;
+        gint64 idle_total_us;
+        int num_resumes;
+        guint poll_source_id;
+    } idl;
+
+    /* Mosaic of several cameras (only present if several sources are configured), feeds the processing stage */
+    struct {
+        MosaicInput* inputs;
+        int num;
+        /* GPU compositor, its output caps (size & framerate of the composited frame) & the download 
+           needed by the CPU effect engine */
+        GstElement* mixer;
+        GstElement* caps_filter;
+        GstElement* downloader;
+        /* Composited frame size & framerate, the processing stage sees it as its camera */
+        CamParams canvas;
+    } mos;
+
+    /* Simulcast renditions (only present if renditions are configured), fed from proc.tee */
+    struct {
+        RenditionHandle* items;
+        int num;
+    } ren;
+
     /* Debug display stage elements*/
     struct {
+        /* Optional: stage thread boundary */
+        GstElement* queue;
         /* Splitter node for two output paths */ 
         GstElement* tee;
         /* Path 1: V4L2 sink */
@@ -62,31 +334,251 @@ typedef struct _PipelineHandle {
         GstElement* disp_decoder;
         GstElement* disp_converter;
         GstElement* disp_sink; 
+
+        /* Only without display & device sink: keeps frames flowing */
+        GstElement* null_sink;
+
+        /* File mode only: container muxer & file sink (replace both paths above) */
+        GstElement* muxer;
+        GstElement* file_sink;
     } out;
+
+    /* Latency budget state (only used if a latency budget is configured) */
+    struct {
+        /* Queues configured for "latest frame wins" operation */
+        struct {
+            GstElement* queue;
+            const char* stage;
+            /* Updated from the streaming threads */
+            guint dropped;
+        } queues[MAX_NUM_MONITORED_QUEUES];
+        int num_queues;
+
+        /* Capture to output sink latency (all outputs) for the current report window, 
+        updated from the streaming threads */
+        guint64 latency_sum_us;
+        guint latency_max_us;
+        guint latency_count;
+        guint report_source_id;
+    } lat;
+
+    /* Metrics exporter state (only used if metrics are enabled) */
+    struct {
+        /* Counters updated from the streaming threads with relaxed atomics, never locked */
+        guint64 frames_in;
+        guint64 frames_out;
+        guint64 camera_dropped;
+        guint64 encoded_bytes;
+        guint64 encoded_keyframes;
+        guint64 max_frame_bytes;
+        /* Last capture sequence number, only accessed from the capture thread */
+        guint64 camera_last_offset;
+        struct {
+            /* Entry time of the frame being processed, only accessed from the stage thread */
+            gint64 enter_us;
+            guint64 busy_us;
+            guint64 frames;
+        } stages[__PIPELINE_STAGE_MAX];
+
+        /* Rates over the last update interval, only accessed from the main loop */
+        struct {
+            gint64 time_us;
+            guint64 frames_in;
+            guint64 frames_out;
+            guint64 encoded_bytes;
+            guint64 stage_busy_us[__PIPELINE_STAGE_MAX];
+            guint64 stage_frames[__PIPELINE_STAGE_MAX];
+        } prev;
+        double fps_in;
+        double fps_out;
+        double bitrate_kbps;
+        guint64 window_max_frame_bytes;
+        double stage_frame_ms[__PIPELINE_STAGE_MAX];
+
+        GSocketService* service;
+        guint update_source_id;
+    } met;
+
+    /* Region of interest shader stages (only present if a stage has an ROI) */
+    struct {
+        RoiStage* stages;
+        int num;
+        guint poll_source_id;
+        gint64 report_us;
+    } roi;
+
+    /* GPU timing state (only used if GPU timing is enabled) */
+    struct {
+        GpuTimingStage* stages;
+        int num_stages;
+        /* Set while a query is open */
+        gint busy;
+        /* Frame interval derived from the capture framerate */
+        double budget_ms;
+        guint report_source_id;
+    } gpu;
+
+    /* Recorder, replay source & frame report state (only used if requested) */
+    struct {
+        /* Recording output, written from the decoding stage thread */
+        FILE* record_file;
+        GstClockTime record_base_pts;
+        guint64 recorded;
+
+        /* Replay input, read from the replay source thread */
+        FILE* replay_file;
+        gsize frame_size;
+        GstClockTime frame_duration;
+        guint64 replayed;
+        /* Pending realtime frame wait (stop_replay unschedules it) */
+        GstClockID replay_wait;
+        gboolean replay_stopping;
+
+        /* Frame report output, frames in flight & run totals (written from the encoding stage thread) */
+        FILE* report_file;
+        FrameReportEntry frames[FRAME_REPORT_RING_SIZE];
+        guint next_frame;
+        struct _GstVideoInfo* proc_info;
+        guint64 reported;
+        guint64 run_checksum;
+        guint64 proc_sum_us;
+        guint64 total_sum_us;
+        guint64 total_max_us;
+        gint64 start_us;
+    } rpl;
+
+    /* Flight recorder state (only used if a trace file is configured) */
+    struct {
+        guint signal_source_id;
+        /* Set by the streaming thread requesting a latency dump, cleared from the main loop */
+        gint dump_pending;
+        gint64 last_dump_us;
+        int num_dumps;
+        /* Last capture sequence number, only accessed from the capture thread */
+        guint64 camera_last_offset;
+    } trc;
+
+    /* Buffer pools proposed on the raw video links (only used if pools or allocation stats are enabled) */
+    struct {
+        BufferPoolLink links[MAX_NUM_POOL_LINKS];
+        int num_links;
+        guint report_source_id;
+    } pool;
+
+    /* Per stage streaming thread settings */
+    StageThreadConfig thread_cfg[__PIPELINE_STAGE_MAX];
+
+    /* Parameters the pipeline was created with (needed to re-create stages at runtime) */
+    CamParams* cam_params;
+    struct _PipelineConfig* config;
+    GMainLoop* loop;
+    int exit_code;
 } PipelineHandle;
 
 
 typedef struct _PipelineConfig {
-    /* Source settings */
+    /* Source settings, several sources are composited into a mosaic. A source is a V4L2 device, a test pattern, 
+       a file or stdin (see source_utils.h), the non V4L2 ones are paced "realtime" (at their framerate) or "fast" */
     char* dev_src;
+    char** dev_srcs;
+    char* source_speed;
+    /* Mosaic: "grid" or one "x,y,w,h" tile per source & per source shader graphs (NULL if not requested), 
+       see mosaic_utils.h */
+    char* mosaic_layout;
+    char* mosaic_shaders;
 
-    /* Chain of shader stages */
+    /* Graph of shader stages, see shader_graph_utils.h */
     char *shader_pipeline;
+    /* Optional folder overriding the embedded shaders */
     char *shader_src_folder;
 
+    /* Processing engine: "auto" (CPU effects on software GL), "always" or "never" */
+    char *cpu_effects;
+
+    /* Processing to encoding handoff: "fused" (single pass scale + I420 convert) or "separate" (videoscale ! videoconvert) */
+    char *scale_convert;
+
     /* Output dimensions after rescaling */
     int out_width;
     int out_height;
 
-    /* Encoder settings */
+    /* Encoder settings, the bitrate is the reference (& starting point) of the adaptive bitrate. 
+       Profile: "ultra-low-latency", "balanced" or "archival" (NULL is ultra-low-latency), see encoder_utils.h */
     int bitrate;
+    char *encoder_profile;
+    /* Adaptive bitrate bounds driven by the scene complexity, "MIN-MAX" in kbps (NULL keeps the bitrate fixed) */
+    char *adaptive_bitrate;
+
+    /* Insert queues at stage boundaries so each stage runs on its own streaming thread */
+    int stage_threads;
+    /* Per stage thread settings (NULL if not requested), eg. "dec=0;proc=1;enc=2-5" & "enc=fifo:10" */
+    char *stage_affinity;
+    char *stage_sched;
 
-    /* Sink settings (NULL if not requested) */
+    /* Capture to encoder output latency budget in ms (0 uses default queue limits) */
+    int latency_budget_ms;
+
+    /* Number of times a failed decoding stage is re-opened (-1 forever, 0 disables recovery) */
+    int source_retries;
+
+    /* Sink settings (NULL if not requested) & display path toggle */
     char *dev_sink; 
+    int no_display;
+
+    /* Min interval between keyframes forced for readers joining a device output in ms (0 disables) */
+    int join_keyframe_ms;
+
+    /* Behaviour without consumer on any output: "off", "decimate" or "pause" (NULL is off), see idle_utils.h */
+    char *idle_mode;
+
+    /* Extra simulcast renditions encoded from the same processed frame (NULL if not requested), see rendition_utils.h */
+    char *renditions;
+
+    /* Raw video buffer pools: buffers preallocated per link (0 disables), huge page backing & allocation counters */
+    int pool_buffers;
+    int hugepages;
+    int alloc_stats;
+
+    /* Time each shader stage on the GPU with timer queries */
+    int gpu_timing;
+
+    /* Metrics exporter: Prometheus text endpoint on 127.0.0.1:<port> and/or periodically rewritten file (0/NULL disabled) */
+    int metrics_port;
+    char *metrics_file;
+
+    /* Recorder: raw decode stage frames & timestamps written to a file (NULL if not requested) */
+    char *record;
+    /* Replay: recording fed back instead of the capture device (NULL runs the live pipeline), 
+       paced "realtime" (as captured) or "fast" (no clock) */
+    char *replay;
+    char *replay_speed;
+    /* Per frame checksum & timing report (CSV, NULL if not requested) */
+    char *frame_report;
+
+    /* Flight recorder: dump path prefix (NULL disabled) & encoder latency which triggers a dump (0 disabled) */
+    char *trace_file;
+    int trace_threshold_ms;
+    /* Converts a flight recorder dump to Chrome trace JSON instead of running the pipeline (NULL if not requested) */
+    char *trace_json;
+
+    /* File mode (NULL runs the live pipeline), input & output container paths and number of segments processed in parallel */
+    char *file_in;
+    char *file_out;
+    int file_jobs;
+
+    /* Benchmark mode (NULL runs the live pipeline), frame count & input size eg. "1920x1080" */
+    char *bench;
+    int bench_frames;
+    char *bench_input;
+    /* Shader suite: golden image & reference timing folder, rewritten instead of checked if bench_update is set */
+    char *bench_golden;
+    int bench_update;
 } PipelineConfig;
 
 void get_default_pipeline_config(PipelineConfig *out_pipeline_config);
 int create_pipeline(CamParams *cam_params, PipelineConfig *pipeline_config, PipelineHandle *out_handle);
 int play_pipeline(PipelineHandle* handle);
+int create_file_pipeline(CamParams *cam_params, PipelineConfig *pipeline_config, const char* out_path, 
+                         const char* muxer_name, PipelineHandle *out_handle);
 
 #endif
\ No newline at end of file
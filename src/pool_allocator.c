@@ -0,0 +1,108 @@
+#include "pool_allocator.h"
+#include "log_utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+struct _RtvppPoolAllocator {
+    GstAllocator parent;
+
+    gboolean use_hugepages;
+    /* Number of blocks allocated, updated from the streaming threads */
+    guint64 num_allocs;
+};
+
+/* Backing store of a single block, released when the wrapping memory is freed */
+typedef struct _PoolBlock {
+    gpointer data;
+    gsize size;
+    gboolean mapped;
+} PoolBlock;
+
+G_DEFINE_TYPE(RtvppPoolAllocator, rtvpp_pool_allocator, GST_TYPE_ALLOCATOR)
+
+static void free_block(gpointer user_data) {
+    PoolBlock *block = (PoolBlock*)user_data;
+    if (block->mapped) 
+        munmap(block->data, block->size);
+    else 
+        free(block->data);
+    g_free(block);
+}
+
+/* Huge page backed mapping, falls back to a 2MB aligned mapping advised for transparent huge pages */
+static gpointer map_hugepages(gsize size) {
+    gpointer data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    if (data != MAP_FAILED) 
+        return data;
+
+    /* THP only backs 2MB aligned ranges, over-map & trim */
+    guint8 *raw = mmap(NULL, size + HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) 
+        return NULL;
+    guint8 *aligned = (guint8*)(((guintptr)raw + HUGEPAGE_SIZE - 1) & ~((guintptr)HUGEPAGE_SIZE - 1));
+    if (aligned > raw) 
+        munmap(raw, aligned - raw);
+    munmap(aligned + size, (raw + size + HUGEPAGE_SIZE) - (aligned + size));
+    madvise(aligned, size, MADV_HUGEPAGE);
+    return aligned;
+}
+
+static GstMemory* rtvpp_pool_allocator_alloc(GstAllocator* allocator, gsize size, GstAllocationParams* params) {
+    RtvppPoolAllocator *self = RTVPP_POOL_ALLOCATOR(allocator);
+    gsize align = params->align | POOL_ALLOCATOR_MIN_ALIGN;
+    /* Block starts aligned, keep the data aligned after the prefix */
+    gsize offset = (params->prefix + align) & ~align;
+    gsize maxsize = offset + size + params->padding;
+    PoolBlock *block = g_new0(PoolBlock, 1);
+
+    if (self->use_hugepages) {
+        block->size = (maxsize + HUGEPAGE_SIZE - 1) & ~((gsize)HUGEPAGE_SIZE - 1);
+        block->data = map_hugepages(block->size);
+        block->mapped = TRUE;
+    } else {
+        block->size = maxsize;
+        if (posix_memalign(&block->data, align + 1, maxsize) != 0) 
+            block->data = NULL;
+    }
+    if (!block->data) {
+        ERROR_FMT("Failed to allocate %" G_GSIZE_FORMAT " bytes", maxsize);
+        g_free(block);
+        return NULL;
+    }
+
+    /* Fault all pages in now, pools allocate when they start rather than on the first frames */
+    memset(block->data, 0, maxsize);
+    __atomic_fetch_add(&self->num_allocs, 1, __ATOMIC_RELAXED);
+    return gst_memory_new_wrapped(params->flags, block->data, maxsize, offset, size, block, free_block);
+}
+
+static void rtvpp_pool_allocator_free(GstAllocator* allocator, GstMemory* memory) {
+    /* Blocks are wrapped into system memory which is freed through free_block */
+}
+
+static void rtvpp_pool_allocator_class_init(RtvppPoolAllocatorClass* klass) {
+    GstAllocatorClass *allocator_class = GST_ALLOCATOR_CLASS(klass);
+    allocator_class->alloc = rtvpp_pool_allocator_alloc;
+    allocator_class->free = rtvpp_pool_allocator_free;
+}
+
+static void rtvpp_pool_allocator_init(RtvppPoolAllocator* self) {
+    GST_ALLOCATOR(self)->mem_type = "RtvppPoolMemory";
+    self->use_hugepages = FALSE;
+    self->num_allocs = 0;
+}
+
+GstAllocator* create_pool_allocator(int use_hugepages) {
+    RtvppPoolAllocator *self = g_object_new(RTVPP_TYPE_POOL_ALLOCATOR, NULL);
+    gst_object_ref_sink(self);
+    self->use_hugepages = use_hugepages;
+    return GST_ALLOCATOR(self);
+}
+
+guint64 get_pool_allocator_count(GstAllocator* allocator) {
+    if (!allocator) 
+        return 0;
+    return __atomic_load_n(&RTVPP_POOL_ALLOCATOR(allocator)->num_allocs, __ATOMIC_RELAXED);
+}
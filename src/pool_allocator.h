@@ -0,0 +1,21 @@
+#ifndef __POOL_ALLOCATOR_H__
+#define __POOL_ALLOCATOR_H__
+
+#include <gst/gst.h>
+
+/* rtvpp pool allocator: backs the buffer pools proposed on raw video links. Blocks are aligned, pre-faulted 
+   & optionally huge page backed (hugetlbfs pages if reserved, transparent huge pages otherwise). 
+   Counts the blocks it allocates, a steady state pipeline should not allocate at all */
+
+#define RTVPP_TYPE_POOL_ALLOCATOR (rtvpp_pool_allocator_get_type())
+G_DECLARE_FINAL_TYPE(RtvppPoolAllocator, rtvpp_pool_allocator, RTVPP, POOL_ALLOCATOR, GstAllocator)
+
+/* x86-64 huge page size */
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+/* Minimal block alignment (mask), cache line & widest SIMD register */
+#define POOL_ALLOCATOR_MIN_ALIGN 63
+
+GstAllocator* create_pool_allocator(int use_hugepages);
+guint64 get_pool_allocator_count(GstAllocator* allocator);
+
+#endif
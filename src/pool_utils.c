@@ -0,0 +1,180 @@
+#include "pool_utils.h"
+#include "pool_allocator.h"
+#include "log_utils.h"
+
+#include <gst/video/video.h>
+
+static GstPadProbeReturn pool_allocation_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn pool_buffer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static gboolean report_pool_stats(gpointer user_data);
+
+void configure_buffer_pool(PipelineHandle *handle, GstElement *element) {
+    PipelineConfig *config = handle->config;
+    BufferPoolLink *link = NULL;
+    if (config->pool_buffers <= 0 && !config->alloc_stats) 
+        return;
+
+    /* Re-created elements (eg. after a source recovery) keep their slot & pool, 
+       elements with the same name in different bins get their own */
+    gchar *key = gst_object_get_path_string(GST_OBJECT(element));
+    for (int idx = 0; idx < handle->pool.num_links; idx++) {
+        if (strcmp(handle->pool.links[idx].key, key) == 0) {
+            link = &handle->pool.links[idx];
+            break;
+        }
+    }
+    if (!link) {
+        if (handle->pool.num_links >= MAX_NUM_POOL_LINKS) {
+            ERROR_FMT("Too many pooled links, not configuring %s", key);
+            g_free(key);
+            return;
+        }
+        link = &handle->pool.links[handle->pool.num_links++];
+        memset(link, 0, sizeof(*link));
+        link->min_buffers = config->pool_buffers;
+        link->max_buffers = 2 * config->pool_buffers;
+        link->use_hugepages = config->hugepages;
+        link->key = key;
+    } else {
+        g_free(key);
+    }
+
+    GstPad *src_pad = gst_element_get_static_pad(element, "src");
+    if (!src_pad) {
+        ERROR_FMT("Failed to get %s output pad", GST_ELEMENT_NAME(element));
+        return;
+    }
+    if (config->pool_buffers > 0) 
+        gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM | GST_PAD_PROBE_TYPE_PULL, 
+                          pool_allocation_probe, link, NULL);
+    if (config->alloc_stats) 
+        gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_BUFFER, pool_buffer_probe, link, NULL);
+    gst_object_unref(src_pad);
+}
+
+int start_pool_stats(PipelineHandle *handle) {
+    if (!handle->config->alloc_stats) 
+        return RET_OK;
+    handle->pool.report_source_id = g_timeout_add(POOL_STATS_REPORT_INTERVAL_MS, report_pool_stats, handle);
+    DEBUG_PRINT_FMT("Allocation stats enabled: monitored links=%d, pool buffers=%d..%d%s\n", handle->pool.num_links, 
+                    handle->config->pool_buffers, 2 * handle->config->pool_buffers, 
+                    handle->config->hugepages ? " (huge pages)" : "");
+    return RET_OK;
+}
+
+void stop_pool_stats(PipelineHandle *handle) {
+    if (!handle->pool.report_source_id) 
+        return;
+    g_source_remove(handle->pool.report_source_id);
+    handle->pool.report_source_id = 0;
+    report_pool_stats(handle);
+}
+
+void cleanup_buffer_pools(PipelineHandle *handle) {
+    for (int idx = 0; idx < handle->pool.num_links; idx++) {
+        if (handle->pool.links[idx].pool) 
+            gst_object_unref(handle->pool.links[idx].pool);
+        if (handle->pool.links[idx].allocator) 
+            gst_object_unref(handle->pool.links[idx].allocator);
+        g_free(handle->pool.links[idx].key);
+    }
+    handle->pool.num_links = 0;
+}
+
+static GstPadProbeReturn pool_allocation_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    BufferPoolLink *link = (BufferPoolLink*)user_data;
+    GstQuery *query = GST_PAD_PROBE_INFO_QUERY(info);
+    GstBufferPool *proposed = NULL;
+    GstAllocationParams params;
+    GstCaps *caps = NULL;
+    GstVideoInfo video_info;
+    guint size = 0, min = 0, max = 0;
+
+    if (GST_QUERY_TYPE(query) != GST_QUERY_ALLOCATION) 
+        return GST_PAD_PROBE_OK;
+    gst_query_parse_allocation(query, &caps, NULL);
+    if (!caps || !gst_video_info_from_caps(&video_info, caps)) 
+        return GST_PAD_PROBE_OK;
+
+    /* 1) Only system memory links, GL & device links keep the memory downstream asked for */
+    GstCapsFeatures *features = gst_caps_get_features(caps, 0);
+    if (features && !gst_caps_features_contains(features, GST_CAPS_FEATURE_MEMORY_SYSTEM_MEMORY)) 
+        return GST_PAD_PROBE_OK;
+    if (gst_query_get_n_allocation_pools(query) > 0) {
+        gst_query_parse_nth_allocation_pool(query, 0, &proposed, &size, &min, &max);
+        gboolean generic = !proposed || G_OBJECT_TYPE(proposed) == GST_TYPE_BUFFER_POOL || 
+                           G_OBJECT_TYPE(proposed) == GST_TYPE_VIDEO_BUFFER_POOL;
+        if (proposed) 
+            gst_object_unref(proposed);
+        if (!generic) 
+            return GST_PAD_PROBE_OK;
+    }
+
+    /* 2) One pool per link, re-used when caps are renegotiated */
+    if (!link->pool) {
+        link->allocator = create_pool_allocator(link->use_hugepages);
+        link->pool = gst_video_buffer_pool_new();
+    }
+    gst_allocation_params_init(&params);
+    params.align = POOL_ALLOCATOR_MIN_ALIGN;
+
+    /* Pre-configure, the element re-applies size & limits from the query (config is rejected while active) */
+    GstStructure *config = gst_buffer_pool_get_config(link->pool);
+    gst_buffer_pool_config_set_params(config, caps, video_info.size, link->min_buffers, link->max_buffers);
+    gst_buffer_pool_config_set_allocator(config, link->allocator, &params);
+    if (gst_query_find_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL)) {
+        /* Padded strides are only safe if downstream reads strides from the video meta */
+        GstVideoAlignment alignment;
+        gst_video_alignment_reset(&alignment);
+        for (int plane = 0; plane < GST_VIDEO_MAX_PLANES; plane++) {
+            alignment.stride_align[plane] = POOL_STRIDE_ALIGN;
+        }
+        gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+        gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+        gst_buffer_pool_config_set_video_alignment(config, &alignment);
+    }
+    gst_buffer_pool_set_config(link->pool, config);
+
+    /* 3) Propose pool & allocator, elements configure the pool with the first allocation param */
+    if (gst_query_get_n_allocation_pools(query) > 0) 
+        gst_query_set_nth_allocation_pool(query, 0, link->pool, video_info.size, link->min_buffers, link->max_buffers);
+    else 
+        gst_query_add_allocation_pool(query, link->pool, video_info.size, link->min_buffers, link->max_buffers);
+    if (gst_query_get_n_allocation_params(query) > 0) 
+        gst_query_set_nth_allocation_param(query, 0, link->allocator, &params);
+    else 
+        gst_query_add_allocation_param(query, link->allocator, &params);
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn pool_buffer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    BufferPoolLink *link = (BufferPoolLink*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    /* Buffers without pool were allocated for this frame only */
+    g_atomic_int_inc(&link->frames);
+    if (buffer->pool == NULL) 
+        g_atomic_int_inc(&link->unpooled);
+    return GST_PAD_PROBE_OK;
+}
+
+static gboolean report_pool_stats(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+
+    for (int idx = 0; idx < handle->pool.num_links; idx++) {
+        BufferPoolLink *link = &handle->pool.links[idx];
+        guint frames = g_atomic_int_get(&link->frames);
+        guint unpooled = g_atomic_int_get(&link->unpooled);
+        guint64 pooled = get_pool_allocator_count(link->allocator);
+
+        guint window_frames = frames - link->prev_frames;
+        guint64 window_allocs = (pooled - link->prev_pooled) + (unpooled - link->prev_unpooled);
+        DEBUG_PRINT_FMT("Allocations [%s]: %.2f/frame over %u frames (pool blocks %" G_GUINT64_FORMAT ", unpooled %u total)\n", 
+                        link->key, window_frames ? (double)window_allocs / window_frames : 0.0, 
+                        window_frames, pooled, unpooled);
+        link->prev_frames = frames;
+        link->prev_unpooled = unpooled;
+        link->prev_pooled = pooled;
+    }
+    return G_SOURCE_CONTINUE;
+}
@@ -0,0 +1,22 @@
+#ifndef __POOL_UTILS_H__
+#define __POOL_UTILS_H__
+
+#include <gst/gst.h>
+#include "pipeline.h"
+
+/* Buffers preallocated by each raw video pool, pools grow up to twice as many (0 disables pools) */
+#define POOL_DEFAULT_MIN_BUFFERS 4
+/* Stride alignment (mask) requested when downstream understands video meta */
+#define POOL_STRIDE_ALIGN 63
+
+/* Interval between allocation reports */
+#define POOL_STATS_REPORT_INTERVAL_MS 5000
+
+/* Proposes a preallocated pool to the element output (system memory raw video only) & counts its allocations, 
+   may be called again for a re-created element with the same path (call once it is in its bin) */
+void configure_buffer_pool(PipelineHandle *handle, GstElement *element);
+int start_pool_stats(PipelineHandle *handle);
+void stop_pool_stats(PipelineHandle *handle);
+void cleanup_buffer_pools(PipelineHandle *handle);
+
+#endif
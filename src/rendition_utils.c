@@ -0,0 +1,58 @@
+#include "rendition_utils.h"
+#include "log_utils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int parse_renditions(const char* renditions, RenditionHandle** out_items, int* out_num) {
+    *out_items = NULL;
+    *out_num = 0;
+    if (!renditions)
+        return RET_OK;
+
+    gchar** entries = g_strsplit(renditions, RENDITION_LIST_DELIMITERS, -1);
+    int num_entries = g_strv_length(entries);
+    RenditionHandle* items = g_new0(RenditionHandle, num_entries);
+    int num = 0;
+
+    for (int idx = 0; idx < num_entries; idx++) {
+        RenditionHandle* item = &items[num];
+        int sink_offset = 0;
+        g_strstrip(entries[idx]);
+        if (entries[idx][0] == '\0')
+            continue;
+
+        /* WxH@kbps:sink */
+        if (sscanf(entries[idx], "%dx%d@%d:%n", &item->width, &item->height, &item->bitrate, &sink_offset) != 3 || 
+            sink_offset == 0 || entries[idx][sink_offset] == '\0') {
+            ERROR_FMT("Invalid rendition [%s], expected WxH@kbps:sink", entries[idx]);
+            goto error;
+        }
+        /* I420 chroma planes need even dimensions */
+        if (item->width <= 0 || item->height <= 0 || item->width % 2 || item->height % 2 || item->bitrate <= 0) {
+            ERROR_FMT("Invalid rendition [%s], size must be even & bitrate positive", entries[idx]);
+            goto error;
+        }
+        item->sink_path = g_strdup(entries[idx] + sink_offset);
+        item->name = g_strdup_printf("ren-%dx%d-%d", item->width, item->height, num);
+        num++;
+    }
+    g_strfreev(entries);
+
+    *out_items = items;
+    *out_num = num;
+    return RET_OK;
+
+error:
+    g_strfreev(entries);
+    cleanup_renditions(items, num);
+    return RET_ERR;
+}
+
+void cleanup_renditions(RenditionHandle* items, int num) {
+    for (int idx = 0; idx < num; idx++) {
+        g_free(items[idx].sink_path);
+        g_free(items[idx].name);
+    }
+    g_free(items);
+}
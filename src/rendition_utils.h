@@ -0,0 +1,41 @@
+#ifndef __RENDITION_UTILS_H__
+#define __RENDITION_UTILS_H__
+
+#include <gst/gst.h>
+
+/* Rendition list syntax: WxH@kbps:sink[,WxH@kbps:sink..], sink is a V4L2 device (/dev/..) or an H.264 byte-stream file 
+ * Eg. "1280x720@2500:/dev/video3,640x360@800:/tmp/360p.h264" */
+#define RENDITION_LIST_DELIMITERS ","
+#define RENDITION_DEVICE_PREFIX "/dev/"
+
+/* Elements of a single simulcast rendition, encoded from the processed frame shared with the main output */
+typedef struct _RenditionHandle {
+    /* Requested output size, bitrate (kbps) & sink path */
+    int width;
+    int height;
+    int bitrate;
+    char* sink_path;
+    /* Element name prefix, eg. "ren-640x360" */
+    char* name;
+
+    /* Rendition thread boundary */
+    GstElement* queue;
+    /* Scaler (glcolorscale on the GPU path, rtvppscaleconv otherwise) */
+    GstElement* scaler;
+    /* GPU path only: I420 conversion & download */
+    GstElement* converter;
+    GstElement* downloader;
+    GstElement* caps_filter;
+    /* H264 encoding */
+    GstElement* encoder;
+    GstElement* parser;
+    GstElement* out_caps_filter;
+    /* v4l2sink or filesink */
+    GstElement* sink;
+} RenditionHandle;
+
+/* Parses a rendition list, out_items must be freed with cleanup_renditions */
+int parse_renditions(const char* renditions, RenditionHandle** out_items, int* out_num);
+void cleanup_renditions(RenditionHandle* items, int num);
+
+#endif
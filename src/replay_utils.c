@@ -0,0 +1,392 @@
+#include "replay_utils.h"
+#include "log_utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <gst/video/video.h>
+
+/* 64-bit multiplicative hash constant (golden ratio) */
+#define FRAME_HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+static void replay_need_data(GstElement *source, guint length, gpointer user_data);
+static GstPadProbeReturn record_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn report_enter_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn report_proc_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn report_enc_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static FrameReportEntry* find_report_entry(PipelineHandle *handle, GstClockTime pts);
+static guint64 hash_bytes(guint64 hash, const guint8* data, gsize size);
+
+int read_recording_params(const char* path, CamParams *out_params) {
+    RecordingHeader header;
+
+    out_params->dev_path = strdup(path);
+
+    DEBUG_PRINT_FMT("Opening recording %s..\n", path);
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        int err = errno;
+        errno = 0;
+        ERROR_FMT("Failed to open recording %s: %s", path, g_strerror(err));
+        return RET_ERR;
+    }
+    size_t read = fread(&header, sizeof(header), 1, file);
+    fclose(file);
+    CHECK(read == 1, "Failed to read recording header", RET_ERR);
+    CHECK(memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) == 0, "Not an rt-vpp recording", RET_ERR);
+    CHECK(header.version == RECORDING_VERSION, "Unsupported recording version", RET_ERR);
+    CHECK(strncmp(header.format, "RGBA", sizeof(header.format)) == 0, "Unsupported recording format", RET_ERR);
+    CHECK(header.frame_size == header.width * header.height * 4, "Corrupted recording header", RET_ERR);
+
+    out_params->pixelformat = PIX_FMT_RGBA;
+    out_params->width = header.width;
+    out_params->height = header.height;
+    out_params->fr_num = header.fr_num;
+    out_params->fr_denom = header.fr_denom;
+    DEBUG_PRINT_FMT("Recording: %dx%d RGBA, %d/%d fps\n", out_params->width, out_params->height,
+                    out_params->fr_denom, out_params->fr_num);
+    return RET_OK;
+}
+
+int select_replay_fast(PipelineConfig *pipeline_config) {
+    const char* speed = pipeline_config->replay_speed ? pipeline_config->replay_speed : "realtime";
+    if (strcmp(speed, "realtime") == 0) return 0;
+    if (strcmp(speed, "fast") == 0) return 1;
+    ERROR_FMT("Unknown replay speed %s (realtime, fast)", speed);
+    return RET_ERR;
+}
+
+GstElement* create_replay_source(PipelineHandle *handle) {
+    CamParams *cam_params = handle->cam_params;
+    RecordingHeader header;
+    int fast = select_replay_fast(handle->config);
+    CHECK(fast != RET_ERR, "Failed to select replay speed", NULL);
+
+    /* 1) Open recording & skip its header, a re-created decoding stage starts over */
+    if (handle->rpl.replay_file)
+        fclose(handle->rpl.replay_file);
+    handle->rpl.replay_file = fopen(cam_params->dev_path, "rb");
+    CHECK(handle->rpl.replay_file != NULL, "Failed to open recording", NULL);
+    CHECK(fread(&header, sizeof(header), 1, handle->rpl.replay_file) == 1, "Failed to read recording header", NULL);
+    handle->rpl.frame_size = header.frame_size;
+    handle->rpl.frame_duration = gst_util_uint64_scale(GST_SECOND, cam_params->fr_num, cam_params->fr_denom);
+    handle->rpl.replayed = 0;
+
+    /* 2) Create source, realtime replay behaves like a live camera (frames released at their capture time) */
+    GstElement *source = gst_element_factory_make("appsrc", "replay-source");
+    CHECK(source != NULL, "Failed to allocate appsrc element", NULL);
+    GstCaps *caps = gst_caps_new_simple("video/x-raw",
+                                "format", G_TYPE_STRING, "RGBA",
+                                "width", G_TYPE_INT, cam_params->width,
+                                "height", G_TYPE_INT, cam_params->height,
+                                "framerate", GST_TYPE_FRACTION, cam_params->fr_denom, cam_params->fr_num,
+                                "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
+                                NULL);
+    g_object_set(G_OBJECT(source),
+                "caps", caps,
+                "format", GST_FORMAT_TIME,
+                "is-live", !fast,
+                "do-timestamp", FALSE,
+                NULL);
+    gst_caps_unref(caps);
+    if (!fast) {
+        g_object_set(G_OBJECT(source),
+                    "min-latency", (gint64)handle->rpl.frame_duration,
+                    "max-latency", (gint64)handle->rpl.frame_duration,
+                    NULL);
+    }
+    g_signal_connect(source, "need-data", G_CALLBACK(replay_need_data), handle);
+    DEBUG_PRINT_FMT("Replaying %s (%s)\n", cam_params->dev_path, fast ? "fast" : "realtime");
+    return source;
+}
+
+int configure_recorder(PipelineHandle *handle) {
+    CamParams *cam_params = handle->cam_params;
+    if (!handle->config->record)
+        return RET_OK;
+
+    /* 1) Open recording & write its header once, a re-created decoding stage keeps appending */
+    if (!handle->rpl.record_file) {
+        RecordingHeader header = {0};
+        memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+        header.version = RECORDING_VERSION;
+        strncpy(header.format, "RGBA", sizeof(header.format));
+        header.width = cam_params->width;
+        header.height = cam_params->height;
+        header.fr_num = cam_params->fr_num;
+        header.fr_denom = cam_params->fr_denom;
+        header.frame_size = cam_params->width * cam_params->height * 4;
+
+        handle->rpl.record_file = fopen(handle->config->record, "wb");
+        CHECK(handle->rpl.record_file != NULL, "Failed to create recording file", RET_ERR);
+        CHECK(fwrite(&header, sizeof(header), 1, handle->rpl.record_file) == 1, "Failed to write recording header", RET_ERR);
+        handle->rpl.record_base_pts = GST_CLOCK_TIME_NONE;
+        handle->rpl.recorded = 0;
+    }
+
+    /* 2) Record the decoding stage output (RGBA at capture size) */
+    GstPad *out_pad = gst_element_get_static_pad(handle->dec.out_caps_filter, "src");
+    CHECK(out_pad != NULL, "Failed to get decoding stage output pad", RET_ERR);
+    gst_pad_add_probe(out_pad, GST_PAD_PROBE_TYPE_BUFFER, record_probe, handle, NULL);
+    gst_object_unref(out_pad);
+    return RET_OK;
+}
+
+int start_frame_report(PipelineHandle *handle) {
+    if (!handle->config->frame_report)
+        return RET_OK;
+
+    /* 1) Open report */
+    handle->rpl.report_file = fopen(handle->config->frame_report, "w");
+    CHECK(handle->rpl.report_file != NULL, "Failed to create frame report file", RET_ERR);
+    fprintf(handle->rpl.report_file, "frame,pts_ms,checksum,proc_ms,total_ms\n");
+    for (int idx = 0; idx < FRAME_REPORT_RING_SIZE; idx++) {
+        handle->rpl.frames[idx].pts = GST_CLOCK_TIME_NONE;
+    }
+    handle->rpl.proc_info = gst_video_info_new();
+    handle->rpl.run_checksum = 0;
+    handle->rpl.start_us = g_get_monotonic_time();
+
+    /* 2) Frames enter at the processing stage input (stays in place if the decoding stage is re-created),
+       are checksummed at its output & leave at the encoder output */
+    GstElement *proc_first = handle->proc.queue ? handle->proc.queue :
+                             (handle->proc.uploader ? handle->proc.uploader : handle->proc.graph.input);
+    GstPad *enter_pad = gst_element_get_static_pad(proc_first, "sink");
+    GstPad *proc_pad = gst_element_get_static_pad(handle->proc.out_caps_filter, "src");
+    GstPad *enc_pad = gst_element_get_static_pad(handle->enc.out_caps_filter, "src");
+    CHECK(enter_pad && proc_pad && enc_pad, "Failed to get frame report pads", RET_ERR);
+    gst_pad_add_probe(enter_pad, GST_PAD_PROBE_TYPE_BUFFER, report_enter_probe, handle, NULL);
+    gst_pad_add_probe(proc_pad, GST_PAD_PROBE_TYPE_BUFFER, report_proc_probe, handle, NULL);
+    gst_pad_add_probe(enc_pad, GST_PAD_PROBE_TYPE_BUFFER, report_enc_probe, handle, NULL);
+    gst_object_unref(enter_pad);
+    gst_object_unref(proc_pad);
+    gst_object_unref(enc_pad);
+
+    DEBUG_PRINT_FMT("Frame report enabled: %s\n", handle->config->frame_report);
+    return RET_OK;
+}
+
+void stop_replay(PipelineHandle *handle) {
+    /* Release a realtime replay source held until its next frame time, the pipeline can't stop while it waits */
+    __atomic_store_n(&handle->rpl.replay_stopping, TRUE, __ATOMIC_SEQ_CST);
+    GstClockID clock_id = __atomic_exchange_n(&handle->rpl.replay_wait, NULL, __ATOMIC_SEQ_CST);
+    if (clock_id) {
+        gst_clock_id_unschedule(clock_id);
+        gst_clock_id_unref(clock_id);
+    }
+}
+
+void cleanup_replay(PipelineHandle *handle) {
+    /* 1) Run summary, compare the run checksum of two builds first & the report lines if they differ */
+    if (handle->rpl.report_file) {
+        guint64 frames = handle->rpl.reported;
+        double elapsed_s = (g_get_monotonic_time() - handle->rpl.start_us) / 1e6;
+        if (frames > 0) {
+            DEBUG_PRINT_FMT("Frame report: %" G_GUINT64_FORMAT " frames, run checksum %016" G_GINT64_MODIFIER "x, "
+                            "proc avg=%.2f ms, total avg=%.2f ms max=%.2f ms, %.1f fps\n",
+                            frames, handle->rpl.run_checksum,
+                            handle->rpl.proc_sum_us / 1000.0 / frames, handle->rpl.total_sum_us / 1000.0 / frames,
+                            handle->rpl.total_max_us / 1000.0, elapsed_s > 0 ? frames / elapsed_s : 0.0);
+        }
+        fclose(handle->rpl.report_file);
+        handle->rpl.report_file = NULL;
+        gst_video_info_free(handle->rpl.proc_info);
+        handle->rpl.proc_info = NULL;
+    }
+
+    /* 2) Close recording & replay input */
+    if (handle->rpl.record_file) {
+        DEBUG_PRINT_FMT("Recorded %" G_GUINT64_FORMAT " frames to %s\n", handle->rpl.recorded, handle->config->record);
+        fclose(handle->rpl.record_file);
+        handle->rpl.record_file = NULL;
+    }
+    if (handle->rpl.replay_file) {
+        fclose(handle->rpl.replay_file);
+        handle->rpl.replay_file = NULL;
+    }
+}
+
+static void replay_need_data(GstElement *source, guint length, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    RecordingFrameHeader frame_header;
+    GstFlowReturn ret;
+    GstMapInfo map;
+
+    /* 1) Read next frame, the end of the recording ends the stream */
+    if (fread(&frame_header, sizeof(frame_header), 1, handle->rpl.replay_file) != 1) {
+        DEBUG_PRINT_FMT("Recording replayed: %" G_GUINT64_FORMAT " frames\n", handle->rpl.replayed);
+        g_signal_emit_by_name(source, "end-of-stream", &ret);
+        return;
+    }
+    GstBuffer *buffer = gst_buffer_new_allocate(NULL, handle->rpl.frame_size, NULL);
+    gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+    size_t read = fread(map.data, 1, handle->rpl.frame_size, handle->rpl.replay_file);
+    gst_buffer_unmap(buffer, &map);
+    if (read != handle->rpl.frame_size) {
+        ERROR("Truncated recording, stopping replay");
+        gst_buffer_unref(buffer);
+        g_signal_emit_by_name(source, "end-of-stream", &ret);
+        return;
+    }
+
+    /* 2) Recorded timestamps drive the shader time uniform, keep them as is */
+    GST_BUFFER_PTS(buffer) = frame_header.pts;
+    GST_BUFFER_DURATION(buffer) = frame_header.duration;
+    GST_BUFFER_OFFSET(buffer) = handle->rpl.replayed++;
+
+    /* 3) Realtime: hold the frame until its capture time (running time), like a camera would deliver it.
+       Fast replay runs without clock */
+    GstClock *clock = gst_element_get_clock(source);
+    if (clock && !__atomic_load_n(&handle->rpl.replay_stopping, __ATOMIC_SEQ_CST)) {
+        GstClockID clock_id = gst_clock_new_single_shot_id(clock, gst_element_get_base_time(source) + frame_header.pts);
+        /* Published with its own reference for stop_replay, recheck the flag in case it ran before the store */
+        __atomic_store_n(&handle->rpl.replay_wait, gst_clock_id_ref(clock_id), __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&handle->rpl.replay_stopping, __ATOMIC_SEQ_CST))
+            gst_clock_id_unschedule(clock_id);
+        gst_clock_id_wait(clock_id, NULL);
+        GstClockID published = __atomic_exchange_n(&handle->rpl.replay_wait, NULL, __ATOMIC_SEQ_CST);
+        if (published)
+            gst_clock_id_unref(published);
+        gst_clock_id_unref(clock_id);
+    }
+    if (clock)
+        gst_object_unref(clock);
+    g_signal_emit_by_name(source, "push-buffer", buffer, &ret);
+    gst_buffer_unref(buffer);
+}
+
+static GstPadProbeReturn record_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    CamParams *cam_params = handle->cam_params;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    RecordingFrameHeader frame_header;
+    GstVideoInfo video_info;
+    GstVideoFrame frame;
+
+    gst_video_info_set_format(&video_info, GST_VIDEO_FORMAT_RGBA, cam_params->width, cam_params->height);
+    if (!gst_video_frame_map(&frame, &video_info, buffer, GST_MAP_READ))
+        return GST_PAD_PROBE_OK;
+
+    /* 1) Rebase timestamps on the first frame, shader time starts at 0 on replay */
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(handle->rpl.record_base_pts))
+        handle->rpl.record_base_pts = GST_CLOCK_TIME_IS_VALID(pts) ? pts : 0;
+    if (GST_CLOCK_TIME_IS_VALID(pts) && pts >= handle->rpl.record_base_pts)
+        frame_header.pts = pts - handle->rpl.record_base_pts;
+    else
+        frame_header.pts = handle->rpl.recorded *
+                           gst_util_uint64_scale(GST_SECOND, cam_params->fr_num, cam_params->fr_denom);
+    frame_header.duration = GST_BUFFER_DURATION_IS_VALID(buffer) ? GST_BUFFER_DURATION(buffer) :
+                            gst_util_uint64_scale(GST_SECOND, cam_params->fr_num, cam_params->fr_denom);
+
+    /* 2) Write header & packed rows (pooled frames may have padded strides) */
+    gboolean res = fwrite(&frame_header, sizeof(frame_header), 1, handle->rpl.record_file) == 1;
+    const guint8 *data = GST_VIDEO_FRAME_PLANE_DATA(&frame, 0);
+    gsize row_size = cam_params->width * 4;
+    for (int row = 0; res && row < cam_params->height; row++) {
+        res = fwrite(data + row * GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0), row_size, 1, handle->rpl.record_file) == 1;
+    }
+    gst_video_frame_unmap(&frame);
+    if (!res) {
+        ERROR("Failed to write recording, recording stopped");
+        return GST_PAD_PROBE_REMOVE;
+    }
+    handle->rpl.recorded++;
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn report_enter_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!GST_BUFFER_PTS_IS_VALID(buffer))
+        return GST_PAD_PROBE_OK;
+
+    /* Oldest slot is recycled, frames dropped on the way never complete */
+    FrameReportEntry *entry = &handle->rpl.frames[handle->rpl.next_frame++ % FRAME_REPORT_RING_SIZE];
+    __atomic_store_n(&entry->pts, GST_CLOCK_TIME_NONE, __ATOMIC_RELAXED);
+    entry->enter_us = g_get_monotonic_time();
+    entry->proc_us = 0;
+    entry->checksum = 0;
+    __atomic_store_n(&entry->pts, GST_BUFFER_PTS(buffer), __ATOMIC_RELEASE);
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn report_proc_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    gint64 now_us = g_get_monotonic_time();
+    GstVideoFrame frame;
+
+    FrameReportEntry *entry = find_report_entry(handle, GST_BUFFER_PTS(buffer));
+    if (!entry)
+        return GST_PAD_PROBE_OK;
+    entry->proc_us = now_us - entry->enter_us;
+
+    /* Hash visible pixels only, stride padding is not part of the output */
+    if (GST_VIDEO_INFO_FORMAT(handle->rpl.proc_info) == GST_VIDEO_FORMAT_UNKNOWN) {
+        GstCaps *caps = gst_pad_get_current_caps(pad);
+        if (!caps || !gst_video_info_from_caps(handle->rpl.proc_info, caps))
+            ERROR("Failed to read processing stage output format");
+        if (caps)
+            gst_caps_unref(caps);
+    }
+    if (!gst_video_frame_map(&frame, handle->rpl.proc_info, buffer, GST_MAP_READ))
+        return GST_PAD_PROBE_OK;
+    guint64 hash = 0;
+    for (guint plane = 0; plane < GST_VIDEO_FRAME_N_PLANES(&frame); plane++) {
+        const guint8 *data = GST_VIDEO_FRAME_PLANE_DATA(&frame, plane);
+        gsize row_size = GST_VIDEO_FRAME_COMP_WIDTH(&frame, plane) * GST_VIDEO_FRAME_COMP_PSTRIDE(&frame, plane);
+        for (int row = 0; row < GST_VIDEO_FRAME_COMP_HEIGHT(&frame, plane); row++) {
+            hash = hash_bytes(hash, data + row * GST_VIDEO_FRAME_PLANE_STRIDE(&frame, plane), row_size);
+        }
+    }
+    gst_video_frame_unmap(&frame);
+    entry->checksum = hash;
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn report_enc_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    gint64 now_us = g_get_monotonic_time();
+
+    FrameReportEntry *entry = find_report_entry(handle, GST_BUFFER_PTS(buffer));
+    if (!entry)
+        return GST_PAD_PROBE_OK;
+
+    /* One line per encoded frame, the run checksum depends on frame order */
+    guint64 total_us = now_us - entry->enter_us;
+    fprintf(handle->rpl.report_file, "%" G_GUINT64_FORMAT ",%.3f,%016" G_GINT64_MODIFIER "x,%.3f,%.3f\n",
+            handle->rpl.reported, (double)entry->pts / GST_MSECOND, entry->checksum,
+            entry->proc_us / 1000.0, total_us / 1000.0);
+    handle->rpl.run_checksum = (handle->rpl.run_checksum ^ entry->checksum) * FRAME_HASH_MULTIPLIER;
+    handle->rpl.proc_sum_us += entry->proc_us;
+    handle->rpl.total_sum_us += total_us;
+    handle->rpl.total_max_us = MAX(handle->rpl.total_max_us, total_us);
+    handle->rpl.reported++;
+    __atomic_store_n(&entry->pts, GST_CLOCK_TIME_NONE, __ATOMIC_RELEASE);
+    return GST_PAD_PROBE_OK;
+}
+
+static FrameReportEntry* find_report_entry(PipelineHandle *handle, GstClockTime pts) {
+    if (!GST_CLOCK_TIME_IS_VALID(pts))
+        return NULL;
+    for (int idx = 0; idx < FRAME_REPORT_RING_SIZE; idx++) {
+        if (__atomic_load_n(&handle->rpl.frames[idx].pts, __ATOMIC_ACQUIRE) == pts)
+            return &handle->rpl.frames[idx];
+    }
+    return NULL;
+}
+
+static guint64 hash_bytes(guint64 hash, const guint8* data, gsize size) {
+    gsize idx = 0;
+    for (; idx + sizeof(guint64) <= size; idx += sizeof(guint64)) {
+        guint64 word;
+        memcpy(&word, data + idx, sizeof(word));
+        hash = (hash ^ word) * FRAME_HASH_MULTIPLIER;
+        hash ^= hash >> 32;
+    }
+    for (; idx < size; idx++) {
+        hash = (hash ^ data[idx]) * FRAME_HASH_MULTIPLIER;
+    }
+    return hash;
+}
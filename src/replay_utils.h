@@ -0,0 +1,50 @@
+#ifndef __REPLAY_UTILS_H__
+#define __REPLAY_UTILS_H__
+
+#include <gst/gst.h>
+#include "cam_utils.h"
+#include "pipeline.h"
+
+/* Recording file layout (host byte order):
+ *   RecordingHeader
+ *   per frame: RecordingFrameHeader followed by frame_size bytes of RGBA, rows packed without padding
+ * Timestamps are rebased on the first recorded frame */
+#define RECORDING_MAGIC "RTVPREC1"
+#define RECORDING_VERSION 1
+
+typedef struct _RecordingHeader {
+    char magic[8];
+    guint32 version;
+    /* GStreamer video format name, NUL padded */
+    char format[8];
+    guint32 width;
+    guint32 height;
+    /* Frame interval in CamParams convention (fr_num / fr_denom seconds) */
+    gint32 fr_num;
+    gint32 fr_denom;
+    guint32 frame_size;
+} RecordingHeader;
+
+typedef struct _RecordingFrameHeader {
+    guint64 pts;
+    guint64 duration;
+} RecordingFrameHeader;
+
+/* Reads frame properties from a recording, same output as read_cam_params */
+int read_recording_params(const char* path, CamParams *out_params);
+
+/* Returns 1 if the recording is replayed as fast as possible (no clock), 0 if paced as captured */
+int select_replay_fast(PipelineConfig *pipeline_config);
+/* Creates the appsrc feeding the recording to the decoding stage */
+GstElement* create_replay_source(PipelineHandle *handle);
+/* Writes the decoding stage output to the recording file (opened on the first call) */
+int configure_recorder(PipelineHandle *handle);
+
+/* Frame report: checksum of each processed frame & its decode to processing / encoder output time */
+int start_frame_report(PipelineHandle *handle);
+/* Releases a realtime replay source waiting for its next frame time (before the pipeline is stopped) */
+void stop_replay(PipelineHandle *handle);
+/* Logs the run summary & closes all files (once the pipeline is stopped) */
+void cleanup_replay(PipelineHandle *handle);
+
+#endif
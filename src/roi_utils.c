@@ -0,0 +1,281 @@
+#include "roi_utils.h"
+#include "log_utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <gst/video/video.h>
+
+static int is_roi_file(const char* roi);
+static int parse_roi_rects(const char* desc, RoiRect* out_rects, int* out_num);
+static int read_roi_file(const char* path, gint64 *out_mtime, RoiRect* out_rects, int* out_num);
+static void set_roi_uniforms(GstElement *shader, const RoiRect* rects, int num_rects);
+static guint64 roi_area(const RoiRect* rects, int num_rects, int width, int height);
+static GstPadProbeReturn roi_frame_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static gboolean poll_roi_stages(gpointer user_data);
+static void report_roi_stages(PipelineHandle *handle);
+
+char* split_roi_stage(const char* stage, char** out_roi) {
+    const char* open = strchr(stage, ROI_OPEN);
+    size_t len = strlen(stage);
+    *out_roi = NULL;
+    if (!open || len == 0 || stage[len - 1] != ROI_CLOSE)
+        return g_strdup(stage);
+    *out_roi = g_strndup(open + 1, stage + len - 1 - (open + 1));
+    return g_strndup(stage, open - stage);
+}
+
+char* wrap_roi_shader(const char* code) {
+    /* 1) The original main becomes a plain function */
+    GRegex *main_regex = g_regex_new("\\bvoid\\s+main\\s*\\(", 0, 0, NULL);
+    if (!g_regex_match(main_regex, code, 0, NULL)) {
+        g_regex_unref(main_regex);
+        ERROR("Shader has no main, can not restrict it to an ROI");
+        return NULL;
+    }
+    char* renamed = g_regex_replace_literal(main_regex, code, -1, 0, "void roi_main(", 0, NULL);
+    g_regex_unref(main_regex);
+
+    /* 2) New main: inside a rectangle run the shader, outside copy the input texel. Rectangles are in pixels
+       (width & height are set by glshader), uniforms not set by the stage default to 0 (empty rectangles) */
+    GString *wrapped = g_string_new(renamed);
+    g_free(renamed);
+    g_string_append(wrapped, "\nuniform int roi_count;\n");
+    for (int idx = 0; idx < ROI_MAX_RECTS; idx++) {
+        g_string_append_printf(wrapped, "uniform float roi%d_x0, roi%d_y0, roi%d_x1, roi%d_y1;\n", idx, idx, idx, idx);
+    }
+    g_string_append(wrapped, "bool in_roi(vec2 p) {\n    return false");
+    for (int idx = 0; idx < ROI_MAX_RECTS; idx++) {
+        g_string_append_printf(wrapped, "\n        || (p.x >= roi%d_x0 && p.x < roi%d_x1 && p.y >= roi%d_y0 && p.y < roi%d_y1)",
+                               idx, idx, idx, idx);
+    }
+    g_string_append(wrapped, ";\n}\n"
+                             "void main() {\n"
+                             "    if (roi_count > 0 && in_roi(v_texcoord * vec2(width, height)))\n"
+                             "        roi_main();\n"
+                             "    else\n"
+                             "        gl_FragColor = texture2D(tex, v_texcoord);\n"
+                             "}\n");
+    return g_string_free(wrapped, FALSE);
+}
+
+int apply_roi(GstElement *shader, const char* roi) {
+    RoiRect rects[ROI_MAX_RECTS];
+    int num_rects = 0;
+    gint64 mtime = 0;
+    if (is_roi_file(roi)) {
+        /* Rectangles may come later, the whole frame is copied until then */
+        if (read_roi_file(roi, &mtime, rects, &num_rects) != RET_OK)
+            num_rects = 0;
+    } else {
+        CHECK(parse_roi_rects(roi, rects, &num_rects) == RET_OK, "Failed to parse ROI rectangles", RET_ERR);
+    }
+    set_roi_uniforms(shader, rects, num_rects);
+    return RET_OK;
+}
+
+void configure_roi_stages(PipelineHandle *handle, ShaderGraph *graph) {
+    for (int idx = 0; idx < graph->num_shader_stages; idx++) {
+        GstElement *shader = graph->shader_stages[idx];
+        const char* roi = g_object_get_data(G_OBJECT(shader), ROI_DESC_KEY);
+        if (!roi)
+            continue;
+
+        handle->roi.stages = g_renew(RoiStage, handle->roi.stages, handle->roi.num + 1);
+        RoiStage *stage = &handle->roi.stages[handle->roi.num++];
+        *stage = (RoiStage){.shader = shader};
+        if (is_roi_file(roi)) {
+            stage->file = g_strdup(roi);
+            if (read_roi_file(roi, &stage->file_mtime, stage->rects, &stage->num_rects) != RET_OK)
+                stage->num_rects = 0;
+        } else {
+            parse_roi_rects(roi, stage->rects, &stage->num_rects);
+        }
+
+        GstPad *src_pad = gst_element_get_static_pad(shader, "src");
+        gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_BUFFER, roi_frame_probe, stage, NULL);
+        gst_object_unref(src_pad);
+    }
+}
+
+int start_roi_monitor(PipelineHandle *handle) {
+    if (handle->roi.num == 0)
+        return RET_OK;
+    handle->roi.report_us = g_get_monotonic_time();
+    handle->roi.poll_source_id = g_timeout_add(ROI_POLL_INTERVAL_MS, poll_roi_stages, handle);
+    DEBUG_PRINT_FMT("ROI stages: %d, shaded pixels reported every %d ms\n", handle->roi.num, ROI_REPORT_INTERVAL_MS);
+    return RET_OK;
+}
+
+void stop_roi_monitor(PipelineHandle *handle) {
+    if (handle->roi.poll_source_id) {
+        g_source_remove(handle->roi.poll_source_id);
+        handle->roi.poll_source_id = 0;
+        poll_roi_stages(handle);
+        DEBUG_PRINT("ROI stages, whole run:\n");
+        report_roi_stages(handle);
+    }
+    for (int idx = 0; idx < handle->roi.num; idx++) {
+        g_free(handle->roi.stages[idx].file);
+    }
+    g_clear_pointer(&handle->roi.stages, g_free);
+    handle->roi.num = 0;
+}
+
+/* Runs on the stage streaming thread */
+static GstPadProbeReturn roi_frame_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    RoiStage *stage = (RoiStage*)user_data;
+    __atomic_add_fetch(&stage->num_frames, 1, __ATOMIC_RELAXED);
+    return GST_PAD_PROBE_OK;
+}
+
+static gboolean poll_roi_stages(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+
+    for (int idx = 0; idx < handle->roi.num; idx++) {
+        RoiStage *stage = &handle->roi.stages[idx];
+
+        /* 1) Frame size, known once negotiated */
+        if (stage->width == 0) {
+            GstPad *src_pad = gst_element_get_static_pad(stage->shader, "src");
+            GstCaps *caps = gst_pad_get_current_caps(src_pad);
+            GstVideoInfo video_info;
+            if (caps && gst_video_info_from_caps(&video_info, caps)) {
+                stage->width = GST_VIDEO_INFO_WIDTH(&video_info);
+                stage->height = GST_VIDEO_INFO_HEIGHT(&video_info);
+            }
+            if (caps) gst_caps_unref(caps);
+            gst_object_unref(src_pad);
+        }
+
+        /* 2) Account frames rendered with the rectangles in place since the last poll */
+        gint64 num_frames = __atomic_load_n(&stage->num_frames, __ATOMIC_RELAXED);
+        gint64 new_frames = num_frames - stage->prev_frames;
+        stage->prev_frames = num_frames;
+        stage->shaded_pixels += new_frames * roi_area(stage->rects, stage->num_rects, stage->width, stage->height);
+        stage->frame_pixels += new_frames * (guint64)stage->width * stage->height;
+
+        /* 3) Rectangles updated at runtime, an unreadable or invalid file keeps the previous ones */
+        struct stat file_stat;
+        if (!stage->file || stat(stage->file, &file_stat) != 0)
+            continue;
+        gint64 mtime = (gint64)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+        if (mtime == stage->file_mtime)
+            continue;
+        RoiRect rects[ROI_MAX_RECTS];
+        int num_rects = 0;
+        if (read_roi_file(stage->file, &stage->file_mtime, rects, &num_rects) != RET_OK)
+            continue;
+        memcpy(stage->rects, rects, sizeof(rects));
+        stage->num_rects = num_rects;
+        set_roi_uniforms(stage->shader, rects, num_rects);
+    }
+
+    gint64 now_us = g_get_monotonic_time();
+    if (now_us - handle->roi.report_us >= ROI_REPORT_INTERVAL_MS * 1000) {
+        handle->roi.report_us = now_us;
+        report_roi_stages(handle);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void report_roi_stages(PipelineHandle *handle) {
+    for (int idx = 0; idx < handle->roi.num; idx++) {
+        RoiStage *stage = &handle->roi.stages[idx];
+        const char* name = g_object_get_data(G_OBJECT(stage->shader), SHADER_NAME_KEY);
+        double ratio = stage->frame_pixels > 0 ? (double)stage->shaded_pixels / stage->frame_pixels : 0.0;
+        DEBUG_PRINT_FMT("  [%s]-[%s] rects=%d, shaded %.1f of %.1f Mpx (%.1f%% of the frames)\n",
+                        name ? name : "?", GST_ELEMENT_NAME(stage->shader), stage->num_rects,
+                        stage->shaded_pixels / 1e6, stage->frame_pixels / 1e6, 100.0 * ratio);
+    }
+}
+
+static int is_roi_file(const char* roi) {
+    return !g_ascii_isdigit(roi[0]);
+}
+
+static int parse_roi_rects(const char* desc, RoiRect* out_rects, int* out_num) {
+    int ret = RET_OK;
+    *out_num = 0;
+    gchar** items = g_strsplit_set(desc, ROI_RECT_DELIMITERS, -1);
+    for (int idx = 0; items[idx] && ret == RET_OK; idx++) {
+        char* item = g_strstrip(items[idx]);
+        if (item[0] == '\0')
+            continue;
+        RoiRect rect;
+        char trailing;
+        if (sscanf(item, "%d,%d,%d,%d%c", &rect.x, &rect.y, &rect.width, &rect.height, &trailing) != 4 ||
+            rect.x < 0 || rect.y < 0 || rect.width <= 0 || rect.height <= 0) {
+            ERROR_FMT("Invalid ROI rectangle [%s], expected x,y,w,h", item);
+            ret = RET_ERR;
+        } else if (*out_num >= ROI_MAX_RECTS) {
+            ERROR_FMT("Too many ROI rectangles, at most %d per stage", ROI_MAX_RECTS);
+            ret = RET_ERR;
+        } else {
+            out_rects[(*out_num)++] = rect;
+        }
+    }
+    g_strfreev(items);
+    return ret;
+}
+
+static int read_roi_file(const char* path, gint64 *out_mtime, RoiRect* out_rects, int* out_num) {
+    struct stat file_stat;
+    gchar* content = NULL;
+    if (stat(path, &file_stat) != 0 || !g_file_get_contents(path, &content, NULL, NULL))
+        return RET_ERR;
+    *out_mtime = (gint64)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+    int ret = parse_roi_rects(content, out_rects, out_num);
+    g_free(content);
+    return ret;
+}
+
+static void set_roi_uniforms(GstElement *shader, const RoiRect* rects, int num_rects) {
+    GstStructure *uniforms = gst_structure_new("uniforms", "roi_count", G_TYPE_INT, num_rects, NULL);
+    char field[32];
+    for (int idx = 0; idx < ROI_MAX_RECTS; idx++) {
+        /* Unused rectangles are empty */
+        RoiRect rect = idx < num_rects ? rects[idx] : (RoiRect){0};
+        snprintf(field, sizeof(field), "roi%d_x0", idx);
+        gst_structure_set(uniforms, field, G_TYPE_FLOAT, (float)rect.x, NULL);
+        snprintf(field, sizeof(field), "roi%d_y0", idx);
+        gst_structure_set(uniforms, field, G_TYPE_FLOAT, (float)rect.y, NULL);
+        snprintf(field, sizeof(field), "roi%d_x1", idx);
+        gst_structure_set(uniforms, field, G_TYPE_FLOAT, (float)(rect.x + rect.width), NULL);
+        snprintf(field, sizeof(field), "roi%d_y1", idx);
+        gst_structure_set(uniforms, field, G_TYPE_FLOAT, (float)(rect.y + rect.height), NULL);
+    }
+    /* Picked up by glshader with its next frame */
+    g_object_set(G_OBJECT(shader), "uniforms", uniforms, NULL);
+    gst_structure_free(uniforms);
+}
+
+/* Pixels covered by the union of the rectangles clipped to the frame (overlaps are shaded once) */
+static guint64 roi_area(const RoiRect* rects, int num_rects, int width, int height) {
+    int xs[2 * ROI_MAX_RECTS], ys[2 * ROI_MAX_RECTS], num_xs = 0, num_ys = 0;
+    for (int idx = 0; idx < num_rects; idx++) {
+        xs[num_xs++] = CLAMP(rects[idx].x, 0, width);
+        xs[num_xs++] = CLAMP(rects[idx].x + rects[idx].width, 0, width);
+        ys[num_ys++] = CLAMP(rects[idx].y, 0, height);
+        ys[num_ys++] = CLAMP(rects[idx].y + rects[idx].height, 0, height);
+    }
+    /* Sort the edges, each cell of the resulting grid is either fully covered or not at all */
+    for (int i = 1; i < num_xs; i++) {
+        for (int j = i; j > 0 && xs[j-1] > xs[j]; j--) { int t = xs[j]; xs[j] = xs[j-1]; xs[j-1] = t; }
+        for (int j = i; j > 0 && ys[j-1] > ys[j]; j--) { int t = ys[j]; ys[j] = ys[j-1]; ys[j-1] = t; }
+    }
+    guint64 area = 0;
+    for (int i = 0; i + 1 < num_xs; i++) {
+        for (int j = 0; j + 1 < num_ys; j++) {
+            for (int idx = 0; idx < num_rects; idx++) {
+                const RoiRect *rect = &rects[idx];
+                if (xs[i] >= rect->x && xs[i+1] <= rect->x + rect->width &&
+                    ys[j] >= rect->y && ys[j+1] <= rect->y + rect->height) {
+                    area += (guint64)(xs[i+1] - xs[i]) * (ys[j+1] - ys[j]);
+                    break;
+                }
+            }
+        }
+    }
+    return area;
+}
@@ -0,0 +1,33 @@
+#ifndef __ROI_UTILS_H__
+#define __ROI_UTILS_H__
+
+#include <gst/gst.h>
+#include "pipeline.h"
+
+/* Region of interest syntax, appended to a GL shader stage of the graph:
+ *   stage[x,y,w,h(+x,y,w,h)*]   static rectangles in stage frame pixels (up to ROI_MAX_RECTS)
+ *   stage[<file>]               rectangles re-read whenever the file changes, same syntax ('+' or new line separated)
+ * Only the pixels inside a rectangle run the shader, the others are copied from the input as is.
+ * Eg. "vertical_flip ! ascii_effect[0,0,640,360+1280,720,320,200] ! vignette[/tmp/faces.roi]" */
+#define ROI_OPEN '['
+#define ROI_CLOSE ']'
+#define ROI_RECT_DELIMITERS "+\n"
+/* Object data key holding the ROI description of a shader stage element */
+#define ROI_DESC_KEY "rtvpp-roi"
+/* Interval between rectangle file checks & shaded pixel accounting */
+#define ROI_POLL_INTERVAL_MS 100
+#define ROI_REPORT_INTERVAL_MS 5000
+
+/* Splits "<name>[<roi>]", returns the stage name & the ROI description (NULL if none), both g_free'd */
+char* split_roi_stage(const char* stage, char** out_roi);
+/* Renames the shader main so it only runs inside the rectangles, NULL on error (g_free) */
+char* wrap_roi_shader(const char* code);
+/* Sets the rectangles of a wrapped shader stage: static ones or the current file content (none if missing) */
+int apply_roi(GstElement *shader, const char* roi);
+
+/* Collects the ROI stages of a graph, called for every graph created */
+void configure_roi_stages(PipelineHandle *handle, ShaderGraph *graph);
+int start_roi_monitor(PipelineHandle *handle);
+void stop_roi_monitor(PipelineHandle *handle);
+
+#endif
@@ -0,0 +1,190 @@
+#include "scaleconv.h"
+#include "scaleconv_kernels.h"
+#include "stripe_runner.h"
+#include "log_utils.h"
+
+struct _RtvppScaleConv {
+    GstVideoFilter parent;
+
+    /* Properties */
+    gint num_threads;
+
+    ScaleConvTables* tables;
+    ScaleConvCoeffs coeffs;
+    StripeRunner* runner;
+};
+
+enum {
+    PROP_0,
+    PROP_THREADS,
+};
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, 
+                                                                    GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("RGBA")));
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, 
+                                                                   GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("I420")));
+
+G_DEFINE_TYPE(RtvppScaleConv, rtvpp_scaleconv, GST_TYPE_VIDEO_FILTER)
+
+static void rtvpp_scaleconv_set_property(GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec) {
+    RtvppScaleConv *self = RTVPP_SCALECONV(object);
+    switch (prop_id) {
+        case PROP_THREADS:
+            self->num_threads = g_value_get_int(value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static void rtvpp_scaleconv_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec) {
+    RtvppScaleConv *self = RTVPP_SCALECONV(object);
+    switch (prop_id) {
+        case PROP_THREADS:
+            g_value_set_int(value, self->num_threads);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static GstCaps* rtvpp_scaleconv_transform_caps(GstBaseTransform* trans, GstPadDirection direction, 
+                                               GstCaps* caps, GstCaps* filter) {
+    /* Size & format are free on the other side, everything else (framerate, par, ..) passes through */
+    GstCaps *result = gst_caps_copy(caps);
+    for (guint i = 0; i < gst_caps_get_size(result); i++) {
+        GstStructure *s = gst_caps_get_structure(result, i);
+        gst_structure_set(s, "width", GST_TYPE_INT_RANGE, 1, G_MAXINT, 
+                             "height", GST_TYPE_INT_RANGE, 1, G_MAXINT,
+                             "format", G_TYPE_STRING, direction == GST_PAD_SINK ? "I420" : "RGBA", NULL);
+        gst_structure_remove_fields(s, "colorimetry", "chroma-site", NULL);
+    }
+
+    if (filter) {
+        GstCaps *tmp = gst_caps_intersect_full(filter, result, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref(result);
+        result = tmp;
+    }
+    return result;
+}
+
+static GstCaps* rtvpp_scaleconv_fixate_caps(GstBaseTransform* trans, GstPadDirection direction, 
+                                            GstCaps* caps, GstCaps* othercaps) {
+    /* Keep the size unless downstream constrains it (default fixation would pick 1x1) */
+    GstStructure *in_s = gst_caps_get_structure(caps, 0);
+    gint width = 0, height = 0;
+    gst_structure_get_int(in_s, "width", &width);
+    gst_structure_get_int(in_s, "height", &height);
+
+    othercaps = gst_caps_truncate(othercaps);
+    othercaps = gst_caps_make_writable(othercaps);
+    GstStructure *out_s = gst_caps_get_structure(othercaps, 0);
+    if (width > 0) gst_structure_fixate_field_nearest_int(out_s, "width", width);
+    if (height > 0) gst_structure_fixate_field_nearest_int(out_s, "height", height);
+    return gst_caps_fixate(othercaps);
+}
+
+static gboolean rtvpp_scaleconv_set_info(GstVideoFilter* filter, GstCaps* incaps, GstVideoInfo* in_info, 
+                                         GstCaps* outcaps, GstVideoInfo* out_info) {
+    RtvppScaleConv *self = RTVPP_SCALECONV(filter);
+
+    /* 1) Sampling tables for this size pair */
+    cleanup_scaleconv_tables(&self->tables);
+    self->tables = create_scaleconv_tables(GST_VIDEO_INFO_WIDTH(in_info), GST_VIDEO_INFO_HEIGHT(in_info),
+                                           GST_VIDEO_INFO_WIDTH(out_info), GST_VIDEO_INFO_HEIGHT(out_info));
+    CHECK(self->tables != NULL, "Failed to create scaling tables (unsupported width?)", FALSE);
+
+    /* 2) Conversion matrix from the negotiated colorimetry (caps without it default to bt601 / bt709 by size) */
+    gdouble kr = 0.0, kb = 0.0;
+    GstVideoColorimetry *colorimetry = &GST_VIDEO_INFO_COLORIMETRY(out_info);
+    if (!gst_video_color_matrix_get_Kr_Kb(colorimetry->matrix, &kr, &kb)) {
+        /* RGB / unknown matrix, fall back to bt709 */
+        gst_video_color_matrix_get_Kr_Kb(GST_VIDEO_COLOR_MATRIX_BT709, &kr, &kb);
+    }
+    int full_range = colorimetry->range == GST_VIDEO_COLOR_RANGE_0_255;
+    init_scaleconv_coeffs(&self->coeffs, kr, kb, full_range);
+
+    gchar *colorimetry_str = gst_video_colorimetry_to_string(colorimetry);
+    DEBUG_PRINT_FMT("[%s] %dx%d RGBA -> %dx%d I420, colorimetry=%s\n", GST_ELEMENT_NAME(self), 
+                    GST_VIDEO_INFO_WIDTH(in_info), GST_VIDEO_INFO_HEIGHT(in_info),
+                    GST_VIDEO_INFO_WIDTH(out_info), GST_VIDEO_INFO_HEIGHT(out_info), 
+                    colorimetry_str ? colorimetry_str : "unknown");
+    g_free(colorimetry_str);
+    return TRUE;
+}
+
+static gboolean rtvpp_scaleconv_start(GstBaseTransform* trans) {
+    RtvppScaleConv *self = RTVPP_SCALECONV(trans);
+    self->runner = create_stripe_runner(self->num_threads);
+    CHECK(self->runner != NULL, "Failed to create stripe runner", FALSE);
+    return TRUE;
+}
+
+static gboolean rtvpp_scaleconv_stop(GstBaseTransform* trans) {
+    RtvppScaleConv *self = RTVPP_SCALECONV(trans);
+    cleanup_stripe_runner(&self->runner);
+    cleanup_scaleconv_tables(&self->tables);
+    return TRUE;
+}
+
+static void process_stripe(void* data, int first_row, int last_row) {
+    scale_convert_rows((const ScaleConvJob*)data, first_row, last_row);
+}
+
+static GstFlowReturn rtvpp_scaleconv_transform_frame(GstVideoFilter* filter, GstVideoFrame* in_frame, 
+                                                     GstVideoFrame* out_frame) {
+    RtvppScaleConv *self = RTVPP_SCALECONV(filter);
+    ScaleConvJob job = {
+        .src = GST_VIDEO_FRAME_PLANE_DATA(in_frame, 0),
+        .src_stride = GST_VIDEO_FRAME_PLANE_STRIDE(in_frame, 0),
+        .tables = self->tables,
+        .coeffs = &self->coeffs,
+    };
+    for (int i = 0; i < 3; i++) {
+        job.dst[i] = GST_VIDEO_FRAME_PLANE_DATA(out_frame, i);
+        job.dst_stride[i] = GST_VIDEO_FRAME_PLANE_STRIDE(out_frame, i);
+    }
+
+    /* Stripes are aligned to row pairs, each one owns its chroma rows */
+    run_stripes(self->runner, GST_VIDEO_FRAME_HEIGHT(out_frame), process_stripe, &job);
+    return GST_FLOW_OK;
+}
+
+static void rtvpp_scaleconv_class_init(RtvppScaleConvClass* klass) {
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseTransformClass *transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+    GstVideoFilterClass *filter_class = GST_VIDEO_FILTER_CLASS(klass);
+
+    gobject_class->set_property = rtvpp_scaleconv_set_property;
+    gobject_class->get_property = rtvpp_scaleconv_get_property;
+
+    g_object_class_install_property(gobject_class, PROP_THREADS, 
+        g_param_spec_int("threads", "Threads", "Number of threads processing row stripes (0 = one per core)", 
+                         0, 256, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    gst_element_class_set_static_metadata(element_class, "RT-VPP scale & convert", "Filter/Converter/Video/Scaler", 
+                                          "Fused bilinear RGBA resample and I420 conversion", "rt-vpp");
+    gst_element_class_add_static_pad_template(element_class, &sink_template);
+    gst_element_class_add_static_pad_template(element_class, &src_template);
+
+    transform_class->transform_caps = GST_DEBUG_FUNCPTR(rtvpp_scaleconv_transform_caps);
+    transform_class->fixate_caps = GST_DEBUG_FUNCPTR(rtvpp_scaleconv_fixate_caps);
+    transform_class->start = GST_DEBUG_FUNCPTR(rtvpp_scaleconv_start);
+    transform_class->stop = GST_DEBUG_FUNCPTR(rtvpp_scaleconv_stop);
+    filter_class->set_info = GST_DEBUG_FUNCPTR(rtvpp_scaleconv_set_info);
+    filter_class->transform_frame = GST_DEBUG_FUNCPTR(rtvpp_scaleconv_transform_frame);
+}
+
+static void rtvpp_scaleconv_init(RtvppScaleConv* self) {
+    self->num_threads = 0;
+    self->tables = NULL;
+}
+
+int register_scaleconv_element() {
+    gboolean ret = gst_element_register(NULL, "rtvppscaleconv", GST_RANK_NONE, RTVPP_TYPE_SCALECONV);
+    CHECK(ret == TRUE, "Failed to register rtvppscaleconv element", RET_ERR);
+    return RET_OK;
+}
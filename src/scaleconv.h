@@ -0,0 +1,17 @@
+#ifndef __SCALECONV_H__
+#define __SCALECONV_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+/* rtvppscaleconv: bilinear resample + RGBA -> I420 conversion fused in a single pass over the frame.
+   Replaces `videoscale ! capsfilter ! videoconvert` between processing and encoding, the RGBA frame at
+   output resolution is never materialized. Conversion matrix & range follow the negotiated output colorimetry */
+
+#define RTVPP_TYPE_SCALECONV (rtvpp_scaleconv_get_type())
+G_DECLARE_FINAL_TYPE(RtvppScaleConv, rtvpp_scaleconv, RTVPP, SCALECONV, GstVideoFilter)
+
+int register_scaleconv_element();
+
+#endif
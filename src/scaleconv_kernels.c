@@ -0,0 +1,297 @@
+#include "scaleconv_kernels.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCALECONV_X86 1
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#define COEFF_BITS 14
+#define WEIGHT_BITS 15
+#define SCALECONV_MAX_WIDTH 8192
+
+void init_scaleconv_coeffs(ScaleConvCoeffs* coeffs, double kr, double kb, int full_range) {
+    double kg = 1.0 - kr - kb;
+    double y_scale = full_range ? 1.0 : 219.0 / 255.0;
+    double uv_scale = full_range ? 1.0 : 224.0 / 255.0;
+    double one = (double)(1 << COEFF_BITS);
+
+    coeffs->yr = (int32_t)lround(kr * y_scale * one);
+    coeffs->yg = (int32_t)lround(kg * y_scale * one);
+    coeffs->yb = (int32_t)lround(kb * y_scale * one);
+    coeffs->y_offset = full_range ? 0 : 16;
+
+    /* U = (B - Y) / (2 * (1 - Kb)), V = (R - Y) / (2 * (1 - Kr)) */
+    double u_div = 2.0 * (1.0 - kb), v_div = 2.0 * (1.0 - kr);
+    coeffs->ur = (int32_t)lround(-kr / u_div * uv_scale * one);
+    coeffs->ug = (int32_t)lround(-kg / u_div * uv_scale * one);
+    coeffs->ub = (int32_t)lround((1.0 - kb) / u_div * uv_scale * one);
+    coeffs->vr = (int32_t)lround((1.0 - kr) / v_div * uv_scale * one);
+    coeffs->vg = (int32_t)lround(-kg / v_div * uv_scale * one);
+    coeffs->vb = (int32_t)lround(-kb / v_div * uv_scale * one);
+}
+
+/* Same sampling positions as a GL_LINEAR / videoscale bilinear resample (pixel centers, clamp to edge) */
+static void compute_axis(int src_size, int dst_size, int32_t* idx, int16_t* weight) {
+    double scale = (double)src_size / dst_size;
+    for (int i = 0; i < dst_size; i++) {
+        double pos = (i + 0.5) * scale - 0.5;
+        if (pos < 0.0) pos = 0.0;
+        int base = (int)floor(pos);
+        if (base >= src_size - 1) {
+            base = src_size - 1;
+            pos = base;
+        }
+        idx[i] = base;
+        weight[i] = (int16_t)lround((pos - base) * ((1 << WEIGHT_BITS) - 1));
+    }
+}
+
+ScaleConvTables* create_scaleconv_tables(int src_width, int src_height, int dst_width, int dst_height) {
+    if (src_width > SCALECONV_MAX_WIDTH || dst_width > SCALECONV_MAX_WIDTH) 
+        return NULL;
+
+    ScaleConvTables* tables = calloc(1, sizeof(ScaleConvTables));
+    if (!tables) 
+        return NULL;
+    *tables = (ScaleConvTables) {
+        .src_width = src_width, .src_height = src_height,
+        .dst_width = dst_width, .dst_height = dst_height,
+        .x0 = malloc(dst_width * sizeof(int32_t)),
+        .fx = malloc(dst_width * sizeof(int16_t)),
+        .y0 = malloc(dst_height * sizeof(int32_t)),
+        .fy = malloc(dst_height * sizeof(int16_t)),
+    };
+    if (!tables->x0 || !tables->fx || !tables->y0 || !tables->fy) {
+        cleanup_scaleconv_tables(&tables);
+        return NULL;
+    }
+
+    compute_axis(src_width, dst_width, tables->x0, tables->fx);
+    compute_axis(src_height, dst_height, tables->y0, tables->fy);
+    return tables;
+}
+
+void cleanup_scaleconv_tables(ScaleConvTables** tables) {
+    if (!(*tables)) return;
+    free((*tables)->x0);
+    free((*tables)->fx);
+    free((*tables)->y0);
+    free((*tables)->fy);
+    free(*tables);
+    *tables = NULL;
+}
+
+#ifdef SCALECONV_X86
+static int has_avx2() {
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+static inline uint8_t lerp_q15(uint8_t a, uint8_t b, int16_t w) {
+    return (uint8_t)(a + (((b - a) * w + (1 << (WEIGHT_BITS - 1))) >> WEIGHT_BITS));
+}
+
+static inline uint8_t clamp_u8(int32_t val) {
+    return val < 0 ? 0 : (val > 255 ? 255 : (uint8_t)val);
+}
+
+/* Vertical pass: blends two source rows, `len` is in bytes */
+
+static void blend_rows(const uint8_t* a, const uint8_t* b, uint8_t* out, int16_t w, int start, int len) {
+    for (int i = start; i < len; i++) 
+        out[i] = lerp_q15(a[i], b[i], w);
+}
+
+#ifdef SCALECONV_X86
+static void blend_rows_sse2(const uint8_t* a, const uint8_t* b, uint8_t* out, int16_t w, int len) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weight = _mm_set1_epi16(w);
+    const __m128i round = _mm_set1_epi16(32);
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i a_lo = _mm_unpacklo_epi8(va, zero), a_hi = _mm_unpackhi_epi8(va, zero);
+        __m128i b_lo = _mm_unpacklo_epi8(vb, zero), b_hi = _mm_unpackhi_epi8(vb, zero);
+        /* No mulhrs in SSE2: mulhi((b - a) << 7, w) = (b - a) * w >> 9, then round & shift the remaining 6 bits */
+        __m128i d_lo = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(b_lo, a_lo), 7), weight);
+        __m128i d_hi = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(b_hi, a_hi), 7), weight);
+        d_lo = _mm_srai_epi16(_mm_add_epi16(d_lo, round), 6);
+        d_hi = _mm_srai_epi16(_mm_add_epi16(d_hi, round), 6);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_add_epi16(a_lo, d_lo), _mm_add_epi16(a_hi, d_hi)));
+    }
+    blend_rows(a, b, out, w, i, len);
+}
+
+TARGET_AVX2 static void blend_rows_avx2(const uint8_t* a, const uint8_t* b, uint8_t* out, int16_t w, int len) {
+    const __m256i weight = _mm256_set1_epi16(w);
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+        __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+        /* mulhrs: (x * w + 2^14) >> 15 */
+        __m256i res = _mm256_add_epi16(va, _mm256_mulhrs_epi16(_mm256_sub_epi16(vb, va), weight));
+        __m256i packed = _mm256_packus_epi16(res, res);
+        _mm_storeu_si128((__m128i*)(out + i), _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0))));
+    }
+    blend_rows(a, b, out, w, i, len);
+}
+#endif
+
+/* Horizontal pass: samples the blended row at the output columns (RGBA) */
+
+static void sample_row(const uint8_t* row, uint8_t* out, const ScaleConvTables* t, int start) {
+    for (int x = start; x < t->dst_width; x++) {
+        const uint8_t* p0 = row + 4 * t->x0[x];
+        const uint8_t* p1 = (t->x0[x] + 1 < t->src_width) ? p0 + 4 : p0;
+        for (int c = 0; c < 4; c++) 
+            out[4 * x + c] = lerp_q15(p0[c], p1[c], t->fx[x]);
+    }
+}
+
+#ifdef SCALECONV_X86
+TARGET_AVX2 static void sample_row_avx2(const uint8_t* row, uint8_t* out, const ScaleConvTables* t) {
+    /* Broadcast one weight per pixel to its 4 channels (same lane layout as cvtepu8_epi16 output) */
+    const __m256i weight_shuffle = _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 2, 3,
+                                                    0, 1, 0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 2, 3);
+    const __m256i one = _mm256_set1_epi32(1);
+    /* The last column samples itself, keep the gathers inside the row */
+    int x = 0, limit = t->dst_width;
+    while (limit > 0 && t->x0[limit - 1] + 1 >= t->src_width) 
+        limit--;
+
+    for (; x + 8 <= limit; x += 8) {
+        __m256i idx = _mm256_loadu_si256((const __m256i*)(t->x0 + x));
+        __m256i p0 = _mm256_i32gather_epi32((const int*)row, idx, 4);
+        __m256i p1 = _mm256_i32gather_epi32((const int*)row, _mm256_add_epi32(idx, one), 4);
+        __m128i w = _mm_loadu_si128((const __m128i*)(t->fx + x));
+
+        __m256i w_lo = _mm256_shuffle_epi8(_mm256_setr_m128i(w, _mm_srli_si128(w, 4)), weight_shuffle);
+        __m256i w_hi = _mm256_shuffle_epi8(_mm256_setr_m128i(_mm_srli_si128(w, 8), _mm_srli_si128(w, 12)), weight_shuffle);
+        __m256i a_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(p0));
+        __m256i a_hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(p0, 1));
+        __m256i b_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(p1));
+        __m256i b_hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(p1, 1));
+        __m256i res_lo = _mm256_add_epi16(a_lo, _mm256_mulhrs_epi16(_mm256_sub_epi16(b_lo, a_lo), w_lo));
+        __m256i res_hi = _mm256_add_epi16(a_hi, _mm256_mulhrs_epi16(_mm256_sub_epi16(b_hi, a_hi), w_hi));
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(res_lo, res_hi), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(out + 4 * x), packed);
+    }
+    sample_row(row, out, t, x);
+}
+#endif
+
+/* Conversion: luma for every pixel, chroma from the 2x2 average */
+
+static void convert_luma(const uint8_t* rgba, uint8_t* y_out, const ScaleConvCoeffs* k, int start, int width) {
+    for (int x = start; x < width; x++) {
+        const uint8_t* p = rgba + 4 * x;
+        int32_t y = (k->yr * p[0] + k->yg * p[1] + k->yb * p[2] + (1 << (COEFF_BITS - 1))) >> COEFF_BITS;
+        y_out[x] = clamp_u8(y + k->y_offset);
+    }
+}
+
+#ifdef SCALECONV_X86
+TARGET_AVX2 static void convert_luma_avx2(const uint8_t* rgba, uint8_t* y_out, const ScaleConvCoeffs* k, int width) {
+    const __m256i coeffs = _mm256_setr_epi16(k->yr, k->yg, k->yb, 0, k->yr, k->yg, k->yb, 0,
+                                             k->yr, k->yg, k->yb, 0, k->yr, k->yg, k->yb, 0);
+    const __m256i round = _mm256_set1_epi32(1 << (COEFF_BITS - 1));
+    const __m256i offset = _mm256_set1_epi16(k->y_offset);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(rgba + 4 * x));
+        /* (R*yr + G*yg) and (B*yb + A*0) per pixel, then pairwise sums */
+        __m256i lo = _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(px)), coeffs);
+        __m256i hi = _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(px, 1)), coeffs);
+        __m256i sum = _mm256_hadd_epi32(lo, hi); /* lanes: [y0 y1 y4 y5 | y2 y3 y6 y7] */
+        sum = _mm256_srai_epi32(_mm256_add_epi32(sum, round), COEFF_BITS);
+        sum = _mm256_permutevar8x32_epi32(sum, _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+        __m256i y16 = _mm256_add_epi16(_mm256_packs_epi32(sum, sum), offset);
+        __m256i y8 = _mm256_packus_epi16(y16, y16);
+        /* Result bytes 0..3 in lane 0 and 4..7 in lane 1 */
+        uint32_t lo_bytes = (uint32_t)_mm256_extract_epi32(y8, 0);
+        uint32_t hi_bytes = (uint32_t)_mm256_extract_epi32(y8, 4);
+        memcpy(y_out + x, &lo_bytes, 4);
+        memcpy(y_out + x + 4, &hi_bytes, 4);
+    }
+    convert_luma(rgba, y_out, k, x, width);
+}
+#endif
+
+static void convert_chroma(const uint8_t* row0, const uint8_t* row1, uint8_t* u_out, uint8_t* v_out, 
+                           const ScaleConvCoeffs* k, int width) {
+    for (int x = 0; x < width; x += 2) {
+        int x1 = (x + 1 < width) ? x + 1 : x;
+        int r = row0[4 * x + 0] + row0[4 * x1 + 0] + row1[4 * x + 0] + row1[4 * x1 + 0];
+        int g = row0[4 * x + 1] + row0[4 * x1 + 1] + row1[4 * x + 1] + row1[4 * x1 + 1];
+        int b = row0[4 * x + 2] + row0[4 * x1 + 2] + row1[4 * x + 2] + row1[4 * x1 + 2];
+        /* Sums are 4x the average, fold the division in the shift */
+        int32_t u = (k->ur * r + k->ug * g + k->ub * b + (1 << (COEFF_BITS + 1))) >> (COEFF_BITS + 2);
+        int32_t v = (k->vr * r + k->vg * g + k->vb * b + (1 << (COEFF_BITS + 1))) >> (COEFF_BITS + 2);
+        u_out[x / 2] = clamp_u8(u + 128);
+        v_out[x / 2] = clamp_u8(v + 128);
+    }
+}
+
+static void scale_row(const ScaleConvJob* job, int y, uint8_t* blended, uint8_t* out) {
+    const ScaleConvTables* t = job->tables;
+    int src_y0 = t->y0[y];
+    int src_y1 = (src_y0 + 1 < t->src_height) ? src_y0 + 1 : src_y0;
+    const uint8_t* a = job->src + (size_t)src_y0 * job->src_stride;
+    const uint8_t* b = job->src + (size_t)src_y1 * job->src_stride;
+    int len = t->src_width * 4;
+
+    /* Skip the vertical pass when the output row lands on a source row */
+    const uint8_t* row = a;
+    if (t->fy[y] != 0) {
+#ifdef SCALECONV_X86
+        if (has_avx2()) blend_rows_avx2(a, b, blended, t->fy[y], len);
+        else blend_rows_sse2(a, b, blended, t->fy[y], len);
+#else
+        blend_rows(a, b, blended, t->fy[y], 0, len);
+#endif
+        row = blended;
+    }
+
+#ifdef SCALECONV_X86
+    if (has_avx2()) { sample_row_avx2(row, out, t); return; }
+#endif
+    sample_row(row, out, t, 0);
+}
+
+static void convert_row(const ScaleConvJob* job, const uint8_t* rgba, int y) {
+#ifdef SCALECONV_X86
+    if (has_avx2()) { 
+        convert_luma_avx2(rgba, job->dst[0] + (size_t)y * job->dst_stride[0], job->coeffs, job->tables->dst_width); 
+        return;
+    }
+#endif
+    convert_luma(rgba, job->dst[0] + (size_t)y * job->dst_stride[0], job->coeffs, 0, job->tables->dst_width);
+}
+
+void scale_convert_rows(const ScaleConvJob* job, int first_row, int last_row) {
+    uint8_t blended[SCALECONV_MAX_WIDTH * 4];
+    uint8_t scaled[2][SCALECONV_MAX_WIDTH * 4];
+    const ScaleConvTables* t = job->tables;
+
+    for (int y = first_row; y < last_row; y += 2) {
+        /* Odd heights: last chroma row only has one luma row */
+        int has_second = (y + 1 < t->dst_height);
+        scale_row(job, y, blended, scaled[0]);
+        convert_row(job, scaled[0], y);
+        if (has_second) {
+            scale_row(job, y + 1, blended, scaled[1]);
+            convert_row(job, scaled[1], y + 1);
+        }
+
+        convert_chroma(scaled[0], has_second ? scaled[1] : scaled[0], 
+                       job->dst[1] + (size_t)(y / 2) * job->dst_stride[1], 
+                       job->dst[2] + (size_t)(y / 2) * job->dst_stride[2], 
+                       job->coeffs, t->dst_width);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef __SCALECONV_KERNELS_H__
+#define __SCALECONV_KERNELS_H__
+
+#include <stdint.h>
+
+/* Fused bilinear resample + RGBA -> I420 conversion. Each pair of output rows is produced from the
+   (at most four) source rows it needs, intermediate rows never leave the cache. The vertical & horizontal 
+   blends and the conversion each round to 8 bits, output is within 1.5 LSB of a double precision reference */
+
+/* Fixed point conversion coefficients (Q14) */
+typedef struct _ScaleConvCoeffs {
+    int32_t yr, yg, yb, y_offset;
+    int32_t ur, ug, ub;
+    int32_t vr, vg, vb;
+} ScaleConvCoeffs;
+
+/* Per output column/row source index & Q15 interpolation weight */
+typedef struct _ScaleConvTables {
+    int src_width, src_height;
+    int dst_width, dst_height;
+    int32_t* x0;
+    int16_t* fx;
+    int32_t* y0;
+    int16_t* fy;
+} ScaleConvTables;
+
+typedef struct _ScaleConvJob {
+    const uint8_t* src;
+    int src_stride;
+    uint8_t* dst[3];
+    int dst_stride[3];
+    const ScaleConvTables* tables;
+    const ScaleConvCoeffs* coeffs;
+} ScaleConvJob;
+
+/* kr & kb as returned by gst_video_color_matrix_get_Kr_Kb() */
+void init_scaleconv_coeffs(ScaleConvCoeffs* coeffs, double kr, double kb, int full_range);
+ScaleConvTables* create_scaleconv_tables(int src_width, int src_height, int dst_width, int dst_height);
+void cleanup_scaleconv_tables(ScaleConvTables** tables);
+
+/* Produces output rows [first_row, last_row), first_row must be even */
+void scale_convert_rows(const ScaleConvJob* job, int first_row, int last_row);
+
+#endif
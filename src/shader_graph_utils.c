@@ -0,0 +1,422 @@
+#include "shader_graph_utils.h"
+#include "log_utils.h"
+
+#include <string.h>
+
+/* Multi-input stages, all inputs are drawn on the same frame */
+static const char* compositors[] = {
+    /* Inputs blended with equal weights */
+    "blend",
+    /* First input full frame, the others as thumbnails stacked in the bottom right corner */
+    "pip",
+    /* Inputs side by side, each scaled down to keep the aspect ratio */
+    "split",
+};
+
+typedef struct _GraphChain {
+    /* Labels read by the chain, NULL terminated */
+    gchar** inputs;
+    int num_inputs;
+    /* Compositor merging the inputs (NULL for single input chains) */
+    gchar* compositor;
+    /* Shader stage names, NULL terminated */
+    gchar** stages;
+    /* Label naming the chain output (NULL for the graph output) */
+    gchar* output;
+} GraphChain;
+
+typedef struct _GraphLabel {
+    /* Element producing the labelled frames (NULL for @in until it is materialized) */
+    GstElement* producer;
+    /* Only created if the label is read by several chains */
+    GstElement* tee;
+    int uses;
+    int num_branches;
+} GraphLabel;
+
+typedef struct _GraphBuilder {
+    GstBin* bin;
+    int use_gl;
+    int width;
+    int height;
+    GHashTable* labels;
+    ShaderGraph* graph;
+} GraphBuilder;
+
+static int is_compositor(const char* name);
+static void free_chain(gpointer data);
+static void strip_quotes(char* s);
+static GPtrArray* parse_shader_graph(const char* description);
+static int parse_chain(char* text, GraphChain* chain);
+static GHashTable* resolve_labels(GPtrArray* chains);
+static GstElement* label_output(GraphBuilder* builder, const char* name);
+static GstElement* create_compositor(GraphBuilder* builder, GraphChain* chain, int idx);
+static void place_compositor_input(GstPad* pad, const char* compositor, int idx, int num_inputs, int width, int height);
+static int add_and_link(GraphBuilder* builder, GstElement* elem, GstElement* prev);
+
+gchar** list_shader_graph_stages(const char* description) {
+    GPtrArray* chains = parse_shader_graph(description);
+    if (!chains)
+        return NULL;
+
+    GPtrArray* names = g_ptr_array_new();
+    for (guint idx = 0; idx < chains->len; idx++) {
+        GraphChain* chain = g_ptr_array_index(chains, idx);
+        for (int stage = 0; chain->stages[stage]; stage++) {
+            g_ptr_array_add(names, g_strdup(chain->stages[stage]));
+        }
+    }
+    g_ptr_array_add(names, NULL);
+    g_ptr_array_free(chains, TRUE);
+    return (gchar**)g_ptr_array_free(names, FALSE);
+}
+
+int create_shader_graph(GstBin *bin, const char* description, CreateShaderFn_t create_fn, int use_gl,
+                        int width, int height, ShaderGraph *out_graph) {
+    int ret = RET_ERR;
+    GHashTable* labels = NULL;
+    GraphBuilder builder = {.bin = bin, .use_gl = use_gl, .width = width, .height = height, .graph = out_graph};
+    *out_graph = (ShaderGraph){0};
+
+    /* 1) Parse chains */
+    GPtrArray* chains = parse_shader_graph(description);
+    CHECK(chains != NULL, "Failed to parse shader graph", RET_ERR);
+    GPtrArray* shader_stages = g_ptr_array_new();
+
+    /* 2) Check labels, chains may only read labels defined by earlier chains so the graph has no cycles */
+    labels = resolve_labels(chains);
+    if (!labels) goto cleanup;
+    builder.labels = labels;
+
+    /* 3) Create & link elements chain by chain */
+    for (guint chain_idx = 0; chain_idx < chains->len; chain_idx++) {
+        GraphChain* chain = g_ptr_array_index(chains, chain_idx);
+        GstElement* prev = NULL;
+
+        if (chain->compositor) {
+            prev = create_compositor(&builder, chain, chain_idx);
+            if (!prev) goto cleanup;
+        } else {
+            /* Plain chain reading the input frame only once, its first stage becomes the graph input */
+            GraphLabel* label = g_hash_table_lookup(labels, chain->inputs[0]);
+            if (label->producer == NULL && label->uses == 1 && chain->stages[0]) {
+                prev = NULL;
+            } else {
+                prev = label_output(&builder, chain->inputs[0]);
+                if (!prev) goto cleanup;
+            }
+        }
+
+        for (int stage = 0; chain->stages[stage]; stage++) {
+            GstElement* elem = create_fn(chain->stages[stage]);
+            if (!elem) {
+                ERROR_FMT("Failed to create shader %s", chain->stages[stage]);
+                goto cleanup;
+            }
+            g_ptr_array_add(shader_stages, elem);
+            if (add_and_link(&builder, elem, prev) != RET_OK) goto cleanup;
+            if (!prev) out_graph->input = elem;
+            prev = elem;
+        }
+
+        if (chain->output) {
+            ((GraphLabel*)g_hash_table_lookup(labels, chain->output))->producer = prev;
+        } else {
+            out_graph->output = prev;
+        }
+    }
+    ret = RET_OK;
+
+cleanup:
+    out_graph->num_shader_stages = shader_stages->len;
+    g_ptr_array_add(shader_stages, NULL);
+    out_graph->shader_stages = (GstElement**)g_ptr_array_free(shader_stages, FALSE);
+    if (labels) g_hash_table_unref(labels);
+    g_ptr_array_free(chains, TRUE);
+    return ret;
+}
+
+static int is_compositor(const char* name) {
+    for (size_t idx = 0; idx < G_N_ELEMENTS(compositors); idx++) {
+        if (strcmp(name, compositors[idx]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static void free_chain(gpointer data) {
+    GraphChain* chain = (GraphChain*)data;
+    g_strfreev(chain->inputs);
+    g_strfreev(chain->stages);
+    g_free(chain->compositor);
+    g_free(chain->output);
+    g_free(chain);
+}
+
+static void strip_quotes(char* s) {
+    int j = 0, n = strlen(s);
+    for (int i = 0; i < n; i++) {
+        if (s[i] != '"')
+            s[j++] = s[i];
+    }
+    s[j] = '\0';
+}
+
+static GPtrArray* parse_shader_graph(const char* description) {
+    CHECK(description != NULL, "Shader graph is empty", NULL);
+
+    GPtrArray* chains = g_ptr_array_new_with_free_func(free_chain);
+    gchar** texts = g_strsplit_set(description, SHADER_GRAPH_CHAIN_DELIMITERS, -1);
+    for (int idx = 0; texts[idx]; idx++) {
+        strip_quotes(texts[idx]);
+        g_strstrip(texts[idx]);
+        /* Tolerate empty chains, eg. trailing ';' */
+        if (texts[idx][0] == '\0')
+            continue;
+
+        GraphChain* chain = g_new0(GraphChain, 1);
+        g_ptr_array_add(chains, chain);
+        if (parse_chain(texts[idx], chain) != RET_OK) {
+            ERROR_FMT("Invalid shader graph chain [%s]", texts[idx]);
+            g_strfreev(texts);
+            g_ptr_array_free(chains, TRUE);
+            return NULL;
+        }
+    }
+    g_strfreev(texts);
+
+    if (chains->len == 0) {
+        ERROR("Shader graph is empty");
+        g_ptr_array_free(chains, TRUE);
+        return NULL;
+    }
+    return chains;
+}
+
+static int parse_chain(char* text, GraphChain* chain) {
+    int ret = RET_OK;
+    GPtrArray* inputs = g_ptr_array_new();
+    GPtrArray* stages = g_ptr_array_new();
+    gchar** segments = g_strsplit(text, SHADER_GRAPH_STAGE_SEPARATOR, -1);
+
+    /* Labels before the first separator are inputs, a label after it names the output. 
+       Stages may also be separated by spaces only */
+    for (int seg = 0; segments[seg] && ret == RET_OK; seg++) {
+        gchar** tokens = g_strsplit_set(segments[seg], SHADER_GRAPH_TOKEN_DELIMITERS, -1);
+        for (int idx = 0; tokens[idx] && ret == RET_OK; idx++) {
+            const char* token = tokens[idx];
+            if (token[0] == '\0')
+                continue;
+            if (chain->output) {
+                ERROR_FMT("Unexpected [%s] after output label %s", token, chain->output);
+                ret = RET_ERR;
+            } else if (token[0] == SHADER_GRAPH_LABEL_PREFIX && seg == 0) {
+                if (stages->len > 0 || chain->compositor) {
+                    ERROR_FMT("Input label %s must come before stages & compositor", token);
+                    ret = RET_ERR;
+                } else {
+                    g_ptr_array_add(inputs, g_strdup(token));
+                }
+            } else if (token[0] == SHADER_GRAPH_LABEL_PREFIX) {
+                if (strcmp(token, SHADER_GRAPH_INPUT_LABEL) == 0) {
+                    ERROR("Label " SHADER_GRAPH_INPUT_LABEL " is reserved for the graph input");
+                    ret = RET_ERR;
+                } else {
+                    chain->output = g_strdup(token);
+                }
+            } else if (is_compositor(token)) {
+                if (inputs->len < 2 || stages->len > 0 || chain->compositor) {
+                    ERROR_FMT("Compositor %s must directly follow at least two input labels", token);
+                    ret = RET_ERR;
+                } else {
+                    chain->compositor = g_strdup(token);
+                }
+            } else {
+                g_ptr_array_add(stages, g_strdup(token));
+            }
+        }
+        g_strfreev(tokens);
+    }
+    g_strfreev(segments);
+
+    if (ret == RET_OK && inputs->len > 1 && !chain->compositor) {
+        ERROR("Chains with several inputs need a compositor (blend, pip or split)");
+        ret = RET_ERR;
+    }
+    if (inputs->len == 0)
+        g_ptr_array_add(inputs, g_strdup(SHADER_GRAPH_INPUT_LABEL));
+
+    chain->num_inputs = inputs->len;
+    g_ptr_array_add(inputs, NULL);
+    g_ptr_array_add(stages, NULL);
+    chain->inputs = (gchar**)g_ptr_array_free(inputs, FALSE);
+    chain->stages = (gchar**)g_ptr_array_free(stages, FALSE);
+    return ret;
+}
+
+static GHashTable* resolve_labels(GPtrArray* chains) {
+    int num_outputs = 0;
+    GHashTable* labels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    g_hash_table_insert(labels, g_strdup(SHADER_GRAPH_INPUT_LABEL), g_new0(GraphLabel, 1));
+
+    for (guint chain_idx = 0; chain_idx < chains->len; chain_idx++) {
+        GraphChain* chain = g_ptr_array_index(chains, chain_idx);
+        for (int idx = 0; chain->inputs[idx]; idx++) {
+            GraphLabel* label = g_hash_table_lookup(labels, chain->inputs[idx]);
+            if (!label) {
+                ERROR_FMT("Label %s is read before it is defined", chain->inputs[idx]);
+                g_hash_table_unref(labels);
+                return NULL;
+            }
+            label->uses++;
+        }
+
+        if (!chain->output) {
+            num_outputs++;
+        } else if (g_hash_table_contains(labels, chain->output)) {
+            ERROR_FMT("Label %s is defined twice", chain->output);
+            g_hash_table_unref(labels);
+            return NULL;
+        } else {
+            g_hash_table_insert(labels, g_strdup(chain->output), g_new0(GraphLabel, 1));
+        }
+    }
+
+    if (num_outputs != 1) {
+        ERROR_FMT("Shader graph must have exactly one chain without output label, found %d", num_outputs);
+        g_hash_table_unref(labels);
+        return NULL;
+    }
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, labels);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        if (((GraphLabel*)value)->uses == 0) {
+            ERROR_FMT("Label %s is never read", (const char*)key);
+            g_hash_table_unref(labels);
+            return NULL;
+        }
+    }
+    return labels;
+}
+
+/* Returns the element a reader of the label links from, one tee branch per reader if the label is read several times */
+static GstElement* label_output(GraphBuilder* builder, const char* name) {
+    GraphLabel* label = g_hash_table_lookup(builder->labels, name);
+    const char* short_name = name + 1;
+    char elem_name[128];
+
+    /* 1) Graph input could not be a shader stage, it becomes a tee or a passthrough element */
+    if (!label->producer && label->uses == 1) {
+        label->producer = gst_element_factory_make("identity", "graph-input");
+        CHECK(label->producer != NULL, "Failed to allocate identity element", NULL);
+        CHECK(add_and_link(builder, label->producer, NULL) == RET_OK, "Failed to add graph input", NULL);
+        builder->graph->input = label->producer;
+    }
+    if (label->uses == 1)
+        return label->producer;
+
+    /* 2) Fan-out, GL memory is shared between branches so nothing is copied or downloaded */
+    if (!label->tee) {
+        snprintf(elem_name, sizeof(elem_name), "graph-tee-%s", short_name);
+        label->tee = gst_element_factory_make("tee", elem_name);
+        CHECK(label->tee != NULL, "Failed to allocate tee element", NULL);
+        CHECK(add_and_link(builder, label->tee, label->producer) == RET_OK, "Failed to link graph tee", NULL);
+        if (!label->producer)
+            builder->graph->input = label->tee;
+    }
+
+    /* 3) Each branch needs its own thread, a compositor reading several branches of the same tee would
+       otherwise block the tee on its first input */
+    snprintf(elem_name, sizeof(elem_name), "graph-queue-%s-%d", short_name, label->num_branches++);
+    GstElement* queue = gst_element_factory_make("queue", elem_name);
+    CHECK(queue != NULL, "Failed to allocate queue element", NULL);
+    g_object_set(G_OBJECT(queue),
+                "max-size-buffers", SHADER_GRAPH_BRANCH_QUEUE_DEPTH,
+                "max-size-bytes", 0,
+                "max-size-time", (guint64)0,
+                NULL);
+    CHECK(add_and_link(builder, queue, label->tee) == RET_OK, "Failed to link graph queue", NULL);
+    return queue;
+}
+
+static GstElement* create_compositor(GraphBuilder* builder, GraphChain* chain, int idx) {
+    char elem_name[64];
+
+    /* 1) Create mixer, glvideomixer draws in the shared GL context */
+    snprintf(elem_name, sizeof(elem_name), "graph-%s-%d", chain->compositor, idx);
+    GstElement* mixer = gst_element_factory_make(builder->use_gl ? "glvideomixer" : "compositor", elem_name);
+    CHECK(mixer != NULL, "Failed to allocate compositor element", NULL);
+    g_object_set(G_OBJECT(mixer), "background", 1, NULL); // black
+    CHECK(add_and_link(builder, mixer, NULL) == RET_OK, "Failed to add compositor", NULL);
+
+    /* 2) Link & place inputs */
+    for (int input = 0; chain->inputs[input]; input++) {
+        GstElement* src = label_output(builder, chain->inputs[input]);
+        CHECK(src != NULL, "Failed to get compositor input", NULL);
+
+        GstPad* sink_pad = gst_element_request_pad_simple(mixer, "sink_%u");
+        GstPad* src_pad = gst_element_get_static_pad(src, "src");
+        place_compositor_input(sink_pad, chain->compositor, input, chain->num_inputs, builder->width, builder->height);
+        GstPadLinkReturn link_ret = gst_pad_link(src_pad, sink_pad);
+        gst_object_unref(src_pad);
+        gst_object_unref(sink_pad);
+        if (link_ret != GST_PAD_LINK_OK) {
+            ERROR_FMT("Failed to link %s to %s", chain->inputs[input], GST_ELEMENT_NAME(mixer));
+            return NULL;
+        }
+    }
+
+    /* 3) Mixers output the bounding box of their inputs, keep the frame size */
+    snprintf(elem_name, sizeof(elem_name), "graph-%s-%d-capsfilter", chain->compositor, idx);
+    GstElement* caps_filter = gst_element_factory_make("capsfilter", elem_name);
+    CHECK(caps_filter != NULL, "Failed to allocate compositor capsfilter", NULL);
+    GstCaps* caps = gst_caps_new_simple("video/x-raw",
+                                        "format", G_TYPE_STRING, "RGBA",
+                                        "width", G_TYPE_INT, builder->width,
+                                        "height", G_TYPE_INT, builder->height,
+                                        NULL);
+    if (builder->use_gl)
+        gst_caps_set_features(caps, 0, gst_caps_features_new(GST_CAPS_FEATURE_MEMORY_GL_MEMORY, NULL));
+    g_object_set(G_OBJECT(caps_filter), "caps", caps, NULL);
+    gst_caps_unref(caps);
+    CHECK(add_and_link(builder, caps_filter, mixer) == RET_OK, "Failed to link compositor capsfilter", NULL);
+    return caps_filter;
+}
+
+static void place_compositor_input(GstPad* pad, const char* compositor, int idx, int num_inputs, int width, int height) {
+    int xpos = 0, ypos = 0, w = width, h = height;
+    double alpha = 1.0;
+
+    if (strcmp(compositor, "blend") == 0) {
+        /* Drawing input i over the previous ones with alpha 1/(i+1) keeps a running average */
+        alpha = 1.0 / (idx + 1);
+    } else if (strcmp(compositor, "pip") == 0 && idx > 0) {
+        int margin = width / 32;
+        w = width / 4;
+        h = height / 4;
+        xpos = width - w - margin;
+        ypos = height - idx * (h + margin);
+    } else if (strcmp(compositor, "split") == 0) {
+        w = width / num_inputs;
+        h = height / num_inputs;
+        xpos = idx * w;
+        ypos = (height - h) / 2;
+    }
+    g_object_set(G_OBJECT(pad),
+                "xpos", xpos, "ypos", ypos,
+                "width", w, "height", h,
+                "alpha", alpha,
+                "zorder", (guint)idx,
+                NULL);
+}
+
+static int add_and_link(GraphBuilder* builder, GstElement* elem, GstElement* prev) {
+    gst_bin_add(builder->bin, elem);
+    if (prev && !gst_element_link(prev, elem)) {
+        ERROR_FMT("Failed to link %s to %s", GST_ELEMENT_NAME(prev), GST_ELEMENT_NAME(elem));
+        return RET_ERR;
+    }
+    return RET_OK;
+}
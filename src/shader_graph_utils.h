@@ -0,0 +1,40 @@
+#ifndef __SHADER_GRAPH_UTILS_H__
+#define __SHADER_GRAPH_UTILS_H__
+
+#include <gst/gst.h>
+
+/* Shader graph syntax:
+ *   graph := chain (';' chain)*
+ *   chain := [@label.. [compositor] '!'] stage ('!' stage)* ['!' @label]   (stages may omit the '!')
+ * Leading labels are the chain inputs (default @in, the uploaded frame), several inputs must be merged
+ * by a compositor. A trailing label names the chain output so later chains can read it, exactly one chain
+ * has no trailing label and feeds the rest of the pipeline.
+ * Eg. "vertical_flip ! @raw; @raw ! crt_effect ! @fx; @raw @fx pip" */
+#define SHADER_GRAPH_CHAIN_DELIMITERS ";"
+#define SHADER_GRAPH_STAGE_SEPARATOR "!"
+#define SHADER_GRAPH_TOKEN_DELIMITERS " \t"
+#define SHADER_GRAPH_LABEL_PREFIX '@'
+#define SHADER_GRAPH_INPUT_LABEL "@in"
+
+/* Depth of the queue decoupling each branch of a label read by several chains */
+#define SHADER_GRAPH_BRANCH_QUEUE_DEPTH 2
+
+typedef GstElement* (*CreateShaderFn_t)(const char* shader_name);
+
+typedef struct _ShaderGraph {
+    /* Upstream links to input, downstream to output (might be the same element) */
+    GstElement* input;
+    GstElement* output;
+    /* Shader stage elements (glshader or rtvppcpufx) in creation order, NULL terminated */
+    GstElement** shader_stages;
+    int num_shader_stages;
+} ShaderGraph;
+
+/* Returns the shader stage names referenced by the graph (g_strfreev), NULL if the description is invalid */
+gchar** list_shader_graph_stages(const char* description);
+/* Creates, adds to bin & links all graph elements. Compositors run on glvideomixer (use_gl) or compositor,
+   frames keep width x height */
+int create_shader_graph(GstBin *bin, const char* description, CreateShaderFn_t create_fn, int use_gl,
+                        int width, int height, ShaderGraph *out_graph);
+
+#endif
@@ -13,7 +13,9 @@ static int is_shader(const char* file_name, char** out_shader_name);
 static char* path_join(const char* file_part1, const char* file_part2); 
 static char* load_shader_code(const char* shader_path);
 
-/* Hash map which will store all loaded shader (mainly used for deduplication)
+static const EmbeddedShader* find_embedded_shader(const char* shader_name);
+
+/* Hash map which will store the shaders loaded from disk, these override the embedded ones
    Must be initialized via a call to init_shader_store();
 */
 static HashMap_t* shader_store = NULL;
@@ -40,7 +42,8 @@ int add_shaders_to_store(const char* shader_folder_path) {
         if (is_shader(dir_entry->d_name, &shader_name) != RET_ERR) {
             /* Compute full path. */
             char *full_path = path_join(shader_folder_path, dir_entry->d_name);
-            DEBUG_PRINT_FMT("Found shader [%s] at path: %s\n",shader_name, full_path);
+            DEBUG_PRINT_FMT("Found shader [%s] at path: %s (%s)\n",shader_name, full_path, 
+                            find_embedded_shader(shader_name) ? "overrides embedded" : "not embedded");
 
             /* Load shader code and add to store. */
             char *shader_code = load_shader_code(full_path); 
@@ -67,7 +70,42 @@ int add_shaders_to_store(const char* shader_folder_path) {
 }
 
 const char* get_shader_code(const char* shader_name) {
-    return hash_map_get(shader_store, shader_name);
+    /* Disk overrides first, then the embedded table (no filesystem access) */
+    const char* shader_code = shader_store ? hash_map_get(shader_store, shader_name) : NULL;
+    if (shader_code) 
+        return shader_code;
+    const EmbeddedShader* shader = find_embedded_shader(shader_name);
+    return shader ? shader->code : NULL;
+}
+
+void visit_shaders(ShaderVisitFn_t visit_fn, void* user_data) {
+    for (int idx = 0; idx < num_embedded_shaders; idx++) 
+        visit_fn(embedded_shaders[idx].name, user_data);
+    if (!shader_store) 
+        return;
+    HashMapIter_t iter = create_hash_map_iter(shader_store);
+    HashMapEntry_t* entry = hash_map_iter_get_next(shader_store, &iter);
+    while (entry) {
+        if (!find_embedded_shader(entry->key)) 
+            visit_fn(entry->key, user_data);
+        entry = hash_map_iter_get_next(shader_store, &iter);
+    }
+}
+
+/* Binary search on the precomputed name hash, then a name compare among (unlikely) equal hashes */
+static const EmbeddedShader* find_embedded_shader(const char* shader_name) {
+    uint64_t hash = hash_shader_name(shader_name);
+    int low = 0, high = num_embedded_shaders;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (embedded_shaders[mid].name_hash < hash) low = mid + 1;
+        else high = mid;
+    }
+    for (int idx = low; idx < num_embedded_shaders && embedded_shaders[idx].name_hash == hash; idx++) {
+        if (strcmp(embedded_shaders[idx].name, shader_name) == 0) 
+            return &embedded_shaders[idx];
+    }
+    return NULL;
 }
 
 
@@ -111,7 +149,6 @@ static char* load_shader_code(const char* shader_path) {
 }
 
 
-#define SHADER_EXT ".glsl"
 static int is_shader(const char* file_name, char** out_shader_name) {
     size_t len = strlen(file_name);
     size_t len_ext = strlen(SHADER_EXT);
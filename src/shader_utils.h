@@ -1,13 +1,47 @@
 #ifndef __SHADER_UTILS_H__
 #define __SHADER_UTILS_H__
 
+#include <stdint.h>
+
 #ifndef DEFAULT_SHADER_VERSION
 #define DEFAULT_SHADER_VERSION "#version 130\n"
 #endif
 
+#define SHADER_EXT ".glsl"
+
+/* Vertex shader paired with all fragment shaders (matches DEFAULT_SHADER_VERSION) */
+extern const char *shader_string_vertex_default;
+
+/* Shader library compiled into the binary (build/shader_table.c, generated from shaders/ by tools/embed_shaders),
+   sorted by name hash. Code already starts with DEFAULT_SHADER_VERSION */
+typedef struct _EmbeddedShader {
+    const char *name;
+    uint64_t name_hash;
+    const char *code;
+} EmbeddedShader;
+
+extern const EmbeddedShader embedded_shaders[];
+extern const int num_embedded_shaders;
+
+/* FNV-1a, shared with the table generator */
+static inline uint64_t hash_shader_name(const char* shader_name) {
+    uint64_t hash = 14695981039346656037UL;
+    while (*shader_name) {
+        hash ^= (uint64_t)(unsigned char)(*shader_name);
+        hash *= 1099511628211UL;
+        shader_name++;
+    }
+    return hash;
+}
+
+typedef void (*ShaderVisitFn_t) (const char* shader_name, void* user_data);
+
 int init_shader_store();
+/* Shaders found in the folder override (or add to) the embedded ones */
 int add_shaders_to_store(const char* shader_folder_path);
 const char* get_shader_code(const char* shader_name);
+/* Calls visit_fn once per available shader name (embedded & overrides) */
+void visit_shaders(ShaderVisitFn_t visit_fn, void* user_data);
 void cleanup_shader_store();
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,404 @@
+#include "source_utils.h"
+#include "file_utils.h"
+#include "latency_utils.h"
+#include "log_utils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int read_pattern_params(const char* source, CamParams *out_params);
+static int read_stream_params(const char* source, CamParams *out_params);
+static int parse_frame_params(const char* text, CamParams *out_params);
+static int is_animated_pattern(const char* pattern);
+static GstElement* create_pattern_source(PipelineHandle *handle, CamParams *cam_params);
+static GstElement* create_container_source(PipelineHandle *handle, CamParams *cam_params);
+static GstElement* create_stream_source(PipelineHandle *handle, CamParams *cam_params);
+static GstElement* expose_source_bin(GstElement *bin, GstElement *last, int pace);
+static void release_loose_element(GstElement *element);
+static void container_pad_added(GstElement *decoder, GstPad *pad, gpointer user_data);
+static GstPadProbeReturn sequence_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+
+int read_source_params(const char* source, CamParams *out_params) {
+    int ret;
+    if (g_str_has_prefix(source, SOURCE_PATTERN_PREFIX))
+        ret = read_pattern_params(source, out_params);
+    else if (g_str_has_prefix(source, SOURCE_FILE_PREFIX) || g_str_has_prefix(source, SOURCE_STDIN_PREFIX))
+        ret = read_stream_params(source, out_params);
+    else
+        return read_cam_params(source, out_params);
+
+    if (ret == RET_OK)
+        DEBUG_PRINT_FMT("Input source %s: width=%d, height=%d, pixelformat=%s, framerate=%d/%d\n", source,
+            out_params->width, out_params->height, pixel_format_to_str(out_params->pixelformat),
+            out_params->fr_denom, out_params->fr_num);
+    return ret;
+}
+
+int is_finite_source(const char* source) {
+    return g_str_has_prefix(source, SOURCE_FILE_PREFIX) || g_str_has_prefix(source, SOURCE_STDIN_PREFIX);
+}
+
+int select_source_fast(PipelineConfig *pipeline_config) {
+    const char* speed = pipeline_config->source_speed ? pipeline_config->source_speed : "realtime";
+    if (strcmp(speed, "realtime") == 0) return 0;
+    if (strcmp(speed, "fast") == 0) return 1;
+    ERROR_FMT("Unknown source speed %s (realtime, fast)", speed);
+    return RET_ERR;
+}
+
+static int read_pattern_params(const char* source, CamParams *out_params) {
+    gchar** fields = g_strsplit(source + strlen(SOURCE_PATTERN_PREFIX), SOURCE_PARAM_DELIMITERS, -1);
+    int num_fields = g_strv_length(fields);
+    int ret = RET_ERR;
+
+    /* 1) Defaults for whatever is left out */
+    out_params->dev_path = strdup(source);
+    out_params->source_type = CAM_SOURCE_PATTERN;
+    out_params->pattern = strdup(num_fields > 0 && fields[0][0] ? fields[0] : SOURCE_DEFAULT_PATTERN);
+    out_params->pixelformat = SOURCE_DEFAULT_FORMAT;
+    out_params->width = SOURCE_DEFAULT_WIDTH;
+    out_params->height = SOURCE_DEFAULT_HEIGHT;
+    out_params->fr_num = 1;
+    out_params->fr_denom = SOURCE_DEFAULT_FPS;
+
+    /* 2) PATTERN[,WxH@FPS[,FORMAT]] */
+    if (num_fields > 3 || (num_fields > 1 && parse_frame_params(fields[1], out_params) != RET_OK)) {
+        ERROR_FMT("Invalid input source [%s], expected %sPATTERN[,WxH@FPS[,FORMAT]]", source, SOURCE_PATTERN_PREFIX);
+        goto out;
+    }
+    if (num_fields > 2)
+        out_params->pixelformat = pixel_format_from_str(fields[2]);
+    if (out_params->pixelformat == PIX_FMT_ERROR || out_params->pixelformat == PIX_FMT_MJPG ||
+        out_params->pixelformat == PIX_FMT_H264) {
+        ERROR_FMT("Invalid input source [%s], patterns are raw frames (YUY2, I420, NV12, RGB, BGR, RGBA)", source);
+        goto out;
+    }
+    ret = RET_OK;
+
+out:
+    g_strfreev(fields);
+    return ret;
+}
+
+static int read_stream_params(const char* source, CamParams *out_params) {
+    int is_stdin = g_str_has_prefix(source, SOURCE_STDIN_PREFIX);
+    gchar** fields = g_strsplit(source + strlen(is_stdin ? SOURCE_STDIN_PREFIX : SOURCE_FILE_PREFIX),
+                                SOURCE_PARAM_DELIMITERS, -1);
+    int num_fields = g_strv_length(fields);
+    int ret = RET_ERR;
+
+    /* 1) file:PATH, the stream parameters come from the container & frames are converted to I420 in the source */
+    if (!is_stdin && num_fields == 1) {
+        GstClockTime duration = GST_CLOCK_TIME_NONE;
+        ret = read_file_params(fields[0], out_params, &duration);
+        out_params->source_type = CAM_SOURCE_CONTAINER;
+        out_params->pixelformat = PIX_FMT_I420;
+        goto out;
+    }
+
+    /* 2) Raw frames & elementary streams carry no frame size & rate, they are given after the path */
+    int first = is_stdin ? 0 : 1;
+    if (num_fields != first + 2 || parse_frame_params(fields[first], out_params) != RET_OK) {
+        ERROR_FMT("Invalid input source [%s], expected %s", source,
+                  is_stdin ? SOURCE_STDIN_PREFIX "WxH@FPS,FORMAT" : SOURCE_FILE_PREFIX "PATH[,WxH@FPS,FORMAT]");
+        goto out;
+    }
+    out_params->pixelformat = pixel_format_from_str(fields[first + 1]);
+    if (out_params->pixelformat == PIX_FMT_ERROR) {
+        ERROR_FMT("Invalid input source [%s], unknown format %s", source, fields[first + 1]);
+        goto out;
+    }
+    if (!is_stdin && !g_file_test(fields[0], G_FILE_TEST_IS_REGULAR)) {
+        ERROR_FMT("Invalid input source [%s], %s is not a file", source, fields[0]);
+        goto out;
+    }
+    out_params->dev_path = strdup(is_stdin ? "stdin" : fields[0]);
+    out_params->source_type = is_stdin ? CAM_SOURCE_STDIN : CAM_SOURCE_STREAM;
+    ret = RET_OK;
+
+out:
+    g_strfreev(fields);
+    return ret;
+}
+
+/* WxH@FPS, FPS being an integer or a fraction */
+static int parse_frame_params(const char* text, CamParams *out_params) {
+    int width = 0, height = 0, fps_num = 0, fps_denom = 1, offset = 0, frac_offset = 0;
+    if (sscanf(text, "%dx%d@%d%n", &width, &height, &fps_num, &offset) != 3)
+        return RET_ERR;
+    if (text[offset] == '/' && sscanf(text + offset, "/%d%n", &fps_denom, &frac_offset) == 1)
+        offset += frac_offset;
+    if (text[offset] != '\0' || width <= 0 || height <= 0 || fps_num <= 0 || fps_denom <= 0)
+        return RET_ERR;
+
+    out_params->width = width;
+    out_params->height = height;
+    /* Stored as time per frame, same as V4L2 */
+    out_params->fr_num = fps_denom;
+    out_params->fr_denom = fps_num;
+    return RET_OK;
+}
+
+static int is_animated_pattern(const char* pattern) {
+    static const char* animated[] = {SOURCE_ANIMATED_PATTERNS};
+    for (size_t idx = 0; idx < G_N_ELEMENTS(animated); idx++) {
+        if (strcmp(pattern, animated[idx]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+GstElement* create_input_source(PipelineHandle *handle, CamParams *cam_params) {
+    GstElement *source = NULL;
+
+    /* 1) Create the source, V4L2 devices are the only ones with driver sequence numbers & capture buffers */
+    switch (cam_params->source_type) {
+        case CAM_SOURCE_V4L2:
+            source = gst_element_factory_make("v4l2src", "camera-source");
+            CHECK(source != NULL, "Failed to allocate v4l2src element", NULL);
+            g_object_set(G_OBJECT(source), "device", cam_params->dev_path, NULL);
+            configure_latency_source(handle, source);
+            return source;
+        case CAM_SOURCE_PATTERN:
+            source = create_pattern_source(handle, cam_params);
+            break;
+        case CAM_SOURCE_CONTAINER:
+            source = create_container_source(handle, cam_params);
+            break;
+        case CAM_SOURCE_STREAM:
+        case CAM_SOURCE_STDIN:
+            source = create_stream_source(handle, cam_params);
+            break;
+        default:
+            ERROR("Unsupported input source");
+            return NULL;
+    }
+    CHECK(source != NULL, "Failed to create input source", NULL);
+
+    /* 2) Number the frames like a capture driver, the drop counters rely on the sequence */
+    GstPad *src_pad = gst_element_get_static_pad(source, "src");
+    gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_BUFFER, sequence_probe, g_new0(guint64, 1), g_free);
+    gst_object_unref(src_pad);
+    return source;
+}
+
+static GstElement* create_pattern_source(PipelineHandle *handle, CamParams *cam_params) {
+    int fast = select_source_fast(handle->config);
+    CHECK(fast != RET_ERR, "Failed to select source speed", NULL);
+    int animated = is_animated_pattern(cam_params->pattern);
+
+    /* 1) Create generator, caps (format, size & framerate) are set by the camera capsfilter downstream */
+    GstElement *pattern = gst_element_factory_make("videotestsrc", animated ? "camera-source" : "src-pattern");
+    CHECK(pattern != NULL, "Failed to allocate videotestsrc element", NULL);
+    GParamSpec *pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(pattern), "pattern");
+    GEnumValue *value = g_enum_get_value_by_nick(G_PARAM_SPEC_ENUM(pspec)->enum_class, cam_params->pattern);
+    if (!value) {
+        ERROR_FMT("Unknown test pattern [%s], see gst-inspect-1.0 videotestsrc", cam_params->pattern);
+        gst_object_unref(pattern);
+        return NULL;
+    }
+    g_object_set(G_OBJECT(pattern), "pattern", value->value, NULL);
+
+    /* 2) Animated patterns are rendered for every frame, live sources are released at their framerate */
+    if (animated) {
+        g_object_set(G_OBJECT(pattern), "is-live", !fast, NULL);
+        return pattern;
+    }
+
+    /* 3) Still patterns are rendered once & imagefreeze repeats that frame, the source costs nothing even at 4K120 */
+    GstElement *bin = gst_bin_new("camera-source");
+    GstElement *freeze = gst_element_factory_make("imagefreeze", "src-freeze");
+    if (!bin || !freeze) {
+        ERROR("Failed to allocate pattern source elements");
+        goto error;
+    }
+    g_object_set(G_OBJECT(pattern), "num-buffers", 1, NULL);
+    gst_bin_add_many(GST_BIN(bin), pattern, freeze, NULL);
+    if (!gst_element_link(pattern, freeze)) {
+        ERROR("Failed to link pattern source");
+        goto error;
+    }
+
+    /* imagefreeze can only be live since GStreamer 1.18, older ones are paced in the source bin */
+    int pace = !fast;
+    if (!fast && g_object_class_find_property(G_OBJECT_GET_CLASS(freeze), "is-live")) {
+        g_object_set(G_OBJECT(freeze), "is-live", TRUE, NULL);
+        pace = 0;
+    }
+    return expose_source_bin(bin, freeze, pace);
+
+error:
+    release_loose_element(pattern);
+    release_loose_element(freeze);
+    if (bin) gst_object_unref(bin);
+    return NULL;
+}
+
+static GstElement* create_container_source(PipelineHandle *handle, CamParams *cam_params) {
+    int fast = select_source_fast(handle->config);
+    CHECK(fast != RET_ERR, "Failed to select source speed", NULL);
+
+    /* 1) Create file source & demuxer/decoder, the decoded pad only shows up once the stream is parsed */
+    GstElement *bin = gst_bin_new("camera-source");
+    GstElement *file = gst_element_factory_make("filesrc", "src-file");
+    GstElement *decoder = gst_element_factory_make("decodebin", "src-decoder");
+    GstElement *converter = gst_element_factory_make("videoconvert", "src-convert");
+    if (!bin || !file || !decoder || !converter) {
+        ERROR("Failed to allocate file source elements");
+        goto error;
+    }
+    g_object_set(G_OBJECT(file), "location", cam_params->dev_path, NULL);
+    g_signal_connect(decoder, "pad-added", G_CALLBACK(container_pad_added), converter);
+
+    /* 2) Add & link static elements, the converter is a passthrough for decoders producing I420 */
+    gst_bin_add_many(GST_BIN(bin), file, decoder, converter, NULL);
+    if (!gst_element_link(file, decoder)) {
+        ERROR("Failed to link file source");
+        goto error;
+    }
+    return expose_source_bin(bin, converter, !fast);
+
+error:
+    release_loose_element(file);
+    release_loose_element(decoder);
+    release_loose_element(converter);
+    if (bin) gst_object_unref(bin);
+    return NULL;
+}
+
+static GstElement* create_stream_source(PipelineHandle *handle, CamParams *cam_params) {
+    int fast = select_source_fast(handle->config);
+    CHECK(fast != RET_ERR, "Failed to select source speed", NULL);
+    GstElement *bin = gst_bin_new("camera-source");
+    GstElement *reader, *caps_filter = NULL, *parser = NULL;
+    CHECK(bin != NULL, "Failed to allocate stream source bin", NULL);
+
+    /* 1) Create byte source */
+    if (cam_params->source_type == CAM_SOURCE_STDIN) {
+        reader = gst_element_factory_make("fdsrc", "src-stdin");
+        if (!reader) {
+            ERROR("Failed to allocate fdsrc element");
+            goto error;
+        }
+        g_object_set(G_OBJECT(reader), "fd", 0, NULL);
+    } else {
+        reader = gst_element_factory_make("filesrc", "src-file");
+        if (!reader) {
+            ERROR("Failed to allocate filesrc element");
+            goto error;
+        }
+        g_object_set(G_OBJECT(reader), "location", cam_params->dev_path, NULL);
+    }
+    gst_bin_add(GST_BIN(bin), reader);
+
+    /* 2) Split the bytes into frames. Raw frames have a fixed size, compressed ones are framed by their parser
+       which needs the framerate to timestamp them */
+    if (cam_params->pixelformat == PIX_FMT_H264 || cam_params->pixelformat == PIX_FMT_MJPG) {
+        int is_h264 = cam_params->pixelformat == PIX_FMT_H264;
+        caps_filter = gst_element_factory_make("capsfilter", "src-capsfilter");
+        parser = gst_element_factory_make(is_h264 ? "h264parse" : "jpegparse", "src-parser");
+        if (!caps_filter || !parser) {
+            ERROR("Failed to allocate stream parser");
+            goto error;
+        }
+        GstCaps *caps = gst_caps_new_simple(is_h264 ? "video/x-h264" : "image/jpeg",
+                                            "framerate", GST_TYPE_FRACTION, cam_params->fr_denom, cam_params->fr_num,
+                                            NULL);
+        if (is_h264)
+            gst_caps_set_simple(caps, "stream-format", G_TYPE_STRING, "byte-stream", NULL);
+        g_object_set(G_OBJECT(caps_filter), "caps", caps, NULL);
+        gst_caps_unref(caps);
+        gst_bin_add_many(GST_BIN(bin), caps_filter, parser, NULL);
+        if (!gst_element_link_many(reader, caps_filter, parser, NULL)) {
+            ERROR("Failed to link stream source");
+            goto error;
+        }
+    } else {
+        parser = gst_element_factory_make("rawvideoparse", "src-parser");
+        if (!parser) {
+            ERROR("Failed to allocate rawvideoparse element");
+            goto error;
+        }
+        gchar *format = g_ascii_strdown(pixel_format_to_str(cam_params->pixelformat), -1);
+        gst_util_set_object_arg(G_OBJECT(parser), "format", format);
+        g_free(format);
+        g_object_set(G_OBJECT(parser),
+                    "width", cam_params->width,
+                    "height", cam_params->height,
+                    "framerate", cam_params->fr_denom, cam_params->fr_num,
+                    NULL);
+        gst_bin_add(GST_BIN(bin), parser);
+        if (!gst_element_link(reader, parser)) {
+            ERROR("Failed to link stream source");
+            goto error;
+        }
+    }
+    return expose_source_bin(bin, parser, !fast);
+
+error:
+    release_loose_element(caps_filter);
+    release_loose_element(parser);
+    gst_object_unref(bin);
+    return NULL;
+}
+
+/* Exposes the last element of a source bin. Paced frames are released at their timestamps, the sinks do not 
+   sync so a non live source would otherwise run as fast as the pipeline goes. The bin is freed on failure */
+static GstElement* expose_source_bin(GstElement *bin, GstElement *last, int pace) {
+    if (pace) {
+        GstElement *pace = gst_element_factory_make("identity", "src-pace");
+        if (!pace) {
+            ERROR("Failed to allocate identity element");
+            goto error;
+        }
+        g_object_set(G_OBJECT(pace), "sync", TRUE, NULL);
+        gst_bin_add(GST_BIN(bin), pace);
+        if (!gst_element_link(last, pace)) {
+            ERROR("Failed to link source pacing");
+            goto error;
+        }
+        last = pace;
+    }
+
+    GstPad *out_pad = gst_element_get_static_pad(last, "src");
+    gboolean res = gst_element_add_pad(bin, gst_ghost_pad_new("src", out_pad));
+    gst_object_unref(out_pad);
+    if (!res) {
+        ERROR("Failed to add source ghost pad");
+        goto error;
+    }
+    return bin;
+
+error:
+    gst_object_unref(bin);
+    return NULL;
+}
+
+/* Frees an element that was not added to its source bin yet, the bin frees the others */
+static void release_loose_element(GstElement *element) {
+    if (element && !GST_OBJECT_PARENT(element))
+        gst_object_unref(element);
+}
+
+static void container_pad_added(GstElement *decoder, GstPad *pad, gpointer user_data) {
+    GstPad *sink_pad = gst_element_get_static_pad(GST_ELEMENT(user_data), "sink");
+
+    /* Only the first video stream is used, audio & other streams are left unlinked */
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (!caps) caps = gst_pad_query_caps(pad, NULL);
+    const char* media_type = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+    if (g_str_has_prefix(media_type, "video/x-raw") && !gst_pad_is_linked(sink_pad)) {
+        if (gst_pad_link(pad, sink_pad) != GST_PAD_LINK_OK)
+            ERROR_FMT("Failed to link decoded stream %s", media_type);
+    }
+    gst_caps_unref(caps);
+    gst_object_unref(sink_pad);
+}
+
+static GstPadProbeReturn sequence_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    guint64 *sequence = (guint64*)user_data;
+    GstBuffer *buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+    GST_BUFFER_OFFSET(buffer) = (*sequence)++;
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    return GST_PAD_PROBE_OK;
+}
@@ -0,0 +1,40 @@
+#ifndef __SOURCE_UTILS_H__
+#define __SOURCE_UTILS_H__
+
+#include <gst/gst.h>
+#include "cam_utils.h"
+#include "pipeline.h"
+
+/* Input source syntax, anything without a prefix is a V4L2 device:
+ *   test:PATTERN[,WxH@FPS[,FORMAT]]   synthetic frames, eg. "test:smpte,3840x2160@120,NV12"
+ *   file:PATH                         container file, decoded by decodebin
+ *   file:PATH,WxH@FPS,FORMAT          raw frames (or an H264/MJPG stream) read from a file
+ *   stdin:WxH@FPS,FORMAT              raw frames (or an H264/MJPG stream) piped on stdin
+ * FPS is an integer or a fraction (30000/1001). Every source yields the frames a camera with the same
+ * parameters would, the rest of the pipeline can not tell them apart */
+#define SOURCE_PATTERN_PREFIX "test:"
+#define SOURCE_FILE_PREFIX "file:"
+#define SOURCE_STDIN_PREFIX "stdin:"
+#define SOURCE_PARAM_DELIMITERS ","
+
+/* Pattern source defaults */
+#define SOURCE_DEFAULT_PATTERN "smpte"
+#define SOURCE_DEFAULT_WIDTH 1280
+#define SOURCE_DEFAULT_HEIGHT 720
+#define SOURCE_DEFAULT_FPS 30
+#define SOURCE_DEFAULT_FORMAT PIX_FMT_YUY2
+
+/* Patterns which change every frame, the others are rendered once & repeated (cheap enough for 4K120) */
+#define SOURCE_ANIMATED_PATTERNS "snow", "ball", "blink"
+
+/* Reads the parameters of any input source (read_cam_params for V4L2 devices) */
+int read_source_params(const char* source, CamParams *out_params);
+/* Files & pipes end, they can not be re-opened like a camera */
+int is_finite_source(const char* source);
+/* Pacing of the non V4L2 sources: "realtime" (at their framerate) or "fast" (as fast as the pipeline goes) */
+int select_source_fast(PipelineConfig *pipeline_config);
+/* Creates the source element (or bin) named "camera-source", its "src" pad yields the frames described by
+   cam_params in the same way v4l2src does: one buffer per frame, offset is the frame sequence number */
+GstElement* create_input_source(PipelineHandle *handle, CamParams *cam_params);
+
+#endif
@@ -0,0 +1,166 @@
+#include "stripe_runner.h"
+#include "log_utils.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Stripes are kept a multiple of this many rows (keeps 4:2:0 chroma rows inside a single stripe) */
+#define STRIPE_ROW_ALIGN 2
+
+struct _StripeRunner {
+    /* Spawned by the first run_stripes call (the streaming thread, not the one starting the element) */
+    pthread_t* workers;
+    int num_workers;
+    int num_threads;
+    int spawned;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    /* Current job, published under lock. Each job bumps the generation counter */
+    unsigned int generation;
+    int num_pending;
+    int shutdown;
+    StripeFn_t fn;
+    void* data;
+    int num_rows;
+    int num_stripes;
+};
+
+static void get_stripe_rows(const StripeRunner* runner, int stripe, int* first_row, int* last_row) {
+    int rows_per_stripe = (runner->num_rows + runner->num_stripes - 1) / runner->num_stripes;
+    rows_per_stripe = (rows_per_stripe + STRIPE_ROW_ALIGN - 1) / STRIPE_ROW_ALIGN * STRIPE_ROW_ALIGN;
+    *first_row = stripe * rows_per_stripe;
+    *last_row = *first_row + rows_per_stripe;
+    if (*first_row > runner->num_rows) *first_row = runner->num_rows;
+    if (*last_row > runner->num_rows) *last_row = runner->num_rows;
+}
+
+static void* worker_main(void* arg) {
+    StripeRunner* runner = (StripeRunner*)arg;
+    unsigned int seen_generation = 0;
+    int first_row, last_row;
+
+    /* Worker i always processes stripe i + 1, stripe 0 runs on the calling thread */
+    int stripe = 0;
+    pthread_mutex_lock(&runner->lock);
+    for (int idx = 0; idx < runner->num_workers; idx++) {
+        if (pthread_equal(runner->workers[idx], pthread_self())) stripe = idx + 1;
+    }
+
+    while (1) {
+        while (!runner->shutdown && runner->generation == seen_generation) 
+            pthread_cond_wait(&runner->work_cond, &runner->lock);
+        if (runner->shutdown) 
+            break;
+        seen_generation = runner->generation;
+
+        get_stripe_rows(runner, stripe, &first_row, &last_row);
+        StripeFn_t fn = runner->fn;
+        void* data = runner->data;
+        pthread_mutex_unlock(&runner->lock);
+
+        if (first_row < last_row) 
+            fn(data, first_row, last_row);
+
+        pthread_mutex_lock(&runner->lock);
+        if (--runner->num_pending == 0) 
+            pthread_cond_signal(&runner->done_cond);
+    }
+    pthread_mutex_unlock(&runner->lock);
+    return NULL;
+}
+
+StripeRunner* create_stripe_runner(int num_threads) {
+    StripeRunner* runner = calloc(1, sizeof(StripeRunner));
+    CHECK(runner != NULL, "Failed to allocate stripe runner", NULL);
+
+    /* Default to one thread per online core */
+    if (num_threads <= 0) 
+        num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads <= 0) 
+        num_threads = 1;
+
+    pthread_mutex_init(&runner->lock, NULL);
+    pthread_cond_init(&runner->work_cond, NULL);
+    pthread_cond_init(&runner->done_cond, NULL);
+    runner->num_threads = num_threads;
+    runner->workers = calloc(num_threads, sizeof(pthread_t));
+    if (!runner->workers) {
+        ERROR("Failed to allocate stripe runner workers");
+        free(runner);
+        return NULL;
+    }
+    return runner;
+}
+
+static void spawn_workers(StripeRunner* runner) {
+    /* Workers look up their own index under lock, hold it until all of them are spawned */
+    pthread_mutex_lock(&runner->lock);
+    for (int idx = 0; idx < runner->num_threads - 1; idx++) {
+        if (pthread_create(&runner->workers[idx], NULL, worker_main, runner) != 0) {
+            ERROR("Failed to spawn stripe worker");
+            break;
+        }
+        runner->num_workers++;
+    }
+    runner->spawned = 1;
+    pthread_mutex_unlock(&runner->lock);
+}
+
+void run_stripes(StripeRunner* runner, int num_rows, StripeFn_t fn, void* data) {
+    int first_row, last_row;
+
+    if (!runner->spawned) 
+        spawn_workers(runner);
+
+    /* Nothing to share the work with */
+    if (runner->num_workers == 0 || num_rows < 2 * STRIPE_ROW_ALIGN) {
+        fn(data, 0, num_rows);
+        return;
+    }
+
+    /* Publish job */
+    pthread_mutex_lock(&runner->lock);
+    runner->fn = fn;
+    runner->data = data;
+    runner->num_rows = num_rows;
+    runner->num_stripes = runner->num_workers + 1;
+    runner->num_pending = runner->num_workers;
+    runner->generation++;
+    get_stripe_rows(runner, 0, &first_row, &last_row);
+    pthread_cond_broadcast(&runner->work_cond);
+    pthread_mutex_unlock(&runner->lock);
+
+    /* Process first stripe on the calling thread, then wait for the workers */
+    fn(data, first_row, last_row);
+
+    pthread_mutex_lock(&runner->lock);
+    while (runner->num_pending > 0) 
+        pthread_cond_wait(&runner->done_cond, &runner->lock);
+    pthread_mutex_unlock(&runner->lock);
+}
+
+int stripe_runner_num_threads(const StripeRunner* runner) {
+    return runner->spawned ? runner->num_workers + 1 : runner->num_threads;
+}
+
+void cleanup_stripe_runner(StripeRunner** runner) {
+    if (!(*runner)) return;
+
+    pthread_mutex_lock(&(*runner)->lock);
+    (*runner)->shutdown = 1;
+    pthread_cond_broadcast(&(*runner)->work_cond);
+    pthread_mutex_unlock(&(*runner)->lock);
+    for (int idx = 0; idx < (*runner)->num_workers; idx++) 
+        pthread_join((*runner)->workers[idx], NULL);
+
+    pthread_mutex_destroy(&(*runner)->lock);
+    pthread_cond_destroy(&(*runner)->work_cond);
+    pthread_cond_destroy(&(*runner)->done_cond);
+    free((*runner)->workers);
+    free(*runner);
+    *runner = NULL;
+}
@@ -0,0 +1,17 @@
+#ifndef __STRIPE_RUNNER_H__
+#define __STRIPE_RUNNER_H__
+
+/* Splits per-frame work into horizontal row stripes processed on a set of persistent worker threads */
+
+/* Processes rows [first_row, last_row) */
+typedef void (*StripeFn_t)(void* data, int first_row, int last_row);
+
+typedef struct _StripeRunner StripeRunner;
+
+/* Workers are spawned by the first run_stripes call & inherit the affinity & scheduling of the calling thread */
+StripeRunner* create_stripe_runner(int num_threads);
+void run_stripes(StripeRunner* runner, int num_rows, StripeFn_t fn, void* data);
+int stripe_runner_num_threads(const StripeRunner* runner);
+void cleanup_stripe_runner(StripeRunner** runner);
+
+#endif
@@ -0,0 +1,141 @@
+#include "thread_utils.h"
+#include "log_utils.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+static const char* map_stage_to_str[__PIPELINE_STAGE_MAX] = {
+    [PIPELINE_STAGE_DEC] = "dec",
+    [PIPELINE_STAGE_PROC] = "proc",
+    [PIPELINE_STAGE_ENC] = "enc",
+    [PIPELINE_STAGE_OUT] = "out",
+};
+const char* pipeline_stage_to_str(PipelineStage stage) {
+    if (stage < 0 || stage >= __PIPELINE_STAGE_MAX) 
+        return "unknown";
+    return map_stage_to_str[stage];
+}
+
+static int parse_stage_name(const char* name) {
+    for (int stage = 0; stage < __PIPELINE_STAGE_MAX; stage++) {
+        if (strcmp(name, map_stage_to_str[stage]) == 0) 
+            return stage;
+    }
+    ERROR_FMT("Unknown pipeline stage [%s], expected dec, proc, enc or out", name);
+    return RET_ERR;
+}
+
+/* Parses a taskset style cpu list, eg. "0,2-4" */
+static int parse_cpu_list(const char* cpu_list, cpu_set_t* out_cpus) {
+    char* end = NULL;
+    CPU_ZERO(out_cpus);
+    while (*cpu_list) {
+        long first = strtol(cpu_list, &end, 10);
+        long last = first;
+        CHECK(end != cpu_list && first >= 0, "Invalid cpu list", RET_ERR);
+        if (*end == '-') {
+            cpu_list = end + 1;
+            last = strtol(cpu_list, &end, 10);
+            CHECK(end != cpu_list && last >= first, "Invalid cpu range", RET_ERR);
+        }
+        CHECK(last < CPU_SETSIZE, "Cpu index out of range", RET_ERR);
+        for (long cpu = first; cpu <= last; cpu++) 
+            CPU_SET(cpu, out_cpus);
+
+        if (*end == ',') end++;
+        else CHECK(*end == '\0', "Invalid cpu list separator", RET_ERR);
+        cpu_list = end;
+    }
+    return RET_OK;
+}
+
+static int parse_policy(const char* policy_str, int* out_policy, int* out_priority) {
+    const char* priority_str = strchr(policy_str, ':');
+    size_t len = priority_str ? (size_t)(priority_str - policy_str) : strlen(policy_str);
+
+    /* Whole token only, "f" or "" are not a policy */
+    char* policy_name = strndup(policy_str, len);
+    int ret = RET_OK;
+    if (strcmp(policy_name, "other") == 0) *out_policy = SCHED_OTHER;
+    else if (strcmp(policy_name, "batch") == 0) *out_policy = SCHED_BATCH;
+    else if (strcmp(policy_name, "fifo") == 0) *out_policy = SCHED_FIFO;
+    else if (strcmp(policy_name, "rr") == 0) *out_policy = SCHED_RR;
+    else {
+        ERROR_FMT("Unknown scheduling policy [%s], expected other, batch, fifo or rr", policy_name);
+        ret = RET_ERR;
+    }
+    free(policy_name);
+
+    *out_priority = priority_str ? atoi(priority_str + 1) : 0;
+    return ret;
+}
+
+/* Splits "stage=value;stage=value" lists and calls parse_fn on each value */ 
+typedef int (*StageValueParseFn)(const char* value, StageThreadConfig* cfg);
+
+static int parse_stage_list(const char* list, StageValueParseFn parse_fn, StageThreadConfig out_cfg[__PIPELINE_STAGE_MAX]) {
+    int ret = RET_OK;
+    char* copy_list = strdup(list);
+    char* save_ptr = NULL;
+    char* entry = strtok_r(copy_list, "; ", &save_ptr);
+    while (entry != NULL && ret == RET_OK) {
+        char* value = strchr(entry, '=');
+        if (!value) {
+            ERROR_FMT("Expected <stage>=<value>, got [%s]", entry);
+            ret = RET_ERR;
+            break;
+        }
+        *value++ = '\0';
+        int stage = parse_stage_name(entry);
+        ret = (stage == RET_ERR) ? RET_ERR : parse_fn(value, &out_cfg[stage]);
+        entry = strtok_r(NULL, "; ", &save_ptr);
+    }
+    free(copy_list);
+    return ret;
+}
+
+static int parse_affinity_value(const char* value, StageThreadConfig* cfg) {
+    cfg->has_cpus = 1;
+    return parse_cpu_list(value, &cfg->cpus);
+}
+
+static int parse_sched_value(const char* value, StageThreadConfig* cfg) {
+    cfg->has_policy = 1;
+    return parse_policy(value, &cfg->policy, &cfg->priority);
+}
+
+int parse_stage_affinity(const char* affinity, StageThreadConfig out_cfg[__PIPELINE_STAGE_MAX]) {
+    if (!affinity) return RET_OK;
+    return parse_stage_list(affinity, parse_affinity_value, out_cfg);
+}
+
+int parse_stage_sched(const char* sched, StageThreadConfig out_cfg[__PIPELINE_STAGE_MAX]) {
+    if (!sched) return RET_OK;
+    return parse_stage_list(sched, parse_sched_value, out_cfg);
+}
+
+int apply_thread_config(PipelineStage stage, const StageThreadConfig* cfg) {
+    int ret = RET_OK;
+    pthread_t self = pthread_self();
+
+    /* Threads spawned later from this thread (eg. x264 workers) inherit these settings */
+    if (cfg->has_cpus) {
+        errno = pthread_setaffinity_np(self, sizeof(cpu_set_t), &cfg->cpus);
+        if (errno != 0) {
+            ERROR_FMT("Failed to set cpu affinity for stage %s: ", pipeline_stage_to_str(stage));
+            ret = RET_ERR;
+        }
+    }
+
+    if (cfg->has_policy) {
+        struct sched_param param = { .sched_priority = cfg->priority };
+        errno = pthread_setschedparam(self, cfg->policy, &param);
+        if (errno != 0) {
+            ERROR_FMT("Failed to set scheduling policy for stage %s: ", pipeline_stage_to_str(stage));
+            ret = RET_ERR;
+        }
+    }
+
+    errno = 0;
+    return ret;
+}
@@ -0,0 +1,31 @@
+#ifndef __THREAD_UTILS_H__
+#define __THREAD_UTILS_H__
+
+#include <sched.h>
+
+/* Pipeline stages which own a streaming thread when stage threading is enabled */
+typedef enum {
+    PIPELINE_STAGE_DEC,
+    PIPELINE_STAGE_PROC,
+    PIPELINE_STAGE_ENC,
+    PIPELINE_STAGE_OUT,
+    __PIPELINE_STAGE_MAX
+} PipelineStage;
+
+typedef struct _StageThreadConfig {
+    /* CPU affinity, only applied if has_cpus is set */
+    int has_cpus;
+    cpu_set_t cpus;
+
+    /* Scheduling policy & priority, only applied if has_policy is set */
+    int has_policy;
+    int policy;
+    int priority;
+} StageThreadConfig;
+
+const char* pipeline_stage_to_str(PipelineStage stage);
+int parse_stage_affinity(const char* affinity, StageThreadConfig out_cfg[__PIPELINE_STAGE_MAX]);
+int parse_stage_sched(const char* sched, StageThreadConfig out_cfg[__PIPELINE_STAGE_MAX]);
+int apply_thread_config(PipelineStage stage, const StageThreadConfig* cfg);
+
+#endif
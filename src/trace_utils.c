@@ -0,0 +1,491 @@
+#include "trace_utils.h"
+#include "log_utils.h"
+
+#include <glib-unix.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* Ring of a single thread, only its owner writes events & advances head */
+typedef struct _TraceRing {
+    pid_t tid;
+    char name[16];
+    guint64 head;
+    /* Owner state: TRACE_RING_OWNED, TRACE_RING_EXITED (free for a new thread) or TRACE_RING_CLAIMED (being 
+       taken over). Head keeps counting across owners, events below first belong to a previous owner */
+    int state;
+    guint64 first;
+    TraceEvent events[TRACE_RING_SIZE];
+} TraceRing;
+
+enum {
+    TRACE_RING_OWNED,
+    TRACE_RING_EXITED,
+    TRACE_RING_CLAIMED,
+};
+
+/* Dump layout: TraceFileHeader, then per thread TraceThreadHeader followed by its events (oldest first) */
+typedef struct _TraceFileHeader {
+    char magic[8];
+    guint32 version;
+    guint32 num_threads;
+    guint32 reason;
+    guint32 reserved;
+    guint64 dump_time_ns;
+} TraceFileHeader;
+
+typedef struct _TraceThreadHeader {
+    gint32 tid;
+    char name[16];
+    guint32 num_events;
+} TraceThreadHeader;
+
+int trace_recording = 0;
+
+/* Rings are never freed, a dump may be copying them. Rings of exited threads (eg. decoding stages torn down 
+   by a source recovery) are handed to new threads once all slots are taken */
+static TraceRing* trace_rings[MAX_NUM_TRACE_THREADS];
+static int num_trace_rings = 0;
+static int trace_rings_full_logged = 0;
+static pthread_key_t thread_ring_key;
+static pthread_once_t thread_ring_key_once = PTHREAD_ONCE_INIT;
+static __thread TraceRing* thread_ring = NULL;
+static __thread gboolean thread_ring_failed = FALSE;
+
+static const char* map_dump_reason_to_str[__TRACE_DUMP_MAX] = {
+    [TRACE_DUMP_SIGNAL] = "signal",
+    [TRACE_DUMP_ERROR] = "error",
+    [TRACE_DUMP_LATENCY] = "latency",
+};
+
+typedef struct _TraceProbeData {
+    PipelineHandle* handle;
+    PipelineStage stage;
+} TraceProbeData;
+
+static TraceProbeData trace_probe_data[__PIPELINE_STAGE_MAX];
+
+static TraceRing* register_thread_ring();
+static void attach_stage_trace(PipelineHandle *handle, PipelineStage stage, GstPad *entry_pad, GstPad *exit_pad);
+static GstPadProbeReturn trace_enter_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn trace_leave_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn trace_capture_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn trace_latency_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static void trace_overrun_cb(GstElement *queue, gpointer user_data);
+static gboolean trace_signal_cb(gpointer user_data);
+static gboolean trace_latency_dump_cb(gpointer user_data);
+
+static inline guint64 trace_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (guint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void record_trace_event(guint16 type, guint16 id, guint32 arg, guint64 value) {
+    TraceRing *ring = thread_ring;
+    if (__builtin_expect(ring == NULL, 0)) {
+        if (thread_ring_failed || (ring = register_thread_ring()) == NULL)
+            return;
+    }
+
+    /* Fill the slot, then publish it (dumps only read slots below head) */
+    guint64 head = ring->head;
+    TraceEvent *event = &ring->events[head & (TRACE_RING_SIZE - 1)];
+    event->time_ns = trace_time_ns();
+    event->type = type;
+    event->id = id;
+    event->arg = arg;
+    event->value = value;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void attach_decoding_stage_trace(PipelineHandle *handle) {
+    if (!handle->config || !handle->config->trace_file)
+        return;
+
+    /* Capture sequence numbers restart with the device */
+    handle->trc.camera_last_offset = GST_BUFFER_OFFSET_NONE;
+
+    GstPad *cam_pad = gst_element_get_static_pad(handle->dec.cam_source, "src");
+    GstPad *out_pad = gst_element_get_static_pad(handle->dec.out_caps_filter, "src");
+    gst_pad_add_probe(cam_pad, GST_PAD_PROBE_TYPE_BUFFER, trace_capture_probe, handle, NULL);
+    attach_stage_trace(handle, PIPELINE_STAGE_DEC, cam_pad, out_pad);
+    gst_object_unref(cam_pad);
+    gst_object_unref(out_pad);
+}
+
+int start_flight_recorder(PipelineHandle *handle) {
+    if (!handle->config->trace_file)
+        return RET_OK;
+
+    /* 1) Stage enter & leave, same boundaries as the stage metrics */
+    GstElement *proc_first = handle->proc.uploader ? handle->proc.uploader : handle->proc.graph.input;
+    GstElement *enc_first = handle->enc.converter ? handle->enc.converter : 
+                            (handle->enc.encoder ? handle->enc.encoder : handle->enc.out_caps_filter);
+    GstElement *stage_bounds[][3] = {
+        [PIPELINE_STAGE_PROC] = {handle->proc.queue, proc_first, handle->proc.out_caps_filter},
+        [PIPELINE_STAGE_ENC] = {handle->enc.queue, enc_first, handle->enc.out_caps_filter},
+        [PIPELINE_STAGE_OUT] = {handle->out.disp_queue, NULL, handle->out.disp_converter},
+    };
+    for (int stage = PIPELINE_STAGE_PROC; stage <= PIPELINE_STAGE_OUT; stage++) {
+        GstElement *queue = stage_bounds[stage][0], *first = stage_bounds[stage][1], *last = stage_bounds[stage][2];
+        if ((!queue && !first) || !last)
+            continue;
+        /* Frames wait in the queue, the stage starts when the queue thread pushes them */
+        GstPad *entry_pad = queue ? gst_element_get_static_pad(queue, "src") : gst_element_get_static_pad(first, "sink");
+        GstPad *exit_pad = gst_element_get_static_pad(last, "src");
+        attach_stage_trace(handle, stage, entry_pad, exit_pad);
+        gst_object_unref(entry_pad);
+        gst_object_unref(exit_pad);
+    }
+
+    /* 2) Leaky queue drops & encoder output latency */
+    for (int idx = 0; idx < handle->lat.num_queues; idx++) {
+        PipelineStage stage = PIPELINE_STAGE_DEC;
+        for (int cur = 0; cur < __PIPELINE_STAGE_MAX; cur++) {
+            if (strcmp(handle->lat.queues[idx].stage, pipeline_stage_to_str(cur)) == 0)
+                stage = cur;
+        }
+        g_signal_connect(handle->lat.queues[idx].queue, "overrun", G_CALLBACK(trace_overrun_cb), GINT_TO_POINTER(stage));
+    }
+    GstPad *enc_pad = gst_element_get_static_pad(handle->enc.out_caps_filter, "src");
+    CHECK(enc_pad != NULL, "Failed to get encoding stage output pad", RET_ERR);
+    gst_pad_add_probe(enc_pad, GST_PAD_PROBE_TYPE_BUFFER, trace_latency_probe, handle, NULL);
+    gst_object_unref(enc_pad);
+
+    /* 3) Dump on demand: kill -USR1 <pid> */
+    handle->trc.signal_source_id = g_unix_signal_add(SIGUSR1, trace_signal_cb, handle);
+    __atomic_store_n(&trace_recording, 1, __ATOMIC_RELAXED);
+    DEBUG_PRINT_FMT("Flight recorder enabled: dumps to %s-<n>.rtvtrace on SIGUSR1, errors%s\n", 
+                    handle->config->trace_file, handle->config->trace_threshold_ms > 0 ? " & latency threshold" : "");
+    return RET_OK;
+}
+
+void stop_flight_recorder(PipelineHandle *handle) {
+    if (!handle->trc.signal_source_id)
+        return;
+    __atomic_store_n(&trace_recording, 0, __ATOMIC_RELAXED);
+    g_source_remove(handle->trc.signal_source_id);
+    handle->trc.signal_source_id = 0;
+}
+
+int dump_flight_recorder(PipelineHandle *handle, TraceDumpReason reason) {
+    if (!handle->config->trace_file)
+        return RET_OK;
+    TRACE_EVENT(TRACE_EVENT_DUMP, 0, reason, 0);
+
+    gchar *path = g_strdup_printf("%s-%d.rtvtrace", handle->config->trace_file, handle->trc.num_dumps++);
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        int err = errno;
+        errno = 0;
+        ERROR_FMT("Failed to create trace dump %s: %s", path, g_strerror(err));
+        g_free(path);
+        return RET_ERR;
+    }
+
+    /* 1) Header, rings registered after this point (or still being registered) are left for the next dump */
+    TraceRing *rings[MAX_NUM_TRACE_THREADS];
+    int num_rings = 0;
+    int num_registered = MIN(__atomic_load_n(&num_trace_rings, __ATOMIC_ACQUIRE), MAX_NUM_TRACE_THREADS);
+    for (int idx = 0; idx < num_registered; idx++) {
+        TraceRing *ring = __atomic_load_n(&trace_rings[idx], __ATOMIC_ACQUIRE);
+        if (ring && __atomic_load_n(&ring->state, __ATOMIC_ACQUIRE) != TRACE_RING_CLAIMED) 
+            rings[num_rings++] = ring;
+    }
+    TraceFileHeader header = {.version = TRACE_VERSION, .num_threads = num_rings, .reason = reason,
+                              .dump_time_ns = trace_time_ns()};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(header), 1, file);
+
+    /* 2) Copy each ring while its owner keeps writing, drop the slots overwritten during the copy */
+    TraceEvent *events = g_new(TraceEvent, TRACE_RING_SIZE);
+    guint64 total_events = 0;
+    for (int idx = 0; idx < num_rings; idx++) {
+        TraceRing *ring = rings[idx];
+        TraceThreadHeader thread_header = {0};
+        guint64 end = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        guint64 start = end > TRACE_RING_SIZE ? end - TRACE_RING_SIZE : 0;
+        start = MAX(start, MIN(__atomic_load_n(&ring->first, __ATOMIC_RELAXED), end));
+        for (guint64 pos = start; pos < end; pos++) {
+            events[pos - start] = ring->events[pos & (TRACE_RING_SIZE - 1)];
+        }
+        /* The owner may be filling slot head, which held position head - TRACE_RING_SIZE. The copy above 
+           must not be reordered after the head re-read, or overwritten slots would go unnoticed */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        guint64 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        guint64 overwritten = (head + 1 > start + TRACE_RING_SIZE) ? head + 1 - TRACE_RING_SIZE - start : 0;
+        if (overwritten > end - start)
+            overwritten = end - start;
+
+        thread_header.tid = ring->tid;
+        memcpy(thread_header.name, ring->name, sizeof(thread_header.name));
+        thread_header.num_events = (guint32)(end - start - overwritten);
+        fwrite(&thread_header, sizeof(thread_header), 1, file);
+        fwrite(events + overwritten, sizeof(TraceEvent), thread_header.num_events, file);
+        total_events += thread_header.num_events;
+    }
+    g_free(events);
+
+    int ret = (fclose(file) == 0) ? RET_OK : RET_ERR;
+    DEBUG_PRINT_FMT("Flight recorder dump (%s): %d threads, %" G_GUINT64_FORMAT " events written to %s\n",
+                    map_dump_reason_to_str[reason], num_rings, total_events, path);
+    g_free(path);
+    return ret;
+}
+
+static void release_thread_ring(void* data) {
+    __atomic_store_n(&((TraceRing*)data)->state, TRACE_RING_EXITED, __ATOMIC_RELEASE);
+}
+
+static void create_thread_ring_key() {
+    pthread_key_create(&thread_ring_key, release_thread_ring);
+}
+
+static TraceRing* claim_exited_ring() {
+    for (int idx = 0; idx < MAX_NUM_TRACE_THREADS; idx++) {
+        TraceRing *ring = __atomic_load_n(&trace_rings[idx], __ATOMIC_ACQUIRE);
+        int state = TRACE_RING_EXITED;
+        if (ring && __atomic_compare_exchange_n(&ring->state, &state, TRACE_RING_CLAIMED, FALSE, 
+                                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) 
+            return ring;
+    }
+    return NULL;
+}
+
+static TraceRing* register_thread_ring() {
+    TraceRing *ring = NULL;
+    pthread_once(&thread_ring_key_once, create_thread_ring_key);
+
+    /* First event of this thread, allocation stays off the steady state path */
+    int idx = __atomic_fetch_add(&num_trace_rings, 1, __ATOMIC_RELAXED);
+    if (idx < MAX_NUM_TRACE_THREADS) {
+        ring = g_new0(TraceRing, 1);
+        ring->state = TRACE_RING_CLAIMED;
+        __atomic_store_n(&trace_rings[idx], ring, __ATOMIC_RELEASE);
+    } else if ((ring = claim_exited_ring()) == NULL) {
+        if (!__atomic_exchange_n(&trace_rings_full_logged, 1, __ATOMIC_RELAXED)) 
+            ERROR_FMT("More than %d live threads, new threads are not traced", MAX_NUM_TRACE_THREADS);
+        thread_ring_failed = TRUE;
+        return NULL;
+    }
+
+    /* Events of a previous owner are not ours, dumps skip them */
+    ring->tid = (pid_t)syscall(SYS_gettid);
+    memset(ring->name, 0, sizeof(ring->name));
+    pthread_getname_np(pthread_self(), ring->name, sizeof(ring->name));
+    __atomic_store_n(&ring->first, ring->head, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->state, TRACE_RING_OWNED, __ATOMIC_RELEASE);
+    pthread_setspecific(thread_ring_key, ring);
+    thread_ring = ring;
+    return ring;
+}
+
+static void attach_stage_trace(PipelineHandle *handle, PipelineStage stage, GstPad *entry_pad, GstPad *exit_pad) {
+    trace_probe_data[stage] = (TraceProbeData){.handle = handle, .stage = stage};
+    gst_pad_add_probe(entry_pad, GST_PAD_PROBE_TYPE_BUFFER, trace_enter_probe, &trace_probe_data[stage], NULL);
+    gst_pad_add_probe(exit_pad, GST_PAD_PROBE_TYPE_BUFFER, trace_leave_probe, &trace_probe_data[stage], NULL);
+}
+
+static GstPadProbeReturn trace_enter_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    TraceProbeData *data = (TraceProbeData*)user_data;
+    TRACE_EVENT(TRACE_EVENT_STAGE_ENTER, data->stage, 0, GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info)));
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn trace_leave_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    TraceProbeData *data = (TraceProbeData*)user_data;
+    TRACE_EVENT(TRACE_EVENT_STAGE_LEAVE, data->stage, 0, GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info)));
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn trace_capture_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    /* v4l2src numbers captured frames, gaps are frames the driver dropped */
+    guint64 offset = GST_BUFFER_OFFSET(buffer);
+    if (offset != GST_BUFFER_OFFSET_NONE && handle->trc.camera_last_offset != GST_BUFFER_OFFSET_NONE &&
+        offset > handle->trc.camera_last_offset + 1)
+        TRACE_EVENT(TRACE_EVENT_DROP, PIPELINE_STAGE_DEC, (guint32)(offset - handle->trc.camera_last_offset - 1), 0);
+    handle->trc.camera_last_offset = offset;
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn trace_latency_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstClock *clock = GST_ELEMENT_CLOCK(handle->pipeline);
+    if (!clock || !GST_BUFFER_PTS_IS_VALID(buffer))
+        return GST_PAD_PROBE_OK;
+
+    /* Current running time minus capture running time */
+    GstClockTime now = gst_clock_get_time(clock) - gst_element_get_base_time(handle->pipeline);
+    if (now < GST_BUFFER_PTS(buffer))
+        return GST_PAD_PROBE_OK;
+    guint64 latency_ns = now - GST_BUFFER_PTS(buffer);
+    TRACE_EVENT(TRACE_EVENT_LATENCY, PIPELINE_STAGE_ENC, 0, latency_ns);
+
+    /* Dump from the main loop, a single request in flight */
+    int threshold_ms = handle->config->trace_threshold_ms;
+    if (threshold_ms > 0 && latency_ns > (guint64)threshold_ms * GST_MSECOND &&
+        g_atomic_int_compare_and_exchange(&handle->trc.dump_pending, 0, 1))
+        g_idle_add(trace_latency_dump_cb, handle);
+    return GST_PAD_PROBE_OK;
+}
+
+static void trace_overrun_cb(GstElement *queue, gpointer user_data) {
+    TRACE_EVENT(TRACE_EVENT_DROP, GPOINTER_TO_INT(user_data), 1, 0);
+}
+
+static gboolean trace_signal_cb(gpointer user_data) {
+    dump_flight_recorder((PipelineHandle*)user_data, TRACE_DUMP_SIGNAL);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean trace_latency_dump_cb(gpointer user_data) {
+    PipelineHandle *handle = (PipelineHandle*)user_data;
+    gint64 now_us = g_get_monotonic_time();
+
+    /* A slow stretch crosses the threshold on every frame, keep the first dump of each stretch */
+    if (handle->trc.last_dump_us == 0 || now_us - handle->trc.last_dump_us >= TRACE_DUMP_MIN_INTERVAL_MS * 1000LL) {
+        dump_flight_recorder(handle, TRACE_DUMP_LATENCY);
+        handle->trc.last_dump_us = now_us;
+    }
+    g_atomic_int_set(&handle->trc.dump_pending, 0);
+    return G_SOURCE_REMOVE;
+}
+
+/* Chrome trace event JSON: stage enter/leave become duration slices on the thread track,
+   drops, QoS, state changes & errors instant events, latency a counter track */
+static void write_json_event(FILE *out, gboolean *first, const TraceThreadHeader *thread, const TraceEvent *event,
+                             guint64 base_ns) {
+    double ts_us = (event->time_ns - base_ns) / 1000.0;
+    const char* stage = pipeline_stage_to_str(event->id);
+
+    fprintf(out, "%s\n", *first ? "" : ",");
+    *first = FALSE;
+    switch (event->type) {
+        case TRACE_EVENT_STAGE_ENTER:
+        case TRACE_EVENT_STAGE_LEAVE:
+            fprintf(out, "{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                    "\"args\":{\"pts_ms\":%.3f}}", stage, event->type == TRACE_EVENT_STAGE_ENTER ? "B" : "E",
+                    thread->tid, ts_us, GST_CLOCK_TIME_IS_VALID(event->value) ? event->value / 1e6 : -1.0);
+            break;
+        case TRACE_EVENT_DROP:
+            fprintf(out, "{\"name\":\"drop\",\"cat\":\"drop\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                    "\"args\":{\"stage\":\"%s\",\"frames\":%u}}", thread->tid, ts_us, stage, event->arg);
+            break;
+        case TRACE_EVENT_QOS:
+            fprintf(out, "{\"name\":\"qos\",\"cat\":\"qos\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                    "\"args\":{\"dropped\":%u,\"jitter_ms\":%.3f}}", thread->tid, ts_us, event->arg,
+                    (gint64)event->value / 1e6);
+            break;
+        case TRACE_EVENT_STATE:
+            fprintf(out, "{\"name\":\"state\",\"cat\":\"state\",\"ph\":\"i\",\"s\":\"p\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                    "\"args\":{\"from\":\"%s\",\"to\":\"%s\"}}", thread->tid, ts_us,
+                    gst_element_state_get_name((GstState)(event->arg >> 8)),
+                    gst_element_state_get_name((GstState)(event->arg & 0xFF)));
+            break;
+        case TRACE_EVENT_LATENCY:
+            fprintf(out, "{\"name\":\"latency_ms\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"latency\":%.3f}}",
+                    ts_us, event->value / 1e6);
+            break;
+        case TRACE_EVENT_ERROR:
+            fprintf(out, "{\"name\":\"error\",\"cat\":\"error\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+                    thread->tid, ts_us);
+            break;
+        case TRACE_EVENT_DUMP:
+            fprintf(out, "{\"name\":\"dump\",\"cat\":\"dump\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                    "\"args\":{\"reason\":\"%s\"}}", thread->tid, ts_us,
+                    event->arg < __TRACE_DUMP_MAX ? map_dump_reason_to_str[event->arg] : "unknown");
+            break;
+        default:
+            fprintf(out, "{\"name\":\"unknown\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+                    thread->tid, ts_us);
+            break;
+    }
+}
+
+int convert_trace_to_json(const char* path) {
+    TraceFileHeader header;
+    gchar *contents = NULL;
+    gsize length = 0;
+    GError *error = NULL;
+
+    /* 1) Load & validate dump */
+    if (!g_file_get_contents(path, &contents, &length, &error)) {
+        ERROR_FMT("Failed to read trace dump %s: %s", path, error->message);
+        g_clear_error(&error);
+        return RET_ERR;
+    }
+    if (length < sizeof(header)) {
+        ERROR_FMT("Trace dump %s is truncated", path);
+        g_free(contents);
+        return RET_ERR;
+    }
+    memcpy(&header, contents, sizeof(header));
+    if (memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 || header.version != TRACE_VERSION) {
+        ERROR_FMT("%s is not a supported trace dump", path);
+        g_free(contents);
+        return RET_ERR;
+    }
+
+    /* 2) Timestamps relative to the oldest event */
+    guint64 base_ns = header.dump_time_ns;
+    gsize pos = sizeof(header);
+    for (guint32 idx = 0; idx < header.num_threads && pos + sizeof(TraceThreadHeader) <= length; idx++) {
+        TraceThreadHeader thread;
+        memcpy(&thread, contents + pos, sizeof(thread));
+        pos += sizeof(thread);
+        if (thread.num_events > 0 && pos + sizeof(TraceEvent) <= length)
+            base_ns = MIN(base_ns, ((TraceEvent*)(contents + pos))->time_ns);
+        pos += (gsize)thread.num_events * sizeof(TraceEvent);
+    }
+
+    /* 3) Thread names, then events */
+    gchar *out_path = g_strdup_printf("%s.json", path);
+    FILE *out = fopen(out_path, "w");
+    if (!out) {
+        int err = errno;
+        errno = 0;
+        ERROR_FMT("Failed to create %s: %s", out_path, g_strerror(err));
+        g_free(out_path);
+        g_free(contents);
+        return RET_ERR;
+    }
+    gboolean first = TRUE;
+    guint64 num_events = 0;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    pos = sizeof(header);
+    for (guint32 idx = 0; idx < header.num_threads && pos + sizeof(TraceThreadHeader) <= length; idx++) {
+        TraceThreadHeader thread;
+        memcpy(&thread, contents + pos, sizeof(thread));
+        pos += sizeof(thread);
+
+        char name[sizeof(thread.name) + 1] = {0};
+        memcpy(name, thread.name, sizeof(thread.name));
+        fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",", thread.tid, name[0] ? name : "unnamed");
+        first = FALSE;
+        for (guint32 ev = 0; ev < thread.num_events && pos + sizeof(TraceEvent) <= length; ev++) {
+            TraceEvent event;
+            memcpy(&event, contents + pos, sizeof(event));
+            pos += sizeof(event);
+            write_json_event(out, &first, &thread, &event, base_ns);
+            num_events++;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    int ret = (fclose(out) == 0) ? RET_OK : RET_ERR;
+
+    DEBUG_PRINT_FMT("Converted %" G_GUINT64_FORMAT " events (%u threads, dump reason %s) to %s\n", num_events,
+                    header.num_threads, header.reason < __TRACE_DUMP_MAX ? map_dump_reason_to_str[header.reason] : "unknown",
+                    out_path);
+    g_free(out_path);
+    g_free(contents);
+    return ret;
+}
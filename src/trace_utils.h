@@ -0,0 +1,75 @@
+#ifndef __TRACE_UTILS_H__
+#define __TRACE_UTILS_H__
+
+#include <gst/gst.h>
+#include "pipeline.h"
+
+/* Flight recorder: every thread appends fixed size binary events to its own ring (single writer, no locks).
+   Rings are dumped on SIGUSR1, on pipeline errors or when the capture to encoder latency crosses a threshold,
+   dumps convert to Chrome trace JSON (chrome://tracing, ui.perfetto.dev) */
+
+/* Events kept per thread, power of 2 */
+#define TRACE_RING_SIZE 8192
+/* Rings of live threads, exited threads hand theirs over */
+#define MAX_NUM_TRACE_THREADS 64
+/* Latency triggered dumps are at least this far apart */
+#define TRACE_DUMP_MIN_INTERVAL_MS 2000
+
+#define TRACE_MAGIC "RTVPTRC1"
+#define TRACE_VERSION 1
+
+typedef enum {
+    /* id: stage, value: buffer pts */
+    TRACE_EVENT_STAGE_ENTER,
+    TRACE_EVENT_STAGE_LEAVE,
+    /* id: stage, arg: frames lost */
+    TRACE_EVENT_DROP,
+    /* arg: frames dropped by the element so far, value: jitter (ns, signed) */
+    TRACE_EVENT_QOS,
+    /* arg: old state << 8 | new state */
+    TRACE_EVENT_STATE,
+    /* value: capture to encoder output latency (ns) */
+    TRACE_EVENT_LATENCY,
+    TRACE_EVENT_ERROR,
+    /* arg: dump reason */
+    TRACE_EVENT_DUMP,
+    __TRACE_EVENT_MAX
+} TraceEventType;
+
+typedef enum {
+    TRACE_DUMP_SIGNAL,
+    TRACE_DUMP_ERROR,
+    TRACE_DUMP_LATENCY,
+    __TRACE_DUMP_MAX
+} TraceDumpReason;
+
+typedef struct _TraceEvent {
+    /* CLOCK_MONOTONIC */
+    guint64 time_ns;
+    guint16 type;
+    guint16 id;
+    guint32 arg;
+    guint64 value;
+} TraceEvent;
+
+/* Set while the recorder runs, checked inline so a disabled event costs a load & a branch */
+extern int trace_recording;
+
+#define TRACE_EVENT(type, id, arg, value) do {\
+        if (__builtin_expect(__atomic_load_n(&trace_recording, __ATOMIC_RELAXED), 0))\
+            record_trace_event((type), (id), (arg), (value));\
+    } while(0)
+
+void record_trace_event(guint16 type, guint16 id, guint32 arg, guint64 value);
+
+/* Called each time the decoding stage is (re-)created */
+void attach_decoding_stage_trace(PipelineHandle *handle);
+int start_flight_recorder(PipelineHandle *handle);
+void stop_flight_recorder(PipelineHandle *handle);
+/* Writes all rings to <trace_file>-<n>.rtvtrace, main loop only */
+int dump_flight_recorder(PipelineHandle *handle, TraceDumpReason reason);
+
+/* Converts a dump to Chrome trace JSON (<path>.json) */
+int convert_trace_to_json(const char* path);
+
+#endif
@@ -0,0 +1,139 @@
+/* Build time generator of the compiled-in shader table.
+   Usage: embed_shaders <out.c> <shader.glsl>...
+   Each shader becomes an EmbeddedShader entry (see shader_utils.h): its name (file name without .glsl),
+   its name hash & its source prefixed with DEFAULT_SHADER_VERSION. Entries are sorted by hash for lookups */
+#include "shader_utils.h"
+#include "log_utils.h"
+
+#include <stdlib.h>
+#include <libgen.h>
+
+typedef struct _ShaderFile {
+    char *name;
+    char *code;
+    size_t code_size;
+    uint64_t hash;
+} ShaderFile;
+
+static int load_shader_file(const char* path, ShaderFile* out_shader);
+static void write_string_literal(FILE* out, const char* str, size_t size);
+static int compare_shader_files(const void* a, const void* b);
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <out.c> <shader.glsl>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int num_shaders = argc - 2;
+    ShaderFile *shaders = calloc(num_shaders, sizeof(ShaderFile));
+    CHECK(shaders != NULL, "Failed to alloc shader list", EXIT_FAILURE);
+
+    /* 1) Load all shaders, sorted by name hash */
+    for (int idx = 0; idx < num_shaders; idx++) {
+        if (load_shader_file(argv[idx + 2], &shaders[idx]) != RET_OK) return EXIT_FAILURE;
+    }
+    qsort(shaders, num_shaders, sizeof(ShaderFile), compare_shader_files);
+    for (int idx = 1; idx < num_shaders; idx++) {
+        if (strcmp(shaders[idx].name, shaders[idx - 1].name) == 0) {
+            ERROR_FMT("Shader [%s] given twice", shaders[idx].name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* 2) Write the table, the version header is prepended by the compiler (string literal concatenation) */
+    FILE *out = fopen(argv[1], "w");
+    if (!out) {
+        ERROR_FMT("Failed to open %s", argv[1]);
+        return EXIT_FAILURE;
+    }
+    fprintf(out, "/* Generated by tools/embed_shaders, do not edit */\n");
+    fprintf(out, "#include \"shader_utils.h\"\n\n");
+    fprintf(out, "const EmbeddedShader embedded_shaders[] = {\n");
+    for (int idx = 0; idx < num_shaders; idx++) {
+        fprintf(out, "    {\"%s\", 0x%016llxULL,\n        DEFAULT_SHADER_VERSION\n", 
+                shaders[idx].name, (unsigned long long)shaders[idx].hash);
+        write_string_literal(out, shaders[idx].code, shaders[idx].code_size);
+        fprintf(out, "    },\n");
+    }
+    fprintf(out, "};\n\nconst int num_embedded_shaders = %d;\n", num_shaders);
+    if (fclose(out) != 0) {
+        ERROR_FMT("Failed to write %s", argv[1]);
+        remove(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    for (int idx = 0; idx < num_shaders; idx++) {
+        free(shaders[idx].name);
+        free(shaders[idx].code);
+    }
+    free(shaders);
+    return EXIT_SUCCESS;
+}
+
+static int load_shader_file(const char* path, ShaderFile* out_shader) {
+    /* Name: file name without extension, must be a valid C string as is */
+    char *path_copy = strdup(path);
+    char *file_name = basename(path_copy);
+    size_t len = strlen(file_name);
+    size_t len_ext = strlen(SHADER_EXT);
+    if ((len <= len_ext) || (strcmp(file_name + len - len_ext, SHADER_EXT) != 0)) {
+        ERROR_FMT("Not a shader file: %s", path);
+        free(path_copy);
+        return RET_ERR;
+    }
+    out_shader->name = strndup(file_name, len - len_ext);
+    free(path_copy);
+    for (const char *c = out_shader->name; *c; c++) {
+        if (*c == '"' || *c == '\\' || *c < ' ') {
+            ERROR_FMT("Unsupported shader name: %s", path);
+            return RET_ERR;
+        }
+    }
+    out_shader->hash = hash_shader_name(out_shader->name);
+
+    /* Source */
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        ERROR_FMT("Failed to open shader file %s", path);
+        return RET_ERR;
+    }
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    out_shader->code = malloc(file_size + 1);
+    CHECK(out_shader->code != NULL, "Failed to alloc shader source", RET_ERR);
+    out_shader->code_size = fread(out_shader->code, 1, file_size, file);
+    out_shader->code[out_shader->code_size] = '\0';
+    fclose(file);
+    if (out_shader->code_size != (size_t)file_size) {
+        ERROR_FMT("Failed to read shader file %s", path);
+        return RET_ERR;
+    }
+    return RET_OK;
+}
+
+/* One literal per source line, non printable characters as 3 digit octal escapes */
+static void write_string_literal(FILE* out, const char* str, size_t size) {
+    fprintf(out, "        \"");
+    for (size_t idx = 0; idx < size; idx++) {
+        unsigned char c = (unsigned char)str[idx];
+        if (c == '\n') {
+            fprintf(out, "\\n\"\n");
+            if (idx + 1 < size) fprintf(out, "        \"");
+            continue;
+        }
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c == '\t') fprintf(out, "\\t");
+        else if (c < ' ' || c >= 0x7F) fprintf(out, "\\%03o", c);
+        /* Keep "??" out of the output, it starts trigraphs */
+        else if (c == '?' && idx + 1 < size && str[idx + 1] == '?') fprintf(out, "\\?");
+        else fputc(c, out);
+    }
+    if (size == 0 || str[size - 1] != '\n') fprintf(out, "\"\n");
+}
+
+static int compare_shader_files(const void* a, const void* b) {
+    const ShaderFile *shader_a = a, *shader_b = b;
+    if (shader_a->hash != shader_b->hash) return (shader_a->hash < shader_b->hash) ? -1 : 1;
+    return strcmp(shader_a->name, shader_b->name);
+}